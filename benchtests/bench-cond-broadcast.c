@@ -0,0 +1,212 @@
+/* Benchmark a worker pool woken up with pthread_cond_broadcast.
+   Copyright (C) 2018 Free Software Foundation, Inc.
+   This file is part of the GNU C Library.
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; if not, see
+   <http://www.gnu.org/licenses/>.  */
+
+/* In each round, the main thread publishes a new generation of work
+   and broadcasts with the mutex held.  Every worker takes its share,
+   does some work without the mutex and reports back; the last one
+   signals the main thread.  The woken workers all need the mutex right
+   away, so the number of context switches per round shows whether they
+   are woken up at once, only to block on the mutex again.  */
+
+#include <errno.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include "bench-timing.h"
+#include "json-lib.h"
+
+/* Benchmark duration in seconds.  */
+#define BENCHMARK_DURATION	10
+
+/* Iterations of the work loop each worker runs per round without
+   holding the mutex.  */
+#define WORK_ITERATIONS		1000
+
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t work_cond = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t done_cond = PTHREAD_COND_INITIALIZER;
+
+/* Protected by LOCK.  */
+static unsigned long generation;
+static size_t pending;
+static bool stop;
+
+static volatile bool timeout;
+
+static void
+alarm_handler (int signum)
+{
+  timeout = true;
+}
+
+static void *
+worker_thread (void *arg)
+{
+  unsigned long seen = 0;
+
+  pthread_mutex_lock (&lock);
+  while (true)
+    {
+      while (generation == seen && !stop)
+	pthread_cond_wait (&work_cond, &lock);
+      if (stop)
+	break;
+      seen = generation;
+      pthread_mutex_unlock (&lock);
+
+      for (volatile int i = 0; i < WORK_ITERATIONS; i++)
+	;
+
+      pthread_mutex_lock (&lock);
+      if (--pending == 0)
+	pthread_cond_signal (&done_cond);
+    }
+  pthread_mutex_unlock (&lock);
+
+  return NULL;
+}
+
+static timing_t
+do_benchmark (size_t num_threads, size_t *iters)
+{
+  pthread_t threads[num_threads];
+  timing_t start, stop_time, elapsed;
+
+  for (size_t i = 0; i < num_threads; i++)
+    pthread_create (&threads[i], NULL, worker_thread, NULL);
+
+  *iters = 0;
+  TIMING_NOW (start);
+  while (!timeout)
+    {
+      pthread_mutex_lock (&lock);
+      generation++;
+      pending = num_threads;
+      pthread_cond_broadcast (&work_cond);
+      while (pending != 0)
+	pthread_cond_wait (&done_cond, &lock);
+      pthread_mutex_unlock (&lock);
+      (*iters)++;
+    }
+  TIMING_NOW (stop_time);
+  TIMING_DIFF (elapsed, start, stop_time);
+
+  pthread_mutex_lock (&lock);
+  stop = true;
+  pthread_cond_broadcast (&work_cond);
+  pthread_mutex_unlock (&lock);
+
+  for (size_t i = 0; i < num_threads; i++)
+    pthread_join (threads[i], NULL);
+
+  return elapsed;
+}
+
+static void usage(const char *name)
+{
+  fprintf (stderr, "%s: <num_threads>\n", name);
+  exit (1);
+}
+
+int
+main (int argc, char **argv)
+{
+  timing_t cur;
+  size_t iters = 0, num_threads = 8;
+  unsigned long res;
+  json_ctx_t json_ctx;
+  double d_total_s, d_total_i;
+  struct sigaction act;
+
+  if (argc == 2)
+    {
+      long ret;
+
+      errno = 0;
+      ret = strtol(argv[1], NULL, 10);
+
+      if (errno || ret <= 0)
+	usage(argv[0]);
+
+      num_threads = ret;
+    }
+  else if (argc != 1)
+    usage(argv[0]);
+
+  json_init (&json_ctx, 0, stdout);
+
+  json_document_begin (&json_ctx);
+
+  json_attr_string (&json_ctx, "timing_type", TIMING_TYPE);
+
+  json_attr_object_begin (&json_ctx, "functions");
+
+  json_attr_object_begin (&json_ctx, "pthread_cond_broadcast");
+
+  json_attr_object_begin (&json_ctx, "");
+
+  TIMING_INIT (res);
+
+  (void) res;
+
+  memset (&act, 0, sizeof (act));
+  act.sa_handler = &alarm_handler;
+
+  sigaction (SIGALRM, &act, NULL);
+
+  alarm (BENCHMARK_DURATION);
+
+  cur = do_benchmark (num_threads, &iters);
+
+  /* The counts include all threads of the process.  */
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+
+  d_total_s = cur;
+  d_total_i = iters;
+
+  json_attr_double (&json_ctx, "duration", d_total_s);
+  json_attr_double (&json_ctx, "iterations", d_total_i);
+  json_attr_double (&json_ctx, "time_per_iteration", d_total_s / d_total_i);
+  json_attr_double (&json_ctx, "voluntary_context_switches",
+		    usage.ru_nvcsw);
+  json_attr_double (&json_ctx, "involuntary_context_switches",
+		    usage.ru_nivcsw);
+  json_attr_double (&json_ctx, "context_switches_per_iteration",
+		    (usage.ru_nvcsw + usage.ru_nivcsw) / d_total_i);
+
+  json_attr_double (&json_ctx, "threads", num_threads);
+  json_attr_double (&json_ctx, "work_iterations", WORK_ITERATIONS);
+
+  json_attr_object_end (&json_ctx);
+
+  json_attr_object_end (&json_ctx);
+
+  json_attr_object_end (&json_ctx);
+
+  json_document_end (&json_ctx);
+
+  return 0;
+}
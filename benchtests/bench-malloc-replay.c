@@ -0,0 +1,655 @@
+/* Benchmark malloc by replaying allocation traces.
+   Copyright (C) 2018 Free Software Foundation, Inc.
+   This file is part of the GNU C Library.
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; if not, see
+   <http://www.gnu.org/licenses/>.  */
+
+/* The traces are recorded by malloc if glibc.malloc.trace_file is set.
+   Every thread of the trace is replayed by a thread of the benchmark,
+   which performs the calls of the traced thread in the same order.  A call
+   which uses a block allocated by another thread waits until that
+   thread has made the call which returned the block, so the replay
+   follows the global order of the trace where it matters and runs
+   concurrently otherwise.
+
+   All memory of the benchmark itself is obtained with mmap and
+   touched before the replay starts.  The peak RSS is reset before the
+   replay, so that the peak RSS measured after the replay, minus the
+   RSS before it, is the memory used by malloc.  The fragmentation is
+   the ratio of that memory to the peak number of bytes requested by
+   live blocks, computed in the order of the trace.  The replay writes
+   to the blocks it allocates outside of the timed calls, so that they
+   are part of the RSS.  */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <malloc.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <malloc/malloc-trace.h>
+
+#include "bench-timing.h"
+#include "json-lib.h"
+
+/* Number of calls of the trace which are replayed at most.  */
+#define MAX_OPERATIONS (64 * 1024 * 1024)
+
+/* A call to replay.  */
+struct operation
+{
+  /* An enum malloc_trace_op value.  */
+  int32_t op;
+  /* Index of the block in blocks.  */
+  uint32_t block;
+  /* Size and alignment of the request.  */
+  uint64_t size;
+  uint64_t arg;
+  /* The call which has to complete first, as the index of its thread
+     and its position in that thread, or wait_thread == UINT32_MAX.  */
+  uint32_t wait_thread;
+  uint32_t wait_index;
+};
+
+/* A thread of the replay.  */
+struct replay_thread
+{
+  struct operation *ops;
+  size_t nops;
+  timing_t *latencies;
+  /* Number of calls completed by the thread.  Read by the other
+     threads.  */
+  size_t done;
+  pthread_t handle;
+} __attribute__ ((aligned (64)));
+
+static struct replay_thread *threads;
+static size_t nthreads;
+/* Number of threads in the trace.  */
+static size_t trace_threads;
+/* The blocks allocated by the replay.  */
+static void **blocks;
+static size_t nblocks;
+/* Peak number of bytes requested by live blocks.  */
+static uint64_t peak_live_bytes;
+
+static size_t page_size;
+
+static pthread_barrier_t start_barrier;
+static pthread_barrier_t ready_barrier;
+
+static const char *const op_names[] =
+  {
+    [malloc_trace_malloc] = "malloc",
+    [malloc_trace_calloc] = "calloc",
+    [malloc_trace_realloc] = "realloc",
+    [malloc_trace_free] = "free",
+    [malloc_trace_memalign] = "memalign",
+  };
+#define NUM_OPS (sizeof (op_names) / sizeof (op_names[0]))
+
+static void __attribute__ ((noreturn))
+error_exit (const char *message, const char *arg)
+{
+  fprintf (stderr, "bench-malloc-replay: %s%s%s\n", message,
+	   arg != NULL ? ": " : "", arg != NULL ? arg : "");
+  exit (1);
+}
+
+/* Allocate SIZE bytes of zeroed memory which does not come from
+   malloc, and touch it.  */
+static void *
+xmmap (size_t size)
+{
+  if (size == 0)
+    size = 1;
+  void *p = mmap (NULL, size, PROT_READ | PROT_WRITE,
+		  MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE, -1, 0);
+  if (p == MAP_FAILED)
+    error_exit ("mmap failed", strerror (errno));
+  memset (p, 0, size);
+  return p;
+}
+
+static int
+compare_seq (const void *l, const void *r)
+{
+  const struct malloc_trace_record *left = l;
+  const struct malloc_trace_record *right = r;
+  if (left->seq < right->seq)
+    return -1;
+  return left->seq > right->seq;
+}
+
+static int
+compare_timing (const void *l, const void *r)
+{
+  timing_t left = *(const timing_t *) l;
+  timing_t right = *(const timing_t *) r;
+  if (left < right)
+    return -1;
+  return left > right;
+}
+
+/* Map the trace file NAME and return its records sorted in the order
+   of the calls.  */
+static struct malloc_trace_record *
+read_trace (const char *name, size_t *count)
+{
+  int fd = open (name, O_RDONLY);
+  if (fd < 0)
+    error_exit ("cannot open trace", name);
+  struct stat st;
+  if (fstat (fd, &st) != 0)
+    error_exit ("cannot stat trace", name);
+  struct malloc_trace_header header;
+  if (st.st_size < (off_t) sizeof (header)
+      || read (fd, &header, sizeof (header)) != sizeof (header)
+      || memcmp (header.magic, MALLOC_TRACE_MAGIC,
+		 sizeof (header.magic)) != 0
+      || header.version != MALLOC_TRACE_VERSION
+      || header.record_size != sizeof (struct malloc_trace_record))
+    error_exit ("not a malloc trace", name);
+
+  /* A trace which is cut short by a crash may end in the middle of a
+     record.  */
+  size_t n = (st.st_size - sizeof (header)) / header.record_size;
+  if (n > MAX_OPERATIONS)
+    n = MAX_OPERATIONS;
+  struct malloc_trace_record *records = xmmap (n * sizeof (*records));
+  size_t size = n * sizeof (*records);
+  for (size_t done = 0; done < size; )
+    {
+      ssize_t ret = read (fd, (char *) records + done, size - done);
+      if (ret <= 0)
+	error_exit ("cannot read trace", name);
+      done += ret;
+    }
+  close (fd);
+
+  qsort (records, n, sizeof (*records), compare_seq);
+  *count = n;
+  return records;
+}
+
+/* Hash table from the addresses of the trace to the blocks of the
+   replay.  Entries are never removed, an address which is not
+   allocated maps to UINT32_MAX.  */
+struct address_map
+{
+  uint64_t *keys;
+  uint32_t *values;
+  size_t mask;
+};
+
+static uint32_t *
+address_lookup (struct address_map *map, uint64_t ptr)
+{
+  size_t i = (ptr >> 4) * 0x9e3779b97f4a7c15ULL;
+  while (true)
+    {
+      i &= map->mask;
+      if (map->keys[i] == ptr)
+	return &map->values[i];
+      if (map->keys[i] == 0)
+	{
+	  map->keys[i] = ptr;
+	  map->values[i] = UINT32_MAX;
+	  return &map->values[i];
+	}
+      ++i;
+    }
+}
+
+/* Translate the trace into the operations of the replay threads.  */
+static void
+prepare_replay (struct malloc_trace_record *records, size_t count)
+{
+  /* Find the first and the last call of every thread of the trace.  */
+  size_t max_thread = 0;
+  for (size_t i = 0; i < count; ++i)
+    if (records[i].thread > max_thread)
+      max_thread = records[i].thread;
+  size_t *first = xmmap ((max_thread + 1) * sizeof (size_t));
+  size_t *last = xmmap ((max_thread + 1) * sizeof (size_t));
+  for (size_t i = count; i > 0; --i)
+    first[records[i - 1].thread] = i - 1;
+  for (size_t i = 0; i < count; ++i)
+    last[records[i].thread] = i;
+
+  /* Traces of programs which create many short-lived threads may
+     contain more threads than can run at the same time.  A replay
+     thread therefore replays a thread of the trace after another if
+     they did not overlap, so that there are only as many replay
+     threads as threads were running at the same time in the trace.
+     The calls of each replay thread are still in the order of the
+     trace, so waiting for calls of other threads cannot deadlock.  */
+  threads = xmmap ((max_thread + 1) * sizeof (*threads));
+  size_t *thread_end = xmmap ((max_thread + 1) * sizeof (size_t));
+  uint32_t *thread_index = xmmap ((max_thread + 1) * sizeof (uint32_t));
+  uint32_t *thread_of = xmmap (count * sizeof (uint32_t));
+  for (size_t i = 0; i < count; ++i)
+    {
+      uint32_t number = records[i].thread;
+      if (first[number] == i)
+	{
+	  size_t t;
+	  for (t = 0; t < nthreads; ++t)
+	    if (thread_end[t] < i)
+	      break;
+	  if (t == nthreads)
+	    ++nthreads;
+	  thread_end[t] = last[number];
+	  thread_index[number] = t;
+	  ++trace_threads;
+	}
+      thread_of[i] = thread_index[number];
+      ++threads[thread_of[i]].nops;
+    }
+  munmap (first, (max_thread + 1) * sizeof (size_t));
+  munmap (last, (max_thread + 1) * sizeof (size_t));
+  munmap (thread_end, (max_thread + 1) * sizeof (size_t));
+  munmap (thread_index, (max_thread + 1) * sizeof (uint32_t));
+  for (size_t i = 0; i < nthreads; ++i)
+    {
+      threads[i].ops = xmmap (threads[i].nops * sizeof (struct operation));
+      threads[i].latencies = xmmap (threads[i].nops * sizeof (timing_t));
+      threads[i].nops = 0;
+    }
+
+  struct address_map map;
+  size_t slots = 16;
+  while (slots < 2 * count)
+    slots *= 2;
+  map.keys = xmmap (slots * sizeof (uint64_t));
+  map.values = xmmap (slots * sizeof (uint32_t));
+  map.mask = slots - 1;
+
+  /* For every block, the size requested and the last call using it, to
+     find the dependencies between threads.  */
+  uint64_t *block_size = xmmap (count * sizeof (uint64_t));
+  uint32_t *last_thread = xmmap (count * sizeof (uint32_t));
+  uint32_t *last_index = xmmap (count * sizeof (uint32_t));
+  uint64_t live_bytes = 0;
+
+  for (size_t i = 0; i < count; ++i)
+    {
+      struct malloc_trace_record *r = &records[i];
+      size_t t = thread_of[i];
+      struct operation *op = &threads[t].ops[threads[t].nops];
+      op->op = -1;
+      op->size = r->size;
+      op->arg = r->arg;
+      op->wait_thread = UINT32_MAX;
+
+      /* The block used by the call, if any.  */
+      uint32_t *old = NULL;
+      if (r->op == malloc_trace_free)
+	old = address_lookup (&map, r->ptr);
+      else if (r->op == malloc_trace_realloc && r->arg != 0)
+	old = address_lookup (&map, r->arg);
+      if (old != NULL && *old == UINT32_MAX)
+	/* The block was allocated before the trace started or by a
+	   call which was not recorded.  */
+	old = NULL;
+      if (old != NULL && last_thread[*old] != t)
+	{
+	  op->wait_thread = last_thread[*old];
+	  op->wait_index = last_index[*old];
+	}
+
+      uint32_t block;
+      switch (r->op)
+	{
+	case malloc_trace_malloc:
+	case malloc_trace_calloc:
+	case malloc_trace_memalign:
+	  if (r->ptr == 0)
+	    break;
+	  block = nblocks++;
+	  op->op = r->op;
+	  op->block = block;
+	  *address_lookup (&map, r->ptr) = block;
+	  block_size[block] = r->size;
+	  live_bytes += r->size;
+	  break;
+
+	case malloc_trace_free:
+	  if (old == NULL)
+	    break;
+	  op->op = r->op;
+	  op->block = block = *old;
+	  *old = UINT32_MAX;
+	  live_bytes -= block_size[block];
+	  break;
+
+	case malloc_trace_realloc:
+	  if (old == NULL)
+	    {
+	      /* Replay realloc of an unknown block as malloc.  */
+	      if (r->ptr == 0)
+		break;
+	      block = nblocks++;
+	      op->op = malloc_trace_malloc;
+	      op->block = block;
+	      block_size[block] = 0;
+	    }
+	  else
+	    {
+	      if (r->ptr == 0)
+		/* Failed, the old block stays allocated.  */
+		break;
+	      op->op = r->op;
+	      op->block = block = *old;
+	      *old = UINT32_MAX;
+	    }
+	  *address_lookup (&map, r->ptr) = block;
+	  live_bytes += r->size - block_size[block];
+	  block_size[block] = r->size;
+	  break;
+	}
+
+      /* Calls which are not replayed, such as failed allocations and
+	 frees of unknown blocks, are dropped, so that they neither
+	 touch a block nor count in the latencies.  */
+      if (op->op >= 0)
+	{
+	  last_thread[op->block] = t;
+	  last_index[op->block] = threads[t].nops;
+	  if (live_bytes > peak_live_bytes)
+	    peak_live_bytes = live_bytes;
+	  ++threads[t].nops;
+	}
+    }
+
+  blocks = xmmap (nblocks * sizeof (void *));
+
+  munmap (block_size, count * sizeof (uint64_t));
+  munmap (last_thread, count * sizeof (uint32_t));
+  munmap (last_index, count * sizeof (uint32_t));
+  munmap (map.keys, slots * sizeof (uint64_t));
+  munmap (map.values, slots * sizeof (uint32_t));
+  munmap (thread_of, count * sizeof (uint32_t));
+}
+
+static void *
+replay_thread (void *closure)
+{
+  struct replay_thread *self = closure;
+
+  pthread_barrier_wait (&ready_barrier);
+  pthread_barrier_wait (&start_barrier);
+
+  for (size_t i = 0; i < self->nops; ++i)
+    {
+      struct operation *op = &self->ops[i];
+      if (op->wait_thread != UINT32_MAX)
+	while (__atomic_load_n (&threads[op->wait_thread].done,
+				__ATOMIC_ACQUIRE) <= op->wait_index)
+	  sched_yield ();
+
+      timing_t start, stop;
+      void *p;
+      TIMING_NOW (start);
+      switch (op->op)
+	{
+	case malloc_trace_malloc:
+	  blocks[op->block] = malloc (op->size);
+	  break;
+	case malloc_trace_calloc:
+	  blocks[op->block] = calloc (1, op->size);
+	  break;
+	case malloc_trace_realloc:
+	  p = realloc (blocks[op->block], op->size);
+	  if (p != NULL || op->size == 0)
+	    blocks[op->block] = p;
+	  break;
+	case malloc_trace_free:
+	  free (blocks[op->block]);
+	  blocks[op->block] = NULL;
+	  break;
+	case malloc_trace_memalign:
+	  blocks[op->block] = memalign (op->arg, op->size);
+	  break;
+	}
+      TIMING_NOW (stop);
+      TIMING_DIFF (self->latencies[i], start, stop);
+
+      /* Write to every page of the block, as the traced program
+	 presumably did.  */
+      if (op->op != malloc_trace_free && blocks[op->block] != NULL)
+	for (size_t offset = 0; offset < op->size; offset += page_size)
+	  ((volatile char *) blocks[op->block])[offset] = 1;
+
+      __atomic_store_n (&self->done, i + 1, __ATOMIC_RELEASE);
+    }
+
+  return NULL;
+}
+
+/* Return the value of FIELD in /proc/self/status in kilobytes, or -1
+   if it is not available.  */
+static long
+proc_status_kb (const char *field)
+{
+  char buf[4096];
+  ssize_t n = -1;
+  int fd = open ("/proc/self/status", O_RDONLY);
+  if (fd >= 0)
+    {
+      n = read (fd, buf, sizeof (buf) - 1);
+      close (fd);
+    }
+  if (n <= 0)
+    return -1;
+  buf[n] = '\0';
+  size_t len = strlen (field);
+  for (char *p = buf; p != NULL; p = strchr (p, '\n'))
+    {
+      if (*p == '\n')
+	++p;
+      if (strncmp (p, field, len) == 0 && p[len] == ':')
+	return strtol (p + len + 1, NULL, 10);
+    }
+  return -1;
+}
+
+/* Return the peak RSS of the process in kilobytes.  */
+static long
+max_rss (void)
+{
+  long rss = proc_status_kb ("VmHWM");
+  if (rss < 0)
+    {
+      struct rusage usage;
+      getrusage (RUSAGE_SELF, &usage);
+      rss = usage.ru_maxrss;
+    }
+  return rss;
+}
+
+/* Reset the peak RSS to the current RSS, and return the current RSS in
+   kilobytes.  Without support for resetting the peak RSS, return the
+   peak RSS, which includes the memory used to read the trace.  */
+static long
+reset_max_rss (void)
+{
+  int fd = open ("/proc/self/clear_refs", O_WRONLY);
+  if (fd < 0)
+    return max_rss ();
+  bool reset = write (fd, "5", 1) == 1;
+  close (fd);
+  long rss = proc_status_kb ("VmRSS");
+  if (!reset || rss < 0)
+    return max_rss ();
+  return rss;
+}
+
+static double
+wall_clock (void)
+{
+  struct timespec ts;
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* Write the number of calls and the latency percentiles of the calls
+   of type OP, or of all calls if OP is -1.  */
+static void
+report_latencies (json_ctx_t *json_ctx, const char *name, int op,
+		  timing_t *sorted)
+{
+  size_t n = 0;
+  for (size_t t = 0; t < nthreads; ++t)
+    for (size_t i = 0; i < threads[t].nops; ++i)
+      if (op < 0 || threads[t].ops[i].op == op)
+	sorted[n++] = threads[t].latencies[i];
+  if (n == 0)
+    return;
+  qsort (sorted, n, sizeof (*sorted), compare_timing);
+
+  static const struct
+  {
+    const char *name;
+    double fraction;
+  } percentiles[] =
+    {
+      { "p50", 0.5 },
+      { "p90", 0.9 },
+      { "p99", 0.99 },
+      { "p99.9", 0.999 },
+    };
+
+  json_attr_object_begin (json_ctx, name);
+  json_attr_double (json_ctx, "calls", n);
+  for (size_t i = 0; i < sizeof (percentiles) / sizeof (percentiles[0]); ++i)
+    json_attr_double (json_ctx, percentiles[i].name,
+		      sorted[(size_t) (percentiles[i].fraction * (n - 1))]);
+  json_attr_double (json_ctx, "max", sorted[n - 1]);
+  json_attr_object_end (json_ctx);
+}
+
+static void
+usage (const char *name)
+{
+  fprintf (stderr, "%s: <trace-file>\n", name);
+  exit (1);
+}
+
+int
+main (int argc, char **argv)
+{
+  json_ctx_t json_ctx;
+  unsigned long res;
+
+  if (argc != 2)
+    usage (argv[0]);
+
+  size_t count;
+  struct malloc_trace_record *records = read_trace (argv[1], &count);
+  prepare_replay (records, count);
+  munmap (records, count * sizeof (*records));
+
+  TIMING_INIT (res);
+  (void) res;
+
+  page_size = sysconf (_SC_PAGESIZE);
+
+  pthread_barrier_init (&ready_barrier, NULL, nthreads + 1);
+  pthread_barrier_init (&start_barrier, NULL, nthreads + 1);
+  for (size_t i = 0; i < nthreads; ++i)
+    if (pthread_create (&threads[i].handle, NULL, replay_thread,
+			&threads[i]) != 0)
+      error_exit ("cannot create thread", NULL);
+
+  /* Measure the RSS once the threads have been set up.  */
+  pthread_barrier_wait (&ready_barrier);
+  long rss_before = reset_max_rss ();
+  double start = wall_clock ();
+  pthread_barrier_wait (&start_barrier);
+  for (size_t i = 0; i < nthreads; ++i)
+    pthread_join (threads[i].handle, NULL);
+  double elapsed = wall_clock () - start;
+  long rss_after = max_rss ();
+
+  size_t calls = 0;
+  timing_t total = 0;
+  for (size_t t = 0; t < nthreads; ++t)
+    for (size_t i = 0; i < threads[t].nops; ++i)
+      {
+	++calls;
+	TIMING_ACCUM (total, threads[t].latencies[i]);
+      }
+  double malloc_bytes = (double) (rss_after - rss_before) * 1024;
+
+  json_init (&json_ctx, 0, stdout);
+
+  json_document_begin (&json_ctx);
+
+  json_attr_string (&json_ctx, "timing_type", TIMING_TYPE);
+
+  json_attr_object_begin (&json_ctx, "functions");
+
+  json_attr_object_begin (&json_ctx, "malloc-replay");
+
+  json_attr_object_begin (&json_ctx, "");
+
+  json_attr_string (&json_ctx, "trace", argv[1]);
+  json_attr_double (&json_ctx, "threads", nthreads);
+  json_attr_double (&json_ctx, "trace_threads", trace_threads);
+  json_attr_double (&json_ctx, "calls", calls);
+  json_attr_double (&json_ctx, "duration", total);
+  json_attr_double (&json_ctx, "time_per_call", calls ? total / calls : 0);
+  json_attr_double (&json_ctx, "wall_time", elapsed);
+  json_attr_double (&json_ctx, "throughput",
+		    elapsed > 0 ? calls / elapsed : 0);
+  json_attr_double (&json_ctx, "max_rss", rss_after);
+  json_attr_double (&json_ctx, "base_rss", rss_before);
+  json_attr_double (&json_ctx, "peak_live_bytes", peak_live_bytes);
+  json_attr_double (&json_ctx, "fragmentation",
+		    peak_live_bytes ? malloc_bytes / peak_live_bytes : 0);
+
+  json_attr_object_begin (&json_ctx, "latency");
+  timing_t *sorted = xmmap (count * sizeof (timing_t));
+  report_latencies (&json_ctx, "all", -1, sorted);
+  for (int op = 0; op < NUM_OPS; ++op)
+    report_latencies (&json_ctx, op_names[op], op, sorted);
+  json_attr_object_end (&json_ctx);
+
+  json_attr_object_end (&json_ctx);
+
+  json_attr_object_end (&json_ctx);
+
+  json_attr_object_end (&json_ctx);
+
+  json_document_end (&json_ctx);
+
+  /* Release the blocks which were still allocated at the end of the
+     trace.  */
+  for (size_t i = 0; i < nblocks; ++i)
+    free (blocks[i]);
+
+  return 0;
+}
@@ -286,6 +286,58 @@ compare (const struct cache_entry *e1, const struct cache_entry *e2)
   return res;
 }
 
+/* Build the hash table for the new format of the cache, which maps
+   each library name to the range of its entries.  The entries are
+   sorted already, so all entries for a name are adjacent.  Store the
+   size of the table in *SIZE.  */
+static struct cache_hash_table *
+build_hash_table (size_t *size)
+{
+  /* Keep the load factor at or below one half, so that probe
+     sequences stay short.  */
+  uint32_t nslots = 1;
+  uint32_t count = 0;
+  for (struct cache_entry *entry = entries; entry != NULL;
+       entry = entry->next)
+    ++count;
+  while (nslots < 2 * count)
+    nslots *= 2;
+
+  *size = sizeof (struct cache_hash_table)
+    + nslots * sizeof (struct cache_hash_slot);
+  struct cache_hash_table *table = xmalloc (*size);
+  memset (table, '\0', *size);
+  table->magic = CACHE_HASH_MAGIC;
+  table->nslots = nslots;
+
+  uint32_t idx = 0;
+  struct cache_entry *entry = entries;
+  while (entry != NULL)
+    {
+      /* Find the end of the entries for this name.  */
+      uint32_t first = idx;
+      struct cache_entry *next = entry->next;
+      ++idx;
+      while (next != NULL && _dl_cache_libcmp (entry->lib, next->lib) == 0)
+	{
+	  next = next->next;
+	  ++idx;
+	}
+
+      uint32_t hash = _dl_cache_hash (entry->lib);
+      uint32_t slot = hash & (nslots - 1);
+      while (table->slots[slot].count != 0)
+	slot = (slot + 1) & (nslots - 1);
+      table->slots[slot].hash = hash;
+      table->slots[slot].first = first;
+      table->slots[slot].count = idx - first;
+
+      entry = next;
+    }
+
+  return table;
+}
+
 /* Save the contents of the cache.  */
 void
 save_cache (const char *cache_name)
@@ -419,6 +471,19 @@ save_cache (const char *cache_name)
       && idx_old < cache_entry_old_count)
     file_entries->libs[idx_old] = file_entries->libs[idx_old - 1];
 
+  /* The hash table follows the string table.  */
+  struct cache_hash_table *hash_table = NULL;
+  size_t hash_table_size = 0;
+  size_t hash_pad = 0;
+
+  if (opt_format != 0)
+    {
+      hash_table = build_hash_table (&hash_table_size);
+      hash_pad = ((str_offset + __alignof__ (struct cache_hash_table) - 1)
+		  & ~(__alignof__ (struct cache_hash_table) - 1)) - str_offset;
+      file_entries_new->hash_offset = str_offset + hash_pad;
+    }
+
   /* Write out the cache.  */
 
   /* Write cache first to a temporary file and rename it later.  */
@@ -457,6 +522,15 @@ save_cache (const char *cache_name)
   if (write (fd, strings, total_strlen) != (ssize_t) total_strlen)
     error (EXIT_FAILURE, errno, _("Writing of cache data failed"));
 
+  if (opt_format != 0)
+    {
+      static const char zero[__alignof__ (struct cache_hash_table)];
+      if (write (fd, zero, hash_pad) != (ssize_t) hash_pad
+	  || (write (fd, hash_table, hash_table_size)
+	      != (ssize_t) hash_table_size))
+	error (EXIT_FAILURE, errno, _("Writing of cache data failed"));
+    }
+
   /* Make sure user can always read cache file */
   if (chmod (temp_name, S_IROTH|S_IRGRP|S_IRUSR|S_IWUSR))
     error (EXIT_FAILURE, errno,
@@ -473,6 +547,7 @@ save_cache (const char *cache_name)
 	   cache_name);
 
   /* Free all allocated memory.  */
+  free (hash_table);
   free (file_entries_new);
   free (file_entries);
   free (strings);
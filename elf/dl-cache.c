@@ -34,10 +34,34 @@
 static struct cache_file *cache;
 static struct cache_file_new *cache_new;
 static size_t cachesize;
+/* The hash table of the new format, or NULL if there is none.  */
+static const struct cache_hash_table *cache_hash;
 
 /* 1 if cache_data + PTR points into the cache.  */
 #define _dl_cache_verify_ptr(ptr) (ptr < cache_data_size)
 
+/* Select the entry LIB as the result if it is usable and better than
+   BEST.  This is used in a loop over the entries for the name, where
+   `continue' in HWCAP_CHECK skips LIB and `break' ends the search.  */
+#define CHECK_ENTRY \
+  {									      \
+    int flags = lib->flags;						      \
+    if (_dl_cache_check_flags (flags)					      \
+	&& _dl_cache_verify_ptr (lib->value))				      \
+      {									      \
+	if (best == NULL || flags == GLRO(dl_correct_cache_id))		      \
+	  {								      \
+	    HWCAP_CHECK;						      \
+	    best = cache_data + lib->value;				      \
+									      \
+	    if (flags == GLRO(dl_correct_cache_id))			      \
+	      /* We've found an exact match for the shared object and no     \
+		 general `ELF' release.  Stop searching.  */		      \
+	      break;							      \
+	  }								      \
+      }									      \
+  }
+
 #define SEARCH_CACHE(cache) \
 /* We use binary search since the table is sorted in the cache file.	      \
    The first matching entry in the table is returned.			      \
@@ -90,7 +114,6 @@ do									      \
 									      \
 	    do								      \
 	      {								      \
-		int flags;						      \
 		__typeof__ (cache->libs[0]) *lib = &cache->libs[middle];      \
 									      \
 		/* Only perform the name test if necessary.  */		      \
@@ -103,22 +126,7 @@ do									      \
 			    != 0)))					      \
 		  break;						      \
 									      \
-		flags = lib->flags;					      \
-		if (_dl_cache_check_flags (flags)			      \
-		    && _dl_cache_verify_ptr (lib->value))		      \
-		  {							      \
-		    if (best == NULL || flags == GLRO(dl_correct_cache_id))   \
-		      {							      \
-			HWCAP_CHECK;					      \
-			best = cache_data + lib->value;			      \
-									      \
-			if (flags == GLRO(dl_correct_cache_id))		      \
-			  /* We've found an exact match for the shared	      \
-			     object and no general `ELF' release.  Stop	      \
-			     searching.  */				      \
-			  break;					      \
-		      }							      \
-		  }							      \
+		CHECK_ENTRY;						      \
 	      }								      \
 	    while (++middle <= right);					      \
 	    break;							      \
@@ -172,6 +180,71 @@ _dl_cache_libcmp (const char *p1, const char *p2)
 }
 
 
+/* Return the hash table of the new format cache, or NULL if there is
+   none or it does not fit into the CACHE_DATA_SIZE bytes of the mapping
+   starting at CACHE_NEW.  */
+static const struct cache_hash_table *
+find_cache_hash (uint32_t cache_data_size)
+{
+  uint32_t offset = cache_new->hash_offset;
+  if (offset == 0
+      || offset % __alignof__ (struct cache_hash_table) != 0
+      || offset > cache_data_size
+      || cache_data_size - offset < sizeof (struct cache_hash_table)
+      /* The table follows the entries, which are used without further
+	 checks when the table is.  */
+      || offset < sizeof (struct cache_file_new)
+      || ((offset - sizeof (struct cache_file_new))
+	  / sizeof (struct file_entry_new)) < cache_new->nlibs)
+    return NULL;
+
+  const struct cache_hash_table *table
+    = (const void *) ((const char *) cache_new + offset);
+  if (table->magic != CACHE_HASH_MAGIC
+      || table->nslots == 0
+      || (table->nslots & (table->nslots - 1)) != 0
+      || ((cache_data_size - offset - sizeof (struct cache_hash_table))
+	  / sizeof (struct cache_hash_slot)) < table->nslots)
+    return NULL;
+
+  return table;
+}
+
+/* Look up NAME in the hash table of the new format cache.  Store the
+   index of the first entry for NAME in *FIRST and return the number of
+   entries, or return 0 if NAME is not in the cache.  Only the slots
+   probed and the first entry for NAME are accessed.  */
+static uint32_t
+search_cache_hash (const char *name, const char *cache_data,
+		   uint32_t cache_data_size, uint32_t *first)
+{
+  uint32_t hash = _dl_cache_hash (name);
+  uint32_t mask = cache_hash->nslots - 1;
+
+  for (uint32_t i = 0; i <= mask; ++i)
+    {
+      const struct cache_hash_slot *slot
+	= &cache_hash->slots[(hash + i) & mask];
+      if (slot->count == 0)
+	break;
+      if (slot->hash != hash
+	  || slot->first >= cache_new->nlibs
+	  || slot->count > cache_new->nlibs - slot->first)
+	continue;
+
+      uint32_t key = cache_new->libs[slot->first].key;
+      if (_dl_cache_verify_ptr (key)
+	  && _dl_cache_libcmp (name, cache_data + key) == 0)
+	{
+	  *first = slot->first;
+	  return slot->count;
+	}
+    }
+
+  return 0;
+}
+
+
 /* Look up NAME in ld.so.cache and return the file name stored there, or null
    if none is found.  The cache is loaded if it was not already.  If loading
    the cache previously failed there will be no more attempts to load it.
@@ -234,6 +307,10 @@ _dl_load_cache_lookup (const char *name)
 	  cache = (void *) -1;
 	}
 
+      if (cache != (void *) -1 && cache_new != (void *) -1)
+	cache_hash = find_cache_hash ((const char *) cache + cachesize
+				      - (const char *) cache_new);
+
       assert (cache != NULL);
     }
 
@@ -273,7 +350,23 @@ _dl_load_cache_lookup (const char *name)
 	  && (lib->hwcap & _DL_HWCAP_PLATFORM) != 0			      \
 	  && (lib->hwcap & _DL_HWCAP_PLATFORM) != platform)		      \
 	continue
-      SEARCH_CACHE (cache_new);
+      if (cache_hash != NULL)
+	{
+	  uint32_t first = 0;
+	  uint32_t count = search_cache_hash (name, cache_data,
+					      cache_data_size, &first);
+
+	  /* The entries for the name have been verified to lie in the
+	     table, and they are sorted in the same order as for the
+	     binary search.  */
+	  for (middle = first; count-- > 0; ++middle)
+	    {
+	      const struct file_entry_new *lib = &cache_new->libs[middle];
+	      CHECK_ENTRY;
+	    }
+	}
+      else
+	SEARCH_CACHE (cache_new);
     }
   else
     {
@@ -318,6 +411,7 @@ _dl_unload_cache (void)
     {
       __munmap (cache, cachesize);
       cache = NULL;
+      cache_hash = NULL;
     }
 }
 #endif
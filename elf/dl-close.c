@@ -244,7 +244,12 @@ _dl_close_worker (struct link_map *map, bool force)
   /* Sort the entries.  We can skip looking for the binary itself which is
      at the front of the search list for the main namespace.  */
   _dl_sort_maps (maps + (nsid == LM_ID_BASE), nloaded - (nsid == LM_ID_BASE),
-		 used + (nsid == LM_ID_BASE), true);
+		 true);
+
+  /* The objects which are still used have been marked above, so USED
+     can be brought in line with the new order of MAPS.  */
+  for (unsigned int i = 0; i < nloaded; ++i)
+    used[i] = maps[i]->l_idx == IDX_STILL_USED;
 
   /* Call all termination functions at once.  */
 #ifdef SHARED
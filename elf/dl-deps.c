@@ -591,7 +591,7 @@ Filters not supported with LD_TRACE_PRELINKING"));
 	  nlist * sizeof (struct link_map *));
   /* We can skip looking for the binary itself which is at the front of
      the search list.  */
-  _dl_sort_maps (&l_initfini[1], nlist - 1, NULL, false);
+  _dl_sort_maps (&l_initfini[1], nlist - 1, false);
 
   /* Terminate the list of dependencies.  */
   l_initfini[nlist] = NULL;
@@ -92,7 +92,7 @@ _dl_fini (void)
 	     binary itself which is at the front of the search list for
 	     the main namespace.  */
 	  _dl_sort_maps (maps + (ns == LM_ID_BASE), nmaps - (ns == LM_ID_BASE),
-			 NULL, true);
+			 true);
 
 	  /* We do not rely on the linked list of loaded object anymore
 	     from this point on.  We have our own list here (maps).  The
@@ -180,5 +180,12 @@ _dl_fini (void)
 		      "final number of relocations from cache: %lu\n",
 		      GL(dl_num_relocations),
 		      GL(dl_num_cache_relocations));
+  if (__glibc_unlikely (GLRO(dl_debug_mask) & DL_DEBUG_STATISTICS)
+      && _dl_path_cache_active)
+    _dl_debug_printf (" final probes answered from path cache: %lu\n"
+		      "     final path cache directory checks: %lu\n"
+		      "    final path cache directory changes: %lu\n",
+		      _dl_path_cache_hits, _dl_path_cache_checks,
+		      _dl_path_cache_invalidations);
 #endif
 }
@@ -694,6 +694,8 @@ _dl_init_paths (const char *llp)
   capstr = _dl_important_hwcaps (GLRO(dl_platform), GLRO(dl_platformlen),
 				 &ncapstr, &max_capstrlen);
 
+  _dl_path_cache_init ();
+
   /* First set up the rest of the default search directory entries.  */
   aelem = rtld_search_dirs.dirs = (struct r_search_path_elem **)
     malloc ((nsystem_dirs_len + 1) * sizeof (struct r_search_path_elem *));
@@ -1811,18 +1813,32 @@ open_path (const char *name, size_t namelen, int mode,
 	  if (this_dir->status[cnt] == nonexisting)
 	    continue;
 
-	  buflen =
-	    ((char *) __mempcpy (__mempcpy (edp, capstr[cnt].str,
-					    capstr[cnt].len),
-				 name, namelen)
-	     - buf);
+	  char *np = __mempcpy (edp, capstr[cnt].str, capstr[cnt].len);
+	  *np = '\0';
+	  struct dl_path_cache_dir *cache_dir
+	    = _dl_path_cache_find_dir (buf, np - buf);
 
-	  /* Print name we try if this is wanted.  */
-	  if (__glibc_unlikely (GLRO(dl_debug_mask) & DL_DEBUG_LIBS))
-	    _dl_debug_printf ("  trying file=%s\n", buf);
+	  buflen = (char *) __mempcpy (np, name, namelen) - buf;
 
-	  fd = open_verify (buf, -1, fbp, loader, whatcode, mode,
-			    found_other_class, false);
+	  if (cache_dir != NULL
+	      && _dl_path_cache_lookup (cache_dir, name, namelen))
+	    {
+	      /* The directory has no entry with this name.  */
+	      if (__glibc_unlikely (GLRO(dl_debug_mask) & DL_DEBUG_LIBS))
+		_dl_debug_printf ("  skipping file=%s (not in directory)\n",
+				  buf);
+	      __set_errno (ENOENT);
+	      fd = -1;
+	    }
+	  else
+	    {
+	      /* Print name we try if this is wanted.  */
+	      if (__glibc_unlikely (GLRO(dl_debug_mask) & DL_DEBUG_LIBS))
+		_dl_debug_printf ("  trying file=%s\n", buf);
+
+	      fd = open_verify (buf, -1, fbp, loader, whatcode, mode,
+				found_other_class, false);
+	    }
 	  if (this_dir->status[cnt] == unknown)
 	    {
 	      if (fd != -1)
@@ -1834,13 +1850,16 @@ open_path (const char *name, size_t namelen, int mode,
 		       || GL(dl_ns)[loader->l_ns]._ns_loaded->l_auditing == 0)
 		{
 		  /* We failed to open machine dependent library.  Let's
-		     test whether there is any directory at all.  */
+		     test whether there is any directory at all.  The path
+		     cache already knows.  */
 		  struct stat64 st;
 
 		  buf[buflen - namelen - 1] = '\0';
 
-		  if (__xstat64 (_STAT_VER, buf, &st) != 0
-		      || ! S_ISDIR (st.st_mode))
+		  if (cache_dir != NULL
+		      ? !_dl_path_cache_dir_exists (cache_dir)
+		      : (__xstat64 (_STAT_VER, buf, &st) != 0
+			 || ! S_ISDIR (st.st_mode)))
 		    /* The directory does not exist or it is no directory.  */
 		    this_dir->status[cnt] = nonexisting;
 		  else
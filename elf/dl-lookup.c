@@ -549,6 +549,37 @@ skip:
 }
 
 
+#ifdef SHARED
+/* Return true if SYM in MAP, which the symbol cache has for the
+   reference REF to UNDEF_NAME, is a definition do_lookup_x would
+   accept.  The cache file is not trusted to get this right.  */
+static bool
+symcache_binding_valid (const char *undef_name, const ElfW(Sym) *ref,
+			const struct r_found_version *version, int flags,
+			int type_class, const struct link_map *map,
+			const ElfW(Sym) *sym)
+{
+  const ElfW(Sym) *symtab = (const void *) D_PTR (map, l_info[DT_SYMTAB]);
+  const char *strtab = (const void *) D_PTR (map, l_info[DT_STRTAB]);
+  const ElfW(Sym) *versioned_sym = NULL;
+  int num_versions = 0;
+
+  /* Without a version, do_lookup_x uses a versioned definition if it
+     is the only one which is not hidden.  */
+  if (check_match (undef_name, ref, version, flags, type_class, sym,
+		   sym - symtab, strtab, map, &versioned_sym,
+		   &num_versions) == NULL
+      && versioned_sym != sym)
+    return false;
+
+  if (dl_symbol_visibility_binds_local_p (sym))
+    return false;
+
+  unsigned char bind = ELFW(ST_BIND) (sym->st_info);
+  return bind == STB_GLOBAL || bind == STB_WEAK;
+}
+#endif
+
 static uint_fast32_t
 dl_new_hash (const char *s)
 {
@@ -803,6 +834,25 @@ _dl_lookup_symbol_x (const char *undef_name, struct link_map *undef_map,
 	     == 0);
 
   size_t i = 0;
+
+#ifdef SHARED
+  if (__glibc_unlikely (_dl_symcache_active) && skip_map == NULL)
+    {
+      struct link_map *cached_map;
+      const ElfW(Sym) *cached_sym;
+      if (_dl_symcache_lookup (undef_name, undef_map, *ref, type_class,
+			       &cached_map, &cached_sym)
+	  && symcache_binding_valid (undef_name, *ref, version, flags,
+				     type_class, cached_map, cached_sym))
+	{
+	  current_value.m = cached_map;
+	  current_value.s = cached_sym;
+	  ++GL(dl_num_symcache_relocations);
+	  goto found;
+	}
+    }
+#endif
+
   if (__glibc_unlikely (skip_map != NULL))
     /* Search the relevant loaded objects for a definition.  */
     while ((*scope)->r_list[i] != skip_map)
@@ -839,6 +889,14 @@ _dl_lookup_symbol_x (const char *undef_name, struct link_map *undef_map,
 	}
     }
 
+#ifdef SHARED
+  if (__glibc_unlikely (_dl_symcache_active)
+      && skip_map == NULL && current_value.s != NULL)
+    _dl_symcache_record (undef_name, undef_map, *ref, type_class,
+			 current_value.m, current_value.s);
+ found:
+#endif
+
   if (__glibc_unlikely (current_value.s == NULL))
     {
       if ((*ref == NULL || ELFW(ST_BIND) ((*ref)->st_info) != STB_WEAK)
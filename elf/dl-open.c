@@ -212,6 +212,10 @@ dl_open_worker (void *a)
      may not be true if this is a recursive call to dlopen.  */
   _dl_debug_initialize (0, args->nsid);
 
+  /* Files may have been added to the search path since the last
+     dlopen.  */
+  _dl_path_cache_revalidate ();
+
   /* Load the named object.  */
   struct link_map *new;
   args->map = new = _dl_map_object (call_map, file, lt_loaded, 0,
@@ -325,7 +329,7 @@ dl_open_worker (void *a)
       l = l->l_next;
     }
   while (l != NULL);
-  _dl_sort_maps (maps, nmaps, NULL, false);
+  _dl_sort_maps (maps, nmaps, false);
 
   int relocation_in_progress = 0;
 
@@ -0,0 +1,413 @@
+/* Memoization of failed library search path probes.
+   Copyright (C) 2018 Free Software Foundation, Inc.
+   This file is part of the GNU C Library.
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; if not, see
+   <http://www.gnu.org/licenses/>.  */
+
+/* open_path tries to open the requested name in every directory of the
+   search path, and in every hardware capability subdirectory of these.
+   Most of these attempts fail with ENOENT, and every dlopen repeats
+   them.  The path cache reads the contents of each absolute directory
+   the first time a name is looked up in it, and answers the probes for
+   names which are not in the directory without trying to open them.
+   Directories which do not exist, like most of the hardware capability
+   subdirectories, are recognized by the failure to open them.
+   Names which are in the directory, including dangling symbolic links,
+   are always tried.  The cache keeps a sorted array of hashes of the
+   names; a hash collision only costs an open call.
+
+   The contents of a directory are read at most once per dlopen call
+   (each "generation"); during the loading of the initial objects, or
+   of an object and its dependencies, they are not read again.  In later
+   generations they are reused as long as the status change time,
+   device and inode number of the directory stay the same, which costs
+   one stat call.  The status change time is used rather than the
+   modification time because programs like tar restore the latter.
+
+   A file created in the directory in the same clock tick in which the
+   contents were read would not change the status change time.  To
+   rule this out, the contents are only reused if the status change
+   time was older than the time they were read, by more than the
+   timestamp granularity of common file systems.
+
+   The memory used by the cache is taken directly from mmap, so that it
+   is not reported as leaked by mtrace and does not depend on the malloc
+   in use.  Arrays of hashes which become too small are not freed, but
+   this only happens when a directory changes.  */
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/param.h>
+#include <sys/stat.h>
+#include <libc-pointer-arith.h>
+#include <ldsodefs.h>
+#include <not-cancel.h>
+#include <sysdep.h>
+
+#if HAVE_TUNABLES
+# define TUNABLE_NAMESPACE rtld
+#endif
+#include <elf/dl-tunables.h>
+
+/* A directory of the search path, with a hardware capability
+   subdirectory appended.  */
+struct dl_path_cache_dir
+{
+  struct dl_path_cache_dir *next;
+  uint32_t hash;
+  /* The generation in which the directory was last checked.  */
+  unsigned int generation;
+  /* Whether NAMES holds the contents of the directory, or the directory
+     was found not to exist.  */
+  bool usable;
+  bool exists;
+  dev_t dev;
+  ino64_t ino;
+  struct timespec ctime;
+  /* The start of the generation in which the contents were read.  */
+  struct timespec read_time;
+  /* The sorted hashes of the names in the directory, their number, and
+     the number of hashes the array can hold.  */
+  uint32_t *names;
+  size_t nnames;
+  size_t names_size;
+  size_t namelen;
+  char name[];
+};
+
+#define PATH_CACHE_DIR_BUCKETS 64
+
+/* Directories with more entries are not cached.  */
+#define PATH_CACHE_MAX_NAMES 16384
+
+/* Size of the buffer for getdents64.  */
+#define PATH_CACHE_DENTS_SIZE (32 * 1024)
+
+static struct dl_path_cache_dir *dir_buckets[PATH_CACHE_DIR_BUCKETS];
+
+/* Zero if no generation has started yet.  */
+static unsigned int generation;
+
+/* The time at which the current generation started, if
+   GENERATION_START_VALID.  */
+static struct timespec generation_start;
+static bool generation_start_valid;
+
+/* Memory for reading directories: PATH_CACHE_DENTS_SIZE bytes for the
+   directory entries, followed by PATH_CACHE_MAX_NAMES hashes.  */
+static char *scratch;
+
+int _dl_path_cache_active;
+unsigned long int _dl_path_cache_hits;
+unsigned long int _dl_path_cache_checks;
+unsigned long int _dl_path_cache_invalidations;
+
+/* The unused part of the memory most recently mapped for the cache.  */
+static char *alloc_ptr;
+static char *alloc_end;
+
+#define PATH_CACHE_ALLOC_SIZE (64 * 1024)
+
+/* Allocate SIZE bytes for the cache.  Return NULL on failure.  */
+static void *
+path_cache_alloc (size_t size)
+{
+  size = ALIGN_UP (size, __alignof__ (struct dl_path_cache_dir));
+  if (alloc_end - alloc_ptr < size)
+    {
+      size_t map_size = ALIGN_UP (MAX (size, PATH_CACHE_ALLOC_SIZE),
+				  GLRO(dl_pagesize));
+      void *p = __mmap (NULL, map_size, PROT_READ | PROT_WRITE,
+			MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+      if (p == MAP_FAILED)
+	return NULL;
+      alloc_ptr = p;
+      alloc_end = alloc_ptr + map_size;
+    }
+  void *result = alloc_ptr;
+  alloc_ptr += size;
+  return result;
+}
+
+/* Hash LEN bytes at S.  */
+static uint32_t
+path_cache_hash (uint32_t hash, const char *s, size_t len)
+{
+  for (size_t i = 0; i < len; ++i)
+    hash = hash * 33 + (unsigned char) s[i];
+  return hash;
+}
+
+void
+_dl_path_cache_init (void)
+{
+#if HAVE_TUNABLES
+  _dl_path_cache_active = TUNABLE_GET (path_cache, int32_t, NULL) != 0;
+#else
+  _dl_path_cache_active = 1;
+#endif
+  _dl_path_cache_revalidate ();
+}
+
+void
+_dl_path_cache_revalidate (void)
+{
+  /* Skip zero on wrap-around, so that new directories are always
+     checked.  */
+  if (++generation == 0)
+    generation = 1;
+  generation_start_valid = false;
+}
+
+/* File system timestamps are taken from the coarse clock, which can
+   lag behind CLOCK_REALTIME.  */
+#ifdef CLOCK_REALTIME_COARSE
+# define PATH_CACHE_CLOCK CLOCK_REALTIME_COARSE
+#else
+# define PATH_CACHE_CLOCK CLOCK_REALTIME
+#endif
+
+/* Record the start of the current generation if that has not been
+   done yet.  Return false if the time is not available.  */
+static bool
+path_cache_start_generation (void)
+{
+  if (!generation_start_valid)
+    {
+#if IS_IN (rtld) && defined __NR_clock_gettime
+      /* The vDSO is not available to ld.so.  */
+      INTERNAL_SYSCALL_DECL (err);
+      int r = INTERNAL_SYSCALL (clock_gettime, err, 2, PATH_CACHE_CLOCK,
+				&generation_start);
+      if (INTERNAL_SYSCALL_ERROR_P (r, err))
+	return false;
+#else
+      if (__clock_gettime (PATH_CACHE_CLOCK, &generation_start) != 0)
+	return false;
+#endif
+      generation_start_valid = true;
+    }
+  return true;
+}
+
+/* Sort the N hashes at BASE in ascending order.  */
+static void
+path_cache_sort (uint32_t *base, size_t n)
+{
+  /* Heapsort, which needs no memory and no recursion.  */
+  for (size_t end = n, start = n / 2; end > 1; )
+    {
+      uint32_t value;
+      if (start > 0)
+	value = base[--start];
+      else
+	{
+	  value = base[--end];
+	  base[end] = base[0];
+	}
+      size_t i = start;
+      for (size_t child; (child = 2 * i + 1) < end; i = child)
+	{
+	  if (child + 1 < end && base[child + 1] > base[child])
+	    ++child;
+	  if (base[child] <= value)
+	    break;
+	  base[i] = base[child];
+	}
+      base[i] = value;
+    }
+}
+
+/* Read the contents of DIR and record its identity.  A directory which
+   does not exist is recorded as such.  Return false if this fails.  */
+static bool
+path_cache_read_dir (struct dl_path_cache_dir *dir)
+{
+  if (scratch == NULL)
+    {
+      void *p = __mmap (NULL, (PATH_CACHE_DENTS_SIZE
+			       + PATH_CACHE_MAX_NAMES * sizeof (uint32_t)),
+			PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS,
+			-1, 0);
+      if (p == MAP_FAILED)
+	return false;
+      scratch = p;
+    }
+  uint32_t *hashes = (uint32_t *) (scratch + PATH_CACHE_DENTS_SIZE);
+
+  int fd = __open64_nocancel (dir->name,
+			      O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  if (fd == -1)
+    {
+      dir->exists = false;
+      return errno == ENOENT || errno == ENOTDIR;
+    }
+
+  /* Take the status change time before the contents, so that changes
+     made while they are read are noticed in the next generation.  */
+  struct stat64 st;
+  bool result = __fxstat64 (_STAT_VER, fd, &st) == 0;
+  size_t n = 0;
+  while (result)
+    {
+      ssize_t len = __getdents64 (fd, scratch, PATH_CACHE_DENTS_SIZE);
+      if (len <= 0)
+	{
+	  result = len == 0;
+	  break;
+	}
+      for (ssize_t off = 0; off < len; )
+	{
+	  struct dirent64 *d = (struct dirent64 *) (scratch + off);
+	  off += d->d_reclen;
+	  if (n == PATH_CACHE_MAX_NAMES)
+	    {
+	      result = false;
+	      break;
+	    }
+	  hashes[n++] = path_cache_hash (5381, d->d_name,
+					 strlen (d->d_name));
+	}
+    }
+  __close_nocancel (fd);
+  if (!result)
+    return false;
+
+  if (n > dir->names_size)
+    {
+      uint32_t *names = path_cache_alloc (n * sizeof (uint32_t));
+      if (names == NULL)
+	return false;
+      dir->names = names;
+      dir->names_size = n;
+    }
+  memcpy (dir->names, hashes, n * sizeof (uint32_t));
+  path_cache_sort (dir->names, n);
+  dir->nnames = n;
+  dir->exists = true;
+  dir->dev = st.st_dev;
+  dir->ino = st.st_ino;
+  dir->ctime = st.st_ctim;
+  return true;
+}
+
+struct dl_path_cache_dir *
+_dl_path_cache_find_dir (const char *name, size_t namelen)
+{
+  /* The current directory can change, and auditing modules can
+     redirect the names we try to open.  */
+  if (!_dl_path_cache_active || name[0] != '/'
+#ifdef SHARED
+      || GLRO(dl_naudit) > 0
+#endif
+      )
+    return NULL;
+
+  uint32_t hash = path_cache_hash (5381, name, namelen);
+  struct dl_path_cache_dir **bucket
+    = &dir_buckets[hash % PATH_CACHE_DIR_BUCKETS];
+  struct dl_path_cache_dir *dir;
+  for (dir = *bucket; dir != NULL; dir = dir->next)
+    if (dir->hash == hash && dir->namelen == namelen
+	&& memcmp (dir->name, name, namelen) == 0)
+      break;
+
+  if (dir == NULL)
+    {
+      dir = path_cache_alloc (sizeof (*dir) + namelen + 1);
+      if (dir == NULL)
+	return NULL;
+      memset (dir, 0, sizeof (*dir));
+      dir->hash = hash;
+      dir->namelen = namelen;
+      *((char *) __mempcpy (dir->name, name, namelen)) = '\0';
+      dir->next = *bucket;
+      *bucket = dir;
+    }
+
+  if (dir->generation != generation)
+    {
+      ++_dl_path_cache_checks;
+      dir->generation = generation;
+
+      /* The start of the generation must be known before the contents
+	 are read.  */
+      if (!path_cache_start_generation ())
+	{
+	  dir->usable = false;
+	  return NULL;
+	}
+
+      if (dir->usable)
+	{
+	  struct stat64 st;
+	  bool unchanged;
+	  if (!dir->exists)
+	    unchanged = (__xstat64 (_STAT_VER, dir->name, &st) != 0
+			 && (errno == ENOENT || errno == ENOTDIR));
+	  else
+	    unchanged = (__xstat64 (_STAT_VER, dir->name, &st) == 0
+			 && st.st_dev == dir->dev && st.st_ino == dir->ino
+			 && st.st_ctim.tv_sec == dir->ctime.tv_sec
+			 && st.st_ctim.tv_nsec == dir->ctime.tv_nsec
+			 /* Some file systems store timestamps with a
+			    granularity of two seconds.  */
+			 && dir->ctime.tv_sec + 2 < dir->read_time.tv_sec);
+	  if (unchanged)
+	    return dir;
+	  ++_dl_path_cache_invalidations;
+	}
+
+      dir->usable = path_cache_read_dir (dir);
+      dir->read_time = generation_start;
+    }
+
+  return dir->usable ? dir : NULL;
+}
+
+bool
+_dl_path_cache_dir_exists (struct dl_path_cache_dir *dir)
+{
+  return dir->exists;
+}
+
+bool
+_dl_path_cache_lookup (struct dl_path_cache_dir *dir, const char *name,
+		       size_t namelen)
+{
+  /* NAMELEN includes the null terminator.  */
+  uint32_t hash = path_cache_hash (5381, name, namelen - 1);
+  size_t lo = 0;
+  size_t hi = dir->nnames;
+  while (lo < hi)
+    {
+      size_t mid = lo + (hi - lo) / 2;
+      if (dir->names[mid] < hash)
+	lo = mid + 1;
+      else
+	hi = mid;
+    }
+  if (lo < dir->nnames && dir->names[lo] == hash)
+    return false;
+
+  ++_dl_path_cache_hits;
+  return true;
+}
@@ -16,20 +16,24 @@
    License along with the GNU C Library; if not, see
    <http://www.gnu.org/licenses/>.  */
 
+#include <assert.h>
 #include <ldsodefs.h>
 
+#if HAVE_TUNABLES
+# define TUNABLE_NAMESPACE rtld
+#endif
+#include <elf/dl-tunables.h>
+
 
 /* Sort array MAPS according to dependencies of the contained objects.
-   Array USED, if non-NULL, is permutated along MAPS.  If FOR_FINI this is
-   called for finishing an object.  */
-void
-_dl_sort_maps (struct link_map **maps, unsigned int nmaps, char *used,
-	       bool for_fini)
+   If FOR_FINI this is called for finishing an object.  This is the
+   original algorithm, which moves each object behind the last object
+   depending on it and may need to look at each pair of objects many
+   times.  */
+static void
+_dl_sort_maps_original (struct link_map **maps, unsigned int nmaps,
+			bool for_fini)
 {
-  /* A list of one element need not be sorted.  */
-  if (nmaps <= 1)
-    return;
-
   unsigned int i = 0;
   uint16_t seen[nmaps];
   memset (seen, 0, nmaps * sizeof (seen[0]));
@@ -66,14 +70,6 @@ _dl_sort_maps (struct link_map **maps, unsigned int nmaps, char *used,
 			   (k - i) * sizeof (maps[0]));
 		  maps[k] = thisp;
 
-		  if (used != NULL)
-		    {
-		      char here_used = used[i];
-		      memmove (&used[i], &used[i + 1],
-			       (k - i) * sizeof (used[0]));
-		      used[k] = here_used;
-		    }
-
 		  if (seen[i + 1] > nmaps - i)
 		    {
 		      ++i;
@@ -120,3 +116,174 @@ _dl_sort_maps (struct link_map **maps, unsigned int nmaps, char *used,
     next:;
     }
 }
+
+
+/* State of an object on the stack of the depth-first search.  */
+struct dfs_frame
+{
+  struct link_map *map;
+  /* Next entry of l_initfini and l_reldeps to look at.  */
+  unsigned int initfini;
+  unsigned int reldeps;
+};
+
+/* Return true if MAP depends on DEP at link time.  */
+static bool
+dfs_depends (struct link_map *map, struct link_map *dep)
+{
+  struct link_map **runp = map->l_initfini;
+  if (runp != NULL)
+    while (*runp != NULL)
+      if (*runp++ == dep)
+	return true;
+  return false;
+}
+
+/* Return the next dependency of the object in FRAME which has not been
+   visited yet, or NULL.  Relocation dependencies are only followed if
+   RELDEPS, and only if they do not contradict a link-time dependency,
+   like in the original algorithm.  Set *CYCLE if a dependency is still
+   being visited.  */
+static struct link_map *
+dfs_next (struct dfs_frame *frame, bool reldeps, bool *cycle)
+{
+  struct link_map *map = frame->map;
+
+  struct link_map **initfini = map->l_initfini;
+  if (initfini != NULL)
+    while (initfini[frame->initfini] != NULL)
+      {
+	struct link_map *dep = initfini[frame->initfini++];
+	if (dep->l_sort_pending)
+	  return dep;
+	if (dep->l_sort_active && dep != map)
+	  *cycle = true;
+      }
+
+  if (__glibc_unlikely (reldeps && map->l_reldeps != NULL))
+    while (frame->reldeps < map->l_reldeps->act)
+      {
+	struct link_map *dep = map->l_reldeps->list[frame->reldeps++];
+	if ((dep->l_sort_pending || dep->l_sort_active)
+	    && !dfs_depends (dep, map))
+	  {
+	    if (dep->l_sort_pending)
+	      return dep;
+	    *cycle = true;
+	  }
+      }
+
+  return NULL;
+}
+
+/* Visit MAP and all objects reachable from it which are still pending,
+   and store them in reverse postorder in front of HEAD, so that each
+   object comes before the objects it depends on.  Return the new start
+   of the stored objects.  STACK must have room for all pending
+   objects.  */
+static struct link_map **
+dfs_traversal (struct link_map **head, struct link_map *map,
+	       struct dfs_frame *stack, bool reldeps, bool *cycle)
+{
+  unsigned int depth = 0;
+  map->l_sort_pending = 0;
+  map->l_sort_active = 1;
+  stack[0] = (struct dfs_frame) { .map = map };
+
+  while (true)
+    {
+      struct link_map *dep = dfs_next (&stack[depth], reldeps, cycle);
+      if (dep != NULL)
+	{
+	  dep->l_sort_pending = 0;
+	  dep->l_sort_active = 1;
+	  stack[++depth] = (struct dfs_frame) { .map = dep };
+	}
+      else
+	{
+	  stack[depth].map->l_sort_active = 0;
+	  *--head = stack[depth].map;
+	  if (depth == 0)
+	    return head;
+	  --depth;
+	}
+    }
+}
+
+/* Sort array MAPS according to dependencies of the contained objects
+   with a depth-first search, which looks at each object and each
+   dependency once.  If FOR_FINI this is called for finishing an
+   object.
+
+   Only the objects in MAPS are sorted; dependencies outside of it
+   (such as the main program, or objects loaded earlier) are not
+   followed.  Objects are marked with l_sort_pending until they are
+   visited, and with l_sort_active until they have been placed.  The
+   search starts from the end of MAPS and follows l_initfini in order,
+   which keeps the result close to the original breadth-first order of
+   the objects where the dependencies do not force otherwise.  */
+static void
+_dl_sort_maps_dfs (struct link_map **maps, unsigned int nmaps,
+		   bool for_fini)
+{
+  struct link_map *rpo[nmaps];
+  struct dfs_frame stack[nmaps];
+  bool cycle = false;
+
+  for (unsigned int i = 0; i < nmaps; ++i)
+    maps[i]->l_sort_pending = 1;
+
+  struct link_map **head = &rpo[nmaps];
+  for (unsigned int i = nmaps; i-- > 0 && head != rpo; )
+    if (maps[i]->l_sort_pending)
+      head = dfs_traversal (head, maps[i], stack, for_fini, &cycle);
+  assert (head == rpo);
+
+  /* There is no requirement how cycles are broken, but destructors
+     should respect the link-time dependencies where possible.  In a
+     cycle which includes relocation dependencies, the search above may
+     have placed an object behind one of its link-time dependencies, so
+     sort again, starting from the result above, with only the link-time
+     dependencies.  */
+  if (__glibc_unlikely (for_fini && cycle))
+    {
+      for (unsigned int i = 0; i < nmaps; ++i)
+	rpo[i]->l_sort_pending = 1;
+
+      head = &maps[nmaps];
+      for (unsigned int i = nmaps; i-- > 0 && head != maps; )
+	if (rpo[i]->l_sort_pending)
+	  head = dfs_traversal (head, rpo[i], stack, false, &cycle);
+      assert (head == maps);
+      return;
+    }
+
+  memcpy (maps, rpo, nmaps * sizeof (maps[0]));
+}
+
+
+void
+_dl_sort_maps_init (void)
+{
+#if HAVE_TUNABLES
+  int32_t algorithm = TUNABLE_GET (dynamic_sort, int32_t, NULL);
+  GLRO(dl_dso_sort_algo) = (algorithm == 1 ? dso_sort_algorithm_original
+			    : dso_sort_algorithm_dfs);
+#else
+  GLRO(dl_dso_sort_algo) = dso_sort_algorithm_dfs;
+#endif
+}
+
+void
+_dl_sort_maps (struct link_map **maps, unsigned int nmaps, bool for_fini)
+{
+  /* A list of one element need not be sorted.  */
+  if (nmaps <= 1)
+    return;
+
+  if (__glibc_unlikely (GLRO(dl_dso_sort_algo)
+			== dso_sort_algorithm_original))
+    _dl_sort_maps_original (maps, nmaps, for_fini);
+  else
+    _dl_sort_maps_dfs (maps, nmaps, for_fini);
+}
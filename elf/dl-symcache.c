@@ -0,0 +1,589 @@
+/* Persistent cache of the symbol bindings of the initial objects.
+   Copyright (C) 2018 Free Software Foundation, Inc.
+   This file is part of the GNU C Library.
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; if not, see
+   <http://www.gnu.org/licenses/>.  */
+
+/* If glibc.rtld.symbol_cache names a directory, the symbol lookups done
+   while the objects loaded at startup are relocated are answered from
+   the file DIR/BUILD-ID, where BUILD-ID is the build ID of the main
+   program in hexadecimal.  This avoids walking the scopes and hash
+   tables of all objects for every symbol, which is what dominates the
+   startup time of programs linked against many objects.
+
+   The file is used only if it lists the build IDs of all objects of the
+   main namespace, in load order.  If an object has no build ID, the
+   cache is not used at all.  A binding is keyed by the index of the
+   referencing object, the index of the referencing symbol table entry
+   and the relocation type class.  It records the index of the defining
+   object and of its symbol table entry.  Before a binding is used, the
+   index is checked against the size of the symbol table, and the
+   definition is checked the way a normal lookup checks it: name, type,
+   version, visibility and binding.  Lookups the file has no binding
+   for, or whose binding fails these checks, are done as usual.
+
+   The file is ignored in privileged processes, and unless it is owned
+   by the effective user and not writable by the group or others.
+
+   If the file does not exist or does not match the objects, the
+   bindings found by the lookups are recorded.  After relocation they are
+   written to a temporary file, which is renamed to the cache file.
+   Concurrent processes thus see either the old or the new file.
+
+   Only lookups during the initial relocation use the cache.  Lazy
+   binding, dlopen and dlsym are not affected.  */
+
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/param.h>
+#include <sys/stat.h>
+#include <array_length.h>
+#include <_itoa.h>
+#include <ldsodefs.h>
+#include <not-cancel.h>
+
+#if HAVE_TUNABLES
+# define TUNABLE_NAMESPACE rtld
+#endif
+#include <elf/dl-tunables.h>
+
+#define SYMCACHE_MAGIC "ld.so-symcache1"
+
+/* The file starts with this header.  It is followed by an array of
+   NOBJECTS struct symcache_object, IDS_SIZE bytes of build IDs and an
+   array of NBINDINGS struct symcache_binding.  */
+struct symcache_header
+{
+  char magic[sizeof SYMCACHE_MAGIC];
+  uint32_t nobjects;
+  uint32_t nbindings;
+  /* A multiple of 4.  */
+  uint32_t ids_size;
+  uint32_t unused;
+};
+
+struct symcache_object
+{
+  /* Offset of the build ID from the start of the build IDs, and its
+     size.  */
+  uint32_t id_offset;
+  uint32_t id_size;
+  /* The bindings of the references of this object.  They are sorted by
+     SYMNDX and TYPE_CLASS.  */
+  uint32_t first_binding;
+  uint32_t nbindings;
+};
+
+struct symcache_binding
+{
+  uint32_t symndx;
+  uint32_t type_class;
+  uint32_t def_object;
+  uint32_t def_symndx;
+};
+
+int _dl_symcache_active;
+
+/* The objects of the main namespace in load order.  Their
+   l_symcache_index is their index in this array plus one.  */
+static struct link_map **symcache_maps;
+static unsigned int symcache_nmaps;
+
+/* The build IDs of SYMCACHE_MAPS.  */
+struct symcache_id
+{
+  const void *id;
+  uint32_t size;
+};
+static struct symcache_id *symcache_ids;
+
+/* The number of symbol table entries of SYMCACHE_MAPS, which bounds
+   the indices of the definitions in the cache file.  */
+static uint32_t *symcache_nsyms;
+
+static char *symcache_path;
+
+/* The cache file, if it matches the objects.  */
+static void *symcache_file;
+static size_t symcache_file_size;
+static const struct symcache_object *symcache_objects;
+static const struct symcache_binding *symcache_bindings;
+
+/* The bindings recorded if the cache file is missing or does not match
+   the objects.  */
+struct symcache_record
+{
+  /* Index of the referencing object.  */
+  uint32_t object;
+  struct symcache_binding binding;
+};
+
+struct symcache_chunk
+{
+  struct symcache_chunk *next;
+  size_t used;
+  struct symcache_record records[1024];
+};
+static struct symcache_chunk *symcache_chunks;
+static size_t symcache_nrecords;
+
+/* Find the build ID of L.  */
+static bool
+symcache_build_id (struct link_map *l, struct symcache_id *result)
+{
+  for (const ElfW(Phdr) *ph = l->l_phdr; ph < &l->l_phdr[l->l_phnum]; ++ph)
+    if (ph->p_type == PT_NOTE)
+      {
+	size_t align = ph->p_align == 8 ? 8 : 4;
+	const char *p = (const char *) (l->l_addr + ph->p_vaddr);
+	const char *end = p + ph->p_memsz;
+	while (end - p >= sizeof (ElfW(Nhdr)))
+	  {
+	    const ElfW(Nhdr) *note = (const ElfW(Nhdr) *) p;
+	    const char *desc = p + sizeof (*note) + ALIGN_UP (note->n_namesz,
+							      align);
+	    if (note->n_type == NT_GNU_BUILD_ID
+		&& note->n_namesz == sizeof "GNU"
+		&& memcmp (note + 1, "GNU", sizeof "GNU") == 0
+		&& note->n_descsz != 0
+		&& desc + note->n_descsz <= end)
+	      {
+		result->id = desc;
+		result->size = note->n_descsz;
+		return true;
+	      }
+	    p = desc + ALIGN_UP (note->n_descsz, align);
+	  }
+      }
+  return false;
+}
+
+/* Return true if the cache file FILE of SIZE bytes describes the
+   objects in SYMCACHE_MAPS.  */
+static bool
+symcache_check (const void *file, size_t size)
+{
+  const struct symcache_header *header = file;
+  if (size < sizeof (*header)
+      || memcmp (header->magic, SYMCACHE_MAGIC, sizeof SYMCACHE_MAGIC) != 0
+      || header->nobjects != symcache_nmaps
+      || header->ids_size % 4 != 0)
+    return false;
+  size -= sizeof (*header);
+  if (size / sizeof (struct symcache_object) < header->nobjects)
+    return false;
+  size -= header->nobjects * sizeof (struct symcache_object);
+  if (size < header->ids_size)
+    return false;
+  size -= header->ids_size;
+  if (size / sizeof (struct symcache_binding) != header->nbindings
+      || size % sizeof (struct symcache_binding) != 0)
+    return false;
+
+  const struct symcache_object *objects = (const void *) (header + 1);
+  const char *ids = (const char *) (objects + header->nobjects);
+  for (unsigned int i = 0; i < symcache_nmaps; ++i)
+    if (objects[i].id_offset > header->ids_size
+	|| objects[i].id_size != symcache_ids[i].size
+	|| objects[i].id_size > header->ids_size - objects[i].id_offset
+	|| memcmp (ids + objects[i].id_offset, symcache_ids[i].id,
+		   objects[i].id_size) != 0
+	|| objects[i].first_binding > header->nbindings
+	|| objects[i].nbindings > header->nbindings - objects[i].first_binding)
+      return false;
+
+  symcache_objects = objects;
+  symcache_bindings = (const void *) (ids + header->ids_size);
+  return true;
+}
+
+/* Return the number of entries in the symbol table of MAP, as far as
+   its hash table shows.  Symbols which are not in the hash table cannot
+   be the definition found by a lookup.  */
+static uint32_t
+symcache_symbol_count (struct link_map *map)
+{
+  if (map->l_info[ADDRIDX (DT_GNU_HASH)] != NULL)
+    {
+      /* The symbols are sorted by bucket, so the chain of the last
+	 bucket which is not empty ends with the last symbol.  */
+      Elf_Symndx bucket = map->l_nbuckets;
+      while (bucket > 0)
+	{
+	  Elf32_Word symndx = map->l_gnu_buckets[--bucket];
+	  if (symndx != 0)
+	    {
+	      while ((map->l_gnu_chain_zero[symndx] & 1) == 0)
+		++symndx;
+	      return symndx + 1;
+	    }
+	}
+      return 0;
+    }
+  if (map->l_info[DT_HASH] != NULL)
+    return ((const Elf_Symndx *) D_PTR (map, l_info[DT_HASH]))[1];
+  return 0;
+}
+
+/* Map the cache file PATH and store its size in *SIZEP.  Only files
+   owned by the effective user and not writable by others are used,
+   since the bindings in them are trusted.  Return MAP_FAILED if the
+   file cannot be used.  */
+static void *
+symcache_read_file (const char *path, size_t *sizep)
+{
+  void *result = MAP_FAILED;
+  int fd = __open64_nocancel (path, O_RDONLY | O_CLOEXEC | O_NOFOLLOW);
+  if (fd < 0)
+    return result;
+
+  struct stat64 st;
+  if (__fxstat64 (_STAT_VER, fd, &st) == 0
+      && S_ISREG (st.st_mode)
+      && st.st_uid == __geteuid ()
+      && (st.st_mode & (S_IWGRP | S_IWOTH)) == 0
+      && st.st_size != 0)
+    {
+      *sizep = st.st_size;
+      result = __mmap (NULL, *sizep, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+  __close_nocancel (fd);
+  return result;
+}
+
+void
+_dl_symcache_setup (void)
+{
+#if HAVE_TUNABLES
+  const char *dir = TUNABLE_GET (symbol_cache, const char *, NULL);
+#else
+  const char *dir = NULL;
+#endif
+  if (dir == NULL || *dir == '\0')
+    return;
+
+  /* Auditors and LD_DYNAMIC_WEAK can change the bindings.  A file
+     chosen by the environment must not decide the bindings of a
+     privileged process.  */
+  if (GLRO(dl_naudit) > 0 || GLRO(dl_dynamic_weak) || __libc_enable_secure)
+    return;
+
+  struct link_map *l;
+  unsigned int n = 0;
+  for (l = GL(dl_ns)[LM_ID_BASE]._ns_loaded; l != NULL; l = l->l_next)
+    ++n;
+  symcache_maps = malloc (n * sizeof (*symcache_maps));
+  symcache_ids = malloc (n * sizeof (*symcache_ids));
+  symcache_nsyms = malloc (n * sizeof (*symcache_nsyms));
+  if (symcache_maps == NULL || symcache_ids == NULL
+      || symcache_nsyms == NULL)
+    return;
+  n = 0;
+  for (l = GL(dl_ns)[LM_ID_BASE]._ns_loaded; l != NULL; l = l->l_next)
+    {
+      if (!symcache_build_id (l, &symcache_ids[n]))
+	return;
+      symcache_nsyms[n] = symcache_symbol_count (l);
+      symcache_maps[n++] = l;
+    }
+  symcache_nmaps = n;
+
+  /* The file is named after the build ID of the main program.  */
+  size_t dirlen = strlen (dir);
+  const struct symcache_id *main_id = &symcache_ids[0];
+  symcache_path = malloc (dirlen + 1 + 2 * main_id->size + 1);
+  if (symcache_path == NULL)
+    return;
+  char *cp = __mempcpy (symcache_path, dir, dirlen);
+  *cp++ = '/';
+  for (uint32_t i = 0; i < main_id->size; ++i)
+    {
+      unsigned char c = ((const unsigned char *) main_id->id)[i];
+      *cp++ = _itoa_lower_digits[c >> 4];
+      *cp++ = _itoa_lower_digits[c & 15];
+    }
+  *cp = '\0';
+
+  for (unsigned int i = 0; i < symcache_nmaps; ++i)
+    symcache_maps[i]->l_symcache_index = i + 1;
+
+  void *file = symcache_read_file (symcache_path, &symcache_file_size);
+  if (file != MAP_FAILED)
+    {
+      if (symcache_check (file, symcache_file_size))
+	symcache_file = file;
+      else
+	__munmap (file, symcache_file_size);
+    }
+
+  if (__glibc_unlikely (GLRO(dl_debug_mask) & DL_DEBUG_FILES))
+    _dl_debug_printf ("symbol cache=%s: %s\n", symcache_path,
+		      symcache_file != NULL ? "using" : "recording");
+
+  _dl_symcache_active = 1;
+}
+
+/* Compute the index of the symbol table entry REF for UNDEF_NAME in
+   UNDEF_MAP.  Return false if the lookup is not for a symbol table
+   entry of an object covered by the cache.  */
+static bool
+symcache_ref_index (const char *undef_name, struct link_map *undef_map,
+		    const ElfW(Sym) *ref, uint32_t *symndx)
+{
+  if (undef_map == NULL || undef_map->l_symcache_index == 0 || ref == NULL)
+    return false;
+
+  const ElfW(Sym) *symtab
+    = (const void *) D_PTR (undef_map, l_info[DT_SYMTAB]);
+  const char *strtab = (const void *) D_PTR (undef_map, l_info[DT_STRTAB]);
+  if (ref < symtab || strtab + ref->st_name != undef_name)
+    return false;
+  *symndx = ref - symtab;
+  return true;
+}
+
+bool
+_dl_symcache_lookup (const char *undef_name, struct link_map *undef_map,
+		     const ElfW(Sym) *ref, int type_class,
+		     struct link_map **mapp, const ElfW(Sym) **symp)
+{
+  uint32_t symndx;
+  if (symcache_file == NULL
+      || !symcache_ref_index (undef_name, undef_map, ref, &symndx))
+    return false;
+
+  const struct symcache_object *object
+    = &symcache_objects[undef_map->l_symcache_index - 1];
+  const struct symcache_binding *b = &symcache_bindings[object->first_binding];
+  size_t left = 0;
+  size_t right = object->nbindings;
+  while (left < right)
+    {
+      size_t middle = (left + right) / 2;
+      if (b[middle].symndx < symndx
+	  || (b[middle].symndx == symndx
+	      && b[middle].type_class < type_class))
+	left = middle + 1;
+      else
+	right = middle;
+    }
+  if (left == object->nbindings
+      || b[left].symndx != symndx || b[left].type_class != type_class
+      || b[left].def_object >= symcache_nmaps
+      || b[left].def_symndx >= symcache_nsyms[b[left].def_object])
+    return false;
+
+  /* Make sure the definition is the symbol we are looking for.  */
+  struct link_map *map = symcache_maps[b[left].def_object];
+  const ElfW(Sym) *symtab = (const void *) D_PTR (map, l_info[DT_SYMTAB]);
+  const char *strtab = (const void *) D_PTR (map, l_info[DT_STRTAB]);
+  const ElfW(Sym) *sym = &symtab[b[left].def_symndx];
+  if ((map->l_info[DT_STRSZ] != NULL
+	  && sym->st_name >= map->l_info[DT_STRSZ]->d_un.d_val)
+      || strcmp (strtab + sym->st_name, undef_name) != 0)
+    return false;
+
+  *mapp = map;
+  *symp = sym;
+  return true;
+}
+
+void
+_dl_symcache_record (const char *undef_name, struct link_map *undef_map,
+		     const ElfW(Sym) *ref, int type_class,
+		     struct link_map *map, const ElfW(Sym) *sym)
+{
+  uint32_t symndx;
+  if (symcache_file != NULL || map->l_symcache_index == 0
+      /* Unique symbols are bound through a table of their own.  */
+      || ELFW(ST_BIND) (sym->st_info) == STB_GNU_UNIQUE
+      || !symcache_ref_index (undef_name, undef_map, ref, &symndx))
+    return;
+
+  struct symcache_chunk *chunk = symcache_chunks;
+  if (chunk == NULL || chunk->used == array_length (chunk->records))
+    {
+      chunk = malloc (sizeof (*chunk));
+      if (chunk == NULL)
+	return;
+      chunk->next = symcache_chunks;
+      chunk->used = 0;
+      symcache_chunks = chunk;
+    }
+
+  const ElfW(Sym) *symtab = (const void *) D_PTR (map, l_info[DT_SYMTAB]);
+  struct symcache_record *r = &chunk->records[chunk->used++];
+  r->object = undef_map->l_symcache_index - 1;
+  r->binding.symndx = symndx;
+  r->binding.type_class = type_class;
+  r->binding.def_object = map->l_symcache_index - 1;
+  r->binding.def_symndx = sym - symtab;
+  ++symcache_nrecords;
+}
+
+static bool
+symcache_binding_less (const struct symcache_binding *a,
+		       const struct symcache_binding *b)
+{
+  return (a->symndx < b->symndx
+	  || (a->symndx == b->symndx && a->type_class < b->type_class));
+}
+
+static void
+symcache_sift_down (struct symcache_binding *b, size_t root, size_t n)
+{
+  while (2 * root + 1 < n)
+    {
+      size_t child = 2 * root + 1;
+      if (child + 1 < n && symcache_binding_less (&b[child], &b[child + 1]))
+	++child;
+      if (!symcache_binding_less (&b[root], &b[child]))
+	return;
+      struct symcache_binding tmp = b[root];
+      b[root] = b[child];
+      b[child] = tmp;
+      root = child;
+    }
+}
+
+/* Sort the N bindings at B.  There is no qsort in ld.so.  */
+static void
+symcache_sort (struct symcache_binding *b, size_t n)
+{
+  for (size_t i = n / 2; i-- > 0; )
+    symcache_sift_down (b, i, n);
+  while (n > 1)
+    {
+      --n;
+      struct symcache_binding tmp = b[0];
+      b[0] = b[n];
+      b[n] = tmp;
+      symcache_sift_down (b, 0, n);
+    }
+}
+
+/* Write the recorded bindings to SYMCACHE_PATH.  */
+static void
+symcache_write (void)
+{
+  uint32_t ids_size = 0;
+  for (unsigned int i = 0; i < symcache_nmaps; ++i)
+    ids_size += ALIGN_UP (symcache_ids[i].size, 4);
+  size_t size = (sizeof (struct symcache_header)
+		 + symcache_nmaps * sizeof (struct symcache_object)
+		 + ids_size
+		 + symcache_nrecords * sizeof (struct symcache_binding));
+  void *file = __mmap (NULL, size, PROT_READ | PROT_WRITE,
+		       MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (file == MAP_FAILED)
+    return;
+
+  struct symcache_header *header = file;
+  memcpy (header->magic, SYMCACHE_MAGIC, sizeof SYMCACHE_MAGIC);
+  header->nobjects = symcache_nmaps;
+  header->ids_size = ids_size;
+
+  struct symcache_object *objects = (void *) (header + 1);
+  char *ids = (char *) (objects + symcache_nmaps);
+  struct symcache_binding *bindings = (void *) (ids + ids_size);
+  uint32_t offset = 0;
+  for (unsigned int i = 0; i < symcache_nmaps; ++i)
+    {
+      objects[i].id_offset = offset;
+      objects[i].id_size = symcache_ids[i].size;
+      memcpy (ids + offset, symcache_ids[i].id, symcache_ids[i].size);
+      offset += ALIGN_UP (symcache_ids[i].size, 4);
+    }
+
+  /* Group the bindings by referencing object, then sort each group and
+     drop the duplicates.  */
+  struct symcache_chunk *chunk;
+  for (chunk = symcache_chunks; chunk != NULL; chunk = chunk->next)
+    for (size_t i = 0; i < chunk->used; ++i)
+      ++objects[chunk->records[i].object].nbindings;
+  uint32_t first = 0;
+  for (unsigned int i = 0; i < symcache_nmaps; ++i)
+    {
+      objects[i].first_binding = first;
+      first += objects[i].nbindings;
+      objects[i].nbindings = 0;
+    }
+  for (chunk = symcache_chunks; chunk != NULL; chunk = chunk->next)
+    for (size_t i = 0; i < chunk->used; ++i)
+      {
+	struct symcache_object *object = &objects[chunk->records[i].object];
+	bindings[object->first_binding + object->nbindings++]
+	  = chunk->records[i].binding;
+      }
+  uint32_t nbindings = 0;
+  for (unsigned int i = 0; i < symcache_nmaps; ++i)
+    {
+      struct symcache_binding *b = &bindings[objects[i].first_binding];
+      uint32_t n = objects[i].nbindings;
+      symcache_sort (b, n);
+      objects[i].first_binding = nbindings;
+      for (uint32_t j = 0; j < n; ++j)
+	if (j == 0 || symcache_binding_less (&b[j - 1], &b[j]))
+	  bindings[nbindings++] = b[j];
+      objects[i].nbindings = nbindings - objects[i].first_binding;
+    }
+  header->nbindings = nbindings;
+  size_t used = (char *) &bindings[nbindings] - (char *) file;
+
+  /* Write the new file under a name of its own first.  */
+  size_t pathlen = strlen (symcache_path);
+  char tmp[pathlen + sizeof ".tmp." + 3 * sizeof (pid_t)];
+  char *cp = __mempcpy (tmp, symcache_path, pathlen);
+  cp = __stpcpy (cp, ".tmp.");
+  char pidbuf[3 * sizeof (pid_t)];
+  char *pid = _itoa (__getpid (), &pidbuf[sizeof (pidbuf)], 10, 0);
+  *(char *) __mempcpy (cp, pid, &pidbuf[sizeof (pidbuf)] - pid) = '\0';
+
+  int fd = __open64_nocancel (tmp, O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC,
+			      S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+  if (fd >= 0)
+    {
+      size_t done = 0;
+      while (done < used)
+	{
+	  ssize_t n = __write_nocancel (fd, (char *) file + done, used - done);
+	  if (n <= 0)
+	    break;
+	  done += n;
+	}
+      __close_nocancel_nostatus (fd);
+      if (done != used || rename (tmp, symcache_path) != 0)
+	__unlink (tmp);
+    }
+
+  __munmap (file, size);
+}
+
+void
+_dl_symcache_finish (void)
+{
+  if (!_dl_symcache_active)
+    return;
+  _dl_symcache_active = 0;
+
+  if (symcache_file != NULL)
+    __munmap (symcache_file, symcache_file_size);
+  else
+    symcache_write ();
+}
@@ -29,10 +29,20 @@
 #include <dl-tls.h>
 #include <ldsodefs.h>
 
+#if HAVE_TUNABLES
+# define TUNABLE_NAMESPACE rtld
+#endif
+#include <elf/dl-tunables.h>
+
 /* Amount of excess space to allocate in the static TLS area
    to allow dynamic loading of modules defining IE-model TLS data.  */
 #define TLS_STATIC_SURPLUS	64 + DL_NNS * 100
 
+/* Default amount of the surplus which may be used opportunistically
+   for modules whose TLS is accessed through TLS descriptors or other
+   dynamic TLS relocations.  */
+#define TLS_STATIC_OPTIONAL	512
+
 
 /* Out-of-memory handler.  */
 static void
@@ -43,6 +53,26 @@ oom (void)
 }
 
 
+/* Compute the size of the surplus in the static TLS area.  Modules
+   with IE-model TLS loaded by dlopen can use all of it.  Modules with
+   dynamic TLS are only put into static TLS while the optional part is
+   not used up, so that they do not take the space away from later IE-model
+   modules.  */
+void
+_dl_tls_static_surplus_init (void)
+{
+  size_t opt_tls;
+
+#if HAVE_TUNABLES
+  opt_tls = TUNABLE_GET (optional_static_tls, size_t, NULL);
+#else
+  opt_tls = TLS_STATIC_OPTIONAL;
+#endif
+
+  GL(dl_tls_static_optional) = opt_tls;
+  GL(dl_tls_static_surplus) = TLS_STATIC_SURPLUS + opt_tls;
+}
+
 size_t
 _dl_next_tls_modid (void)
 {
@@ -218,7 +248,8 @@ _dl_determine_tlsoffset (void)
     }
 
   GL(dl_tls_static_used) = offset;
-  GL(dl_tls_static_size) = (roundup (offset + TLS_STATIC_SURPLUS, max_align)
+  GL(dl_tls_static_size) = (roundup (offset + GL(dl_tls_static_surplus),
+				     max_align)
 			    + TLS_TCB_SIZE);
 #elif TLS_DTV_AT_TP
   /* The TLS blocks start right after the TCB.  */
@@ -262,7 +293,7 @@ _dl_determine_tlsoffset (void)
     }
 
   GL(dl_tls_static_used) = offset;
-  GL(dl_tls_static_size) = roundup (offset + TLS_STATIC_SURPLUS,
+  GL(dl_tls_static_size) = roundup (offset + GL(dl_tls_static_surplus),
 				    TLS_TCB_ALIGN);
 #else
 # error "Either TLS_TCB_AT_TP or TLS_DTV_AT_TP must be defined"
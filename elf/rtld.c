@@ -721,6 +721,7 @@ init_tls (void)
   assert (i == GL(dl_tls_max_dtv_idx));
 
   /* Compute the TLS offsets for the various blocks.  */
+  _dl_tls_static_surplus_init ();
   _dl_determine_tlsoffset ();
 
   /* Construct the static TLS block and the dtv for the initial
@@ -900,6 +901,9 @@ dl_main (const ElfW(Phdr) *phdr,
   /* Process the environment variable which control the behaviour.  */
   process_envvars (&mode);
 
+  /* Select the algorithm for sorting objects by dependencies.  */
+  _dl_sort_maps_init ();
+
 #ifndef HAVE_INLINED_SYSCALLS
   /* Set up a flag which tells we are just starting.  */
   _dl_starting_up = 1;
@@ -2174,6 +2178,8 @@ ERROR: ld.so: object '%s' cannot be loaded as audit interface: %s; ignored.\n",
       /* If we are profiling we also must do lazy reloaction.  */
       GLRO(dl_lazy) |= consider_profiling;
 
+      _dl_symcache_setup ();
+
       HP_TIMING_NOW (start);
       unsigned i = main_map->l_searchlist.r_nlist;
       while (i-- > 0)
@@ -2205,6 +2211,8 @@ ERROR: ld.so: object '%s' cannot be loaded as audit interface: %s; ignored.\n",
 
       HP_TIMING_DIFF (relocate_time, start, stop);
 
+      _dl_symcache_finish ();
+
       /* Now enable profiling if needed.  Like the previous call,
 	 this has to go here because the calls it makes should use the
 	 rtld versions of the functions (particularly calloc()), but it
@@ -2767,6 +2775,15 @@ print_statistics (hp_timing_t *rtld_total_timep)
 		    GL(dl_num_relocations),
 		    GL(dl_num_cache_relocations),
 		    num_relative_relocations);
+  if (GL(dl_num_symcache_relocations) != 0)
+    _dl_debug_printf ("number of relocations from symbol cache: %lu\n",
+		      GL(dl_num_symcache_relocations));
+  if (_dl_path_cache_active)
+    _dl_debug_printf ("       probes answered from path cache: %lu\n"
+		      "           path cache directory checks: %lu\n"
+		      "          path cache directory changes: %lu\n",
+		      _dl_path_cache_hits, _dl_path_cache_checks,
+		      _dl_path_cache_invalidations);
 
 #ifndef HP_TIMING_NONAVAIL
   /* Time spend while loading the object and the dependencies.  */
@@ -0,0 +1,411 @@
+/* Test _dl_sort_maps with large synthetic dependency graphs.
+   Copyright (C) 2018 Free Software Foundation, Inc.
+   This file is part of the GNU C Library.
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; if not, see
+   <http://www.gnu.org/licenses/>.  */
+
+/* The sorting functions are included here so that both algorithms can
+   be tested on link maps built by the test, independently of the
+   glibc.rtld.dynamic_sort setting of the dynamic linker.  */
+#include "dl-sort-maps.c"
+
+#include <array_length.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <support/check.h>
+#include <support/support.h>
+#include <support/test-driver.h>
+
+enum dso_sort_algorithm _dl_dso_sort_algo;
+
+typedef void (*sort_function) (struct link_map **, unsigned int, bool);
+
+static const struct
+{
+  const char *name;
+  sort_function sort;
+} algorithms[] =
+  {
+    { "original", _dl_sort_maps_original },
+    { "dfs", _dl_sort_maps_dfs },
+  };
+
+/* A synthetic dependency graph.  The objects are numbered in
+   topological order: object I depends only on objects with a higher
+   number, except for the back edges inside a cycle group.  Objects in
+   the same group (a range of numbers) may therefore depend on each
+   other.  */
+struct graph
+{
+  unsigned int nobjects;
+  struct link_map *objects;
+  /* Group of each object, for objects in cycles.  */
+  unsigned int *group;
+  /* Number of objects at the end which are dependencies but are not
+     passed to the sort, like the main program or objects loaded
+     earlier.  */
+  unsigned int nexternal;
+};
+
+/* Dependencies of each object while the graph is built.  */
+struct deps
+{
+  unsigned int count;
+  unsigned int allocated;
+  unsigned int *list;
+};
+
+static bool
+has_dep (struct deps *deps, unsigned int dep)
+{
+  for (unsigned int i = 0; i < deps->count; ++i)
+    if (deps->list[i] == dep)
+      return true;
+  return false;
+}
+
+static void
+add_dep (struct deps *deps, unsigned int dep)
+{
+  if (deps->count == deps->allocated)
+    {
+      deps->allocated = 2 * deps->allocated + 4;
+      deps->list = xrealloc (deps->list,
+			     deps->allocated * sizeof (deps->list[0]));
+    }
+  deps->list[deps->count++] = dep;
+}
+
+/* Replace the dependencies in DEPS with all objects reachable from
+   each object, like the l_initfini lists built by _dl_map_object_deps.
+   The objects are in topological order, so one pass in reverse order
+   is enough unless there are CYCLES.  */
+static void
+close_deps (struct deps *deps, unsigned int nobjects, bool cycles)
+{
+  /* Used to avoid duplicates.  */
+  unsigned int *mark = xmalloc (nobjects * sizeof (unsigned int));
+  bool changed = true;
+  while (changed)
+    {
+      changed = false;
+      for (unsigned int i = 0; i < nobjects; ++i)
+	mark[i] = -1;
+      for (unsigned int i = nobjects; i-- > 0; )
+	{
+	  unsigned int count = deps[i].count;
+	  mark[i] = i;
+	  for (unsigned int j = 0; j < count; ++j)
+	    mark[deps[i].list[j]] = i;
+	  for (unsigned int j = 0; j < count; ++j)
+	    {
+	      struct deps *next = &deps[deps[i].list[j]];
+	      for (unsigned int k = 0; k < next->count; ++k)
+		if (mark[next->list[k]] != i)
+		  {
+		    mark[next->list[k]] = i;
+		    add_dep (&deps[i], next->list[k]);
+		    changed = cycles;
+		  }
+	    }
+	}
+    }
+  free (mark);
+}
+
+/* Return true if the object number A depends on object number B at
+   link time.  */
+static bool
+depends (struct graph *graph, unsigned int a, unsigned int b)
+{
+  for (struct link_map **l = graph->objects[a].l_initfini + 1; *l != NULL;
+       ++l)
+    if ((*l)->l_idx == b)
+      return true;
+  return false;
+}
+
+/* Create a graph with NOBJECTS objects (including NEXTERNAL external
+   ones), in which each object has between one and MAXDEPS dependencies
+   among the next SPAN objects.  If CYCLE is not zero, groups of CYCLE
+   objects get a back edge from their last to their first object.  If
+   CLOSURE, the l_initfini lists contain all objects reachable from the
+   object.  If RELDEPS, some objects get a relocation dependency.  */
+static struct graph
+make_graph (unsigned int nobjects, unsigned int nexternal,
+	    unsigned int maxdeps, unsigned int span, unsigned int cycle,
+	    bool closure, bool reldeps)
+{
+  struct graph graph =
+    {
+      .nobjects = nobjects,
+      .objects = xcalloc (nobjects, sizeof (struct link_map)),
+      .group = xcalloc (nobjects, sizeof (unsigned int)),
+      .nexternal = nexternal,
+    };
+  struct deps *deps = xcalloc (nobjects, sizeof (struct deps));
+
+  for (unsigned int i = 0; i < nobjects; ++i)
+    {
+      graph.group[i] = cycle == 0 ? i : i / cycle;
+      if (i + 1 >= nobjects)
+	continue;
+      unsigned int count = 1 + random () % maxdeps;
+      for (unsigned int j = 0; j < count; ++j)
+	{
+	  unsigned int limit = nobjects - i - 1;
+	  if (limit > span)
+	    limit = span;
+	  unsigned int dep = i + 1 + random () % limit;
+	  if (!has_dep (&deps[i], dep))
+	    add_dep (&deps[i], dep);
+	}
+      if (cycle > 1 && i % cycle == cycle - 1)
+	add_dep (&deps[i], i - cycle + 1);
+    }
+  if (closure)
+    close_deps (deps, nobjects, cycle > 1);
+
+  for (unsigned int i = 0; i < nobjects; ++i)
+    {
+      struct link_map *l = &graph.objects[i];
+      l->l_real = l;
+      l->l_idx = i;
+      /* The object itself comes first, as in the real lists.  */
+      l->l_initfini = xmalloc ((deps[i].count + 2)
+			       * sizeof (struct link_map *));
+      l->l_initfini[0] = l;
+      for (unsigned int j = 0; j < deps[i].count; ++j)
+	l->l_initfini[j + 1] = &graph.objects[deps[i].list[j]];
+      l->l_initfini[deps[i].count + 1] = NULL;
+      free (deps[i].list);
+    }
+  free (deps);
+
+  /* Relocation dependencies either on a later object, which must be
+     respected, or on an object which depends on this one at link time,
+     which must be ignored.  Neither kind introduces cycles.  */
+  if (reldeps)
+    for (unsigned int i = 0; i + 1 < nobjects; ++i)
+      {
+	if (random () % 4 != 0)
+	  continue;
+	unsigned int target;
+	if (random () % 2 == 0)
+	  target = i + 1 + random () % (nobjects - i - 1);
+	else if (i > 0)
+	  {
+	    target = random () % i;
+	    if (!depends (&graph, target, i))
+	      continue;
+	  }
+	else
+	  continue;
+	struct link_map *l = &graph.objects[i];
+	l->l_reldeps = xmalloc (sizeof (struct link_map_reldeps)
+				+ sizeof (struct link_map *));
+	l->l_reldeps->act = 1;
+	l->l_reldeps->list[0] = &graph.objects[target];
+      }
+
+  return graph;
+}
+
+static void
+free_graph (struct graph *graph)
+{
+  for (unsigned int i = 0; i < graph->nobjects; ++i)
+    {
+      free (graph->objects[i].l_initfini);
+      free (graph->objects[i].l_reldeps);
+    }
+  free (graph->objects);
+  free (graph->group);
+}
+
+/* Sort the objects of GRAPH which are not external, passed in a
+   shuffled order, with SORT and check the result.  */
+static void
+check_sort (struct graph *graph, unsigned int algorithm, bool for_fini)
+{
+  unsigned int nmaps = graph->nobjects - graph->nexternal;
+  struct link_map **maps = xmalloc (nmaps * sizeof (struct link_map *));
+  for (unsigned int i = 0; i < nmaps; ++i)
+    maps[i] = &graph->objects[i];
+  for (unsigned int i = nmaps; i > 1; --i)
+    {
+      unsigned int j = random () % i;
+      struct link_map *tmp = maps[i - 1];
+      maps[i - 1] = maps[j];
+      maps[j] = tmp;
+    }
+
+  algorithms[algorithm].sort (maps, nmaps, for_fini);
+
+  /* The result is a permutation of the input.  */
+  unsigned int *position = xmalloc (graph->nobjects * sizeof (unsigned int));
+  for (unsigned int i = 0; i < graph->nobjects; ++i)
+    position[i] = -1;
+  for (unsigned int i = 0; i < nmaps; ++i)
+    {
+      int idx = maps[i]->l_idx;
+      TEST_VERIFY_EXIT (idx >= 0 && idx < nmaps);
+      TEST_VERIFY_EXIT (position[idx] == -1);
+      position[idx] = i;
+      TEST_VERIFY (!maps[i]->l_sort_pending);
+    }
+
+  /* Each object comes before the objects it depends on, unless they are
+     in a cycle.  */
+  unsigned int errors = 0;
+  for (unsigned int i = 0; i < nmaps; ++i)
+    {
+      for (struct link_map **l = graph->objects[i].l_initfini + 1;
+	   *l != NULL; ++l)
+	{
+	  unsigned int dep = (*l)->l_idx;
+	  if (dep < nmaps && graph->group[i] != graph->group[dep]
+	      && position[i] > position[dep])
+	    ++errors;
+	}
+
+      /* For finalizers, relocation dependencies count as well, unless
+	 they contradict a link-time dependency.  */
+      struct link_map_reldeps *reldeps = graph->objects[i].l_reldeps;
+      if (for_fini && reldeps != NULL)
+	{
+	  unsigned int dep = reldeps->list[0]->l_idx;
+	  if (dep >= nmaps || graph->group[i] == graph->group[dep])
+	    continue;
+	  if (depends (graph, dep, i) ? position[dep] > position[i]
+	      : position[i] > position[dep])
+	    ++errors;
+	}
+    }
+  if (errors != 0)
+    {
+      support_record_failure ();
+      printf ("error: %s: %u dependencies not respected\n",
+	      algorithms[algorithm].name, errors);
+    }
+
+  free (position);
+  free (maps);
+}
+
+static void
+run (const char *description, unsigned int nobjects, unsigned int nexternal,
+     unsigned int maxdeps, unsigned int span, unsigned int cycle,
+     bool closure, bool reldeps, bool with_original)
+{
+  struct graph graph = make_graph (nobjects, nexternal, maxdeps, span,
+				   cycle, closure, reldeps);
+  for (unsigned int algorithm = !with_original;
+       algorithm < array_length (algorithms); ++algorithm)
+    for (int for_fini = 0; for_fini <= 1; ++for_fini)
+      {
+	if (test_verbose > 0)
+	  printf ("info: %s, %s%s\n", description,
+		  algorithms[algorithm].name, for_fini ? ", fini" : "");
+	check_sort (&graph, algorithm, for_fini);
+      }
+  free_graph (&graph);
+}
+
+/* A cycle of a link-time dependency and two relocation dependencies,
+   in which the link-time dependency must be respected.  The original
+   algorithm does not get this right for every input order.  */
+static void
+check_reldeps_cycle (void)
+{
+  for (unsigned int algorithm = 1; algorithm < array_length (algorithms);
+       ++algorithm)
+    for (unsigned int start = 0; start < 3; ++start)
+      {
+	struct link_map objects[3] = { { 0 } };
+	struct link_map *initfini[3][3] =
+	  {
+	    { &objects[0], &objects[2], NULL },
+	    { &objects[1], NULL },
+	    { &objects[2], NULL },
+	  };
+	struct
+	{
+	  struct link_map_reldeps reldeps;
+	  struct link_map *list[1];
+	} reldeps[3] =
+	  {
+	    [1] = { { .act = 1 }, { &objects[0] } },
+	    [2] = { { .act = 1 }, { &objects[1] } },
+	  };
+	struct link_map *maps[3];
+	for (unsigned int i = 0; i < 3; ++i)
+	  {
+	    objects[i].l_real = &objects[i];
+	    objects[i].l_initfini = initfini[i];
+	    if (i > 0)
+	      objects[i].l_reldeps = &reldeps[i].reldeps;
+	    maps[i] = &objects[(start + i) % 3];
+	  }
+
+	algorithms[algorithm].sort (maps, 3, true);
+
+	unsigned int position[3] = { -1, -1, -1 };
+	for (unsigned int i = 0; i < 3; ++i)
+	  {
+	    TEST_VERIFY_EXIT (maps[i] >= objects && maps[i] < objects + 3);
+	    TEST_VERIFY (position[maps[i] - objects] == -1);
+	    position[maps[i] - objects] = i;
+	  }
+	if (position[0] > position[2])
+	  {
+	    support_record_failure ();
+	    printf ("error: %s: link-time dependency not respected\n",
+		    algorithms[algorithm].name);
+	  }
+      }
+}
+
+static int
+do_test (void)
+{
+  srandom (1);
+
+  for (int i = 0; i < 10; ++i)
+    {
+      /* Graphs like those of real programs, which both algorithms can
+	 sort quickly.  */
+      run ("small", 50, 0, 4, 10, 0, true, false, true);
+      run ("small, external", 50, 5, 4, 10, 0, true, false, true);
+      run ("small, cycles", 60, 0, 3, 8, 3, true, false, true);
+      run ("small, reldeps", 60, 0, 3, 8, 0, true, true, true);
+    }
+
+  check_reldeps_cycle ();
+
+  /* Large graphs, for the linear algorithm only.  */
+  run ("large", 20000, 0, 4, 200, 0, false, false, false);
+  run ("large, external", 20000, 100, 4, 200, 0, false, false, false);
+  run ("large, closure", 1000, 10, 3, 50, 0, true, false, false);
+  run ("large, cycles", 20000, 0, 4, 100, 5, false, false, false);
+  run ("large, reldeps", 1000, 0, 3, 50, 0, true, true, false);
+  /* A long chain, which needs a deep search.  */
+  run ("chain", 100000, 0, 1, 1, 0, false, false, false);
+  run ("wide", 20000, 0, 50, 20000, 0, false, false, false);
+
+  return 0;
+}
+
+#include <support/test-driver.c>
@@ -0,0 +1,48 @@
+/* Test that TLS descriptors do not use up the static TLS surplus.
+   Copyright (C) 2018 Free Software Foundation, Inc.
+   This file is part of the GNU C Library.
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; if not, see
+   <http://www.gnu.org/licenses/>.  */
+
+/* tst-gnu2-tls2mod1.so uses TLS descriptors, and its TLS block is
+   larger than the optional part of the static TLS surplus, so it must
+   use dynamic TLS.  The initial-exec TLS of tst-gnu2-tls2mod2.so only
+   fits into the surplus if the first module did not take it.  */
+
+#include <stddef.h>
+#include <support/check.h>
+#include <support/xdlfcn.h>
+
+static int
+do_test (void)
+{
+  void *h1 = xdlopen ("tst-gnu2-tls2mod1.so", RTLD_NOW);
+  int (*check1) (size_t) = xdlsym (h1, "check_desc");
+  TEST_COMPARE (check1 (0), 0);
+
+  void *h2 = xdlopen ("tst-gnu2-tls2mod2.so", RTLD_NOW);
+  int (*check2) (size_t) = xdlsym (h2, "check_ie");
+  TEST_COMPARE (check2 (0), 0);
+
+  /* The values are preserved across calls.  */
+  TEST_COMPARE (check1 (1), 1);
+  TEST_COMPARE (check2 (1), 1);
+
+  xdlclose (h2);
+  xdlclose (h1);
+  return 0;
+}
+
+#include <support/test-driver.c>
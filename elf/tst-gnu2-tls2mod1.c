@@ -0,0 +1,32 @@
+/* Module with a large TLS block accessed with TLS descriptors.
+   Copyright (C) 2018 Free Software Foundation, Inc.
+   This file is part of the GNU C Library.
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; if not, see
+   <http://www.gnu.org/licenses/>.  */
+
+#include <stddef.h>
+
+static __thread char desc_buf[1024] = { 1 };
+
+/* Return the previous marker and store VALUE + 1 as the new one.  */
+int
+check_desc (size_t value)
+{
+  int result = desc_buf[sizeof (desc_buf) - 1];
+  if (desc_buf[0] != 1)
+    return -1;
+  desc_buf[sizeof (desc_buf) - 1] = value + 1;
+  return result;
+}
@@ -0,0 +1,37 @@
+/* Module with initial-exec TLS loaded by dlopen.
+   Copyright (C) 2018 Free Software Foundation, Inc.
+   This file is part of the GNU C Library.
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; if not, see
+   <http://www.gnu.org/licenses/>.  */
+
+#include <stddef.h>
+
+#ifndef TLS_SIZE
+# define TLS_SIZE 1400
+#endif
+
+static __thread char ie_buf[TLS_SIZE]
+  __attribute__ ((tls_model ("initial-exec"))) = { 1 };
+
+/* Return the previous marker and store VALUE + 1 as the new one.  */
+int
+check_ie (size_t value)
+{
+  int result = ie_buf[sizeof (ie_buf) - 1];
+  if (ie_buf[0] != 1)
+    return -1;
+  ie_buf[sizeof (ie_buf) - 1] = value + 1;
+  return result;
+}
@@ -0,0 +1,156 @@
+/* Check the hash table in an ld.so.cache file written by ldconfig.
+   Copyright (C) 2018 Free Software Foundation, Inc.
+   This file is part of the GNU C Library.
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; if not, see
+   <http://www.gnu.org/licenses/>.  */
+
+/* tst-ldconfig-hash.sh runs this program on the caches it creates.  */
+
+#include <dl-cache.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <support/check.h>
+#include <support/xunistd.h>
+
+static const struct cache_file_new *cache_new;
+static const char *cache_data;
+static const struct cache_hash_table *table;
+
+/* Look up NAME in the hash table.  Return the slot for it, or NULL.  */
+static const struct cache_hash_slot *
+lookup (const char *name)
+{
+  uint32_t hash = _dl_cache_hash (name);
+  uint32_t mask = table->nslots - 1;
+  for (uint32_t i = 0; i <= mask; ++i)
+    {
+      const struct cache_hash_slot *slot = &table->slots[(hash + i) & mask];
+      if (slot->count == 0)
+	return NULL;
+      if (slot->hash == hash
+	  && strcmp (name, cache_data + cache_new->libs[slot->first].key) == 0)
+	return slot;
+    }
+  return NULL;
+}
+
+/* Check that NAME has COUNT entries.  */
+static void
+check_name (const char *name, uint32_t count)
+{
+  const struct cache_hash_slot *slot = lookup (name);
+  printf ("info: %s: %u entries\n", name, slot == NULL ? 0 : slot->count);
+  if (count == 0)
+    TEST_VERIFY (slot == NULL);
+  else if (slot == NULL)
+    {
+      support_record_failure ();
+      printf ("error: %s not found\n", name);
+    }
+  else
+    TEST_COMPARE (slot->count, count);
+}
+
+static int
+do_test (int argc, char **argv)
+{
+  TEST_VERIFY_EXIT (argc == 2);
+
+  int fd = xopen (argv[1], O_RDONLY, 0);
+  struct stat64 st;
+  xfstat (fd, &st);
+  const char *file = xmmap (NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd);
+  xclose (fd);
+
+  /* Find the new format, which may be embedded in the old one.  */
+  cache_new = (const struct cache_file_new *) file;
+  if (memcmp (file, CACHEMAGIC, sizeof CACHEMAGIC - 1) == 0)
+    {
+      const struct cache_file *cache = (const struct cache_file *) file;
+      cache_new = (const void *) (file
+				  + ALIGN_CACHE (sizeof (struct cache_file)
+						 + (cache->nlibs
+						    * sizeof (struct file_entry))));
+    }
+  TEST_VERIFY_EXIT (memcmp (cache_new->magic, CACHEMAGIC_VERSION_NEW,
+			    sizeof CACHEMAGIC_VERSION_NEW - 1) == 0);
+  cache_data = (const char *) cache_new;
+
+  /* The table follows the string table.  */
+  uint32_t offset = cache_new->hash_offset;
+  TEST_VERIFY_EXIT (offset % __alignof__ (struct cache_hash_table) == 0);
+  TEST_VERIFY_EXIT (offset >= sizeof (struct cache_file_new)
+			      + (cache_new->nlibs
+				 * sizeof (struct file_entry_new))
+			      + cache_new->len_strings);
+  table = (const void *) (cache_data + offset);
+  TEST_COMPARE (table->magic, CACHE_HASH_MAGIC);
+  TEST_VERIFY_EXIT (table->nslots >= 2 * cache_new->nlibs);
+  TEST_COMPARE (table->nslots & (table->nslots - 1), 0);
+  TEST_VERIFY_EXIT (cache_data + offset + sizeof (struct cache_hash_table)
+		    + table->nslots * sizeof (struct cache_hash_slot)
+		    == file + st.st_size);
+  printf ("info: %u entries, %u slots\n", cache_new->nlibs, table->nslots);
+
+  /* Every entry is covered by exactly one slot, which has all entries
+     for its name.  */
+  uint32_t covered = 0;
+  for (uint32_t i = 0; i < table->nslots; ++i)
+    {
+      const struct cache_hash_slot *slot = &table->slots[i];
+      if (slot->count == 0)
+	continue;
+      TEST_VERIFY_EXIT (slot->first < cache_new->nlibs);
+      TEST_VERIFY_EXIT (slot->count <= cache_new->nlibs - slot->first);
+      covered += slot->count;
+      const char *name = cache_data + cache_new->libs[slot->first].key;
+      TEST_COMPARE (slot->hash, _dl_cache_hash (name));
+      TEST_VERIFY (lookup (name) == slot);
+      for (uint32_t j = slot->first; j < slot->first + slot->count; ++j)
+	TEST_VERIFY (strcmp (name, cache_data + cache_new->libs[j].key) == 0);
+      if (slot->first > 0)
+	TEST_VERIFY (strcmp (name, cache_data
+			     + cache_new->libs[slot->first - 1].key) != 0);
+      if (slot->first + slot->count < cache_new->nlibs)
+	TEST_VERIFY (strcmp (name, cache_data
+			     + cache_new->libs[slot->first
+					       + slot->count].key) != 0);
+    }
+  TEST_COMPARE (covered, cache_new->nlibs);
+
+  check_name ("libtsthash1.so.1", 2);
+  check_name ("libtsthash2.so.1", 2);
+  check_name ("libtsthash3.so.1", 1);
+  check_name ("libtsthash500.so.1", 1);
+  check_name ("libtsthash0.so.1", 0);
+  check_name ("libtsthash501.so.1", 0);
+  check_name ("libtsthash1.so.10", 0);
+  check_name ("libtsthash.so.1", 0);
+
+  /* Names which _dl_cache_libcmp treats as equal hash equally.  */
+  TEST_COMPARE (_dl_cache_hash ("libtsthash01.so.001"),
+		_dl_cache_hash ("libtsthash1.so.1"));
+  TEST_VERIFY (_dl_cache_hash ("libtsthash10.so.1")
+	       != _dl_cache_hash ("libtsthash1.so.1"));
+
+  xmunmap ((void *) file, st.st_size);
+  return 0;
+}
+
+#define TEST_FUNCTION_ARGV do_test
+#include <support/test-driver.c>
@@ -0,0 +1,60 @@
+#!/bin/sh
+# Test the hash table which ldconfig writes into ld.so.cache.
+# Copyright (C) 2018 Free Software Foundation, Inc.
+# This file is part of the GNU C Library.
+
+# The GNU C Library is free software; you can redistribute it and/or
+# modify it under the terms of the GNU Lesser General Public
+# License as published by the Free Software Foundation; either
+# version 2.1 of the License, or (at your option) any later version.
+
+# The GNU C Library is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+# Lesser General Public License for more details.
+
+# You should have received a copy of the GNU Lesser General Public
+# License along with the GNU C Library; if not, see
+# <http://www.gnu.org/licenses/>.
+
+set -e
+
+common_objpfx=$1
+test_wrapper_env=$2
+run_program_env=$3
+
+testroot="${common_objpfx}elf/tst-ldconfig-hash-directory"
+cleanup () {
+    rm -rf "$testroot"
+}
+trap cleanup 0
+
+rm -rf "$testroot"
+mkdir -p $testroot/lib/tls $testroot/lib2
+
+# Enough names for collisions in the table.  libtsthash1.so.1 has a
+# second entry for the tls subdirectory, and libtsthash2.so.1 one for
+# the second directory.
+mod=${common_objpfx}elf/tst-ldconfig-hashmod.so
+i=1
+while test $i -le 500; do
+  cp $mod $testroot/lib/libtsthash$i.so.1
+  i=$((i + 1))
+done
+cp $mod $testroot/lib/tls/libtsthash1.so.1
+cp $mod $testroot/lib2/libtsthash2.so.1
+
+for format in compat new; do
+  echo "format: $format"
+  ${test_wrapper_env} \
+  ${run_program_env} \
+  ${common_objpfx}elf/ldconfig -X -f /dev/null -c $format \
+    -C $testroot/ld.so.cache \
+    $testroot/lib $testroot/lib2
+
+  ${test_wrapper_env} \
+  ${run_program_env} \
+  ${common_objpfx}elf/ld.so \
+    --library-path ${common_objpfx}elf:${common_objpfx}. \
+    ${common_objpfx}elf/tst-ldconfig-hash $testroot/ld.so.cache
+done
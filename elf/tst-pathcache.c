@@ -0,0 +1,138 @@
+/* Test the memoization of failed search path probes (glibc.rtld.path_cache).
+   Copyright (C) 2018 Free Software Foundation, Inc.
+   This file is part of the GNU C Library.
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; if not, see
+   <http://www.gnu.org/licenses/>.  */
+
+/* The program has PFX "tst-pathcache-dir" in its run path and runs with
+   LD_DEBUG=libs, writing the debugging output to a file.  */
+
+#include <dlfcn.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <support/check.h>
+#include <support/support.h>
+#include <support/xdlfcn.h>
+#include <support/xstdio.h>
+#include <support/xunistd.h>
+
+static const char dir[] = PFX "tst-pathcache-dir";
+static const char copy[] = PFX "tst-pathcache-dir/tst-pathcache-copy.so";
+static const char link_name[]
+  = PFX "tst-pathcache-dir/tst-pathcache-link.so";
+static const char target[] = PFX "tst-pathcache-target.so";
+
+/* The process which opened the debugging output file.  The test runs
+   in a subprocess of it.  */
+static pid_t initial_pid;
+
+static void __attribute__ ((constructor))
+init (void)
+{
+  initial_pid = getpid ();
+}
+
+/* Return the number of lines in the debugging output which end with
+   SUFFIX.  */
+static int
+count_lines (const char *suffix)
+{
+  char *name = xasprintf ("%s.%d", getenv ("LD_DEBUG_OUTPUT"),
+			  (int) initial_pid);
+  FILE *fp = xfopen (name, "r");
+  int count = 0;
+  char *line = NULL;
+  size_t line_size = 0;
+  while (getline (&line, &line_size, fp) > 0)
+    {
+      size_t len = strlen (line);
+      if (len >= strlen (suffix)
+	  && strcmp (line + len - strlen (suffix), suffix) == 0)
+	++count;
+    }
+  free (line);
+  xfclose (fp);
+  free (name);
+  return count;
+}
+
+static int
+do_test (void)
+{
+  TEST_VERIFY_EXIT (getenv ("LD_DEBUG_OUTPUT") != NULL);
+
+  unlink (copy);
+  unlink (link_name);
+  unlink (target);
+  rmdir (dir);
+  xmkdir (dir, 0777);
+  TEST_COMPARE (symlink (target, link_name), 0);
+
+  /* Changes made to the directory in the last few seconds prevent it
+     from being cached.  */
+  sleep (4);
+
+  char *trying = xasprintf (" trying file=%s\n", copy);
+  char *skipping = xasprintf (" skipping file=%s (not in directory)\n",
+			      copy);
+
+  /* Both attempts are answered from the contents of the directory.  */
+  TEST_VERIFY (dlopen ("tst-pathcache-copy.so", RTLD_NOW) == NULL);
+  TEST_COMPARE (count_lines (trying), 0);
+  TEST_COMPARE (count_lines (skipping), 1);
+  TEST_VERIFY (dlopen ("tst-pathcache-copy.so", RTLD_NOW) == NULL);
+  TEST_COMPARE (count_lines (trying), 0);
+  TEST_COMPARE (count_lines (skipping), 2);
+
+  /* A dangling symbolic link has a directory entry, so it is tried
+     every time; its target can be created without changing the
+     directory.  */
+  char *trying_link = xasprintf (" trying file=%s\n", link_name);
+  TEST_VERIFY (dlopen ("tst-pathcache-link.so", RTLD_NOW) == NULL);
+  TEST_VERIFY (dlopen ("tst-pathcache-link.so", RTLD_NOW) == NULL);
+  TEST_COMPARE (count_lines (trying_link), 2);
+  if (system ("cp " PFX "tst-pathcachemod.so " PFX
+	      "tst-pathcache-target.so") != 0)
+    FAIL_EXIT1 ("cannot copy tst-pathcachemod.so");
+  void *handle = xdlopen ("tst-pathcache-link.so", RTLD_NOW);
+  xdlclose (handle);
+  TEST_COMPARE (count_lines (trying_link), 3);
+  free (trying_link);
+
+  /* Adding the file to the directory invalidates the cache.  */
+  if (system ("cp " PFX "tst-pathcachemod.so " PFX
+	      "tst-pathcache-dir/tst-pathcache-copy.so") != 0)
+    FAIL_EXIT1 ("cannot copy tst-pathcachemod.so");
+  handle = xdlopen ("tst-pathcache-copy.so", RTLD_NOW);
+  int (*func) (void) = xdlsym (handle, "tst_pathcachemod_func");
+  TEST_COMPARE (func (), 42);
+  xdlclose (handle);
+  TEST_COMPARE (count_lines (trying), 1);
+  TEST_COMPARE (count_lines (skipping), 2);
+
+  free (skipping);
+  free (trying);
+  xunlink (copy);
+  xunlink (link_name);
+  xunlink (target);
+  rmdir (dir);
+  return 0;
+}
+
+#include <support/test-driver.c>
@@ -0,0 +1,69 @@
+/* Test the persistent symbol cache (glibc.rtld.symbol_cache).
+   Copyright (C) 2018 Free Software Foundation, Inc.
+   This file is part of the GNU C Library.
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; if not, see
+   <http://www.gnu.org/licenses/>.  */
+
+/* tst-symcache.sh runs this program several times, with and without a
+   valid cache.  The bindings must be the same in every run.  */
+
+#include <stdio.h>
+#include <string.h>
+
+extern int symcache_var;
+extern int symcache_mod1 (void);
+extern int symcache_mod2 (void);
+extern int (*symcache_ptr) (void);
+extern size_t (*symcache_strlen) (const char *);
+
+/* Interposes the definition in tst-symcachemod1.so.  */
+int
+symcache_interposed (void)
+{
+  return 40;
+}
+
+static int
+do_test (void)
+{
+  int result = 0;
+
+  if (symcache_ptr != symcache_interposed)
+    {
+      puts ("symcache_ptr does not point to symcache_interposed");
+      result = 1;
+    }
+  if (symcache_mod1 () != 41 || symcache_mod2 () != 41)
+    {
+      printf ("symcache_mod1 () == %d, symcache_mod2 () == %d\n",
+	      symcache_mod1 (), symcache_mod2 ());
+      result = 1;
+    }
+  if (symcache_strlen != strlen || symcache_strlen ("symcache") != 8)
+    {
+      puts ("symcache_strlen does not point to strlen");
+      result = 1;
+    }
+  symcache_var = 2;
+  if (symcache_mod1 () != 42)
+    {
+      puts ("symcache_var is not shared");
+      result = 1;
+    }
+
+  return result;
+}
+
+#include <support/test-driver.c>
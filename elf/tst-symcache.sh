@@ -0,0 +1,108 @@
+#!/bin/sh
+# Test the persistent symbol cache (glibc.rtld.symbol_cache).
+# Copyright (C) 2018 Free Software Foundation, Inc.
+# This file is part of the GNU C Library.
+
+# The GNU C Library is free software; you can redistribute it and/or
+# modify it under the terms of the GNU Lesser General Public
+# License as published by the Free Software Foundation; either
+# version 2.1 of the License, or (at your option) any later version.
+
+# The GNU C Library is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+# Lesser General Public License for more details.
+
+# You should have received a copy of the GNU Lesser General Public
+# License along with the GNU C Library; if not, see
+# <http://www.gnu.org/licenses/>.
+
+set -e
+
+common_objpfx=$1
+test_wrapper_env=$2
+run_program_env=$3
+
+cache=${common_objpfx}elf/tst-symcache.dir
+stats=${common_objpfx}elf/tst-symcache.stats
+rm -rf $cache
+mkdir $cache
+
+# Run the test program with the cache and the environment variables in
+# the arguments.  Set HITS to the number of relocations which used the
+# cache.
+run ()
+{
+  if ! ${test_wrapper_env} \
+       ${run_program_env} \
+       GLIBC_TUNABLES=glibc.rtld.symbol_cache=$cache \
+       LD_BIND_NOW=1 LD_DEBUG=statistics "$@" \
+	 ${common_objpfx}elf/ld.so \
+	   --library-path ${common_objpfx}elf:${common_objpfx}. \
+	   ${common_objpfx}elf/tst-symcache 2> $stats; then
+    echo "error: test program failed"
+    cat $stats
+    exit 1
+  fi
+  hits=$(sed -n 's/.*relocations from symbol cache: *//p' $stats)
+}
+
+check ()
+{
+  echo "$1: $2"
+  if test "$2" != "$3"; then
+    echo "error: expected $3"
+    exit 1
+  fi
+}
+
+# The first run writes the cache, the second one uses it.
+run
+check "first run" "$hits" ""
+check "cache files" "$(ls $cache | wc -l)" "1"
+run
+echo "second run: $hits"
+if test -z "$hits" || test "$hits" -eq 0; then
+  echo "error: cache not used"
+  exit 1
+fi
+expected=$hits
+run
+check "third run" "$hits" "$expected"
+
+# A damaged cache is not used, and replaced.
+file=$cache/$(ls $cache)
+echo "damaged" > $file
+run
+check "damaged cache" "$hits" ""
+run
+check "replaced cache" "$hits" "$expected"
+
+# A cache file which others can write is not trusted, and replaced.
+chmod go+w $file
+run
+check "writable cache" "$hits" ""
+check "replaced mode" "$(ls -l $file | cut -c1-10)" "-rw-r--r--"
+run
+check "after writable cache" "$hits" "$expected"
+
+# The cache does not match if the objects are loaded in a different
+# order.
+run LD_PRELOAD=${common_objpfx}elf/tst-symcachemod2.so
+check "preload" "$hits" ""
+run
+check "after preload" "$hits" ""
+run
+check "rewritten cache" "$hits" "$expected"
+check "cache files" "$(ls $cache | wc -l)" "1"
+
+# A binding whose definition is outside the symbol table is not used.
+# The last four bytes of the file are the symbol index of the last
+# definition.
+size=$(wc -c < $file)
+printf '\377\377\377\377' | dd of=$file bs=1 seek=$((size - 4)) \
+  conv=notrunc 2> /dev/null
+run
+check "bad symbol index" "$hits" "$((expected - 1))"
+
+rm -rf $cache $stats
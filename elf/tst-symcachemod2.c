@@ -0,0 +1,31 @@
+/* Module for tst-symcache.  It uses the definitions of the others.
+   Copyright (C) 2018 Free Software Foundation, Inc.
+   This file is part of the GNU C Library.
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; if not, see
+   <http://www.gnu.org/licenses/>.  */
+
+#include <string.h>
+
+extern int symcache_var;
+extern int symcache_interposed (void);
+
+int (*symcache_ptr) (void) = symcache_interposed;
+size_t (*symcache_strlen) (const char *) = strlen;
+
+int
+symcache_mod2 (void)
+{
+  return symcache_ptr () + symcache_var;
+}
@@ -0,0 +1,37 @@
+/* Test the glibc.rtld.optional_static_tls tunable.
+   Copyright (C) 2018 Free Software Foundation, Inc.
+   This file is part of the GNU C Library.
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; if not, see
+   <http://www.gnu.org/licenses/>.  */
+
+/* The initial-exec TLS block of tst-tls-surplusmod.so is larger than
+   the default static TLS surplus.  */
+
+#include <stddef.h>
+#include <support/check.h>
+#include <support/xdlfcn.h>
+
+static int
+do_test (void)
+{
+  void *h = xdlopen ("tst-tls-surplusmod.so", RTLD_NOW);
+  int (*check) (size_t) = xdlsym (h, "check_ie");
+  TEST_COMPARE (check (0), 0);
+  TEST_COMPARE (check (1), 1);
+  xdlclose (h);
+  return 0;
+}
+
+#include <support/test-driver.c>
@@ -202,6 +202,10 @@ struct link_map
     unsigned int l_free_initfini:1; /* Nonzero if l_initfini can be
 				       freed, ie. not allocated with
 				       the dummy malloc in ld.so.  */
+    unsigned int l_sort_pending:1; /* Nonzero while _dl_sort_maps has
+				      not visited the object yet.  */
+    unsigned int l_sort_active:1; /* Nonzero while _dl_sort_maps has
+				     visited but not placed the object.  */
 
 #include <link_map.h>
 
@@ -281,6 +285,10 @@ struct link_map
       const ElfW(Sym) *ret;
     } l_lookup_cache;
 
+    /* Index of the object in the persistent symbol cache plus one, or
+       zero if it is not covered by the cache.  */
+    unsigned int l_symcache_index;
+
     /* Thread-local storage related info.  */
 
     /* Start of the initialization image.  */
@@ -0,0 +1,155 @@
+/* Output of profile reports.
+   Copyright (C) 2018 Free Software Foundation, Inc.
+   This file is part of the GNU C Library.
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; if not, see
+   <http://www.gnu.org/licenses/>.  */
+
+#ifndef _PROFILE_WRITER_H
+#define _PROFILE_WRITER_H
+
+/* The heap profiler in malloc and the lock profiler in libpthread
+   write their reports from signal handlers, so the output is buffered
+   and written to a file descriptor without calling malloc.  In libc,
+   the output can go to a stream instead.  */
+
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/param.h>
+#include <_itoa.h>
+#include <not-cancel.h>
+
+struct profile_writer
+{
+  /* If not NULL, the stream the output is written to, instead of
+     FD.  */
+  FILE *fp;
+  int fd;
+  size_t len;
+  char buf[512];
+};
+
+static inline void
+profile_writer_flush (struct profile_writer *w)
+{
+#if IS_IN (libc)
+  if (w->fp != NULL)
+    fwrite (w->buf, 1, w->len, w->fp);
+  else
+#endif
+    for (size_t done = 0; done < w->len; )
+      {
+	ssize_t n = __write_nocancel (w->fd, w->buf + done, w->len - done);
+	if (n <= 0)
+	  break;
+	done += n;
+      }
+  w->len = 0;
+}
+
+static inline void
+profile_writer_write (struct profile_writer *w, const char *s, size_t len)
+{
+  while (len > 0)
+    {
+      if (w->len == sizeof (w->buf))
+	profile_writer_flush (w);
+      size_t n = MIN (len, sizeof (w->buf) - w->len);
+      memcpy (w->buf + w->len, s, n);
+      w->len += n;
+      s += n;
+      len -= n;
+    }
+}
+
+static inline void
+profile_writer_puts (struct profile_writer *w, const char *s)
+{
+  profile_writer_write (w, s, strlen (s));
+}
+
+/* Write VALUE in BASE, padded with blanks to WIDTH characters.  */
+static inline void
+profile_writer_putnum (struct profile_writer *w, unsigned long int value,
+		       unsigned int base, int width)
+{
+  char buf[3 * sizeof (value)];
+  char *end = buf + sizeof (buf);
+  char *p = _itoa_word (value, end, base, 0);
+  for (int pad = width - (end - p); pad > 0; --pad)
+    profile_writer_write (w, " ", 1);
+  profile_writer_write (w, p, end - p);
+}
+
+/* Write the address P with all its hexadecimal digits.  */
+static inline void
+profile_writer_putaddr (struct profile_writer *w, const void *p)
+{
+  char buf[2 + 2 * sizeof (p)];
+  char *end = buf + sizeof (buf);
+  char *start = _itoa_word ((uintptr_t) p, end, 16, 0);
+  while (start > buf + 2)
+    *--start = '0';
+  buf[0] = '0';
+  buf[1] = 'x';
+  profile_writer_write (w, buf, sizeof (buf));
+}
+
+/* Write the memory map of the process, which pprof and other tools
+   need to symbolize the addresses in a report, and flush the
+   output.  */
+static inline void
+profile_writer_finish (struct profile_writer *w)
+{
+  profile_writer_puts (w, "\nMAPPED_LIBRARIES:\n");
+  int fd = __open_nocancel ("/proc/self/maps", O_RDONLY | O_CLOEXEC);
+  if (fd >= 0)
+    {
+      char buf[512];
+      ssize_t n;
+      while ((n = __read_nocancel (fd, buf, sizeof (buf))) > 0)
+	profile_writer_write (w, buf, n);
+      __close_nocancel_nostatus (fd);
+    }
+  profile_writer_flush (w);
+}
+
+/* Create the file PREFIX.PID.NSUFFIX in the current directory, where
+   PID is the process ID, and return a descriptor for writing to it, or
+   -1 on failure.  */
+static inline int
+profile_writer_open (const char *prefix, unsigned int n, const char *suffix)
+{
+  char name[64];
+  char buf[3 * sizeof (unsigned long int)];
+  char *end = buf + sizeof (buf);
+  char *p;
+
+  strcpy (name, prefix);
+  strcat (name, ".");
+  p = _itoa_word (__getpid (), end, 10, 0);
+  strncat (name, p, end - p);
+  strcat (name, ".");
+  p = _itoa_word (n, end, 10, 0);
+  strncat (name, p, end - p);
+  strcat (name, suffix);
+
+  return __open_nocancel (name, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC,
+			  0644);
+}
+
+#endif /* _PROFILE_WRITER_H */
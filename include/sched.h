@@ -26,5 +26,8 @@ libc_hidden_proto (__clone)
 extern int __clone2 (int (*__fn) (void *__arg), void *__child_stack_base,
 		     size_t __child_stack_size, int __flags, void *__arg, ...);
 libc_hidden_proto (__clone2)
+extern int __sched_getcpu (void);
+libc_hidden_proto (__sched_getcpu)
+extern int __sched_getnode (void) attribute_hidden;
 #endif
 #endif
@@ -57,10 +57,11 @@ typedef struct _heap_info
   size_t size;   /* Current size in bytes. */
   size_t mprotect_size; /* Size in bytes that has been mprotected
                            PROT_READ|PROT_WRITE.  */
+  size_t pagesize; /* Page size used for the heap mapping.  */
   /* Make sure the following data is properly aligned, particularly
      that sizeof (heap_info) + 2 * SIZE_SZ is a multiple of
      MALLOC_ALIGNMENT. */
-  char pad[-6 * SIZE_SZ & MALLOC_ALIGN_MASK];
+  char pad[-7 * SIZE_SZ & MALLOC_ALIGN_MASK];
 } heap_info;
 
 /* Get a compile-time error if the heap_info padding is not correct
@@ -73,6 +74,10 @@ extern int sanity_check_heap_info_alignment[(sizeof (heap_info)
 
 static __thread mstate thread_arena attribute_tls_model_ie;
 
+/* The NUMA node the thread was last seen running on plus one, or 0 if
+   it has not been determined yet (see thread_node).  */
+static __thread int thread_node_cache attribute_tls_model_ie;
+
 /* Arena free list.  free_list_lock synchronizes access to the
    free_list variable below, and the next_free and attached_threads
    members of struct malloc_state objects.  No other locks must be
@@ -96,6 +101,44 @@ static mstate free_list;
    acquired.  */
 __libc_lock_define_initialized (static, list_lock);
 
+/* stats_lock protects the list of per-thread statistics counters in
+   stats.c.  No other lock must be acquired while it is held.  */
+__libc_lock_define_initialized (static, stats_lock);
+
+/* mmap_cache_lock protects the cache of unmapped chunks in
+   mmap-cache.c.  It may be acquired while an arena lock is held, and
+   no other lock must be acquired while it is held.  */
+__libc_lock_define_initialized (static, mmap_cache_lock);
+
+/* Per-CPU arenas.  If the glibc.malloc.percpu tunable is set, threads
+   are not attached to an arena; arena_get instead selects the arena
+   owned by the CPU the thread is currently running on, so the number
+   of arenas follows the number of CPUs rather than the number of
+   threads.  The table is allocated once in ptmalloc_init and its
+   entries are filled lazily under percpu_lock.  Each entry holds a
+   permanent reference (attached_threads) on its arena, so per-CPU
+   arenas never end up on free_list.  The lock order is percpu_lock,
+   then list_lock.  */
+static mstate *percpu_arenas;
+static size_t percpu_narenas;
+__libc_lock_define_initialized (static, percpu_lock);
+
+/* NUMA-aware arenas.  If the glibc.malloc.numa tunable is set, every
+   arena other than main_arena is created for the NUMA node of the
+   thread creating it, and its heaps are placed on that node with
+   mbind.  arena_get switches a thread to an arena on its current node
+   whenever the thread's arena belongs to a different one, and
+   get_free_list and reused_arena only consider arenas on that node.
+   The node of a thread is cached, and only read again when its arena
+   is contended or a new arena has to be selected, because threads
+   rarely move between nodes.  The arena limit is divided evenly among
+   the nodes; a node which has not used up its share when the limit is
+   reached shares the arenas of the other nodes.  main_arena is not
+   bound to a node.  Single-threaded processes, including the main
+   thread before the first thread is created, keep allocating from it
+   directly, but otherwise it is only used as a fallback when no other
+   arena can be created.  */
+
 /* Already initialized? */
 int __malloc_initialized = -1;
 
@@ -111,17 +154,40 @@ int __malloc_initialized = -1;
    in the new arena. */
 
 #define arena_get(ptr, size) do { \
-      ptr = thread_arena;						      \
-      arena_lock (ptr, size);						      \
+      if (__glibc_unlikely (mp_.percpu))				      \
+        ptr = arena_get_percpu (size);					      \
+      else if (__glibc_unlikely (mp_.numa))				      \
+        ptr = arena_get_numa (size);					      \
+      else								      \
+        {								      \
+          ptr = thread_arena;						      \
+          arena_lock (ptr, size);					      \
+        }								      \
+      if (ptr != NULL)							      \
+        remote_frees_drain (ptr);					      \
   } while (0)
 
 #define arena_lock(ptr, size) do {					      \
       if (ptr)								      \
-        __libc_lock_lock (ptr->mutex);					      \
+        lock_arena (ptr);						      \
       else								      \
         ptr = arena_get2 ((size), NULL);				      \
   } while (0)
 
+/* Lock the mutex of arena AV.  If statistics are enabled, count the
+   acquisitions which have to wait for another thread.  */
+static inline void
+lock_arena (mstate av)
+{
+  if (__glibc_unlikely (mp_.stats))
+    {
+      if (__libc_lock_trylock (av->mutex) == 0)
+	return;
+      atomic_fetch_add_relaxed (&av->stats_contended, 1);
+    }
+  __libc_lock_lock (av->mutex);
+}
+
 /* find the heap and corresponding arena for a given ptr */
 
 #define heap_for_ptr(ptr) \
@@ -130,6 +196,37 @@ int __malloc_initialized = -1;
   (chunk_main_arena (ptr) ? &main_arena : heap_for_ptr (ptr)->ar_ptr)
 
 
+/* Return true if a chunk of AV which the calling thread frees goes on
+   the remote-free list of AV: the thread does not allocate from AV
+   (its own arena, or with per-CPU arenas the one of its CPU), and
+   other threads do, so that the list is drained.  */
+static inline bool
+arena_is_remote (mstate av)
+{
+  if (av == thread_arena || atomic_load_relaxed (&av->attached_threads) == 0)
+    return false;
+  if (__glibc_unlikely (mp_.percpu))
+    {
+      int cpu = malloc_getcpu ();
+      if (cpu >= 0
+	  && (atomic_load_relaxed (&percpu_arenas[(unsigned int) cpu
+						  % percpu_narenas])
+	      == av))
+	return false;
+    }
+  return true;
+}
+
+/* Return true if AR_PTR is referenced from the per-CPU arena table.  */
+static bool
+arena_is_percpu (mstate ar_ptr)
+{
+  for (size_t i = 0; i < percpu_narenas; ++i)
+    if (percpu_arenas[i] == ar_ptr)
+      return true;
+  return false;
+}
+
 /**************************************************************************/
 
 /* atfork support.  */
@@ -149,6 +246,7 @@ __malloc_fork_lock_parent (void)
   /* We do not acquire free_list_lock here because we completely
      reconstruct free_list in __malloc_fork_unlock_child.  */
 
+  __libc_lock_lock (profile_lock);
   __libc_lock_lock (list_lock);
 
   for (mstate ar_ptr = &main_arena;; )
@@ -158,6 +256,9 @@ __malloc_fork_lock_parent (void)
       if (ar_ptr == &main_arena)
         break;
     }
+
+  __libc_lock_lock (mmap_cache_lock);
+  __libc_lock_lock (stats_lock);
 }
 
 void
@@ -166,6 +267,8 @@ __malloc_fork_unlock_parent (void)
   if (__malloc_initialized < 1)
     return;
 
+  __libc_lock_unlock (stats_lock);
+  __libc_lock_unlock (mmap_cache_lock);
   for (mstate ar_ptr = &main_arena;; )
     {
       __libc_lock_unlock (ar_ptr->mutex);
@@ -174,6 +277,7 @@ __malloc_fork_unlock_parent (void)
         break;
     }
   __libc_lock_unlock (list_lock);
+  __libc_lock_unlock (profile_lock);
 }
 
 void
@@ -191,7 +295,10 @@ __malloc_fork_unlock_child (void)
   for (mstate ar_ptr = &main_arena;; )
     {
       __libc_lock_init (ar_ptr->mutex);
-      if (ar_ptr != thread_arena)
+      if (arena_is_percpu (ar_ptr))
+	/* Only the reference from the per-CPU table survives.  */
+	ar_ptr->attached_threads = 1 + (ar_ptr == thread_arena);
+      else if (ar_ptr != thread_arena)
         {
 	  /* This arena is no longer attached to any thread.  */
 	  ar_ptr->attached_threads = 0;
@@ -203,7 +310,18 @@ __malloc_fork_unlock_child (void)
         break;
     }
 
+  __libc_lock_init (percpu_lock);
   __libc_lock_init (list_lock);
+  __libc_lock_init (profile_lock);
+  __libc_lock_init (stats_lock);
+  __libc_lock_init (mmap_cache_lock);
+  __libc_lock_init (trace_lock);
+}
+
+void
+__malloc_fork_child (void)
+{
+  trace_fork_child ();
 }
 
 #if HAVE_TUNABLES
@@ -216,6 +334,12 @@ TUNABLE_CALLBACK (set_mallopt_check) (tunable_val_t *valp)
     __malloc_check_init ();
 }
 
+void
+TUNABLE_CALLBACK (set_trace_file) (tunable_val_t *valp)
+{
+  trace_init (valp->strval);
+}
+
 # define TUNABLE_CALLBACK_FNDECL(__name, __type) \
 static inline int do_ ## __name (__type value);				      \
 void									      \
@@ -232,10 +356,22 @@ TUNABLE_CALLBACK_FNDECL (set_perturb_byte, int32_t)
 TUNABLE_CALLBACK_FNDECL (set_trim_threshold, size_t)
 TUNABLE_CALLBACK_FNDECL (set_arena_max, size_t)
 TUNABLE_CALLBACK_FNDECL (set_arena_test, size_t)
+TUNABLE_CALLBACK_FNDECL (set_percpu, int32_t)
+TUNABLE_CALLBACK_FNDECL (set_remote_free, int32_t)
+TUNABLE_CALLBACK_FNDECL (set_numa, int32_t)
+TUNABLE_CALLBACK_FNDECL (set_profile_interval, size_t)
+TUNABLE_CALLBACK_FNDECL (set_profile_signal, int32_t)
+TUNABLE_CALLBACK_FNDECL (set_stats, int32_t)
+TUNABLE_CALLBACK_FNDECL (set_hugetlb, int32_t)
+TUNABLE_CALLBACK_FNDECL (set_madv_free, int32_t)
+TUNABLE_CALLBACK_FNDECL (set_decay_ms, size_t)
+TUNABLE_CALLBACK_FNDECL (set_mmap_cache_max, size_t)
 #if USE_TCACHE
 TUNABLE_CALLBACK_FNDECL (set_tcache_max, size_t)
 TUNABLE_CALLBACK_FNDECL (set_tcache_count, size_t)
 TUNABLE_CALLBACK_FNDECL (set_tcache_unsorted_limit, size_t)
+TUNABLE_CALLBACK_FNDECL (set_tcache_batch, size_t)
+TUNABLE_CALLBACK_FNDECL (set_tcache_aligned_free, int32_t)
 #endif
 #else
 /* Initialization routine. */
@@ -285,6 +421,27 @@ extern struct dl_open_hook *_dl_open_hook;
 libc_hidden_proto (_dl_open_hook);
 #endif
 
+/* Allocate the per-CPU arena table.  If this fails, or the number of
+   CPUs is unknown, per-CPU mode is turned off again and threads are
+   attached to arenas as usual.  */
+static void
+percpu_init (void)
+{
+  int n = __get_nprocs ();
+  if (n >= 1)
+    {
+      size_t size = ALIGN_UP (n * sizeof (mstate), GLRO (dl_pagesize));
+      void *table = MMAP (0, size, PROT_READ | PROT_WRITE, 0);
+      if (table != MAP_FAILED)
+	{
+	  percpu_arenas = table;
+	  percpu_narenas = n;
+	  return;
+	}
+    }
+  mp_.percpu = 0;
+}
+
 static void
 ptmalloc_init (void)
 {
@@ -318,11 +475,27 @@ ptmalloc_init (void)
   TUNABLE_GET (mmap_max, int32_t, TUNABLE_CALLBACK (set_mmaps_max));
   TUNABLE_GET (arena_max, size_t, TUNABLE_CALLBACK (set_arena_max));
   TUNABLE_GET (arena_test, size_t, TUNABLE_CALLBACK (set_arena_test));
+  TUNABLE_GET (percpu, int32_t, TUNABLE_CALLBACK (set_percpu));
+  TUNABLE_GET (remote_free, int32_t, TUNABLE_CALLBACK (set_remote_free));
+  TUNABLE_GET (numa, int32_t, TUNABLE_CALLBACK (set_numa));
+  TUNABLE_GET (profile_interval, size_t,
+	       TUNABLE_CALLBACK (set_profile_interval));
+  TUNABLE_GET (profile_signal, int32_t, TUNABLE_CALLBACK (set_profile_signal));
+  TUNABLE_GET (stats, int32_t, TUNABLE_CALLBACK (set_stats));
+  TUNABLE_GET (hugetlb, int32_t, TUNABLE_CALLBACK (set_hugetlb));
+  TUNABLE_GET (madv_free, int32_t, TUNABLE_CALLBACK (set_madv_free));
+  TUNABLE_GET (decay_ms, size_t, TUNABLE_CALLBACK (set_decay_ms));
+  TUNABLE_GET (mmap_cache_max, size_t,
+	       TUNABLE_CALLBACK (set_mmap_cache_max));
+  TUNABLE_GET (trace_file, const char *, TUNABLE_CALLBACK (set_trace_file));
 # if USE_TCACHE
   TUNABLE_GET (tcache_max, size_t, TUNABLE_CALLBACK (set_tcache_max));
   TUNABLE_GET (tcache_count, size_t, TUNABLE_CALLBACK (set_tcache_count));
   TUNABLE_GET (tcache_unsorted_limit, size_t,
 	       TUNABLE_CALLBACK (set_tcache_unsorted_limit));
+  TUNABLE_GET (tcache_batch, size_t, TUNABLE_CALLBACK (set_tcache_batch));
+  TUNABLE_GET (tcache_aligned_free, int32_t,
+	       TUNABLE_CALLBACK (set_tcache_aligned_free));
 # endif
 #else
   const char *s = NULL;
@@ -391,6 +564,11 @@ ptmalloc_init (void)
     __malloc_check_init ();
 #endif
 
+  if (mp_.percpu)
+    percpu_init ();
+  if (mp_.profile_interval != 0)
+    profile_init ();
+
 #if HAVE_MALLOC_INIT_HOOK
   void (*hook) (void) = atomic_forced_read (__malloc_initialize_hook);
   if (hook != NULL)
@@ -445,13 +623,72 @@ dump_heap (heap_info *heap)
    multiple threads, but only one will succeed.  */
 static char *aligned_heap_area;
 
-/* Create a new heap.  size is automatically rounded up to a multiple
-   of the page size. */
+/* Mark the range of SIZE bytes at P as eligible for transparent huge
+   pages if glibc.malloc.hugetlb=1 and the range can hold at least one
+   of them.  */
 
-static heap_info *
-new_heap (size_t size, size_t top_pad)
+static void
+madvise_thp (void *p, size_t size)
 {
+#ifdef MADV_HUGEPAGE
   size_t pagesize = GLRO (dl_pagesize);
+
+  if (mp_.thp_pagesize == 0 || size < mp_.thp_pagesize)
+    return;
+
+  /* The kernel requires a page-aligned start address.  */
+  size += (uintptr_t) p & (pagesize - 1);
+  p = PTR_ALIGN_DOWN (p, pagesize);
+  __madvise (p, size, MADV_HUGEPAGE);
+#endif
+}
+
+/* Give the pages in the SIZE bytes at P back to the kernel.  With
+   glibc.malloc.madv_free they are released lazily with MADV_FREE, which
+   leaves them in place until there is memory pressure and avoids page
+   faults if they are reused before that.  */
+
+static void
+malloc_release_pages (void *p, size_t size)
+{
+#ifdef MADV_FREE
+  /* Fall back to MADV_DONTNEED on kernels older than 4.5 and for huge
+     page mappings, which do not support MADV_FREE.  */
+  if (mp_.madv_free && __madvise (p, size, MADV_FREE) == 0)
+    return;
+#endif
+  __madvise (p, size, MADV_DONTNEED);
+}
+
+/* Make the SIZE bytes at P, in a heap using pages of PAGESIZE bytes,
+   readable and writable.  Heaps of explicit huge pages are mapped with
+   MAP_NORESERVE, so touching a page which the huge page pool cannot
+   supply would raise SIGBUS.  Their pages are allocated here instead,
+   and the heap cannot grow if that fails.  */
+
+static int
+heap_protect (char *p, size_t size, size_t pagesize)
+{
+  if (__mprotect (p, size, PROT_READ | PROT_WRITE) != 0)
+    return -1;
+  if (pagesize != GLRO (dl_pagesize) && !malloc_populate (p, size))
+    {
+      __madvise (p, size, MADV_DONTNEED);
+      __mprotect (p, size, PROT_NONE);
+      return -1;
+    }
+  return 0;
+}
+
+/* Create a new heap using pages of PAGESIZE bytes, passing MMAP_FLAGS
+   to mmap to reserve the address space.  If NODE is not negative, the
+   heap is placed on that NUMA node.  size is automatically rounded
+   up to a multiple of the page size. */
+
+static heap_info *
+new_heap_internal (size_t size, size_t top_pad, size_t pagesize,
+		   int mmap_flags, int node)
+{
   char *p1, *p2;
   unsigned long ul;
   heap_info *h;
@@ -469,12 +706,16 @@ new_heap (size_t size, size_t top_pad)
   /* A memory region aligned to a multiple of HEAP_MAX_SIZE is needed.
      No swap space needs to be reserved for the following large
      mapping (on Linux, this is the case for all non-writable mappings
-     anyway). */
+     anyway), so MMAP_FLAGS contains MAP_NORESERVE.  This also applies
+     to explicit huge pages: reserving them would take twice
+     HEAP_MAX_SIZE from the huge page pool for every heap, most of
+     which is never used.  Their pages are allocated by heap_protect
+     instead. */
   p2 = MAP_FAILED;
   if (aligned_heap_area)
     {
       p2 = (char *) MMAP (aligned_heap_area, HEAP_MAX_SIZE, PROT_NONE,
-                          MAP_NORESERVE);
+                          mmap_flags);
       aligned_heap_area = NULL;
       if (p2 != MAP_FAILED && ((unsigned long) p2 & (HEAP_MAX_SIZE - 1)))
         {
@@ -484,7 +725,8 @@ new_heap (size_t size, size_t top_pad)
     }
   if (p2 == MAP_FAILED)
     {
-      p1 = (char *) MMAP (0, HEAP_MAX_SIZE << 1, PROT_NONE, MAP_NORESERVE);
+      p1 = (char *) MMAP (0, HEAP_MAX_SIZE << 1, PROT_NONE,
+			  mmap_flags);
       if (p1 != MAP_FAILED)
         {
           p2 = (char *) (((unsigned long) p1 + (HEAP_MAX_SIZE - 1))
@@ -500,7 +742,8 @@ new_heap (size_t size, size_t top_pad)
         {
           /* Try to take the chance that an allocation of only HEAP_MAX_SIZE
              is already aligned. */
-          p2 = (char *) MMAP (0, HEAP_MAX_SIZE, PROT_NONE, MAP_NORESERVE);
+          p2 = (char *) MMAP (0, HEAP_MAX_SIZE, PROT_NONE,
+			      mmap_flags);
           if (p2 == MAP_FAILED)
             return 0;
 
@@ -511,7 +754,12 @@ new_heap (size_t size, size_t top_pad)
             }
         }
     }
-  if (__mprotect (p2, size, PROT_READ | PROT_WRITE) != 0)
+  /* Advise the whole reservation, so that the parts made accessible by
+     grow_heap later on inherit the setting.  */
+  madvise_thp (p2, HEAP_MAX_SIZE);
+  if (node >= 0)
+    malloc_bind_node (p2, HEAP_MAX_SIZE, node);
+  if (heap_protect (p2, size, pagesize) != 0)
     {
       __munmap (p2, HEAP_MAX_SIZE);
       return 0;
@@ -519,32 +767,65 @@ new_heap (size_t size, size_t top_pad)
   h = (heap_info *) p2;
   h->size = size;
   h->mprotect_size = size;
+  h->pagesize = pagesize;
   LIBC_PROBE (memory_heap_new, 2, h, h->size);
   return h;
 }
 
+/* Create a new heap, backed by explicit huge pages if
+   glibc.malloc.hugetlb=2 and they are available.  */
+
+static heap_info *
+new_heap (size_t size, size_t top_pad, int node)
+{
+  if (__glibc_unlikely (mp_.hp_pagesize != 0)
+      && mp_.hp_pagesize < HEAP_MAX_SIZE)
+    {
+      heap_info *h = new_heap_internal (size, top_pad, mp_.hp_pagesize,
+					mp_.hp_flags | MAP_NORESERVE, node);
+      if (h != NULL)
+	return h;
+    }
+  return new_heap_internal (size, top_pad, GLRO (dl_pagesize),
+			    MAP_NORESERVE, node);
+}
+
 /* Grow a heap.  size is automatically rounded up to a
    multiple of the page size. */
 
 static int
 grow_heap (heap_info *h, long diff)
 {
-  size_t pagesize = GLRO (dl_pagesize);
   long new_size;
 
-  diff = ALIGN_UP (diff, pagesize);
+  diff = ALIGN_UP (diff, h->pagesize);
   new_size = (long) h->size + diff;
   if ((unsigned long) new_size > (unsigned long) HEAP_MAX_SIZE)
     return -1;
 
   if ((unsigned long) new_size > h->mprotect_size)
     {
-      if (__mprotect ((char *) h + h->mprotect_size,
-                      (unsigned long) new_size - h->mprotect_size,
-                      PROT_READ | PROT_WRITE) != 0)
+      unsigned long mprotect_size = new_size;
+
+      /* Unless writable mappings are charged against a commit limit
+         (see check_may_shrink_heap), make at least twice as much of
+         the heap accessible as before, so that a heap growing in small
+         steps does not need an mprotect call for each of them.  Also
+         keep the boundary aligned to transparent huge pages, which
+         cannot straddle mappings with different protections.  */
+      if (!check_may_shrink_heap ())
+        {
+          mprotect_size = MAX (mprotect_size, 2 * h->mprotect_size);
+          if (mp_.thp_pagesize != 0)
+            mprotect_size = ALIGN_UP (mprotect_size, mp_.thp_pagesize);
+          mprotect_size = MIN (mprotect_size, HEAP_MAX_SIZE);
+        }
+
+      if (heap_protect ((char *) h + h->mprotect_size,
+                        mprotect_size - h->mprotect_size, h->pagesize) != 0)
         return -2;
 
-      h->mprotect_size = new_size;
+      h->mprotect_size = mprotect_size;
     }
 
   h->size = new_size;
@@ -564,17 +845,26 @@ shrink_heap (heap_info *h, long diff)
     return -1;
 
   /* Try to re-map the extra heap space freshly to save memory, and make it
-     inaccessible.  See malloc-sysdep.h to know when this is true.  */
-  if (__glibc_unlikely (check_may_shrink_heap ()))
+     inaccessible.  See malloc-sysdep.h to know when this is true.  This
+     is also done for explicit huge pages, so that heap_protect
+     allocates them again before they are used.  A heap of explicit
+     huge pages has to stay one, so that it can grow again.  */
+  bool hugetlb = h->pagesize != GLRO (dl_pagesize);
+  if (__glibc_unlikely (check_may_shrink_heap () || hugetlb))
     {
+      int flags = MAP_FIXED;
+      if (hugetlb)
+        flags |= mp_.hp_flags | MAP_NORESERVE;
       if ((char *) MMAP ((char *) h + new_size, diff, PROT_NONE,
-                         MAP_FIXED) == (char *) MAP_FAILED)
+                         flags) == (char *) MAP_FAILED)
         return -2;
 
       h->mprotect_size = new_size;
+      if (h->ar_ptr->numa_node >= 0)
+	malloc_bind_node ((char *) h + new_size, diff, h->ar_ptr->numa_node);
     }
   else
-    __madvise ((char *) h + new_size, diff, MADV_DONTNEED);
+    malloc_release_pages ((char *) h + new_size, diff);
   /*fprintf(stderr, "shrink %p %08lx\n", h, new_size);*/
 
   h->size = new_size;
@@ -591,8 +881,11 @@ shrink_heap (heap_info *h, long diff)
       __munmap ((char *) (heap), HEAP_MAX_SIZE);			      \
     } while (0)
 
+/* Release unused memory at the top of HEAP, keeping PAD bytes, if the
+   top chunk is at least THRESHOLD bytes large.  */
+
 static int
-heap_trim (heap_info *heap, size_t pad)
+heap_trim (heap_info *heap, size_t pad, unsigned long threshold)
 {
   mstate ar_ptr = heap->ar_ptr;
   unsigned long pagesz = GLRO (dl_pagesize);
@@ -638,8 +931,7 @@ heap_trim (heap_info *heap, size_t pad)
      and _int_free by preserving the top pad and rounding down to the nearest
      page.  */
   top_size = chunksize (top_chunk);
-  if ((unsigned long)(top_size) <
-      (unsigned long)(mp_.trim_threshold))
+  if ((unsigned long)(top_size) < threshold)
     return 0;
 
   top_area = top_size - MINSIZE - 1;
@@ -647,7 +939,7 @@ heap_trim (heap_info *heap, size_t pad)
     return 0;
 
   /* Release in pagesize units and round down to the nearest page.  */
-  extra = ALIGN_DOWN(top_area - pad, pagesz);
+  extra = ALIGN_DOWN(top_area - pad, heap->pagesize);
   if (extra == 0)
     return 0;
 
@@ -681,8 +973,11 @@ detach_arena (mstate replaced_arena)
     }
 }
 
+/* Allocate a new arena with initial size SIZE for NUMA node NODE (or
+   -1) and add it to the global list.  The arena is returned unlocked,
+   with one attached reference that the caller takes over.  */
 static mstate
-_int_new_arena (size_t size)
+alloc_new_arena (size_t size, int node)
 {
   mstate a;
   heap_info *h;
@@ -690,19 +985,21 @@ _int_new_arena (size_t size)
   unsigned long misalign;
 
   h = new_heap (size + (sizeof (*h) + sizeof (*a) + MALLOC_ALIGNMENT),
-                mp_.top_pad);
+                mp_.top_pad, node);
   if (!h)
     {
       /* Maybe size is too large to fit in a single heap.  So, just try
          to create a minimally-sized arena and let _int_malloc() attempt
          to deal with the large request via mmap_chunk().  */
-      h = new_heap (sizeof (*h) + sizeof (*a) + MALLOC_ALIGNMENT, mp_.top_pad);
+      h = new_heap (sizeof (*h) + sizeof (*a) + MALLOC_ALIGNMENT, mp_.top_pad,
+		    node);
       if (!h)
         return 0;
     }
   a = h->ar_ptr = (mstate) (h + 1);
   malloc_init_state (a);
   a->attached_threads = 1;
+  a->numa_node = node;
   /*a->next = NULL;*/
   a->system_mem = a->max_system_mem = h->size;
 
@@ -715,8 +1012,6 @@ _int_new_arena (size_t size)
   set_head (top (a), (((char *) h + h->size) - ptr) | PREV_INUSE);
 
   LIBC_PROBE (memory_arena_new, 2, a, size);
-  mstate replaced_arena = thread_arena;
-  thread_arena = a;
   __libc_lock_init (a->mutex);
 
   __libc_lock_lock (list_lock);
@@ -731,6 +1026,19 @@ _int_new_arena (size_t size)
 
   __libc_lock_unlock (list_lock);
 
+  return a;
+}
+
+static mstate
+_int_new_arena (size_t size, int node)
+{
+  mstate a = alloc_new_arena (size, node);
+  if (a == NULL)
+    return 0;
+
+  mstate replaced_arena = thread_arena;
+  thread_arena = a;
+
   __libc_lock_lock (free_list_lock);
   detach_arena (replaced_arena);
   __libc_lock_unlock (free_list_lock);
@@ -751,19 +1059,26 @@ _int_new_arena (size_t size)
 }
 
 
-/* Remove an arena from free_list.  */
+/* Remove an arena from free_list.  If NODE is not negative, only an
+   arena on that NUMA node is taken.  */
 static mstate
-get_free_list (void)
+get_free_list (int node)
 {
   mstate replaced_arena = thread_arena;
   mstate result = free_list;
   if (result != NULL)
     {
       __libc_lock_lock (free_list_lock);
-      result = free_list;
+      mstate *previous = &free_list;
+      for (result = free_list; result != NULL; result = result->next_free)
+	{
+	  if (node < 0 || result->numa_node == node)
+	    break;
+	  previous = &result->next_free;
+	}
       if (result != NULL)
 	{
-	  free_list = result->next_free;
+	  *previous = result->next_free;
 
 	  /* The arena will be attached to this thread.  */
 	  assert (result->attached_threads == 0);
@@ -776,7 +1091,7 @@ get_free_list (void)
       if (result != NULL)
         {
           LIBC_PROBE (memory_arena_reuse_free_list, 1, result);
-          __libc_lock_lock (result->mutex);
+          lock_arena (result);
 	  thread_arena = result;
         }
     }
@@ -806,9 +1121,12 @@ remove_from_free_list (mstate arena)
 
 /* Lock and return an arena that can be reused for memory allocation.
    Avoid AVOID_ARENA as we have already failed to allocate memory in
-   it and it is currently locked.  */
+   it and it is currently locked.  If NODE is not negative, only
+   arenas on that NUMA node are considered, and NULL is returned if
+   there are fewer than NODE_LIMIT of them and none is available
+   without contention, so that the caller creates a new one.  */
 static mstate
-reused_arena (mstate avoid_arena)
+reused_arena (mstate avoid_arena, int node, size_t node_limit)
 {
   mstate result;
   /* FIXME: Access to next_to_use suffers from data races.  */
@@ -818,25 +1136,44 @@ reused_arena (mstate avoid_arena)
 
   /* Iterate over all arenas (including those linked from
      free_list).  */
+  size_t on_node = 0;
   result = next_to_use;
   do
     {
-      if (!__libc_lock_trylock (result->mutex))
-        goto out;
+      if (node < 0 || result->numa_node == node)
+	{
+	  if (!__libc_lock_trylock (result->mutex))
+	    goto out;
+	  ++on_node;
+	}
 
       /* FIXME: This is a data race, see _int_new_arena.  */
       result = result->next;
     }
   while (result != next_to_use);
 
+  if (node >= 0)
+    {
+      if (on_node < node_limit)
+	return NULL;
+
+      /* Wait for the next arena in line on NODE, other than
+	 AVOID_ARENA.  */
+      while (result->numa_node != node || result == avoid_arena)
+	{
+	  result = result->next;
+	  if (result == next_to_use)
+	    return NULL;
+	}
+    }
   /* Avoid AVOID_ARENA as we have already failed to allocate memory
      in that arena and it is currently locked.   */
-  if (result == avoid_arena)
+  else if (result == avoid_arena)
     result = result->next;
 
   /* No arena available without contention.  Wait for the next in line.  */
   LIBC_PROBE (memory_arena_reuse_wait, 3, &result->mutex, result, avoid_arena);
-  __libc_lock_lock (result->mutex);
+  lock_arena (result);
 
 out:
   /* Attach the arena to the current thread.  */
@@ -868,14 +1205,31 @@ out:
   return result;
 }
 
+/* Return the NUMA node the calling thread runs on, or -1.  Unless
+   REFRESH, the node determined last time is returned.  */
+static inline int
+thread_node (bool refresh)
+{
+  int node = thread_node_cache;
+  if (refresh || node == 0)
+    {
+      node = malloc_getnode () + 1;
+      thread_node_cache = node;
+    }
+  return node - 1;
+}
+
 static mstate
 arena_get2 (size_t size, mstate avoid_arena)
 {
   mstate a;
 
   static size_t narenas_limit;
+  static size_t numa_node_limit;
+  int node = mp_.numa ? thread_node (true) : -1;
+  int reuse_node = node;
 
-  a = get_free_list ();
+  a = get_free_list (node);
   if (a == NULL)
     {
       /* Nothing immediately available, so generate a new arena.  */
@@ -894,6 +1248,8 @@ arena_get2 (size_t size, mstate avoid_arena)
                    cores.  */
                 narenas_limit = NARENAS_FROM_NCORES (2);
             }
+          if (narenas_limit != 0 && mp_.numa)
+            numa_node_limit = MAX (narenas_limit / malloc_numa_nodes (), 1);
         }
     repeat:;
       size_t n = narenas;
@@ -908,16 +1264,116 @@ arena_get2 (size_t size, mstate avoid_arena)
         {
           if (catomic_compare_and_exchange_bool_acq (&narenas, n + 1, n))
             goto repeat;
-          a = _int_new_arena (size);
+          a = _int_new_arena (size, node);
 	  if (__glibc_unlikely (a == NULL))
             catomic_decrement (&narenas);
         }
       else
-        a = reused_arena (avoid_arena);
+        {
+          a = reused_arena (avoid_arena, reuse_node, numa_node_limit);
+          if (a == NULL)
+            {
+              /* This NUMA node has not used up its share of the arena
+                 limit, but the other nodes have used up the rest of
+                 it.  Create an arena if that has become possible in
+                 the meantime, and otherwise share one on any node.  */
+              reuse_node = -1;
+              goto repeat;
+            }
+        }
     }
   return a;
 }
 
+/* Create the arena for per-CPU slot SLOT unless another thread has
+   already done so.  Returns NULL if no memory could be obtained.  */
+static mstate
+percpu_arena_new (size_t slot, size_t size)
+{
+  __libc_lock_lock (percpu_lock);
+  mstate a = percpu_arenas[slot];
+  if (a == NULL)
+    {
+      a = alloc_new_arena (size, mp_.numa ? thread_node (true) : -1);
+      if (a != NULL)
+	{
+	  catomic_increment (&narenas);
+	  atomic_store_release (&percpu_arenas[slot], a);
+	}
+    }
+  __libc_lock_unlock (percpu_lock);
+  return a;
+}
+
+/* Lock and return the arena of the CPU the calling thread runs on.
+   Being migrated to another CPU after the CPU number has been read is
+   harmless: the operation simply completes in the arena of the
+   previous CPU, under that arena's lock.  If that arena is busy and
+   the thread has moved in the meantime, the arena of the new CPU is
+   tried instead of waiting.  If the CPU cannot be determined, or the
+   arena cannot be created, fall back to the thread's own arena.  */
+static mstate
+arena_get_percpu (size_t size)
+{
+  mstate a;
+  int cpu = malloc_getcpu ();
+
+  for (int tries = 0; cpu >= 0; ++tries)
+    {
+      size_t slot = (unsigned int) cpu % percpu_narenas;
+      a = atomic_load_acquire (&percpu_arenas[slot]);
+      if (a == NULL)
+	{
+	  a = percpu_arena_new (slot, size);
+	  if (a == NULL)
+	    break;
+	}
+
+      if (__libc_lock_trylock (a->mutex) == 0)
+	return a;
+
+      int newcpu = malloc_getcpu ();
+      if (tries > 0 || newcpu == cpu || newcpu < 0)
+	{
+	  lock_arena (a);
+	  return a;
+	}
+      cpu = newcpu;
+    }
+
+  a = thread_arena;
+  arena_lock (a, size);
+  return a;
+}
+
+/* Lock and return the thread's arena if it is on the NUMA node the
+   thread is running on, and otherwise move the thread to an arena on
+   that node.  */
+static mstate
+arena_get_numa (size_t size)
+{
+  mstate a = thread_arena;
+  int node = thread_node (false);
+
+  if (a != NULL && (node < 0 || a->numa_node == node))
+    {
+      if (__libc_lock_trylock (a->mutex) == 0)
+	return a;
+
+      /* Waiting for the arena is a good time to check whether the
+	 thread has moved to another node.  */
+      node = thread_node (true);
+      if (node < 0 || a->numa_node == node)
+	{
+	  if (__glibc_unlikely (mp_.stats))
+	    atomic_fetch_add_relaxed (&a->stats_contended, 1);
+	  __libc_lock_lock (a->mutex);
+	  return a;
+	}
+    }
+  return arena_get2 (size, NULL);
+}
+
 /* If we don't have the main arena, then maybe the failure is due to running
    out of mmapped areas, so we can try allocating on the main arena.
    Otherwise, it is likely that sbrk() has failed and there is still a chance
@@ -930,7 +1386,7 @@ arena_get_retry (mstate ar_ptr, size_t bytes)
     {
       __libc_lock_unlock (ar_ptr->mutex);
       ar_ptr = &main_arena;
-      __libc_lock_lock (ar_ptr->mutex);
+      lock_arena (ar_ptr);
     }
   else
     {
@@ -944,10 +1400,14 @@ arena_get_retry (mstate ar_ptr, size_t bytes)
 void
 __malloc_arena_thread_freeres (void)
 {
+  /* Stop tracing before the internal data of the thread is freed.  */
+  trace_thread_release ();
+
   /* Shut down the thread cache first.  This could deallocate data for
      the thread arena, so do this before we put the arena on the free
      list.  */
   tcache_thread_shutdown ();
+  stats_thread_release ();
 
   mstate a = thread_arena;
   thread_arena = NULL;
@@ -958,12 +1418,23 @@ __malloc_arena_thread_freeres (void)
       /* If this was the last attached thread for this arena, put the
 	 arena on the free list.  */
       assert (a->attached_threads > 0);
-      if (--a->attached_threads == 0)
+      bool detached = --a->attached_threads == 0;
+      if (detached)
 	{
 	  a->next_free = free_list;
 	  free_list = a;
 	}
       __libc_lock_unlock (free_list_lock);
+
+      /* No thread allocates from the arena anymore, and frees no longer
+	 go on its remote-free list.  Release the chunks queued so
+	 far.  */
+      if (detached)
+	{
+	  __libc_lock_lock (a->mutex);
+	  remote_frees_drain (a);
+	  __libc_lock_unlock (a->mutex);
+	}
     }
 }
 
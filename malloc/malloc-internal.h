@@ -71,6 +71,10 @@ void __malloc_fork_unlock_parent (void) attribute_hidden;
 /* Called in the child process after a fork.  */
 void __malloc_fork_unlock_child (void) attribute_hidden;
 
+/* Called in the child process after every fork, including forks of
+   single-threaded processes.  Must be async-signal-safe.  */
+void __malloc_fork_child (void) attribute_hidden;
+
 /* Called as part of the thread shutdown sequence.  */
 void __malloc_arena_thread_freeres (void) attribute_hidden;
 
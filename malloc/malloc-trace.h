@@ -0,0 +1,82 @@
+/* Binary format of the allocation traces written by malloc.
+   Copyright (C) 2018 Free Software Foundation, Inc.
+   This file is part of the GNU C Library.
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; if not, see
+   <http://www.gnu.org/licenses/>.  */
+
+#ifndef _MALLOC_TRACE_H
+#define _MALLOC_TRACE_H
+
+#include <stdint.h>
+
+/* This header is shared between malloc, which writes the traces if
+   glibc.malloc.trace_file is set, and benchtests/bench-malloc-replay,
+   which reads them.  It is not installed.
+
+   A trace file starts with a struct malloc_trace_header, followed by
+   the records of all threads.  The records of a thread appear in the
+   order of their calls, but the records of different threads are
+   interleaved in blocks, so readers have to sort them by their seq
+   field to restore the global order.  All fields are in the byte
+   order of the traced process.  */
+
+#define MALLOC_TRACE_MAGIC "GLIBCMTR"
+#define MALLOC_TRACE_VERSION 1
+
+struct malloc_trace_header
+{
+  char magic[8];
+  uint32_t version;
+  /* sizeof (struct malloc_trace_record).  */
+  uint32_t record_size;
+};
+
+enum malloc_trace_op
+{
+  /* ptr = malloc (size).  */
+  malloc_trace_malloc,
+  /* ptr = calloc (arg, size / arg).  */
+  malloc_trace_calloc,
+  /* ptr = realloc (arg, size).  */
+  malloc_trace_realloc,
+  /* free (ptr).  size is 0.  */
+  malloc_trace_free,
+  /* ptr = memalign (arg, size).  All aligned allocation functions are
+     recorded as memalign.  */
+  malloc_trace_memalign,
+};
+
+struct malloc_trace_record
+{
+  /* Position of the call in the global order.  The sequence number of
+     free is taken before the block is released and that of the other
+     functions after the block has been obtained, so that a block is
+     always freed before a later call can return it.  */
+  uint64_t seq;
+  /* The block returned or freed, 0 if the allocation failed.  */
+  uint64_t ptr;
+  /* Old block for realloc, alignment for memalign and number of
+     elements for calloc.  */
+  uint64_t arg;
+  /* Requested size in bytes.  */
+  uint64_t size;
+  /* Number of the calling thread, starting at 1 in the order in which
+     threads first called malloc.  */
+  uint32_t thread;
+  /* An enum malloc_trace_op value.  */
+  uint32_t op;
+};
+
+#endif /* _MALLOC_TRACE_H */
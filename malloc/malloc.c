@@ -236,6 +236,9 @@
 /* For MIN, MAX, powerof2.  */
 #include <sys/param.h>
 
+/* For __clock_gettime.  */
+#include <time.h>
+
 /* For ALIGN_UP et. al.  */
 #include <libc-pointer-arith.h>
 
@@ -321,6 +324,17 @@ __malloc_assert (const char *assertion, const char *file, unsigned int line,
 /* This is another arbitrary limit, which tunables can change.  Each
    tcache bin will hold at most this number of chunks.  */
 # define TCACHE_FILL_COUNT 7
+
+/* Requests for cache line or page alignment have their own tcache
+   bins.  Their sizes are rounded up to a multiple of the alignment, and
+   bin K of an alignment class holds chunks at an aligned address which
+   are at least request2size ((K + 1) * alignment) bytes large, and at
+   most MINSIZE bytes larger than that, because _int_memalign only
+   splits off remainders larger than MINSIZE.  */
+# define TCACHE_LINE_ALIGN	64
+# define TCACHE_LINE_BINS	16
+# define TCACHE_PAGE_BINS	4
+# define TCACHE_ALIGNED_BINS	(TCACHE_LINE_BINS + TCACHE_PAGE_BINS)
 #endif
 
 
@@ -514,6 +528,18 @@ libc_hidden_proto (__libc_malloc)
 void     __libc_free(void*);
 libc_hidden_proto (__libc_free)
 
+/*
+  free_sized(void* p, size_t n);
+  free_aligned_sized(void* p, size_t alignment, size_t n);
+  Like free, for a block of n bytes allocated by malloc, calloc or
+  realloc, or by aligned_alloc with the given alignment.  If the chunk
+  has exactly the size malloc uses for n bytes, it is put into the
+  thread cache without the checks of free.  It is an error if n is
+  larger than the block.
+*/
+void     __libc_free_sized(void*, size_t);
+void     __libc_free_aligned_sized(void*, size_t, size_t);
+
 /*
   calloc(size_t n_elements, size_t element_size);
   Returns a pointer to n_elements * element_size bytes, with all locations
@@ -991,6 +1017,7 @@ typedef struct malloc_chunk* mchunkptr;
 
 static void*  _int_malloc(mstate, size_t);
 static void     _int_free(mstate, mchunkptr, int);
+static void     _int_free_chunk(mstate, mchunkptr, INTERNAL_SIZE_T, int);
 static void*  _int_realloc(mstate, mchunkptr, INTERNAL_SIZE_T,
 			   INTERNAL_SIZE_T);
 static void*  _int_memalign(mstate, size_t, size_t);
@@ -1654,6 +1681,16 @@ get_max_fast (void)
    use relaxed atomic accesses.
  */
 
+/* Allocation counters for malloc_get_stats, see stats.c.  */
+struct malloc_counters
+{
+  size_t allocs;
+  size_t frees;
+  size_t alloc_bytes;
+  size_t free_bytes;
+  size_t tcache_hits;
+  size_t tcache_misses;
+};
 
 struct malloc_state
 {
@@ -1694,6 +1731,31 @@ struct malloc_state
      free_list_lock in arena.c.  */
   INTERNAL_SIZE_T attached_threads;
 
+  /* Chunks freed by threads other than the ones attached to this
+     arena, linked through their fd fields.  Pushed to without holding
+     the mutex and drained by a thread which holds it.  */
+  mchunkptr remote_frees;
+
+  /* Frees since the clock was last checked, and the time in
+     milliseconds of the last decay pass (see malloc_decay).  */
+  unsigned int decay_ticks;
+  uint64_t decay_time;
+
+  /* With glibc.malloc.madv_free, systrim has released the pages from
+     RELEASED to RELEASED_END, the end of the top chunk at that time.
+     RELEASED is reset when the top chunk is split above it.  */
+  char *released;
+  char *released_end;
+
+  /* NUMA node the heaps of this arena are placed on, or -1.  */
+  int numa_node;
+
+  /* Allocations from this arena which are not counted by the threads
+     allocating from it, and the number of times the mutex was found
+     locked.  Updated atomically without holding the mutex.  */
+  struct malloc_counters stats;
+  size_t stats_contended;
+
   /* Memory allocated from the system in this arena.  */
   INTERNAL_SIZE_T system_mem;
   INTERNAL_SIZE_T max_system_mem;
@@ -1707,6 +1769,29 @@ struct malloc_par
   INTERNAL_SIZE_T mmap_threshold;
   INTERNAL_SIZE_T arena_test;
   INTERNAL_SIZE_T arena_max;
+  /* Nonzero if arenas are selected by CPU rather than by thread.  */
+  int percpu;
+  /* Nonzero if frees into an arena other than the thread's own are
+     queued on the arena's remote-free list.  */
+  int remote_free;
+  /* Nonzero if arenas are bound to the NUMA node of the threads using
+     them.  */
+  int numa;
+  /* Mean number of bytes allocated between two samples of the heap
+     profiler, or 0 if it is disabled.  */
+  size_t profile_interval;
+  /* Signal on which the heap profile is written, or 0.  */
+  int profile_signal;
+  /* Nonzero if allocations are counted for malloc_get_stats.  */
+  int stats;
+  /* Nonzero if unused pages are released with MADV_FREE.  */
+  int madv_free;
+  /* Interval in milliseconds at which unused memory at the top of each
+     arena is returned to the system, or 0 to only trim on demand.  */
+  size_t decay_ms;
+  /* Maximum number of bytes of freed mmapped chunks kept for reuse, or
+     0 if they are unmapped immediately.  */
+  size_t mmap_cache_max;
 
   /* Memory map support */
   int n_mmaps;
@@ -1724,6 +1809,14 @@ struct malloc_par
   /* First address handed out by MORECORE/sbrk.  */
   char *sbrk_base;
 
+  /* Transparent huge page size used to align and madvise heap memory
+     (glibc.malloc.hugetlb=1), or 0.  */
+  size_t thp_pagesize;
+  /* Explicit huge page size and the mmap flags to allocate it
+     (glibc.malloc.hugetlb=2), or 0.  */
+  size_t hp_pagesize;
+  int hp_flags;
+
 #if USE_TCACHE
   /* Maximum number of buckets to use.  */
   size_t tcache_bins;
@@ -1733,6 +1826,11 @@ struct malloc_par
   /* Maximum number of chunks to remove from the unsorted list, which
      aren't used to prefill the cache.  */
   size_t tcache_unsorted_limit;
+  /* Number of chunks moved between a tcache bin and the arena under a
+     single lock acquisition when the bin runs empty or overflows.  */
+  size_t tcache_batch;
+  /* Whether free puts suitably aligned chunks into the aligned bins.  */
+  int tcache_aligned_free;
 #endif
 };
 
@@ -1746,7 +1844,8 @@ static struct malloc_state main_arena =
 {
   .mutex = _LIBC_LOCK_INITIALIZER,
   .next = &main_arena,
-  .attached_threads = 1
+  .attached_threads = 1,
+  .numa_node = -1
 };
 
 /* These variables are used for undumping support.  Chunked are marked
@@ -1777,7 +1876,8 @@ static struct malloc_par mp_ =
   .tcache_count = TCACHE_FILL_COUNT,
   .tcache_bins = TCACHE_MAX_BINS,
   .tcache_max_bytes = tidx2usize (TCACHE_MAX_BINS-1),
-  .tcache_unsorted_limit = 0 /* No limit.  */
+  .tcache_unsorted_limit = 0, /* No limit.  */
+  .tcache_batch = 0 /* Move chunks one at a time.  */
 #endif
 };
 
@@ -1812,6 +1912,16 @@ malloc_init_state (mstate av)
   av->top = initial_top (av);
 }
 
+/* Called after memory was allocated from the start of the top chunk of
+   AV.  Pages which systrim released before can be in use now.  */
+static inline void
+top_split (mstate av)
+{
+  if (__glibc_unlikely (av->released != NULL)
+      && (char *) av->top + MINSIZE > av->released)
+    av->released = NULL;
+}
+
 /*
    Other internal utilities operating on mstates
  */
@@ -1819,6 +1929,8 @@ malloc_init_state (mstate av)
 static void *sysmalloc (INTERNAL_SIZE_T, mstate);
 static int      systrim (size_t, mstate);
 static void     malloc_consolidate (mstate);
+static void     remote_frees_push (mstate, mchunkptr);
+static void     remote_frees_drain (mstate);
 
 
 /* -------------- Early definitions for debugging hooks ---------------- */
@@ -1861,6 +1973,9 @@ void weak_variable (*__after_morecore_hook) (void) = NULL;
    thread cache (if it exists).  */
 static void tcache_thread_shutdown (void);
 
+/* Likewise, to release the statistics counters of the thread.  */
+static void stats_thread_release (void);
+
 /* ------------------ Testing support ----------------------------------*/
 
 static int perturb_byte;
@@ -1883,9 +1998,32 @@ free_perturb (char *p, size_t n)
 
 #include <stap-probe.h>
 
+/* Return the coarse monotonic time in milliseconds, or 0 if the clock
+   cannot be read.  Used for glibc.malloc.decay_ms.  */
+static uint64_t
+malloc_clock_ms (void)
+{
+  struct timespec ts;
+  if (__clock_gettime (CLOCK_MONOTONIC_COARSE, &ts) != 0)
+    return 0;
+  return (uint64_t) ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/* ------------------------ Heap profiling ---------------------------- */
+#include "profile.c"
+
+/* ------------------------ Allocation traces ------------------------- */
+#include "trace.c"
+
 /* ------------------- Support for multiple arenas -------------------- */
 #include "arena.c"
 
+/* ------------------- Cache of unmapped chunks ----------------------- */
+#include "mmap-cache.c"
+
+/* ------------------------ Statistics -------------------------------- */
+#include "stats.c"
+
 /*
    Debugging support
 
@@ -2246,6 +2384,106 @@ do_check_malloc_state (mstate av)
 
 /* ----------- Routines dealing with system allocation -------------- */
 
+/*
+   Directly map a chunk of at least NB bytes, using pages of PAGESIZE
+   bytes and passing EXTRA_FLAGS to mmap.  Returns the user pointer, or
+   MAP_FAILED if the mapping could not be created.
+ */
+
+static void *
+sysmalloc_mmap (INTERNAL_SIZE_T nb, size_t pagesize, int extra_flags,
+		mstate av)
+{
+  long int size;
+  char *mm;
+  mchunkptr p;
+  INTERNAL_SIZE_T front_misalign;
+  long correction;
+
+  /*
+     Round up size to nearest page.  For mmapped chunks, the overhead
+     is one SIZE_SZ unit larger than for normal chunks, because there
+     is no following chunk whose prev_size field could be used.
+
+     See the front_misalign handling below, for glibc there is no
+     need for further alignments unless we have have high alignment.
+   */
+  if (MALLOC_ALIGNMENT == 2 * SIZE_SZ)
+    size = ALIGN_UP (nb + SIZE_SZ, pagesize);
+  else
+    size = ALIGN_UP (nb + SIZE_SZ + MALLOC_ALIGN_MASK, pagesize);
+
+  /* Don't try if size wraps around 0 */
+  if ((unsigned long) (size) <= (unsigned long) (nb))
+    return MAP_FAILED;
+
+  mmap_cache_reused = false;
+  if (extra_flags == 0 && mp_.mmap_cache_max != 0)
+    {
+      size_t mapped;
+      mm = mmap_cache_get (size, &mapped);
+      if (mm != NULL)
+	{
+	  size = mapped;
+	  mmap_cache_reused = true;
+	}
+    }
+  if (!mmap_cache_reused)
+    {
+      mm = (char *) (MMAP (0, size, PROT_READ | PROT_WRITE, extra_flags));
+      if (mm == MAP_FAILED)
+	return mm;
+
+      if (extra_flags == 0)
+	madvise_thp (mm, size);
+    }
+
+  /*
+     The offset to the start of the mmapped region is stored
+     in the prev_size field of the chunk. This allows us to adjust
+     returned start address to meet alignment requirements here
+     and in memalign(), and still be able to compute proper
+     address argument for later munmap in free() and realloc().
+   */
+
+  if (MALLOC_ALIGNMENT == 2 * SIZE_SZ)
+    {
+      /* For glibc, chunk2mem increases the address by 2*SIZE_SZ and
+         MALLOC_ALIGN_MASK is 2*SIZE_SZ-1.  Each mmap'ed area is page
+         aligned and therefore definitely MALLOC_ALIGN_MASK-aligned.  */
+      assert (((INTERNAL_SIZE_T) chunk2mem (mm) & MALLOC_ALIGN_MASK) == 0);
+      front_misalign = 0;
+    }
+  else
+    front_misalign = (INTERNAL_SIZE_T) chunk2mem (mm) & MALLOC_ALIGN_MASK;
+  if (front_misalign > 0)
+    {
+      correction = MALLOC_ALIGNMENT - front_misalign;
+      p = (mchunkptr) (mm + correction);
+      set_prev_size (p, correction);
+      set_head (p, (size - correction) | IS_MMAPPED);
+    }
+  else
+    {
+      p = (mchunkptr) mm;
+      set_prev_size (p, 0);
+      set_head (p, size | IS_MMAPPED);
+    }
+
+  /* update statistics */
+
+  int new = atomic_exchange_and_add (&mp_.n_mmaps, 1) + 1;
+  atomic_max (&mp_.max_n_mmaps, new);
+
+  unsigned long sum;
+  sum = atomic_exchange_and_add (&mp_.mmapped_mem, size) + size;
+  atomic_max (&mp_.max_mmapped_mem, sum);
+
+  check_chunk (av, p);
+
+  return chunk2mem (p);
+}
+
 /*
    sysmalloc handles malloc cases requiring more memory from the system.
    On entry, it is assumed that av->top does not have enough
@@ -2292,74 +2530,20 @@ sysmalloc (INTERNAL_SIZE_T nb, mstate av)
     {
       char *mm;           /* return value from mmap call*/
 
-    try_mmap:
-      /*
-         Round up size to nearest page.  For mmapped chunks, the overhead
-         is one SIZE_SZ unit larger than for normal chunks, because there
-         is no following chunk whose prev_size field could be used.
+      /* Back the chunk with explicit huge pages if that was requested
+	 and it covers at least one of them.  */
+      if (__glibc_unlikely (mp_.hp_pagesize != 0) && nb >= mp_.hp_pagesize)
+	{
+	  mm = sysmalloc_mmap (nb, mp_.hp_pagesize, mp_.hp_flags, av);
+	  if (mm != MAP_FAILED)
+	    return mm;
+	}
 
-         See the front_misalign handling below, for glibc there is no
-         need for further alignments unless we have have high alignment.
-       */
-      if (MALLOC_ALIGNMENT == 2 * SIZE_SZ)
-        size = ALIGN_UP (nb + SIZE_SZ, pagesize);
-      else
-        size = ALIGN_UP (nb + SIZE_SZ + MALLOC_ALIGN_MASK, pagesize);
+    try_mmap:
+      mm = sysmalloc_mmap (nb, pagesize, 0, av);
+      if (mm != MAP_FAILED)
+	return mm;
       tried_mmap = true;
-
-      /* Don't try if size wraps around 0 */
-      if ((unsigned long) (size) > (unsigned long) (nb))
-        {
-          mm = (char *) (MMAP (0, size, PROT_READ | PROT_WRITE, 0));
-
-          if (mm != MAP_FAILED)
-            {
-              /*
-                 The offset to the start of the mmapped region is stored
-                 in the prev_size field of the chunk. This allows us to adjust
-                 returned start address to meet alignment requirements here
-                 and in memalign(), and still be able to compute proper
-                 address argument for later munmap in free() and realloc().
-               */
-
-              if (MALLOC_ALIGNMENT == 2 * SIZE_SZ)
-                {
-                  /* For glibc, chunk2mem increases the address by 2*SIZE_SZ and
-                     MALLOC_ALIGN_MASK is 2*SIZE_SZ-1.  Each mmap'ed area is page
-                     aligned and therefore definitely MALLOC_ALIGN_MASK-aligned.  */
-                  assert (((INTERNAL_SIZE_T) chunk2mem (mm) & MALLOC_ALIGN_MASK) == 0);
-                  front_misalign = 0;
-                }
-              else
-                front_misalign = (INTERNAL_SIZE_T) chunk2mem (mm) & MALLOC_ALIGN_MASK;
-              if (front_misalign > 0)
-                {
-                  correction = MALLOC_ALIGNMENT - front_misalign;
-                  p = (mchunkptr) (mm + correction);
-		  set_prev_size (p, correction);
-                  set_head (p, (size - correction) | IS_MMAPPED);
-                }
-              else
-                {
-                  p = (mchunkptr) mm;
-		  set_prev_size (p, 0);
-                  set_head (p, size | IS_MMAPPED);
-                }
-
-              /* update statistics */
-
-              int new = atomic_exchange_and_add (&mp_.n_mmaps, 1) + 1;
-              atomic_max (&mp_.max_n_mmaps, new);
-
-              unsigned long sum;
-              sum = atomic_exchange_and_add (&mp_.mmapped_mem, size) + size;
-              atomic_max (&mp_.max_mmapped_mem, sum);
-
-              check_chunk (av, p);
-
-              return chunk2mem (p);
-            }
-        }
     }
 
   /* There are no usable arenas and mmap also failed.  */
@@ -2403,7 +2587,8 @@ sysmalloc (INTERNAL_SIZE_T nb, mstate av)
           set_head (old_top, (((char *) old_heap + old_heap->size) - (char *) old_top)
                     | PREV_INUSE);
         }
-      else if ((heap = new_heap (nb + (MINSIZE + sizeof (*heap)), mp_.top_pad)))
+      else if ((heap = new_heap (nb + (MINSIZE + sizeof (*heap)), mp_.top_pad,
+				    av->numa_node)))
         {
           /* Use a newly allocated heap.  */
           heap->ar_ptr = av;
@@ -2460,15 +2645,27 @@ sysmalloc (INTERNAL_SIZE_T nb, mstate av)
          previous calls. Otherwise, we correct to page-align below.
        */
 
-      size = ALIGN_UP (size, pagesize);
+      /* With transparent huge pages, end the new space on a huge page
+         boundary so that the whole region can be backed by them.  */
+      if (__glibc_unlikely (mp_.thp_pagesize != 0))
+        {
+          uintptr_t cur_brk = (uintptr_t) MORECORE (0);
+          uintptr_t top = ALIGN_UP (cur_brk + size, mp_.thp_pagesize);
+          size = top - cur_brk;
+        }
+      else
+        size = ALIGN_UP (size, pagesize);
 
       /*
          Don't try to call MORECORE if argument is so big as to appear
          negative. Note that since mmap takes size_t arg, it may succeed
          below even if we cannot call MORECORE.
+
+         The break cannot be backed by explicit huge pages, so skip it
+         and use mmap right away if they were requested.
        */
 
-      if (size > 0)
+      if (size > 0 && mp_.hp_pagesize == 0)
         {
           brk = (char *) (MORECORE (size));
           LIBC_PROBE (memory_sbrk_more, 2, brk, size);
@@ -2480,6 +2677,7 @@ sysmalloc (INTERNAL_SIZE_T nb, mstate av)
           void (*hook) (void) = atomic_forced_read (__after_morecore_hook);
           if (__builtin_expect (hook != NULL, 0))
             (*hook)();
+          madvise_thp (brk, size);
         }
       else
         {
@@ -2503,7 +2701,22 @@ sysmalloc (INTERNAL_SIZE_T nb, mstate av)
           /* Don't try if size wraps around 0 */
           if ((unsigned long) (size) > (unsigned long) (nb))
             {
-              char *mbrk = (char *) (MMAP (0, size, PROT_READ | PROT_WRITE, 0));
+              char *mbrk = MAP_FAILED;
+
+              if (__glibc_unlikely (mp_.hp_pagesize != 0))
+                {
+                  long hp_size = ALIGN_UP (size, mp_.hp_pagesize);
+                  mbrk = (char *) (MMAP (0, hp_size, PROT_READ | PROT_WRITE,
+                                         mp_.hp_flags));
+                  if (mbrk != MAP_FAILED)
+                    size = hp_size;
+                }
+              if (mbrk == MAP_FAILED)
+                {
+                  mbrk = (char *) (MMAP (0, size, PROT_READ | PROT_WRITE, 0));
+                  if (mbrk != MAP_FAILED)
+                    madvise_thp (mbrk, size);
+                }
 
               if (mbrk != MAP_FAILED)
                 {
@@ -2719,6 +2932,7 @@ sysmalloc (INTERNAL_SIZE_T nb, mstate av)
       remainder_size = size - nb;
       remainder = chunk_at_offset (p, nb);
       av->top = remainder;
+      top_split (av);
       set_head (p, nb | PREV_INUSE | (av != &main_arena ? NON_MAIN_ARENA : 0));
       set_head (remainder, remainder_size | PREV_INUSE);
       check_malloced_chunk (av, p, nb);
@@ -2764,6 +2978,29 @@ systrim (size_t pad, mstate av)
   if (extra == 0)
     return 0;
 
+  /* Keep the break where it is and let the kernel reclaim the pages
+     lazily, so that a later allocation burst can reuse them without
+     faulting them in again.  Only the pages below the ones released
+     before need to be released, so that repeated calls from free do
+     not make a system call each.  */
+  if (mp_.madv_free)
+    {
+      char *top_end = (char *) av->top + top_size;
+      char *start = top_end - extra;
+      char *end = top_end;
+
+      if (av->released != NULL && av->released_end == top_end)
+        {
+          if (start >= av->released)
+            return 0;
+          end = av->released;
+        }
+      malloc_release_pages (start, end - start);
+      av->released = start;
+      av->released_end = top_end;
+      return 1;
+    }
+
   /*
      Only proceed if end of memory is where we last set it.
      This avoids problems if there were foreign sbrk calls.
@@ -2807,20 +3044,67 @@ systrim (size_t pad, mstate av)
   return 0;
 }
 
+/* Number of frees into an arena between two checks of the clock for
+   glibc.malloc.decay_ms.  */
+#define DECAY_CHECK_INTERVAL 64
+
+/*
+  malloc_decay returns unused memory at the top of arena AV to the
+  system once every glibc.malloc.decay_ms milliseconds, independently
+  of the trim threshold, so that the footprint of an idle arena
+  follows its load.  It is called with the arena lock held on the
+  free path, and only reads the (coarse, vDSO-backed) clock once per
+  DECAY_CHECK_INTERVAL frees of chunks outside the fast bins.  Each
+  pass releases half of the memory above the top pad, so memory that
+  stays unused decays geometrically and short dips in load do not
+  cause fault storms.  If pages are released with MADV_FREE, which
+  leaves them in place until the kernel needs them, all of it is
+  released; pages released by an earlier pass are skipped.
+*/
+
 static void
-munmap_chunk (mchunkptr p)
+malloc_decay (mstate av)
 {
-  INTERNAL_SIZE_T size = chunksize (p);
+  if (++av->decay_ticks < DECAY_CHECK_INTERVAL)
+    return;
+  av->decay_ticks = 0;
 
-  assert (chunk_is_mmapped (p));
+  uint64_t now = malloc_clock_ms ();
+  if (now == 0)
+    return;
+  if (av->decay_time == 0)
+    {
+      /* Start the first period.  */
+      av->decay_time = now;
+      return;
+    }
+  if (now - av->decay_time < mp_.decay_ms)
+    return;
+  av->decay_time = now;
 
-  /* Do nothing if the chunk is a faked mmapped chunk in the dumped
-     main arena.  We never free this memory.  */
-  if (DUMPED_MAIN_ARENA_CHUNK (p))
+  long top_area = chunksize (av->top) - MINSIZE - 1;
+  if (top_area <= (long) mp_.top_pad)
     return;
+  size_t pad = mp_.top_pad;
+  if (!mp_.madv_free)
+    pad += (top_area - mp_.top_pad) / 2;
+
+  if (av == &main_arena)
+    {
+#ifndef MORECORE_CANNOT_TRIM
+      systrim (pad, av);
+#endif
+    }
+  else
+    heap_trim (heap_for_ptr (top (av)), pad, 0);
+}
 
+/* Abort if the mmapped chunk P cannot be released by munmap_chunk.  */
+static __always_inline void
+munmap_chunk_check (mchunkptr p)
+{
   uintptr_t block = (uintptr_t) p - prev_size (p);
-  size_t total_size = prev_size (p) + size;
+  size_t total_size = prev_size (p) + chunksize (p);
   /* Unfortunately we have to do the compilers job by hand here.  Normally
      we would test BLOCK and TOTAL-SIZE separately for compliance with the
      page size.  But gcc does not recognize the optimization possibility
@@ -2828,10 +3112,48 @@ munmap_chunk (mchunkptr p)
      the bit test.  */
   if (__builtin_expect (((block | total_size) & (GLRO (dl_pagesize) - 1)) != 0, 0))
     malloc_printerr ("munmap_chunk(): invalid pointer");
+}
+
+/* Abort if the chunk P of SIZE bytes cannot be released by
+   _int_free.  */
+static __always_inline void
+int_free_check (mchunkptr p, INTERNAL_SIZE_T size)
+{
+  /* Little security check which won't hurt performance: the
+     allocator never wrapps around at the end of the address space.
+     Therefore we can exclude some size values which might appear
+     here by accident or by "design" from some intruder.  */
+  if (__builtin_expect ((uintptr_t) p > (uintptr_t) -size, 0)
+      || __builtin_expect (misaligned_chunk (p), 0))
+    malloc_printerr ("free(): invalid pointer");
+  /* We know that each chunk is at least MINSIZE bytes in size or a
+     multiple of MALLOC_ALIGNMENT.  */
+  if (__glibc_unlikely (size < MINSIZE || !aligned_OK (size)))
+    malloc_printerr ("free(): invalid size");
+}
+
+static void
+munmap_chunk (mchunkptr p)
+{
+  INTERNAL_SIZE_T size = chunksize (p);
+
+  assert (chunk_is_mmapped (p));
+
+  /* Do nothing if the chunk is a faked mmapped chunk in the dumped
+     main arena.  We never free this memory.  */
+  if (DUMPED_MAIN_ARENA_CHUNK (p))
+    return;
+
+  munmap_chunk_check (p);
+  uintptr_t block = (uintptr_t) p - prev_size (p);
+  size_t total_size = prev_size (p) + size;
 
   atomic_decrement (&mp_.n_mmaps);
   atomic_add (&mp_.mmapped_mem, -total_size);
 
+  if (mp_.mmap_cache_max != 0 && mmap_cache_put ((void *) block, total_size))
+    return;
+
   /* If munmap failed the process virtual memory address space is in a
      bad shape.  Just leave the block hanging around, the process will
      terminate shortly anyway since not much can be done.  */
@@ -2898,7 +3220,9 @@ typedef struct tcache_entry
 typedef struct tcache_perthread_struct
 {
   char counts[TCACHE_MAX_BINS];
+  char aligned_counts[TCACHE_ALIGNED_BINS];
   tcache_entry *entries[TCACHE_MAX_BINS];
+  tcache_entry *aligned_entries[TCACHE_ALIGNED_BINS];
 } tcache_perthread_struct;
 
 static __thread bool tcache_shutting_down = false;
@@ -2929,6 +3253,159 @@ tcache_get (size_t tc_idx)
   return (void *) e;
 }
 
+/* Return the aligned bin for requests of *BYTES bytes aligned to
+   *ALIGNMENT, which is a power of two, or -1 if there is none.  If
+   there is one, *ALIGNMENT and *BYTES are rounded up to the alignment
+   and size of the chunks in the bin.  */
+static __always_inline int
+tcache_aligned_request (size_t *alignment, size_t *bytes)
+{
+  size_t align, nbins;
+  int base;
+  if (*alignment <= TCACHE_LINE_ALIGN)
+    {
+      align = TCACHE_LINE_ALIGN;
+      nbins = TCACHE_LINE_BINS;
+      base = 0;
+    }
+  else if (*alignment <= GLRO (dl_pagesize))
+    {
+      align = GLRO (dl_pagesize);
+      nbins = TCACHE_PAGE_BINS;
+      base = TCACHE_LINE_BINS;
+    }
+  else
+    return -1;
+
+  if (*bytes > nbins * align || mp_.tcache_bins == 0)
+    return -1;
+  size_t k = *bytes == 0 ? 1 : (*bytes + align - 1) >> __builtin_ctzl (align);
+  *alignment = align;
+  *bytes = k * align;
+  return base + k - 1;
+}
+
+/* Return the aligned bin for chunk P of SIZE bytes, or -1 if it does
+   not have the size and alignment of the chunks in one.  */
+static __always_inline int
+tcache_aligned_chunk (mchunkptr p, INTERNAL_SIZE_T size)
+{
+  uintptr_t mem = (uintptr_t) chunk2mem (p);
+  if (__glibc_likely ((mem & (TCACHE_LINE_ALIGN - 1)) != 0)
+      || mp_.tcache_bins == 0)
+    return -1;
+
+  size_t k = (size - SIZE_SZ) / TCACHE_LINE_ALIGN;
+  if (k - 1 < TCACHE_LINE_BINS
+      && size - request2size (k * TCACHE_LINE_ALIGN) <= MINSIZE)
+    return k - 1;
+
+  size_t pagesize = GLRO (dl_pagesize);
+  if ((mem & (pagesize - 1)) != 0)
+    return -1;
+  k = (size - SIZE_SZ) >> __builtin_ctzl (pagesize);
+  if (k - 1 < TCACHE_PAGE_BINS
+      && size - request2size (k * pagesize) <= MINSIZE)
+    return TCACHE_LINE_BINS + k - 1;
+  return -1;
+}
+
+/* Return the aligned bin with room for chunk P of SIZE bytes, or -1.  */
+static __always_inline int
+tcache_aligned_slot (mchunkptr p, INTERNAL_SIZE_T size)
+{
+  int idx = tcache_aligned_chunk (p, size);
+  if (idx < 0 || tcache->aligned_counts[idx] >= mp_.tcache_count)
+    return -1;
+  return idx;
+}
+
+/* Caller must ensure that IDX is valid and there's room for more
+   chunks.  */
+static __always_inline void
+tcache_aligned_put (mchunkptr p, int idx)
+{
+  tcache_entry *e = (tcache_entry *) chunk2mem (p);
+  e->next = tcache->aligned_entries[idx];
+  tcache->aligned_entries[idx] = e;
+  ++(tcache->aligned_counts[idx]);
+}
+
+/* Caller must ensure that IDX is valid and the bin is not empty.  */
+static __always_inline void *
+tcache_aligned_get (int idx)
+{
+  tcache_entry *e = tcache->aligned_entries[idx];
+  tcache->aligned_entries[idx] = e->next;
+  --(tcache->aligned_counts[idx]);
+  return (void *) e;
+}
+
+/* Take a chunk of at least NB bytes for malloc from the cache line
+   bins, which also receive suitably aligned chunks freed by malloc
+   users if glibc.malloc.tcache_aligned_free is set.  Returns NULL if
+   there is none.  */
+static __always_inline void *
+tcache_get_line_aligned (INTERNAL_SIZE_T nb)
+{
+  size_t k = (nb - SIZE_SZ) / TCACHE_LINE_ALIGN;
+  if (k - 1 >= TCACHE_LINE_BINS
+      || request2size (k * TCACHE_LINE_ALIGN) != nb
+      || tcache->aligned_entries[k - 1] == NULL)
+    return NULL;
+  return tcache_aligned_get (k - 1);
+}
+
+/* Return the NULL-terminated list of tcache entries starting at E to
+   their arenas.  Runs of entries which belong to the same arena are
+   freed under a single acquisition of that arena's lock, and at most
+   one arena lock is held at any time.  */
+static void
+tcache_release (tcache_entry *e)
+{
+  mstate locked = NULL;
+
+  while (e != NULL)
+    {
+      tcache_entry *next = e->next;
+      mchunkptr p = mem2chunk (e);
+      mstate av = arena_for_chunk (p);
+
+      if (av != locked)
+	{
+	  if (locked != NULL)
+	    __libc_lock_unlock (locked->mutex);
+	  lock_arena (av);
+	  locked = av;
+	}
+      _int_free_chunk (av, p, chunksize (p), 1);
+      e = next;
+    }
+
+  if (locked != NULL)
+    __libc_lock_unlock (locked->mutex);
+}
+
+/* Detach up to N entries from the tail of tcache bin TC_IDX and
+   return them to their arenas.  The tail holds the entries which
+   were freed least recently and are therefore the coldest.  */
+static void
+tcache_flush (size_t tc_idx, size_t n)
+{
+  tcache_entry **ep = &tcache->entries[tc_idx];
+  size_t keep = 0;
+
+  if ((size_t) tcache->counts[tc_idx] > n)
+    keep = tcache->counts[tc_idx] - n;
+  for (size_t i = 0; i < keep; ++i)
+    ep = &(*ep)->next;
+
+  tcache_entry *e = *ep;
+  *ep = NULL;
+  tcache->counts[tc_idx] = keep;
+  tcache_release (e);
+}
+
 static void
 tcache_thread_shutdown (void)
 {
@@ -2943,15 +3420,19 @@ tcache_thread_shutdown (void)
   tcache_shutting_down = true;
 
   /* Free all of the entries and the tcache itself back to the arena
-     heap for coalescing.  */
+     heap for coalescing.  Each bin is released in one batch so that
+     the arena lock is not taken once per chunk.  */
   for (i = 0; i < TCACHE_MAX_BINS; ++i)
     {
-      while (tcache_tmp->entries[i])
-	{
-	  tcache_entry *e = tcache_tmp->entries[i];
-	  tcache_tmp->entries[i] = e->next;
-	  __libc_free (e);
-	}
+      tcache_entry *e = tcache_tmp->entries[i];
+      tcache_tmp->entries[i] = NULL;
+      tcache_release (e);
+    }
+  for (i = 0; i < TCACHE_ALIGNED_BINS; ++i)
+    {
+      tcache_entry *e = tcache_tmp->aligned_entries[i];
+      tcache_tmp->aligned_entries[i] = NULL;
+      tcache_release (e);
     }
 
   __libc_free (tcache_tmp);
@@ -2988,6 +3469,7 @@ tcache_init(void)
     {
       tcache = (tcache_perthread_struct *) victim;
       memset (tcache, 0, sizeof (tcache_perthread_struct));
+      stats_count_alloc (victim, stats_tcache_none);
     }
 
 }
@@ -3017,6 +3499,11 @@ __libc_malloc (size_t bytes)
     = atomic_forced_read (__malloc_hook);
   if (__builtin_expect (hook != NULL, 0))
     return (*hook)(bytes, RETURN_ADDRESS (0));
+  if (trace_due ())
+    return trace_malloc (bytes);
+  if (__glibc_unlikely (profile_sample_due (bytes)))
+    return profile_malloc (bytes, RETURN_ADDRESS (0));
+  int tcache_status = stats_tcache_none;
 #if USE_TCACHE
   /* int_free also calls request2size, be careful to not pad twice.  */
   size_t tbytes;
@@ -3028,10 +3515,21 @@ __libc_malloc (size_t bytes)
   DIAG_PUSH_NEEDS_COMMENT;
   if (tc_idx < mp_.tcache_bins
       /*&& tc_idx < TCACHE_MAX_BINS*/ /* to appease gcc */
-      && tcache
-      && tcache->entries[tc_idx] != NULL)
+      && tcache)
     {
-      return tcache_get (tc_idx);
+      if (tcache->entries[tc_idx] != NULL)
+	{
+	  victim = tcache_get (tc_idx);
+	  stats_count_alloc (victim, stats_tcache_hit);
+	  return victim;
+	}
+      victim = tcache_get_line_aligned (tbytes);
+      if (victim != NULL)
+	{
+	  stats_count_alloc (victim, stats_tcache_hit);
+	  return victim;
+	}
+      tcache_status = stats_tcache_miss;
     }
   DIAG_POP_NEEDS_COMMENT;
 #endif
@@ -3041,6 +3539,7 @@ __libc_malloc (size_t bytes)
       victim = _int_malloc (&main_arena, bytes);
       assert (!victim || chunk_is_mmapped (mem2chunk (victim)) ||
 	      &main_arena == arena_for_chunk (mem2chunk (victim)));
+      stats_count_alloc (victim, tcache_status);
       return victim;
     }
 
@@ -3061,6 +3560,7 @@ __libc_malloc (size_t bytes)
 
   assert (!victim || chunk_is_mmapped (mem2chunk (victim)) ||
           ar_ptr == arena_for_chunk (mem2chunk (victim)));
+  stats_count_alloc (victim, tcache_status);
   return victim;
 }
 libc_hidden_def (__libc_malloc)
@@ -3082,13 +3582,22 @@ __libc_free (void *mem)
   if (mem == 0)                              /* free(0) has no effect */
     return;
 
+  if (trace_due ())
+    {
+      trace_free (mem);
+      return;
+    }
+
+  profile_forget (mem);
+
   p = mem2chunk (mem);
 
   if (chunk_is_mmapped (p))                       /* release mmapped memory. */
     {
       /* See if the dynamic brk/mmap threshold needs adjusting.
-	 Dumped fake mmapped chunks do not affect the threshold.  */
-      if (!mp_.no_dyn_threshold
+	 Dumped fake mmapped chunks do not affect the threshold.  With
+	 the mmap cache, the chunk is kept for reuse instead.  */
+      if (!mp_.no_dyn_threshold && mp_.mmap_cache_max == 0
           && chunksize_nomask (p) > mp_.mmap_threshold
           && chunksize_nomask (p) <= DEFAULT_MMAP_THRESHOLD_MAX
 	  && !DUMPED_MAIN_ARENA_CHUNK (p))
@@ -3098,17 +3607,122 @@ __libc_free (void *mem)
           LIBC_PROBE (memory_mallopt_free_dyn_thresholds, 2,
                       mp_.mmap_threshold, mp_.trim_threshold);
         }
+      /* Count the chunk only once it is known to be valid.  Dumped
+	 chunks are not counted, nor checked.  */
+      if (__glibc_unlikely (mp_.stats) && !DUMPED_MAIN_ARENA_CHUNK (p))
+	{
+	  munmap_chunk_check (p);
+	  stats_count (p, true, stats_tcache_none);
+	}
       munmap_chunk (p);
       return;
     }
 
   MAYBE_INIT_TCACHE ();
 
+  /* Check the chunk before stats_count looks up its arena.  */
+  if (__glibc_unlikely (mp_.stats))
+    {
+      int_free_check (p, chunksize (p));
+      stats_count (p, true, stats_tcache_none);
+    }
   ar_ptr = arena_for_chunk (p);
   _int_free (ar_ptr, p, 0);
 }
 libc_hidden_def (__libc_free)
 
+/* Try to free MEM, a block of SIZE bytes, into the tcache.  This only
+   reads the size field of the chunk, which must match SIZE exactly, so
+   that chunks which are mmapped or larger than requested take the
+   path of free.  Returns false if the chunk has not been freed.  */
+static __always_inline bool
+free_sized_tcache (void *mem, size_t size)
+{
+#if USE_TCACHE
+  if (__glibc_unlikely (tcache == NULL) || size > mp_.tcache_max_bytes)
+    return false;
+
+  mchunkptr p = mem2chunk (mem);
+  INTERNAL_SIZE_T nb = request2size (size);
+  size_t tc_idx = csize2tidx (nb);
+  if ((chunksize_nomask (p) & ~(PREV_INUSE | NON_MAIN_ARENA)) != nb
+      || __glibc_unlikely (misaligned_chunk (p))
+      || tcache->counts[tc_idx] >= mp_.tcache_count)
+    return false;
+
+  profile_forget (mem);
+  stats_count_free (p);
+  tcache_put (p, tc_idx);
+  return true;
+#else
+  return false;
+#endif
+}
+
+/* Free MEM through free after checking that SIZE is not larger than
+   the block.  */
+static void
+free_sized_slow (void *mem, size_t size, const char *errstr)
+{
+  mchunkptr p = mem2chunk (mem);
+  if (__glibc_unlikely (REQUEST_OUT_OF_RANGE (size)
+			|| chunksize (p) < request2size (size)))
+    malloc_printerr (errstr);
+  __libc_free (mem);
+}
+
+void
+__libc_free_sized (void *mem, size_t size)
+{
+  if (__glibc_unlikely (mem == NULL
+			|| atomic_forced_read (__free_hook) != NULL
+			|| trace_due ()))
+    {
+      __libc_free (mem);
+      return;
+    }
+  if (__glibc_likely (free_sized_tcache (mem, size)))
+    return;
+  free_sized_slow (mem, size, "free_sized(): invalid size");
+}
+
+void
+__libc_free_aligned_sized (void *mem, size_t alignment, size_t size)
+{
+  if (__glibc_unlikely (mem == NULL
+			|| atomic_forced_read (__free_hook) != NULL
+			|| trace_due ()))
+    {
+      __libc_free (mem);
+      return;
+    }
+  if (__glibc_unlikely (!powerof2 (alignment)
+			|| ((uintptr_t) mem & (alignment - 1)) != 0))
+    malloc_printerr ("free_aligned_sized(): invalid alignment");
+#if USE_TCACHE
+  /* Chunks from the aligned bins are larger than SIZE.  */
+  if (tcache != NULL && alignment > MALLOC_ALIGNMENT)
+    {
+      mchunkptr p = mem2chunk (mem);
+      INTERNAL_SIZE_T csize = chunksize (p);
+      int idx;
+      if (!chunk_is_mmapped (p)
+	  && (idx = tcache_aligned_slot (p, csize)) >= 0
+	  && !REQUEST_OUT_OF_RANGE (size)
+	  && request2size (size) <= csize)
+	{
+	  profile_forget (mem);
+	  stats_count_free (p);
+	  tcache_aligned_put (p, idx);
+	  return;
+	}
+    }
+#endif
+  if (__glibc_likely (free_sized_tcache (mem, size)))
+    return;
+  free_sized_slow (mem, size, "free_aligned_sized(): invalid size");
+}
+
 void *
 __libc_realloc (void *oldmem, size_t bytes)
 {
@@ -3129,6 +3743,17 @@ __libc_realloc (void *oldmem, size_t bytes)
     }
 #endif
 
+  if (trace_due ())
+    return trace_realloc (oldmem, bytes);
+
+  /* profile_busy is checked so that the call from profile_realloc
+     does not come back here.  */
+  bool profile_due = profile_sample_due (bytes);
+  if (__glibc_unlikely (profile_due
+			|| (oldmem != NULL && profile_may_be_sampled (oldmem)
+			    && !profile_busy)))
+    return profile_realloc (oldmem, bytes, profile_due, RETURN_ADDRESS (0));
+
   /* realloc of null is supposed to be same as malloc */
   if (oldmem == 0)
     return __libc_malloc (bytes);
@@ -3181,35 +3806,52 @@ __libc_realloc (void *oldmem, size_t bytes)
 
       void *newmem;
 
+      /* The statistics count realloc as a free of the old chunk and an
+	 allocation of the new one.  */
+      stats_count_free (oldp);
+      mmap_cache_reused = false;
+
 #if HAVE_MREMAP
       newp = mremap_chunk (oldp, nb);
       if (newp)
-        return chunk2mem (newp);
+	{
+	  stats_count_alloc (chunk2mem (newp), stats_tcache_none);
+	  return chunk2mem (newp);
+	}
 #endif
       /* Note the extra SIZE_SZ overhead. */
       if (oldsize - SIZE_SZ >= nb)
-        return oldmem;                         /* do nothing */
+	{
+	  stats_count_alloc (oldmem, stats_tcache_none);
+	  return oldmem;                         /* do nothing */
+	}
 
       /* Must alloc, copy, free. */
       newmem = __libc_malloc (bytes);
       if (newmem == 0)
-        return 0;              /* propagate failure */
+	{
+	  stats_count_alloc (oldmem, stats_tcache_none);
+	  return 0;              /* propagate failure */
+	}
 
       memcpy (newmem, oldmem, oldsize - 2 * SIZE_SZ);
       munmap_chunk (oldp);
       return newmem;
     }
 
+  stats_count_free (oldp);
+
   if (SINGLE_THREAD_P)
     {
       newp = _int_realloc (ar_ptr, oldp, oldsize, nb);
       assert (!newp || chunk_is_mmapped (mem2chunk (newp)) ||
 	      ar_ptr == arena_for_chunk (mem2chunk (newp)));
 
+      stats_count_alloc (newp != NULL ? newp : oldmem, stats_tcache_none);
       return newp;
     }
 
-  __libc_lock_lock (ar_ptr->mutex);
+  lock_arena (ar_ptr);
 
   newp = _int_realloc (ar_ptr, oldp, oldsize, nb);
 
@@ -3217,7 +3859,9 @@ __libc_realloc (void *oldmem, size_t bytes)
   assert (!newp || chunk_is_mmapped (mem2chunk (newp)) ||
           ar_ptr == arena_for_chunk (mem2chunk (newp)));
 
-  if (newp == NULL)
+  if (newp != NULL)
+    stats_count_alloc (newp, stats_tcache_none);
+  else
     {
       /* Try harder to allocate memory in other arenas.  */
       LIBC_PROBE (memory_realloc_retry, 2, bytes, oldmem);
@@ -3227,6 +3871,8 @@ __libc_realloc (void *oldmem, size_t bytes)
           memcpy (newp, oldmem, oldsize - SIZE_SZ);
           _int_free (ar_ptr, oldp, 0);
         }
+      else
+	stats_count_alloc (oldmem, stats_tcache_none);
     }
 
   return newp;
@@ -3251,6 +3897,9 @@ _mid_memalign (size_t alignment, size_t bytes, void *address)
   if (__builtin_expect (hook != NULL, 0))
     return (*hook)(alignment, bytes, address);
 
+  if (trace_due ())
+    return trace_memalign (alignment, bytes, address);
+
   /* If we need less alignment than we give anyway, just relay to malloc.  */
   if (alignment <= MALLOC_ALIGNMENT)
     return __libc_malloc (bytes);
@@ -3284,12 +3933,49 @@ _mid_memalign (size_t alignment, size_t bytes, void *address)
       alignment = a;
     }
 
+  if (__glibc_unlikely (profile_sample_due (bytes)))
+    return profile_memalign (alignment, bytes, address);
+
+  int tcache_status = stats_tcache_none;
+#if USE_TCACHE
+  size_t tc_alignment = alignment, tc_bytes = bytes;
+  int tc_idx = tcache_aligned_request (&tc_alignment, &tc_bytes);
+
+  MAYBE_INIT_TCACHE ();
+
+  if (tc_idx >= 0 && tcache)
+    {
+      if (tcache->aligned_entries[tc_idx] != NULL)
+	{
+	  p = tcache_aligned_get (tc_idx);
+	  stats_count_alloc (p, stats_tcache_hit);
+	  return p;
+	}
+      /* A chunk in the plain bin of the same size may happen to be
+	 aligned.  */
+      size_t idx = csize2tidx (request2size (tc_bytes));
+      if (idx < mp_.tcache_bins && tcache->entries[idx] != NULL
+	  && ((uintptr_t) tcache->entries[idx] & (alignment - 1)) == 0)
+	{
+	  p = tcache_get (idx);
+	  stats_count_alloc (p, stats_tcache_hit);
+	  return p;
+	}
+      tcache_status = stats_tcache_miss;
+      /* Allocate a chunk which fits into the aligned bin when it is
+	 freed.  */
+      alignment = tc_alignment;
+      bytes = tc_bytes;
+    }
+#endif
+
   if (SINGLE_THREAD_P)
     {
       p = _int_memalign (&main_arena, alignment, bytes);
       assert (!p || chunk_is_mmapped (mem2chunk (p)) ||
 	      &main_arena == arena_for_chunk (mem2chunk (p)));
 
+      stats_count_alloc (p, tcache_status);
       return p;
     }
 
@@ -3308,6 +3994,7 @@ _mid_memalign (size_t alignment, size_t bytes, void *address)
 
   assert (!p || chunk_is_mmapped (mem2chunk (p)) ||
           ar_ptr == arena_for_chunk (mem2chunk (p)));
+  stats_count_alloc (p, tcache_status);
   return p;
 }
 /* For ISO C11.  */
@@ -3383,6 +4070,12 @@ __libc_calloc (size_t n, size_t elem_size)
 
   sz = bytes;
 
+  if (trace_due ())
+    return trace_calloc (n, elem_size);
+
+  if (__glibc_unlikely (profile_sample_due (sz)))
+    return profile_calloc (n, elem_size, RETURN_ADDRESS (0));
+
   MAYBE_INIT_TCACHE ();
 
   if (SINGLE_THREAD_P)
@@ -3439,12 +4132,13 @@ __libc_calloc (size_t n, size_t elem_size)
   if (mem == 0)
     return 0;
 
+  stats_count_alloc (mem, stats_tcache_none);
   p = mem2chunk (mem);
 
   /* Two optional cases in which clearing not necessary */
   if (chunk_is_mmapped (p))
     {
-      if (__builtin_expect (perturb_byte, 0))
+      if (__builtin_expect (perturb_byte, 0) || mmap_cache_reused)
         return memset (mem, 0, sz);
 
       return mem;
@@ -3546,6 +4240,10 @@ _int_malloc (mstate av, size_t bytes)
       return p;
     }
 
+  /* Chunks other threads have freed into this arena in the meantime
+     may satisfy this request.  */
+  remote_frees_drain (av);
+
   /*
      If the size qualifies as a fastbin, first check corresponding bin.
      This code is safe to execute even if av is not yet initialized, so we
@@ -4081,10 +4779,39 @@ _int_malloc (mstate av, size_t bytes)
           remainder_size = size - nb;
           remainder = chunk_at_offset (victim, nb);
           av->top = remainder;
+          top_split (av);
           set_head (victim, nb | PREV_INUSE |
                     (av != &main_arena ? NON_MAIN_ARENA : 0));
           set_head (remainder, remainder_size | PREV_INUSE);
 
+#if USE_TCACHE
+	  /* The tcache bin for this size is empty.  While we hold the
+	     arena lock, carve a batch of further chunks of the same size
+	     from top so that the next requests can be served without
+	     coming back to the arena.  */
+	  if (tcache_nb && mp_.tcache_batch > 1)
+	    {
+	      size_t n = mp_.tcache_batch;
+
+	      while (n-- > 0
+		     && tcache->counts[tc_idx] < mp_.tcache_count
+		     && (unsigned long) remainder_size
+			>= (unsigned long) (nb + MINSIZE))
+		{
+		  mchunkptr tc_victim = remainder;
+
+		  remainder_size -= nb;
+		  remainder = chunk_at_offset (tc_victim, nb);
+		  av->top = remainder;
+		  top_split (av);
+		  set_head (tc_victim, nb | PREV_INUSE |
+			    (av != &main_arena ? NON_MAIN_ARENA : 0));
+		  set_head (remainder, remainder_size | PREV_INUSE);
+		  tcache_put (tc_victim, tc_idx);
+		}
+	    }
+#endif
+
           check_malloced_chunk (av, victim, nb);
           void *p = chunk2mem (victim);
           alloc_perturb (p, bytes);
@@ -4124,27 +4851,10 @@ static void
 _int_free (mstate av, mchunkptr p, int have_lock)
 {
   INTERNAL_SIZE_T size;        /* its size */
-  mfastbinptr *fb;             /* associated fastbin */
-  mchunkptr nextchunk;         /* next contiguous chunk */
-  INTERNAL_SIZE_T nextsize;    /* its size */
-  int nextinuse;               /* true if nextchunk is used */
-  INTERNAL_SIZE_T prevsize;    /* size of previous contiguous chunk */
-  mchunkptr bck;               /* misc temp for linking */
-  mchunkptr fwd;               /* misc temp for linking */
 
   size = chunksize (p);
 
-  /* Little security check which won't hurt performance: the
-     allocator never wrapps around at the end of the address space.
-     Therefore we can exclude some size values which might appear
-     here by accident or by "design" from some intruder.  */
-  if (__builtin_expect ((uintptr_t) p > (uintptr_t) -size, 0)
-      || __builtin_expect (misaligned_chunk (p), 0))
-    malloc_printerr ("free(): invalid pointer");
-  /* We know that each chunk is at least MINSIZE bytes in size or a
-     multiple of MALLOC_ALIGNMENT.  */
-  if (__glibc_unlikely (size < MINSIZE || !aligned_OK (size)))
-    malloc_printerr ("free(): invalid size");
+  int_free_check (p, size);
 
   check_inuse_chunk(av, p);
 
@@ -4152,6 +4862,14 @@ _int_free (mstate av, mchunkptr p, int have_lock)
   {
     size_t tc_idx = csize2tidx (size);
 
+    int aligned_idx;
+    if (tcache && __glibc_unlikely (mp_.tcache_aligned_free)
+	&& (aligned_idx = tcache_aligned_slot (p, size)) >= 0)
+      {
+	tcache_aligned_put (p, aligned_idx);
+	return;
+      }
+
     if (tcache
 	&& tc_idx < mp_.tcache_bins
 	&& tcache->counts[tc_idx] < mp_.tcache_count)
@@ -4159,9 +4877,40 @@ _int_free (mstate av, mchunkptr p, int have_lock)
 	tcache_put (p, tc_idx);
 	return;
       }
+
+    /* The bin is full.  Rather than taking the arena lock for this
+       chunk alone, hand a batch of the coldest cached chunks back to
+       the arena and cache this one instead.  Callers which already
+       hold an arena lock must not lock another one here.  */
+    if (tcache
+	&& tc_idx < mp_.tcache_bins
+	&& mp_.tcache_count > 0
+	&& mp_.tcache_batch > 1
+	&& !have_lock)
+      {
+	tcache_flush (tc_idx, mp_.tcache_batch);
+	tcache_put (p, tc_idx);
+	return;
+      }
   }
 #endif
 
+  _int_free_chunk (av, p, size, have_lock);
+}
+
+/* Free chunk P of SIZE bytes into arena AV, bypassing the tcache.  The
+   chunk must already have passed the sanity checks in _int_free.  */
+static void
+_int_free_chunk (mstate av, mchunkptr p, INTERNAL_SIZE_T size, int have_lock)
+{
+  mfastbinptr *fb;             /* associated fastbin */
+  mchunkptr nextchunk;         /* next contiguous chunk */
+  INTERNAL_SIZE_T nextsize;    /* its size */
+  int nextinuse;               /* true if nextchunk is used */
+  INTERNAL_SIZE_T prevsize;    /* size of previous contiguous chunk */
+  mchunkptr bck;               /* misc temp for linking */
+  mchunkptr fwd;               /* misc temp for linking */
+
   /*
     If eligible, place chunk on a fastbin so it can be found
     and used quickly in malloc.
@@ -4248,8 +4997,16 @@ _int_free (mstate av, mchunkptr p, int have_lock)
     if (SINGLE_THREAD_P)
       have_lock = true;
 
+    /* A chunk which belongs to another thread's arena is queued for
+       that arena instead of contending for its lock.  */
+    if (!have_lock && mp_.remote_free && arena_is_remote (av))
+      {
+	remote_frees_push (av, p);
+	return;
+      }
+
     if (!have_lock)
-      __libc_lock_lock (av->mutex);
+      lock_arena (av);
 
     nextchunk = chunk_at_offset(p, size);
 
@@ -4359,10 +5116,13 @@ _int_free (mstate av, mchunkptr p, int have_lock)
 	heap_info *heap = heap_for_ptr(top(av));
 
 	assert(heap->ar_ptr == av);
-	heap_trim(heap, mp_.top_pad);
+	heap_trim(heap, mp_.top_pad, mp_.trim_threshold);
       }
     }
 
+    if (__glibc_unlikely (mp_.decay_ms != 0))
+      malloc_decay (av);
+
     if (!have_lock)
       __libc_lock_unlock (av->mutex);
   }
@@ -4375,6 +5135,67 @@ _int_free (mstate av, mchunkptr p, int have_lock)
   }
 }
 
+/*
+  ------------------------- remote frees -------------------------
+
+  A thread freeing a chunk which belongs to an arena other than its
+  own would normally have to take that arena's lock, which is held by
+  the allocating threads most of the time in producer/consumer
+  workloads.  With glibc.malloc.remote_free, such chunks are instead
+  pushed onto a lock-free list in the arena.  The list is taken as a
+  whole by the next thread which locks the arena to allocate from it
+  (or to trim it or report statistics), by arena_get, and when the
+  last thread detaches from the arena, and its chunks are then freed
+  as usual.  Only the owner of the lock ever removes entries, so the
+  push side cannot suffer from ABA problems.
+
+  Queued chunks are marked with the address of the list in their bk
+  field, like tcache entries with their key.  A chunk which carries the
+  mark is either queued already or holds that value by chance, so the
+  list is searched for it under the arena lock, which keeps the list
+  from being drained meanwhile.
+*/
+
+static void
+remote_frees_push (mstate av, mchunkptr p)
+{
+  mchunkptr key = (mchunkptr) &av->remote_frees;
+
+  if (__glibc_unlikely (p->bk == key))
+    {
+      __libc_lock_lock (av->mutex);
+      for (mchunkptr q = atomic_load_acquire (&av->remote_frees); q != NULL;
+	   q = q->fd)
+	if (q == p)
+	  malloc_printerr ("double free or corruption (remote)");
+      __libc_lock_unlock (av->mutex);
+    }
+  p->bk = key;
+
+  mchunkptr old = atomic_load_relaxed (&av->remote_frees);
+  do
+    p->fd = old;
+  while (!atomic_compare_exchange_weak_release (&av->remote_frees, &old, p));
+}
+
+/* Free all chunks queued on the remote-free list of AV.  The caller
+   must hold the lock of AV.  */
+static void
+remote_frees_drain (mstate av)
+{
+  if (atomic_load_relaxed (&av->remote_frees) == NULL)
+    return;
+
+  mchunkptr p = atomic_exchange_acquire (&av->remote_frees, NULL);
+  while (p != NULL)
+    {
+      mchunkptr next = p->fd;
+      p->bk = NULL;
+      _int_free_chunk (av, p, chunksize (p), 1);
+      p = next;
+    }
+}
+
 /*
   ------------------------- malloc_consolidate -------------------------
 
@@ -4535,6 +5356,7 @@ _int_realloc(mstate av, mchunkptr oldp, INTERNAL_SIZE_T oldsize,
         {
           set_head_size (oldp, nb | (av != &main_arena ? NON_MAIN_ARENA : 0));
           av->top = chunk_at_offset (oldp, nb);
+          top_split (av);
           set_head (av->top, (newsize - nb) | PREV_INUSE);
           check_inuse_chunk (av, oldp);
           return chunk2mem (oldp);
@@ -4750,6 +5572,7 @@ static int
 mtrim (mstate av, size_t pad)
 {
   /* Ensure all blocks are consolidated.  */
+  remote_frees_drain (av);
   malloc_consolidate (av);
 
   const size_t ps = GLRO (dl_pagesize);
@@ -4786,7 +5609,7 @@ mtrim (mstate av, size_t pad)
                        content.  */
                     memset (paligned_mem, 0x89, size & ~psm1);
 #endif
-                    __madvise (paligned_mem, size & ~psm1, MADV_DONTNEED);
+                    malloc_release_pages (paligned_mem, size & ~psm1);
 
                     result = 1;
                   }
@@ -4822,6 +5645,8 @@ __malloc_trim (size_t s)
     }
   while (ar_ptr != &main_arena);
 
+  result |= mmap_cache_flush ();
+
   return result;
 }
 
@@ -4880,6 +5705,7 @@ int_mallinfo (mstate av, struct mallinfo *m)
   int nblocks;
   int nfastblocks;
 
+  remote_frees_drain (av);
   check_malloc_state (av);
 
   /* Account for top */
@@ -5086,6 +5912,101 @@ do_set_arena_max (size_t value)
   return 1;
 }
 
+static inline int
+__always_inline
+do_set_percpu (int32_t value)
+{
+  LIBC_PROBE (memory_tunable_percpu, 2, value, mp_.percpu);
+  mp_.percpu = value != 0;
+  return 1;
+}
+
+static inline int
+__always_inline
+do_set_remote_free (int32_t value)
+{
+  LIBC_PROBE (memory_tunable_remote_free, 2, value, mp_.remote_free);
+  mp_.remote_free = value != 0;
+  return 1;
+}
+
+static inline int
+__always_inline
+do_set_numa (int32_t value)
+{
+  LIBC_PROBE (memory_tunable_numa, 2, value, mp_.numa);
+  mp_.numa = value != 0;
+  return 1;
+}
+
+static inline int
+__always_inline
+do_set_madv_free (int32_t value)
+{
+  LIBC_PROBE (memory_tunable_madv_free, 2, value, mp_.madv_free);
+  mp_.madv_free = value != 0;
+  return 1;
+}
+
+static inline int
+__always_inline
+do_set_decay_ms (size_t value)
+{
+  LIBC_PROBE (memory_tunable_decay_ms, 2, value, mp_.decay_ms);
+  mp_.decay_ms = value;
+  return 1;
+}
+
+static inline int
+__always_inline
+do_set_mmap_cache_max (size_t value)
+{
+  LIBC_PROBE (memory_tunable_mmap_cache_max, 2, value, mp_.mmap_cache_max);
+  mp_.mmap_cache_max = value;
+  return 1;
+}
+
+static inline int
+__always_inline
+do_set_profile_interval (size_t value)
+{
+  LIBC_PROBE (memory_tunable_profile_interval, 2, value,
+	      mp_.profile_interval);
+  mp_.profile_interval = value;
+  return 1;
+}
+
+static inline int
+__always_inline
+do_set_profile_signal (int32_t value)
+{
+  LIBC_PROBE (memory_tunable_profile_signal, 2, value, mp_.profile_signal);
+  mp_.profile_signal = value;
+  return 1;
+}
+
+static inline int
+__always_inline
+do_set_stats (int32_t value)
+{
+  LIBC_PROBE (memory_tunable_stats, 2, value, mp_.stats);
+  mp_.stats = value;
+  return 1;
+}
+
+static inline int
+__always_inline
+do_set_hugetlb (int32_t value)
+{
+  LIBC_PROBE (memory_tunable_hugetlb, 2, value,
+	      mp_.thp_pagesize != 0 ? 1 : mp_.hp_pagesize != 0 ? 2 : 0);
+  if (value == 1)
+    mp_.thp_pagesize = malloc_thp_pagesize ();
+  else if (value == 2)
+    malloc_hugepage_config (&mp_.hp_pagesize, &mp_.hp_flags);
+  return 1;
+}
+
 #if USE_TCACHE
 static inline int
 __always_inline
@@ -5117,6 +6038,25 @@ do_set_tcache_unsorted_limit (size_t value)
   mp_.tcache_unsorted_limit = value;
   return 1;
 }
+
+static inline int
+__always_inline
+do_set_tcache_batch (size_t value)
+{
+  LIBC_PROBE (memory_tunable_tcache_batch, 2, value, mp_.tcache_batch);
+  mp_.tcache_batch = value;
+  return 1;
+}
+
+static inline int
+__always_inline
+do_set_tcache_aligned_free (int32_t value)
+{
+  LIBC_PROBE (memory_tunable_tcache_aligned_free, 2, value,
+	      mp_.tcache_aligned_free);
+  mp_.tcache_aligned_free = value != 0;
+  return 1;
+}
 #endif
 
 int
@@ -5409,6 +6349,7 @@ __malloc_info (int options, FILE *fp)
 #define nsizes (sizeof (sizes) / sizeof (sizes[0]))
 
       __libc_lock_lock (ar_ptr->mutex);
+      remote_frees_drain (ar_ptr);
 
       for (size_t i = 0; i < NFASTBINS; ++i)
 	{
@@ -5559,9 +6500,74 @@ __malloc_info (int options, FILE *fp)
 }
 weak_alias (__malloc_info, malloc_info)
 
+int
+__malloc_profile (int options, FILE *fp)
+{
+  /* For now, at least.  */
+  if (options != 0)
+    {
+      __set_errno (EINVAL);
+      return -1;
+    }
+
+  if (__malloc_initialized < 0)
+    ptmalloc_init ();
+
+  struct profile_writer w = { .fp = fp, .fd = -1 };
+  return profile_dump (&w, false);
+}
+weak_alias (__malloc_profile, malloc_profile)
+
+int
+__malloc_get_stats (int options, struct malloc_size_class_stats *classes,
+		    size_t *nclasses, struct malloc_arena_stats *arenas,
+		    size_t *narenas)
+{
+  /* For now, at least.  */
+  if (options != 0)
+    {
+      __set_errno (EINVAL);
+      return -1;
+    }
+
+  if (__malloc_initialized < 0)
+    ptmalloc_init ();
+
+  if (!mp_.stats)
+    {
+      __set_errno (ENOTSUP);
+      return -1;
+    }
+
+  __libc_lock_lock (stats_lock);
+
+  size_t n = stats_nclasses ();
+  for (size_t i = 0; i < n && i < *nclasses; ++i)
+    stats_get_class (i, &classes[i]);
+  *nclasses = n;
+
+  n = 0;
+  mstate ar_ptr = &main_arena;
+  do
+    {
+      if (n < *narenas)
+	stats_get_arena (ar_ptr, &arenas[n]);
+      ++n;
+      ar_ptr = ar_ptr->next;
+    }
+  while (ar_ptr != &main_arena);
+  *narenas = n;
+
+  __libc_lock_unlock (stats_lock);
+  return 0;
+}
+weak_alias (__malloc_get_stats, malloc_get_stats)
+
 
 strong_alias (__libc_calloc, __calloc) weak_alias (__libc_calloc, calloc)
 strong_alias (__libc_free, __free) strong_alias (__libc_free, free)
+weak_alias (__libc_free_sized, free_sized)
+weak_alias (__libc_free_aligned_sized, free_aligned_sized)
 strong_alias (__libc_malloc, __malloc) strong_alias (__libc_malloc, malloc)
 strong_alias (__libc_memalign, __memalign)
 weak_alias (__libc_memalign, memalign)
@@ -60,6 +60,15 @@ __THROW __attribute_warn_unused_result__;
 /* Free a block allocated by `malloc', `realloc' or `calloc'.  */
 extern void free (void *__ptr) __THROW;
 
+/* Free a block of SIZE bytes allocated by `malloc', `realloc' or
+   `calloc'.  SIZE must be the size that was requested.  */
+extern void free_sized (void *__ptr, size_t __size) __THROW;
+
+/* Free a block of SIZE bytes allocated by `aligned_alloc' with an
+   alignment of ALIGNMENT bytes.  */
+extern void free_aligned_sized (void *__ptr, size_t __alignment,
+				size_t __size) __THROW;
+
 /* Allocate SIZE bytes allocated to ALIGNMENT bytes.  */
 extern void *memalign (size_t __alignment, size_t __size)
 __THROW __attribute_malloc__ __wur;
@@ -139,6 +148,45 @@ extern void malloc_stats (void) __THROW;
 /* Output information about state of allocator to stream FP.  */
 extern int malloc_info (int __options, FILE *__fp) __THROW;
 
+/* Write the heap profile collected by sampling allocations to stream
+   FP, if enabled with the glibc.malloc.profile_interval tunable.  */
+extern int malloc_profile (int __options, FILE *__fp) __THROW;
+
+/* Allocation statistics of a size class.  */
+struct malloc_size_class_stats
+{
+  size_t size;            /* largest usable size in the class */
+  size_t allocs;          /* number of allocations */
+  size_t frees;           /* number of deallocations */
+  size_t bytes_in_use;    /* chunk bytes allocated and not freed */
+  size_t tcache_hits;     /* allocations served by the thread cache */
+  size_t tcache_misses;   /* allocations not found in the thread cache */
+  size_t mmaps;           /* allocations of mmapped chunks */
+  size_t munmaps;         /* deallocations of mmapped chunks */
+  size_t mmap_cache_hits; /* mmapped chunks reused from the mmap cache */
+};
+
+/* Allocation statistics of an arena.  */
+struct malloc_arena_stats
+{
+  size_t allocs;           /* number of allocations */
+  size_t frees;            /* number of deallocations */
+  size_t bytes_in_use;     /* chunk bytes allocated and not freed */
+  size_t tcache_hits;      /* allocations served by the thread cache */
+  size_t tcache_misses;    /* allocations not found in the thread cache */
+  size_t lock_contentions; /* lock acquisitions which had to wait */
+};
+
+/* Store the statistics of up to *NCLASSES size classes in CLASSES and
+   of up to *NARENAS arenas in ARENAS, and set *NCLASSES and *NARENAS
+   to the number of size classes and arenas.  Requires the
+   glibc.malloc.stats tunable.  Does not acquire any arena lock.  */
+extern int malloc_get_stats (int __options,
+			     struct malloc_size_class_stats *__classes,
+			     size_t *__nclasses,
+			     struct malloc_arena_stats *__arenas,
+			     size_t *__narenas) __THROW;
+
 /* Hooks for debugging and user-defined versions. */
 extern void (*__MALLOC_HOOK_VOLATILE __free_hook) (void *__ptr,
                                                    const void *)
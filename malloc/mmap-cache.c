@@ -0,0 +1,215 @@
+/* Cache of unmapped large chunks.
+   Copyright (C) 2018 Free Software Foundation, Inc.
+   This file is part of the GNU C Library.
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public License as
+   published by the Free Software Foundation; either version 2.1 of the
+   License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; see the file COPYING.LIB.  If
+   not, see <http://www.gnu.org/licenses/>.  */
+
+/* If glibc.malloc.mmap_cache_max is set, munmap_chunk keeps the
+   mappings of freed mmapped chunks, up to that many bytes in total,
+   and sysmalloc_mmap reuses them for later requests instead of
+   creating a new mapping.  This avoids the mmap and munmap calls and
+   the page faults on the fresh pages when large buffers are allocated
+   and freed repeatedly.
+
+   The bookkeeping for a cached mapping is stored at its start.
+   Mappings are kept in buckets by the logarithm of their size, and in
+   a list ordered by the time they were cached.  A request is served
+   from the smallest mapping in its bucket or the next one which is
+   large enough; if that mapping is much larger than needed, its tail
+   is unmapped.  When the cache exceeds its limit, the mappings cached
+   the longest time ago are unmapped.  If glibc.malloc.decay_ms is set,
+   mappings which stay in the cache for longer than that are unmapped
+   as well.  The munmap calls are made after dropping mmap_cache_lock,
+   which is defined in arena.c.  */
+
+#define MMAP_CACHE_BUCKETS (8 * sizeof (size_t))
+
+struct mmap_cache_entry
+{
+  /* Links in the bucket.  */
+  struct mmap_cache_entry *next;
+  struct mmap_cache_entry *prev;
+  /* Links in the age list.  */
+  struct mmap_cache_entry *newer;
+  struct mmap_cache_entry *older;
+  size_t size;
+  /* Time at which the mapping was cached, in milliseconds.  */
+  uint64_t time;
+};
+
+static struct
+{
+  struct mmap_cache_entry *buckets[MMAP_CACHE_BUCKETS];
+  struct mmap_cache_entry *newest;
+  struct mmap_cache_entry *oldest;
+  /* Total size of the cached mappings.  */
+  size_t bytes;
+} mmap_cache;
+
+/* Set by sysmalloc_mmap if the mapping it returned was reused, so that
+   calloc clears it and malloc_get_stats counts it.  */
+static __thread bool mmap_cache_reused;
+
+static inline size_t
+mmap_cache_bucket (size_t size)
+{
+  return 8 * sizeof (size_t) - 1 - __builtin_clzl (size);
+}
+
+static void
+mmap_cache_unlink (struct mmap_cache_entry *e)
+{
+  if (e->prev != NULL)
+    e->prev->next = e->next;
+  else
+    mmap_cache.buckets[mmap_cache_bucket (e->size)] = e->next;
+  if (e->next != NULL)
+    e->next->prev = e->prev;
+
+  if (e->newer != NULL)
+    e->newer->older = e->older;
+  else
+    mmap_cache.newest = e->older;
+  if (e->older != NULL)
+    e->older->newer = e->newer;
+  else
+    mmap_cache.oldest = e->newer;
+
+  mmap_cache.bytes -= e->size;
+}
+
+/* Remove the oldest mappings until the cache holds at most LIMIT
+   bytes, and those which have aged out at time NOW.  Returns the
+   removed mappings, linked through their next fields.  Called with
+   mmap_cache_lock held.  */
+static struct mmap_cache_entry *
+mmap_cache_expire (size_t limit, uint64_t now)
+{
+  struct mmap_cache_entry *expired = NULL;
+
+  while (mmap_cache.oldest != NULL)
+    {
+      struct mmap_cache_entry *e = mmap_cache.oldest;
+      if (mmap_cache.bytes <= limit
+	  && (mp_.decay_ms == 0 || now - e->time < mp_.decay_ms))
+	break;
+      mmap_cache_unlink (e);
+      e->next = expired;
+      expired = e;
+    }
+  return expired;
+}
+
+static void
+mmap_cache_release (struct mmap_cache_entry *e)
+{
+  while (e != NULL)
+    {
+      struct mmap_cache_entry *next = e->next;
+      __munmap (e, e->size);
+      e = next;
+    }
+}
+
+static uint64_t
+mmap_cache_now (void)
+{
+  return mp_.decay_ms != 0 ? malloc_clock_ms () : 0;
+}
+
+/* Return a cached mapping of at least SIZE bytes and store its size
+   in *MAPPED, or return NULL.  */
+static void *
+mmap_cache_get (size_t size, size_t *mapped)
+{
+  uint64_t now = mmap_cache_now ();
+  struct mmap_cache_entry *best = NULL;
+
+  __libc_lock_lock (mmap_cache_lock);
+  size_t b = mmap_cache_bucket (size);
+  for (size_t i = b; i < b + 2 && i < MMAP_CACHE_BUCKETS && best == NULL; ++i)
+    for (struct mmap_cache_entry *e = mmap_cache.buckets[i]; e != NULL;
+	 e = e->next)
+      if (e->size >= size && (best == NULL || e->size < best->size))
+	best = e;
+  if (best != NULL)
+    mmap_cache_unlink (best);
+  struct mmap_cache_entry *expired
+    = mmap_cache_expire (mp_.mmap_cache_max, now);
+  __libc_lock_unlock (mmap_cache_lock);
+
+  mmap_cache_release (expired);
+  if (best == NULL)
+    return NULL;
+
+  /* Do not waste more than an eighth of the request on a larger
+     mapping.  */
+  *mapped = best->size;
+  if (best->size - size > size / 8)
+    {
+      __munmap ((char *) best + size, best->size - size);
+      *mapped = size;
+    }
+  return best;
+}
+
+/* Cache the mapping of SIZE bytes at BLOCK.  Returns false if it has to
+   be unmapped instead.  */
+static bool
+mmap_cache_put (void *block, size_t size)
+{
+  /* Mappings of huge pages can only be split at huge page
+     boundaries.  */
+  if (size > mp_.mmap_cache_max || mp_.hp_pagesize != 0)
+    return false;
+
+  struct mmap_cache_entry *e = block;
+  e->size = size;
+  e->time = mmap_cache_now ();
+
+  __libc_lock_lock (mmap_cache_lock);
+  size_t b = mmap_cache_bucket (size);
+  e->prev = NULL;
+  e->next = mmap_cache.buckets[b];
+  if (e->next != NULL)
+    e->next->prev = e;
+  mmap_cache.buckets[b] = e;
+  e->newer = NULL;
+  e->older = mmap_cache.newest;
+  if (e->older != NULL)
+    e->older->newer = e;
+  else
+    mmap_cache.oldest = e;
+  mmap_cache.newest = e;
+  mmap_cache.bytes += size;
+  struct mmap_cache_entry *expired
+    = mmap_cache_expire (mp_.mmap_cache_max, e->time);
+  __libc_lock_unlock (mmap_cache_lock);
+
+  mmap_cache_release (expired);
+  return true;
+}
+
+/* Unmap all cached mappings.  Returns 1 if there were any.  */
+static int
+mmap_cache_flush (void)
+{
+  __libc_lock_lock (mmap_cache_lock);
+  struct mmap_cache_entry *expired = mmap_cache_expire (0, 0);
+  __libc_lock_unlock (mmap_cache_lock);
+
+  mmap_cache_release (expired);
+  return expired != NULL;
+}
@@ -0,0 +1,562 @@
+/* Sampling heap profiler.
+   Copyright (C) 2018 Free Software Foundation, Inc.
+   This file is part of the GNU C Library.
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public License as
+   published by the Free Software Foundation; either version 2.1 of the
+   License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; see the file COPYING.LIB.  If
+   not, see <http://www.gnu.org/licenses/>.  */
+
+/* If glibc.malloc.profile_interval is set, one allocation is sampled
+   for every profile_interval bytes allocated on average.  The distance
+   in bytes between two samples is drawn from an exponential
+   distribution, so that samples form a Poisson process over the
+   allocated bytes and every byte is equally likely to be sampled,
+   independently of the allocation pattern.  Each thread counts down
+   the bytes to its next sample in profile_countdown, which is the only
+   work done on allocations that are not sampled.  If profiling is
+   disabled, allocations only check profile.filter.
+
+   For a sampled allocation, the stack is captured with __backtrace and
+   looked up in a table of buckets, which accumulate the number and
+   size of samples taken on that stack (the cumulative profile) and of
+   those not yet freed (the live profile).  Live samples are kept in a
+   hash table keyed by address.  free checks a byte array indexed by
+   the hash of the address first, which tells without a lock whether
+   the pointer may have been sampled.  Samples are rare, so all other
+   accesses are serialized by profile_lock.
+
+   The profile is written in the legacy text format of gperftools heap
+   profiles, which pprof reads and scales by the sampling interval to
+   estimate the totals.  Memory for the profiler itself is obtained
+   with mmap, so that the profiler never calls back into malloc while
+   it holds profile_lock.  profile_lock is acquired before list_lock
+   and the arena locks.  */
+
+#include <array_length.h>
+#include <execinfo.h>
+#include <limits.h>
+#include <profile-writer.h>
+#include <signal.h>
+
+#ifndef SHARED
+/* Do not pull the unwinder into every static program which calls
+   malloc.  */
+weak_extern (__backtrace)
+#endif
+
+/* Maximum number of frames recorded per sample.  */
+#define PROFILE_MAX_FRAMES 32
+
+/* Number of slots in the live sample filter, and number of hash chains
+   for live samples and buckets.  All are powers of two.  */
+#define PROFILE_FILTER_BITS 16
+#define PROFILE_HASH_BITS 12
+
+/* Size of the blocks from which samples and buckets are allocated.  */
+#define PROFILE_BLOCK_SIZE (64 * 1024)
+
+/* Allocations sampled on the same stack.  */
+struct profile_bucket
+{
+  struct profile_bucket *next;
+  size_t hash;
+  size_t alloc_count;
+  size_t alloc_bytes;
+  size_t live_count;
+  size_t live_bytes;
+  int depth;
+  void *frames[];
+};
+
+/* A sampled allocation which has not been freed yet.  */
+struct profile_sample
+{
+  struct profile_sample *next;
+  void *mem;
+  size_t bytes;
+  struct profile_bucket *bucket;
+};
+
+static struct
+{
+  /* Number of live samples whose address hashes to each slot.  Read
+     without holding profile_lock.  NULL if profiling is disabled.  */
+  unsigned char *filter;
+  struct profile_sample **samples;
+  struct profile_bucket **buckets;
+  size_t nbuckets;
+  struct profile_sample *free_samples;
+  char *block;
+  size_t block_left;
+  /* Number of profiles written on a signal.  */
+  unsigned int dumps;
+  /* The action for the profile signal before profile_init.  */
+  struct sigaction old_action;
+} profile;
+
+__libc_lock_define_initialized (static, profile_lock);
+
+/* Bytes left until the next sample on this thread.  */
+static __thread size_t profile_countdown;
+/* State of the random number generator drawing the sampling
+   intervals.  */
+static __thread uint64_t profile_rng;
+/* True while this thread takes a sample, so that the allocations made
+   by the unwinder are not sampled themselves.  */
+static __thread bool profile_busy;
+
+static size_t
+profile_hash_ptr (const void *mem)
+{
+  return ((uintptr_t) mem >> 4) * (size_t) 0x9e3779b97f4a7c15ULL;
+}
+
+/* Return the slot of MEM in the live sample filter.  */
+static __always_inline size_t
+profile_filter_slot (void *mem)
+{
+  return (profile_hash_ptr (mem)
+	  >> (8 * sizeof (size_t) - PROFILE_FILTER_BITS));
+}
+
+/* Return a random distance in bytes to the next sample, drawn from an
+   exponential distribution with mean mp_.profile_interval.  */
+static size_t
+profile_next_interval (void)
+{
+  /* The 48-bit linear congruential generator of drand48.  */
+  profile_rng = (profile_rng * 0x5deece66dULL + 0xb) & ((1ULL << 48) - 1);
+  /* Take a uniform number Q in [1, 2^26] and return
+     -log (Q / 2^26) * interval, that is
+     (26 - log2 (Q)) * log (2) * interval.  The fractional part of
+     log2 (Q) is approximated with a quadratic polynomial, which is
+     accurate to about 0.001.  */
+  uint64_t q = (profile_rng >> (48 - 26)) + 1;
+  int e = 63 - __builtin_clzll (q);
+  double x = (double) q / (double) (1ULL << e) - 1.0;
+  double log2q = e + x + 0.33971 * x * (1.0 - x);
+  return (26.0 - log2q) * 0.693147180559945 * mp_.profile_interval + 1;
+}
+
+/* Charge an allocation of BYTES bytes to the current thread and return
+   true if it has to be sampled.  */
+static bool profile_sample_slow (size_t bytes);
+
+static __always_inline bool
+profile_sample_due (size_t bytes)
+{
+  if (__glibc_unlikely (profile.filter != NULL))
+    {
+      if (__glibc_likely (bytes < profile_countdown))
+	{
+	  profile_countdown -= bytes;
+	  return false;
+	}
+      return profile_sample_slow (bytes);
+    }
+  return false;
+}
+
+static bool
+profile_sample_slow (size_t bytes)
+{
+  if (profile_busy)
+    return false;
+
+  if (profile_rng == 0)
+    {
+      /* First allocation on this thread.  */
+      struct timespec ts;
+      __clock_gettime (CLOCK_MONOTONIC, &ts);
+      profile_rng = ((uintptr_t) &profile_rng ^ ts.tv_nsec) | 1;
+      profile_countdown = profile_next_interval ();
+      if (bytes < profile_countdown)
+	{
+	  profile_countdown -= bytes;
+	  return false;
+	}
+    }
+
+  profile_countdown = profile_next_interval ();
+  return true;
+}
+
+/* Allocate SIZE bytes of memory for the profiler itself.  Called with
+   profile_lock held.  */
+static void *
+profile_alloc (size_t size)
+{
+  size = ALIGN_UP (size, sizeof (void *));
+  if (size > profile.block_left)
+    {
+      char *block = (char *) MMAP (0, PROFILE_BLOCK_SIZE,
+				   PROT_READ | PROT_WRITE, 0);
+      if (block == MAP_FAILED)
+	return NULL;
+      profile.block = block;
+      profile.block_left = PROFILE_BLOCK_SIZE;
+    }
+  void *result = profile.block;
+  profile.block += size;
+  profile.block_left -= size;
+  return result;
+}
+
+/* Return the bucket for the DEPTH frames at FRAMES, creating it if
+   necessary.  Called with profile_lock held.  */
+static struct profile_bucket *
+profile_bucket_get (void **frames, int depth)
+{
+  size_t hash = depth;
+  for (int i = 0; i < depth; ++i)
+    hash = (hash ^ (uintptr_t) frames[i]) * (size_t) 0x100000001b3ULL;
+
+  struct profile_bucket **head
+    = &profile.buckets[profile_hash_ptr ((void *) hash)
+		       >> (8 * sizeof (size_t) - PROFILE_HASH_BITS)];
+  for (struct profile_bucket *b = *head; b != NULL; b = b->next)
+    if (b->hash == hash && b->depth == depth
+	&& memcmp (b->frames, frames, depth * sizeof (void *)) == 0)
+      return b;
+
+  struct profile_bucket *b
+    = profile_alloc (sizeof (*b) + depth * sizeof (void *));
+  if (b == NULL)
+    return NULL;
+  b->hash = hash;
+  b->depth = depth;
+  memcpy (b->frames, frames, depth * sizeof (void *));
+  b->next = *head;
+  *head = b;
+  ++profile.nbuckets;
+  return b;
+}
+
+/* Record the allocation of BYTES bytes at MEM, which was requested
+   from the function returning to CALLER.  */
+static void
+profile_record (void *mem, size_t bytes, const void *caller)
+{
+  void *frames[PROFILE_MAX_FRAMES + 8];
+  int n = 0;
+#ifndef SHARED
+  if (__backtrace != NULL)
+#endif
+    n = __backtrace (frames, array_length (frames));
+  /* __backtrace fails if the unwinder cannot be loaded.  */
+  if (n <= 0)
+    {
+      frames[0] = (void *) caller;
+      n = 1;
+    }
+
+  /* Drop the frames of malloc itself.  */
+  int start = 0;
+  for (int i = 0; i < n; ++i)
+    if (frames[i] == caller)
+      {
+	start = i;
+	break;
+      }
+  int depth = MIN (n - start, PROFILE_MAX_FRAMES);
+
+  size_t hash = profile_hash_ptr (mem);
+  size_t slot = profile_filter_slot (mem);
+
+  __libc_lock_lock (profile_lock);
+  struct profile_bucket *b = profile_bucket_get (frames + start, depth);
+  struct profile_sample *s = profile.free_samples;
+  if (s != NULL)
+    profile.free_samples = s->next;
+  else
+    s = profile_alloc (sizeof (*s));
+  if (b != NULL && s != NULL)
+    {
+      ++b->alloc_count;
+      b->alloc_bytes += bytes;
+      ++b->live_count;
+      b->live_bytes += bytes;
+
+      s->mem = mem;
+      s->bytes = bytes;
+      s->bucket = b;
+      struct profile_sample **head
+	= &profile.samples[hash >> (8 * sizeof (size_t) - PROFILE_HASH_BITS)];
+      s->next = *head;
+      *head = s;
+      /* A saturated slot stays set, which only costs a lock
+	 acquisition on free.  */
+      if (profile.filter[slot] != UCHAR_MAX)
+	atomic_store_relaxed (&profile.filter[slot],
+			      profile.filter[slot] + 1);
+    }
+  else if (s != NULL)
+    {
+      s->next = profile.free_samples;
+      profile.free_samples = s;
+    }
+  __libc_lock_unlock (profile_lock);
+}
+
+/* Return false if MEM has certainly not been sampled.  */
+static __always_inline bool
+profile_may_be_sampled (void *mem)
+{
+  unsigned char *filter = profile.filter;
+  if (__glibc_likely (filter == NULL))
+    return false;
+  return atomic_load_relaxed (&filter[profile_filter_slot (mem)]) != 0;
+}
+
+/* Remove MEM from the live samples if it has been sampled.  Return
+   true if it was.  */
+static bool profile_forget_slow (void *mem);
+
+static __always_inline bool
+profile_forget (void *mem)
+{
+  if (__glibc_likely (!profile_may_be_sampled (mem)))
+    return false;
+  return profile_forget_slow (mem);
+}
+
+static bool
+profile_forget_slow (void *mem)
+{
+  size_t hash = profile_hash_ptr (mem);
+  size_t slot = profile_filter_slot (mem);
+  bool found = false;
+
+  __libc_lock_lock (profile_lock);
+  struct profile_sample **prev
+    = &profile.samples[hash >> (8 * sizeof (size_t) - PROFILE_HASH_BITS)];
+  for (struct profile_sample *s = *prev; s != NULL; s = s->next)
+    {
+      if (s->mem == mem)
+	{
+	  *prev = s->next;
+	  --s->bucket->live_count;
+	  s->bucket->live_bytes -= s->bytes;
+	  s->next = profile.free_samples;
+	  profile.free_samples = s;
+	  if (profile.filter[slot] != UCHAR_MAX)
+	    atomic_store_relaxed (&profile.filter[slot],
+				  profile.filter[slot] - 1);
+	  found = true;
+	  break;
+	}
+      prev = &s->next;
+    }
+  __libc_lock_unlock (profile_lock);
+  return found;
+}
+
+/* The sampled versions of the allocation functions.  CALLER is the
+   return address of the public entry point, which is where the
+   recorded stack starts.  */
+
+static void * __attribute_noinline__
+profile_malloc (size_t bytes, const void *caller)
+{
+  profile_busy = true;
+  void *mem = __libc_malloc (bytes);
+  if (mem != NULL)
+    profile_record (mem, bytes, caller);
+  profile_busy = false;
+  return mem;
+}
+
+static void * __attribute_noinline__
+profile_calloc (size_t n, size_t elem_size, const void *caller)
+{
+  profile_busy = true;
+  void *mem = __libc_calloc (n, elem_size);
+  if (mem != NULL)
+    profile_record (mem, n * elem_size, caller);
+  profile_busy = false;
+  return mem;
+}
+
+/* OLDMEM may have been sampled, or DUE is true if the new block has
+   to be sampled.  A sampled block is sampled again at its new
+   location, so that the live profile does not lose it.  The old
+   sample is only removed once the block has moved, as it stays live
+   if realloc fails.  */
+static void * __attribute_noinline__
+profile_realloc (void *oldmem, size_t bytes, bool due, const void *caller)
+{
+  profile_busy = true;
+  void *mem = __libc_realloc (oldmem, bytes);
+  if (mem != NULL && ((oldmem != NULL && profile_forget (oldmem)) | due))
+    profile_record (mem, bytes, caller);
+  profile_busy = false;
+  return mem;
+}
+
+static void * __attribute_noinline__
+profile_memalign (size_t alignment, size_t bytes, void *caller)
+{
+  profile_busy = true;
+  void *mem = _mid_memalign (alignment, bytes, caller);
+  if (mem != NULL)
+    profile_record (mem, bytes, caller);
+  profile_busy = false;
+  return mem;
+}
+
+/* Write the counts of a profile line.  */
+static void
+profile_put_counts (struct profile_writer *w, size_t live_count,
+		    size_t live_bytes, size_t alloc_count, size_t alloc_bytes)
+{
+  profile_writer_putnum (w, live_count, 10, 6);
+  profile_writer_puts (w, ": ");
+  profile_writer_putnum (w, live_bytes, 10, 8);
+  profile_writer_puts (w, " [");
+  profile_writer_putnum (w, alloc_count, 10, 6);
+  profile_writer_puts (w, ": ");
+  profile_writer_putnum (w, alloc_bytes, 10, 8);
+  profile_writer_puts (w, "] @");
+}
+
+/* Write the profile to W.  If TRY is true, give up if profile_lock is
+   not available immediately.  Return 0 on success and -1 on
+   failure.  */
+static int
+profile_dump (struct profile_writer *w, bool try)
+{
+  struct profile_bucket *snapshot = NULL;
+  size_t count = 0;
+  size_t size = 0;
+
+  /* Copy the counters, so that the output is written without holding
+     profile_lock.  Writing to the stream may call malloc and free.
+     The frames of a bucket never change.  */
+  if (try)
+    {
+      if (__libc_lock_trylock (profile_lock) != 0)
+	return -1;
+    }
+  else
+    __libc_lock_lock (profile_lock);
+  if (profile.nbuckets > 0)
+    {
+      size = ALIGN_UP (profile.nbuckets * sizeof (*snapshot),
+		       GLRO (dl_pagesize));
+      snapshot = (struct profile_bucket *) MMAP (0, size,
+						 PROT_READ | PROT_WRITE, 0);
+      if (snapshot == MAP_FAILED)
+	{
+	  __libc_lock_unlock (profile_lock);
+	  return -1;
+	}
+      for (size_t i = 0; i < (1 << PROFILE_HASH_BITS); ++i)
+	for (struct profile_bucket *b = profile.buckets[i]; b != NULL;
+	     b = b->next)
+	  {
+	    snapshot[count] = *b;
+	    /* Point to the original bucket for the frames.  */
+	    snapshot[count].next = b;
+	    ++count;
+	  }
+    }
+  __libc_lock_unlock (profile_lock);
+
+  size_t live_count = 0, live_bytes = 0, alloc_count = 0, alloc_bytes = 0;
+  for (size_t i = 0; i < count; ++i)
+    {
+      live_count += snapshot[i].live_count;
+      live_bytes += snapshot[i].live_bytes;
+      alloc_count += snapshot[i].alloc_count;
+      alloc_bytes += snapshot[i].alloc_bytes;
+    }
+
+  profile_writer_puts (w, "heap profile: ");
+  profile_put_counts (w, live_count, live_bytes, alloc_count, alloc_bytes);
+  profile_writer_puts (w, " heap_v2/");
+  profile_writer_putnum (w, mp_.profile_interval, 10, 0);
+  profile_writer_puts (w, "\n");
+
+  for (size_t i = 0; i < count; ++i)
+    {
+      profile_put_counts (w, snapshot[i].live_count, snapshot[i].live_bytes,
+			  snapshot[i].alloc_count, snapshot[i].alloc_bytes);
+      for (int j = 0; j < snapshot[i].depth; ++j)
+	{
+	  profile_writer_puts (w, " 0x");
+	  profile_writer_putnum (w, (uintptr_t) snapshot[i].next->frames[j],
+				 16, 0);
+	}
+      profile_writer_puts (w, "\n");
+    }
+
+  profile_writer_finish (w);
+
+  if (snapshot != NULL)
+    __munmap (snapshot, size);
+  return 0;
+}
+
+/* Write the profile to malloc-profile.PID.N.heap in the current
+   directory, where N counts the profiles written so far.  Then call
+   the handler the application had installed for SIG, if any.  */
+static void
+profile_signal_handler (int sig, siginfo_t *info, void *context)
+{
+  int saved_errno = errno;
+  int fd = profile_writer_open ("malloc-profile", profile.dumps++, ".heap");
+  if (fd >= 0)
+    {
+      struct profile_writer w = { .fp = NULL, .fd = fd };
+      profile_dump (&w, true);
+      __close_nocancel_nostatus (fd);
+    }
+  __set_errno (saved_errno);
+
+  if (profile.old_action.sa_flags & SA_SIGINFO)
+    profile.old_action.sa_sigaction (sig, info, context);
+  else if (profile.old_action.sa_handler != SIG_DFL
+	   && profile.old_action.sa_handler != SIG_IGN)
+    profile.old_action.sa_handler (sig);
+}
+
+/* Set up the profiler if glibc.malloc.profile_interval is set.  Called
+   from ptmalloc_init.  */
+static void
+profile_init (void)
+{
+  size_t filter_size = 1 << PROFILE_FILTER_BITS;
+  size_t heads_size = (1 << PROFILE_HASH_BITS) * sizeof (void *);
+  char *p = (char *) MMAP (0, filter_size + 2 * heads_size,
+			   PROT_READ | PROT_WRITE, 0);
+  if (p == MAP_FAILED)
+    {
+      mp_.profile_interval = 0;
+      return;
+    }
+  profile.samples = (struct profile_sample **) p;
+  profile.buckets = (struct profile_bucket **) (p + heads_size);
+  profile.filter = (unsigned char *) p + 2 * heads_size;
+
+  if (mp_.profile_signal != 0)
+    {
+      /* The application may have installed a handler for the signal
+	 before the first call to malloc.  It is called after the
+	 profile has been written.  */
+      struct sigaction sa;
+      memset (&sa, 0, sizeof (sa));
+      sa.sa_sigaction = profile_signal_handler;
+      sa.sa_flags = SA_RESTART | SA_SIGINFO;
+      __sigaction (mp_.profile_signal, &sa, &profile.old_action);
+    }
+}
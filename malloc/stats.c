@@ -0,0 +1,365 @@
+/* Lock-free allocation statistics.
+   Copyright (C) 2018 Free Software Foundation, Inc.
+   This file is part of the GNU C Library.
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public License as
+   published by the Free Software Foundation; either version 2.1 of the
+   License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; see the file COPYING.LIB.  If
+   not, see <http://www.gnu.org/licenses/>.  */
+
+/* If glibc.malloc.stats is set, the public allocation functions count
+   every allocation and deallocation in a block of counters owned by
+   the calling thread.  A block has a set of counters for each size
+   class, and a single set for the arena the thread currently
+   allocates from.  Only the owning thread writes to a block, so the
+   counters are updated with plain relaxed loads and stores, without
+   atomic read-modify-write operations and without locks.
+
+   Events which concern an arena other than the one a thread's counters
+   are kept for, such as freeing a chunk allocated by another thread,
+   are added atomically to the counters in struct malloc_state.  When a
+   thread starts allocating from a different arena, or exits, its arena
+   counters are folded into the old arena, and the counters of exiting
+   threads are added to stats_retired.
+
+   malloc_get_stats sums the counters without acquiring any arena lock.
+   stats_lock serializes the reader against threads registering,
+   exiting and moving between arenas; it is never held while acquiring
+   another lock.  Chunks allocated with mmap do not belong to an arena,
+   and are only counted per size class.  */
+
+/* Chunk sizes up to STATS_SMALL_MAX have a class for each multiple of
+   MALLOC_ALIGNMENT, like the tcache bins.  Larger chunks are grouped
+   into classes bounded by powers of two.  */
+#define STATS_SMALL_CLASSES 64
+#define STATS_SMALL_MAX \
+  (MINSIZE + (STATS_SMALL_CLASSES - 1) * MALLOC_ALIGNMENT)
+#define STATS_MAX_CLASSES (STATS_SMALL_CLASSES + 8 * sizeof (size_t))
+
+struct stats_class
+{
+  struct malloc_counters c;
+  size_t mmaps;
+  size_t munmaps;
+  size_t mmap_cache_hits;
+};
+
+struct stats_thread
+{
+  struct stats_thread *next;
+  /* Arena whose counters are kept in LOCAL, or NULL.  */
+  mstate arena;
+  struct malloc_counters local;
+  struct stats_class classes[STATS_MAX_CLASSES];
+};
+
+/* List of the counters of all threads, and the counters of exited
+   threads.  Protected by stats_lock, which is defined in arena.c.  */
+static struct stats_thread *stats_threads;
+static struct stats_class stats_retired[STATS_MAX_CLASSES];
+
+static __thread struct stats_thread *stats_self;
+static __thread bool stats_shutting_down;
+
+enum
+  {
+    stats_tcache_none,
+    stats_tcache_hit,
+    stats_tcache_miss
+  };
+
+/* Return the number of size classes in use.  */
+static inline size_t
+stats_nclasses (void)
+{
+  return STATS_SMALL_CLASSES + __builtin_clzl (STATS_SMALL_MAX) + 1;
+}
+
+/* Return the size class of chunks of SIZE bytes.  */
+static inline size_t
+stats_class (INTERNAL_SIZE_T size)
+{
+  if (size <= STATS_SMALL_MAX)
+    return (size - MINSIZE) / MALLOC_ALIGNMENT;
+  return (STATS_SMALL_CLASSES + __builtin_clzl (STATS_SMALL_MAX)
+	  - __builtin_clzl (size - 1));
+}
+
+/* Return the largest usable size of the chunks in class I.  */
+static size_t
+stats_class_size (size_t i)
+{
+  if (i < STATS_SMALL_CLASSES)
+    return MINSIZE + i * MALLOC_ALIGNMENT - SIZE_SZ;
+  size_t shift = (8 * sizeof (size_t) - __builtin_clzl (STATS_SMALL_MAX)
+		  + i - STATS_SMALL_CLASSES);
+  if (shift >= 8 * sizeof (size_t))
+    return SIZE_MAX;
+  return ((size_t) 1 << shift) - SIZE_SZ;
+}
+
+/* Add N to *COUNTER, which only the calling thread modifies.  */
+static inline void
+stats_add (size_t *counter, size_t n)
+{
+  atomic_store_relaxed (counter, atomic_load_relaxed (counter) + n);
+}
+
+/* Count an event in M.  If SHARED, other threads may update M
+   concurrently.  */
+static void
+stats_record (struct malloc_counters *m, bool shared, bool freed,
+	      INTERNAL_SIZE_T size, int tcache)
+{
+  if (shared)
+    {
+      if (freed)
+	{
+	  atomic_fetch_add_relaxed (&m->frees, 1);
+	  atomic_fetch_add_relaxed (&m->free_bytes, size);
+	}
+      else
+	{
+	  atomic_fetch_add_relaxed (&m->allocs, 1);
+	  atomic_fetch_add_relaxed (&m->alloc_bytes, size);
+	  if (tcache == stats_tcache_hit)
+	    atomic_fetch_add_relaxed (&m->tcache_hits, 1);
+	  else if (tcache == stats_tcache_miss)
+	    atomic_fetch_add_relaxed (&m->tcache_misses, 1);
+	}
+    }
+  else
+    {
+      if (freed)
+	{
+	  stats_add (&m->frees, 1);
+	  stats_add (&m->free_bytes, size);
+	}
+      else
+	{
+	  stats_add (&m->allocs, 1);
+	  stats_add (&m->alloc_bytes, size);
+	  if (tcache == stats_tcache_hit)
+	    stats_add (&m->tcache_hits, 1);
+	  else if (tcache == stats_tcache_miss)
+	    stats_add (&m->tcache_misses, 1);
+	}
+    }
+}
+
+/* Add the arena counters of thread T to its arena.  Called with
+   stats_lock held.  */
+static void
+stats_fold_arena (struct stats_thread *t)
+{
+  struct malloc_counters *to = &t->arena->stats;
+  atomic_fetch_add_relaxed (&to->allocs, t->local.allocs);
+  atomic_fetch_add_relaxed (&to->frees, t->local.frees);
+  atomic_fetch_add_relaxed (&to->alloc_bytes, t->local.alloc_bytes);
+  atomic_fetch_add_relaxed (&to->free_bytes, t->local.free_bytes);
+  atomic_fetch_add_relaxed (&to->tcache_hits, t->local.tcache_hits);
+  atomic_fetch_add_relaxed (&to->tcache_misses, t->local.tcache_misses);
+}
+
+static struct stats_thread *
+stats_thread_new (void)
+{
+  if (stats_shutting_down)
+    return NULL;
+
+  size_t size = ALIGN_UP (sizeof (struct stats_thread), GLRO (dl_pagesize));
+  struct stats_thread *t = (struct stats_thread *) MMAP (0, size,
+							 PROT_READ
+							 | PROT_WRITE, 0);
+  if (t == MAP_FAILED)
+    return NULL;
+
+  __libc_lock_lock (stats_lock);
+  t->next = stats_threads;
+  stats_threads = t;
+  __libc_lock_unlock (stats_lock);
+  stats_self = t;
+  return t;
+}
+
+/* Move the arena counters of thread T to arena AV.  */
+static void
+stats_thread_attach (struct stats_thread *t, mstate av)
+{
+  __libc_lock_lock (stats_lock);
+  if (t->arena != NULL)
+    stats_fold_arena (t);
+  memset (&t->local, 0, sizeof (t->local));
+  t->arena = av;
+  __libc_lock_unlock (stats_lock);
+}
+
+/* Count the allocation or deallocation of chunk P.  TCACHE tells
+   whether an allocation was looked up in the tcache.  */
+static void __attribute_noinline__
+stats_count (mchunkptr p, bool freed, int tcache)
+{
+  /* Chunks from the dumped main arena were never allocated by this
+     malloc.  */
+  if (DUMPED_MAIN_ARENA_CHUNK (p))
+    return;
+
+  struct stats_thread *t = stats_self;
+  if (t == NULL)
+    {
+      t = stats_thread_new ();
+      if (t == NULL)
+	return;
+    }
+
+  INTERNAL_SIZE_T size = chunksize (p);
+  struct stats_class *c = &t->classes[stats_class (size)];
+  stats_record (&c->c, false, freed, size, tcache);
+  if (chunk_is_mmapped (p))
+    {
+      stats_add (freed ? &c->munmaps : &c->mmaps, 1);
+      if (!freed && mmap_cache_reused)
+	stats_add (&c->mmap_cache_hits, 1);
+      return;
+    }
+
+  mstate av = arena_for_chunk (p);
+  if (av != t->arena)
+    {
+      /* Chunks freed to another arena and chunks left in the tcache by
+	 an earlier arena do not move the counters of the thread.  */
+      if (freed || tcache == stats_tcache_hit)
+	{
+	  stats_record (&av->stats, true, freed, size, tcache);
+	  return;
+	}
+      stats_thread_attach (t, av);
+    }
+  stats_record (&t->local, false, freed, size, tcache);
+}
+
+static __always_inline void
+stats_count_alloc (void *mem, int tcache)
+{
+  if (__glibc_unlikely (mp_.stats) && mem != NULL)
+    stats_count (mem2chunk (mem), false, tcache);
+}
+
+static __always_inline void
+stats_count_free (mchunkptr p)
+{
+  if (__glibc_unlikely (mp_.stats))
+    stats_count (p, true, stats_tcache_none);
+}
+
+/* Add the counters of the calling thread to the totals of exited
+   threads, and stop counting its allocations.  */
+static void
+stats_thread_release (void)
+{
+  struct stats_thread *t = stats_self;
+  stats_self = NULL;
+  stats_shutting_down = true;
+  if (t == NULL)
+    return;
+
+  __libc_lock_lock (stats_lock);
+  struct stats_thread **tp = &stats_threads;
+  while (*tp != t)
+    tp = &(*tp)->next;
+  *tp = t->next;
+  if (t->arena != NULL)
+    stats_fold_arena (t);
+  for (size_t i = 0; i < stats_nclasses (); ++i)
+    {
+      struct stats_class *from = &t->classes[i];
+      struct stats_class *to = &stats_retired[i];
+      to->c.allocs += from->c.allocs;
+      to->c.frees += from->c.frees;
+      to->c.alloc_bytes += from->c.alloc_bytes;
+      to->c.free_bytes += from->c.free_bytes;
+      to->c.tcache_hits += from->c.tcache_hits;
+      to->c.tcache_misses += from->c.tcache_misses;
+      to->mmaps += from->mmaps;
+      to->munmaps += from->munmaps;
+      to->mmap_cache_hits += from->mmap_cache_hits;
+    }
+  __libc_lock_unlock (stats_lock);
+
+  __munmap (t, ALIGN_UP (sizeof (struct stats_thread), GLRO (dl_pagesize)));
+}
+
+/* Return the number of bytes in use from ALLOC_BYTES and FREE_BYTES,
+   which are not read atomically together.  */
+static inline size_t
+stats_in_use (size_t alloc_bytes, size_t free_bytes)
+{
+  return alloc_bytes > free_bytes ? alloc_bytes - free_bytes : 0;
+}
+
+static void
+stats_get_class (size_t i, struct malloc_size_class_stats *s)
+{
+  struct stats_class sum = stats_retired[i];
+  for (struct stats_thread *t = stats_threads; t != NULL; t = t->next)
+    {
+      struct stats_class *c = &t->classes[i];
+      sum.c.allocs += atomic_load_relaxed (&c->c.allocs);
+      sum.c.frees += atomic_load_relaxed (&c->c.frees);
+      sum.c.alloc_bytes += atomic_load_relaxed (&c->c.alloc_bytes);
+      sum.c.free_bytes += atomic_load_relaxed (&c->c.free_bytes);
+      sum.c.tcache_hits += atomic_load_relaxed (&c->c.tcache_hits);
+      sum.c.tcache_misses += atomic_load_relaxed (&c->c.tcache_misses);
+      sum.mmaps += atomic_load_relaxed (&c->mmaps);
+      sum.munmaps += atomic_load_relaxed (&c->munmaps);
+      sum.mmap_cache_hits += atomic_load_relaxed (&c->mmap_cache_hits);
+    }
+
+  s->size = stats_class_size (i);
+  s->allocs = sum.c.allocs;
+  s->frees = sum.c.frees;
+  s->bytes_in_use = stats_in_use (sum.c.alloc_bytes, sum.c.free_bytes);
+  s->tcache_hits = sum.c.tcache_hits;
+  s->tcache_misses = sum.c.tcache_misses;
+  s->mmaps = sum.mmaps;
+  s->munmaps = sum.munmaps;
+  s->mmap_cache_hits = sum.mmap_cache_hits;
+}
+
+static void
+stats_get_arena (mstate av, struct malloc_arena_stats *s)
+{
+  struct malloc_counters sum;
+  sum.allocs = atomic_load_relaxed (&av->stats.allocs);
+  sum.frees = atomic_load_relaxed (&av->stats.frees);
+  sum.alloc_bytes = atomic_load_relaxed (&av->stats.alloc_bytes);
+  sum.free_bytes = atomic_load_relaxed (&av->stats.free_bytes);
+  sum.tcache_hits = atomic_load_relaxed (&av->stats.tcache_hits);
+  sum.tcache_misses = atomic_load_relaxed (&av->stats.tcache_misses);
+  for (struct stats_thread *t = stats_threads; t != NULL; t = t->next)
+    if (t->arena == av)
+      {
+	sum.allocs += atomic_load_relaxed (&t->local.allocs);
+	sum.frees += atomic_load_relaxed (&t->local.frees);
+	sum.alloc_bytes += atomic_load_relaxed (&t->local.alloc_bytes);
+	sum.free_bytes += atomic_load_relaxed (&t->local.free_bytes);
+	sum.tcache_hits += atomic_load_relaxed (&t->local.tcache_hits);
+	sum.tcache_misses += atomic_load_relaxed (&t->local.tcache_misses);
+      }
+
+  s->allocs = sum.allocs;
+  s->frees = sum.frees;
+  s->bytes_in_use = stats_in_use (sum.alloc_bytes, sum.free_bytes);
+  s->tcache_hits = sum.tcache_hits;
+  s->tcache_misses = sum.tcache_misses;
+  s->lock_contentions = atomic_load_relaxed (&av->stats_contended);
+}
@@ -0,0 +1,323 @@
+/* Allocation trace recorder.
+   Copyright (C) 2018 Free Software Foundation, Inc.
+   This file is part of the GNU C Library.
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public License as
+   published by the Free Software Foundation; either version 2.1 of the
+   License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   along with the GNU C Library; see the file COPYING.LIB.  If
+   not, see <http://www.gnu.org/licenses/>.  */
+
+/* If glibc.malloc.trace_file is set to FILE, every call to malloc,
+   calloc, realloc, free and the aligned allocation functions is
+   recorded in FILE.PID, in the format described in malloc-trace.h.
+   benchtests/bench-malloc-replay replays such traces.
+
+   Each thread appends its records to a buffer of its own, which is
+   obtained with mmap so that the recorder never calls back into
+   malloc.  A full buffer is written to the file by its thread.  The
+   buffers are also written when their thread exits and, for the
+   threads still running, when the process exits, which is why
+   records are published with a release store of the used count.  All
+   writes to the file and all changes to the list of buffers are
+   serialized by trace_lock, which is a leaf lock.
+
+   The records are ordered by a global sequence number.  A process
+   which exits through _exit or a fatal signal loses the records not
+   written yet.  Tracing stops in the child after fork, so that the
+   records of the parent are neither duplicated nor mixed with those
+   of the child.  */
+
+#include "malloc-trace.h"
+
+/* Size of the buffer of a thread, including its header.  */
+#define TRACE_BUFFER_SIZE (64 * 1024)
+
+struct trace_buffer
+{
+  struct trace_buffer *next;
+  /* Records [0, flushed) have been written to the file.  Protected by
+     trace_lock.  */
+  size_t flushed;
+  /* Number of valid records.  Only modified by the owning thread, and
+     reset to 0 under trace_lock.  */
+  size_t used;
+  struct malloc_trace_record records[];
+};
+
+#define TRACE_BUFFER_RECORDS \
+  ((TRACE_BUFFER_SIZE - sizeof (struct trace_buffer)) \
+   / sizeof (struct malloc_trace_record))
+
+static struct
+{
+  /* The trace file, or -1 if tracing is disabled.  */
+  int fd;
+  /* Next sequence number.  */
+  uint64_t seq;
+  /* Number of threads seen so far.  */
+  uint32_t threads;
+  /* Buffers of the running threads.  Protected by trace_lock.  */
+  struct trace_buffer *buffers;
+} trace = { .fd = -1 };
+
+__libc_lock_define_initialized (static, trace_lock);
+
+/* The buffer of this thread, allocated on first use.  */
+static __thread struct trace_buffer *trace_self;
+/* Number of this thread in the trace, 0 if not assigned yet.  */
+static __thread uint32_t trace_thread;
+/* True while this thread is in a traced call, so that the nested
+   calls of the allocation functions are not recorded.  */
+static __thread bool trace_busy;
+
+/* Return true if the current call has to be recorded.  */
+static __always_inline bool
+trace_due (void)
+{
+  return __glibc_unlikely (atomic_load_relaxed (&trace.fd) >= 0)
+	 && !trace_busy;
+}
+
+static __always_inline uint64_t
+trace_next_seq (void)
+{
+  return atomic_fetch_add_relaxed (&trace.seq, 1);
+}
+
+/* Write LEN bytes at BUF to the trace file.  Called with trace_lock
+   held.  */
+static void
+trace_write (const void *buf, size_t len)
+{
+  const char *p = buf;
+  while (len > 0)
+    {
+      ssize_t n = __write_nocancel (trace.fd, p, len);
+      if (n <= 0)
+	break;
+      p += n;
+      len -= n;
+    }
+}
+
+/* Write the pending records of B.  Called with trace_lock held.  */
+static void
+trace_flush_buffer (struct trace_buffer *b)
+{
+  size_t used = atomic_load_acquire (&b->used);
+  trace_write (b->records + b->flushed,
+	       (used - b->flushed) * sizeof (struct malloc_trace_record));
+  b->flushed = used;
+}
+
+/* Allocate the buffer of the current thread.  Return NULL on
+   failure.  */
+static struct trace_buffer *
+trace_buffer_init (void)
+{
+  struct trace_buffer *b = (struct trace_buffer *)
+    MMAP (0, TRACE_BUFFER_SIZE, PROT_READ | PROT_WRITE, 0);
+  if (b == MAP_FAILED)
+    return NULL;
+  __libc_lock_lock (trace_lock);
+  b->next = trace.buffers;
+  trace.buffers = b;
+  __libc_lock_unlock (trace_lock);
+  trace_self = b;
+  return b;
+}
+
+/* Record a call of OP with sequence number SEQ.  */
+static void
+trace_record (uint32_t op, uint64_t seq, void *ptr, uint64_t arg,
+	      size_t size)
+{
+  if (trace_thread == 0)
+    trace_thread = atomic_fetch_add_relaxed (&trace.threads, 1) + 1;
+  struct malloc_trace_record r =
+    {
+      .seq = seq,
+      .ptr = (uintptr_t) ptr,
+      .arg = arg,
+      .size = size,
+      .thread = trace_thread,
+      .op = op,
+    };
+
+  struct trace_buffer *b = trace_self;
+  if (__glibc_unlikely (b == NULL))
+    b = trace_buffer_init ();
+  if (__glibc_unlikely (b == NULL))
+    {
+      /* Write the record directly if there is no memory for the
+	 buffer.  */
+      __libc_lock_lock (trace_lock);
+      if (trace.fd >= 0)
+	trace_write (&r, sizeof (r));
+      __libc_lock_unlock (trace_lock);
+      return;
+    }
+
+  size_t used = b->used;
+  if (used == TRACE_BUFFER_RECORDS)
+    {
+      __libc_lock_lock (trace_lock);
+      if (trace.fd >= 0)
+	trace_flush_buffer (b);
+      b->flushed = 0;
+      atomic_store_relaxed (&b->used, 0);
+      __libc_lock_unlock (trace_lock);
+      used = 0;
+    }
+  b->records[used] = r;
+  atomic_store_release (&b->used, used + 1);
+}
+
+/* The recorded versions of the allocation functions.  */
+
+static void * __attribute_noinline__
+trace_malloc (size_t bytes)
+{
+  trace_busy = true;
+  void *mem = __libc_malloc (bytes);
+  trace_record (malloc_trace_malloc, trace_next_seq (), mem, 0, bytes);
+  trace_busy = false;
+  return mem;
+}
+
+static void * __attribute_noinline__
+trace_calloc (size_t n, size_t elem_size)
+{
+  trace_busy = true;
+  void *mem = __libc_calloc (n, elem_size);
+  trace_record (malloc_trace_calloc, trace_next_seq (), mem, n,
+		n * elem_size);
+  trace_busy = false;
+  return mem;
+}
+
+static void * __attribute_noinline__
+trace_realloc (void *oldmem, size_t bytes)
+{
+  trace_busy = true;
+  void *mem = __libc_realloc (oldmem, bytes);
+  trace_record (malloc_trace_realloc, trace_next_seq (), mem,
+		(uintptr_t) oldmem, bytes);
+  trace_busy = false;
+  return mem;
+}
+
+static void __attribute_noinline__
+trace_free (void *mem)
+{
+  trace_busy = true;
+  trace_record (malloc_trace_free, trace_next_seq (), mem, 0, 0);
+  __libc_free (mem);
+  trace_busy = false;
+}
+
+static void * __attribute_noinline__
+trace_memalign (size_t alignment, size_t bytes, void *address)
+{
+  trace_busy = true;
+  void *mem = _mid_memalign (alignment, bytes, address);
+  trace_record (malloc_trace_memalign, trace_next_seq (), mem, alignment,
+		bytes);
+  trace_busy = false;
+  return mem;
+}
+
+/* Write the records of the current thread and release its buffer.
+   Called on thread exit, before the internal data of the thread is
+   deallocated.  Those deallocations and any later calls on this thread
+   are not recorded.  */
+static void
+trace_thread_release (void)
+{
+  struct trace_buffer *b = trace_self;
+  trace_self = NULL;
+  trace_busy = true;
+  if (b == NULL)
+    return;
+
+  __libc_lock_lock (trace_lock);
+  /* After fork, the list still contains the buffers of the threads of
+     the parent, but it is no longer used.  */
+  if (trace.fd >= 0)
+    {
+      trace_flush_buffer (b);
+      struct trace_buffer **bp = &trace.buffers;
+      while (*bp != b)
+	bp = &(*bp)->next;
+      *bp = b->next;
+    }
+  __libc_lock_unlock (trace_lock);
+  __munmap (b, TRACE_BUFFER_SIZE);
+}
+
+/* Write the records of all threads on process exit.  */
+static void
+trace_flush_all (void)
+{
+  if (atomic_load_relaxed (&trace.fd) < 0)
+    return;
+  __libc_lock_lock (trace_lock);
+  for (struct trace_buffer *b = trace.buffers; b != NULL; b = b->next)
+    trace_flush_buffer (b);
+  __libc_lock_unlock (trace_lock);
+}
+text_set_element (__libc_atexit, trace_flush_all);
+
+/* Stop tracing in the child after fork.  Async-signal-safe.  */
+static void
+trace_fork_child (void)
+{
+  int fd = trace.fd;
+  if (fd >= 0)
+    {
+      atomic_store_relaxed (&trace.fd, -1);
+      __close_nocancel_nostatus (fd);
+    }
+}
+
+/* Open FILE.PID and write the header of the trace.  Called from
+   ptmalloc_init if glibc.malloc.trace_file is set.  */
+static void
+trace_init (const char *file)
+{
+  if (file == NULL || file[0] == '\0')
+    return;
+
+  char buf[3 * sizeof (unsigned long int)];
+  char *end = buf + sizeof (buf);
+  char *p = _itoa_word (__getpid (), end, 10, 0);
+  size_t len = strlen (file);
+  char name[len + 1 + (end - p) + 1];
+  memcpy (name, file, len);
+  name[len] = '.';
+  memcpy (name + len + 1, p, end - p);
+  name[len + 1 + (end - p)] = '\0';
+
+  int fd = __open_nocancel (name, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC,
+			    0644);
+  if (fd < 0)
+    return;
+
+  struct malloc_trace_header header =
+    {
+      .magic = MALLOC_TRACE_MAGIC,
+      .version = MALLOC_TRACE_VERSION,
+      .record_size = sizeof (struct malloc_trace_record),
+    };
+  trace.fd = fd;
+  trace_write (&header, sizeof (header));
+}
@@ -0,0 +1,140 @@
+/* Test free_sized and free_aligned_sized.
+   Copyright (C) 2018 Free Software Foundation, Inc.
+   This file is part of the GNU C Library.
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; if not, see
+   <http://www.gnu.org/licenses/>.  */
+
+#include <malloc.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <support/capture_subprocess.h>
+#include <support/check.h>
+#include <support/support.h>
+#include <support/xthread.h>
+
+enum
+  {
+    thread_count = 4,
+    block_count = 1000,
+  };
+
+/* Check that CALLBACK terminates the process with the malloc error
+   EXPECTED.  */
+static void
+check_abort (void (*callback) (void *), const char *expected)
+{
+  struct support_capture_subprocess result
+    = support_capture_subprocess (callback, NULL);
+  TEST_VERIFY (strstr (result.err.buffer, expected) != NULL);
+  TEST_VERIFY (WIFSIGNALED (result.status));
+  if (WIFSIGNALED (result.status))
+    TEST_COMPARE (WTERMSIG (result.status), SIGABRT);
+  support_capture_subprocess_free (&result);
+}
+
+static void
+free_too_large (void *closure)
+{
+  setenv ("LIBC_FATAL_STDERR_", "1", 1);
+  free_sized (xmalloc (16), 4096);
+}
+
+static void
+free_bad_alignment (void *closure)
+{
+  setenv ("LIBC_FATAL_STDERR_", "1", 1);
+  char *p = aligned_alloc (64, 256);
+  TEST_VERIFY_EXIT (p != NULL);
+  free_aligned_sized (p, 48, 256);
+}
+
+/* Allocate and free blocks of all sizes up to SIZE with free_sized
+   and free_aligned_sized.  */
+static void *
+thread_function (void *closure)
+{
+  size_t size = (uintptr_t) closure;
+  void *blocks[block_count];
+  for (size_t n = 1; n <= size; n += 7)
+    {
+      for (size_t i = 0; i < block_count; ++i)
+	{
+	  blocks[i] = xmalloc (n);
+	  memset (blocks[i], 0xa5, n);
+	}
+      for (size_t i = 0; i < block_count; ++i)
+	free_sized (blocks[i], n);
+
+      for (size_t i = 0; i < block_count; ++i)
+	{
+	  blocks[i] = aligned_alloc (64, n);
+	  TEST_VERIFY_EXIT (blocks[i] != NULL);
+	}
+      for (size_t i = 0; i < block_count; ++i)
+	free_aligned_sized (blocks[i], 64, n);
+    }
+  return NULL;
+}
+
+static int
+do_test (void)
+{
+  free_sized (NULL, 0);
+  free_sized (NULL, 100);
+  free_aligned_sized (NULL, 64, 100);
+
+  /* A block freed with the correct size is reused.  */
+  for (size_t n = 0; n <= 1024; ++n)
+    {
+      void *p = xmalloc (n);
+      free_sized (p, n);
+      void *q = xmalloc (n);
+      TEST_VERIFY (p == q);
+      free (q);
+    }
+
+  /* Blocks which are larger than the requested size.  */
+  char *p = xcalloc (1, 1000);
+  free_sized (p, 1000);
+  p = xmalloc (1000);
+  p = xrealloc (p, 200);
+  free_sized (p, 200);
+  p = memalign (4096, 100);
+  TEST_VERIFY_EXIT (p != NULL);
+  free_aligned_sized (p, 4096, 100);
+
+  /* Chunks allocated with mmap.  */
+  p = xmalloc (1024 * 1024);
+  free_sized (p, 1024 * 1024);
+  p = aligned_alloc (4096, 1024 * 1024);
+  TEST_VERIFY_EXIT (p != NULL);
+  free_aligned_sized (p, 4096, 1024 * 1024);
+
+  pthread_t threads[thread_count];
+  for (size_t i = 0; i < thread_count; ++i)
+    threads[i] = xpthread_create (NULL, thread_function,
+				  (void *) (uintptr_t) (256 << i));
+  for (size_t i = 0; i < thread_count; ++i)
+    xpthread_join (threads[i]);
+
+  check_abort (free_too_large, "free_sized(): invalid size");
+  check_abort (free_bad_alignment, "free_aligned_sized(): invalid alignment");
+
+  return 0;
+}
+
+#include <support/test-driver.c>
@@ -0,0 +1,78 @@
+/* Test time-based trimming of arenas (glibc.malloc.decay_ms).
+   Copyright (C) 2018 Free Software Foundation, Inc.
+   This file is part of the GNU C Library.
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; if not, see
+   <http://www.gnu.org/licenses/>.  */
+
+/* The test runs with a trim threshold that is never reached, so the
+   only way memory at the top of an arena can be returned to the system
+   is the time-based decay.  Grow an arena, free everything, and keep
+   freeing small amounts of memory for a while; the memory obtained
+   from the system must then go down again.  This is done for the main
+   arena and for the arena of a second thread.  */
+
+#include <malloc.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <support/check.h>
+#include <support/support.h>
+#include <support/xthread.h>
+
+enum
+  {
+    block_count = 64,
+    block_size = 64 * 1024,
+  };
+
+static void *
+exercise_arena (void *closure)
+{
+  const char *name = closure;
+  void *blocks[block_count];
+
+  for (int i = 0; i < block_count; ++i)
+    blocks[i] = xmalloc (block_size);
+  int before = mallinfo ().arena;
+  for (int i = 0; i < block_count; ++i)
+    free (blocks[i]);
+
+  /* The blocks are larger than the tcache and fastbin limits, so each
+     free goes through the arena and checks for decay.  */
+  for (int round = 0; round < 20; ++round)
+    {
+      struct timespec delay = { 0, 20 * 1000 * 1000 };
+      nanosleep (&delay, NULL);
+      for (int i = 0; i < 100; ++i)
+	free (xmalloc (2000));
+    }
+
+  int after = mallinfo ().arena;
+  printf ("info: %s: %d bytes from the system before, %d after\n",
+	  name, before, after);
+  TEST_VERIFY (after < before - block_count * block_size / 2);
+  return NULL;
+}
+
+static int
+do_test (void)
+{
+  exercise_arena ((void *) "main arena");
+  xpthread_join (xpthread_create (NULL, exercise_arena,
+				  (void *) "thread arena"));
+  return 0;
+}
+
+#include <support/test-driver.c>
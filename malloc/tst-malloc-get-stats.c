@@ -0,0 +1,235 @@
+/* Test malloc_get_stats (glibc.malloc.stats).
+   Copyright (C) 2018 Free Software Foundation, Inc.
+   This file is part of the GNU C Library.
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; if not, see
+   <http://www.gnu.org/licenses/>.  */
+
+#include <array_length.h>
+#include <errno.h>
+#include <malloc.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <support/check.h>
+#include <support/support.h>
+#include <support/xthread.h>
+
+enum
+  {
+    thread_count = 4,
+    block_count = 1000,
+    block_size = 100,
+    large_count = 4,
+    /* Above the default mmap threshold.  */
+    large_size = 1024 * 1024,
+  };
+
+struct snapshot
+{
+  size_t nclasses;
+  size_t narenas;
+  struct malloc_size_class_stats classes[256];
+  struct malloc_arena_stats arenas[64];
+};
+
+static void
+get_stats (struct snapshot *s)
+{
+  s->nclasses = array_length (s->classes);
+  s->narenas = array_length (s->arenas);
+  TEST_COMPARE (malloc_get_stats (0, s->classes, &s->nclasses,
+				  s->arenas, &s->narenas), 0);
+  TEST_VERIFY_EXIT (s->nclasses <= array_length (s->classes));
+  TEST_VERIFY_EXIT (s->narenas <= array_length (s->arenas));
+}
+
+/* Return the index of the size class for allocations of SIZE bytes.  */
+static size_t
+class_of (const struct snapshot *s, size_t size)
+{
+  for (size_t i = 0; i < s->nclasses; ++i)
+    if (s->classes[i].size >= size)
+      return i;
+  FAIL_EXIT1 ("no size class for %zu bytes", size);
+}
+
+static size_t
+total_allocs (const struct snapshot *s)
+{
+  size_t sum = 0;
+  for (size_t i = 0; i < s->nclasses; ++i)
+    sum += s->classes[i].allocs;
+  return sum;
+}
+
+/* Check that the arena totals match the size class totals, except for
+   mmapped chunks, which do not belong to an arena.  Only valid while
+   no other thread allocates.  */
+static void
+check_totals (const struct snapshot *s)
+{
+  size_t class_allocs = 0, class_frees = 0;
+  for (size_t i = 0; i < s->nclasses; ++i)
+    {
+      class_allocs += s->classes[i].allocs - s->classes[i].mmaps;
+      class_frees += s->classes[i].frees - s->classes[i].munmaps;
+    }
+  size_t arena_allocs = 0, arena_frees = 0;
+  for (size_t i = 0; i < s->narenas; ++i)
+    {
+      arena_allocs += s->arenas[i].allocs;
+      arena_frees += s->arenas[i].frees;
+      TEST_VERIFY (s->arenas[i].tcache_hits <= s->arenas[i].allocs);
+    }
+  TEST_COMPARE (arena_allocs, class_allocs);
+  TEST_COMPARE (arena_frees, class_frees);
+}
+
+static void *blocks[thread_count][block_count];
+
+static void *
+allocation_thread_function (void *closure)
+{
+  void **b = closure;
+  for (size_t i = 0; i < block_count; ++i)
+    b[i] = xmalloc (block_size);
+  return NULL;
+}
+
+static void *
+free_thread_function (void *closure)
+{
+  void **b = closure;
+  for (size_t i = 0; i < block_count; ++i)
+    free (b[i]);
+  return NULL;
+}
+
+static volatile bool monitor_stop;
+
+/* Read the statistics repeatedly while other threads allocate.  */
+static void *
+monitor_thread_function (void *closure)
+{
+  static struct snapshot s;
+  size_t last = 0;
+  while (!monitor_stop)
+    {
+      get_stats (&s);
+      size_t allocs = total_allocs (&s);
+      TEST_VERIFY (allocs >= last);
+      last = allocs;
+    }
+  return NULL;
+}
+
+static struct snapshot before, during, after;
+
+static int
+do_test (void)
+{
+  size_t nclasses = 0, narenas = 0;
+  TEST_COMPARE (malloc_get_stats (1, NULL, &nclasses, NULL, &narenas), -1);
+  TEST_COMPARE (errno, EINVAL);
+  TEST_COMPARE (malloc_get_stats (0, NULL, &nclasses, NULL, &narenas), 0);
+  TEST_VERIFY (nclasses > 64);
+  TEST_COMPARE (narenas, 1);
+
+  /* Allocations and frees on the main thread, through the arena and
+     through the tcache.  */
+  get_stats (&before);
+  size_t c = class_of (&before, block_size);
+  for (size_t i = 0; i < block_count; ++i)
+    blocks[0][i] = xmalloc (block_size);
+  get_stats (&during);
+  TEST_VERIFY (during.classes[c].allocs - before.classes[c].allocs
+	       >= block_count);
+  TEST_VERIFY (during.classes[c].bytes_in_use
+	       - before.classes[c].bytes_in_use >= block_count * block_size);
+  TEST_COMPARE (during.classes[c].frees, before.classes[c].frees);
+  for (size_t i = 0; i < block_count; ++i)
+    free (blocks[0][i]);
+  for (size_t i = 0; i < block_count; ++i)
+    free (xmalloc (block_size));
+  get_stats (&after);
+  TEST_VERIFY (after.classes[c].frees - during.classes[c].frees
+	       >= 2 * block_count);
+  TEST_VERIFY (after.classes[c].tcache_hits - during.classes[c].tcache_hits
+	       >= block_count / 2);
+  TEST_VERIFY (after.classes[c].bytes_in_use
+	       <= before.classes[c].bytes_in_use);
+  TEST_VERIFY (after.arenas[0].allocs - before.arenas[0].allocs
+	       >= 2 * block_count);
+  check_totals (&after);
+
+  /* Chunks allocated with mmap.  */
+  void *large[large_count];
+  get_stats (&before);
+  c = class_of (&before, large_size);
+  for (size_t i = 0; i < large_count; ++i)
+    large[i] = xmalloc (large_size);
+  get_stats (&during);
+  TEST_COMPARE (during.classes[c].mmaps - before.classes[c].mmaps,
+		large_count);
+  for (size_t i = 0; i < large_count; ++i)
+    free (large[i]);
+  get_stats (&after);
+  TEST_COMPARE (after.classes[c].munmaps - before.classes[c].munmaps,
+		large_count);
+  TEST_COMPARE (after.classes[c].bytes_in_use,
+		before.classes[c].bytes_in_use);
+  check_totals (&after);
+
+  /* Allocate on several threads and free on others while another
+     thread reads the statistics.  */
+  get_stats (&before);
+  c = class_of (&before, block_size);
+  pthread_t monitor = xpthread_create (NULL, monitor_thread_function, NULL);
+  pthread_t threads[thread_count];
+  for (size_t i = 0; i < thread_count; ++i)
+    threads[i] = xpthread_create (NULL, allocation_thread_function,
+				  blocks[i]);
+  for (size_t i = 0; i < thread_count; ++i)
+    xpthread_join (threads[i]);
+  for (size_t i = 0; i < thread_count; ++i)
+    threads[i] = xpthread_create (NULL, free_thread_function,
+				  blocks[(i + 1) % thread_count]);
+  for (size_t i = 0; i < thread_count; ++i)
+    xpthread_join (threads[i]);
+  monitor_stop = true;
+  xpthread_join (monitor);
+
+  get_stats (&after);
+  TEST_VERIFY (after.narenas > 1);
+  TEST_VERIFY (after.classes[c].allocs - before.classes[c].allocs
+	       >= thread_count * block_count);
+  TEST_VERIFY (after.classes[c].frees - before.classes[c].frees
+	       >= thread_count * block_count);
+  size_t arena_allocs = 0;
+  for (size_t i = 1; i < after.narenas; ++i)
+    {
+      printf ("info: arena %zu: %zu allocations, %zu bytes in use,"
+	      " %zu contended locks\n", i, after.arenas[i].allocs,
+	      after.arenas[i].bytes_in_use, after.arenas[i].lock_contentions);
+      arena_allocs += after.arenas[i].allocs;
+    }
+  TEST_VERIFY (arena_allocs >= thread_count * block_count);
+  check_totals (&after);
+
+  return 0;
+}
+
+#include <support/test-driver.c>
@@ -0,0 +1,151 @@
+/* Test huge page support in malloc (glibc.malloc.hugetlb=1).
+   Copyright (C) 2018 Free Software Foundation, Inc.
+   This file is part of the GNU C Library.
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; if not, see
+   <http://www.gnu.org/licenses/>.  */
+
+/* Allocate memory from the main arena, from a thread arena, and
+   directly with mmap, and check that it is usable.  With
+   transparent huge pages, also check that the heap mapping has been
+   marked with MADV_HUGEPAGE.  The same test is run with explicit huge
+   pages by tst-malloc-hugetlb2, where the allocations must succeed
+   whether or not huge pages have been reserved.  */
+
+#include <malloc.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <support/check.h>
+#include <support/support.h>
+#include <support/xstdio.h>
+#include <support/xthread.h>
+
+#ifndef TEST_THP
+# define TEST_THP 1
+#endif
+
+enum
+  {
+    small_count = 4096,
+    small_size = 1000,
+    large_size = 8 * 1024 * 1024,
+  };
+
+static void
+allocate_and_check (void)
+{
+  void **small = xmalloc (small_count * sizeof (void *));
+  for (int i = 0; i < small_count; ++i)
+    {
+      small[i] = xmalloc (small_size);
+      memset (small[i], i, small_size);
+    }
+  unsigned char *large = xmalloc (large_size);
+  memset (large, 0x5a, large_size);
+
+  for (int i = 0; i < small_count; ++i)
+    {
+      const unsigned char *p = small[i];
+      TEST_VERIFY (p[0] == (unsigned char) i
+		   && p[small_size - 1] == (unsigned char) i);
+      free (small[i]);
+    }
+  TEST_VERIFY (large[0] == 0x5a && large[large_size - 1] == 0x5a);
+  large = xrealloc (large, 2 * large_size);
+  TEST_VERIFY (large[large_size - 1] == 0x5a);
+  free (large);
+  free (small);
+}
+
+static void *
+thread_function (void *closure)
+{
+  allocate_and_check ();
+  return NULL;
+}
+
+#if TEST_THP
+/* Return true if transparent huge pages are enabled in madvise or
+   always mode.  */
+static bool
+thp_enabled (void)
+{
+  FILE *fp = fopen ("/sys/kernel/mm/transparent_hugepage/enabled", "r");
+  if (fp == NULL)
+    return false;
+  char buf[64];
+  bool enabled = (fgets (buf, sizeof (buf), fp) != NULL
+		  && strstr (buf, "[never]") == NULL);
+  xfclose (fp);
+  return enabled;
+}
+
+/* Return true if one of the [heap] mappings has the "hg"
+   (MADV_HUGEPAGE) flag.  The part of the heap before the first huge
+   page boundary cannot hold a huge page and is not advised, so it
+   ends up in a mapping of its own.  */
+static bool
+heap_has_hugepage_flag (void)
+{
+  FILE *fp = xfopen ("/proc/self/smaps", "r");
+  char *line = NULL;
+  size_t len = 0;
+  bool in_heap = false;
+  bool result = false;
+
+  while (getline (&line, &len, fp) > 0)
+    {
+      if (strstr (line, "[heap]") != NULL)
+	in_heap = true;
+      else if (in_heap && strncmp (line, "VmFlags:", 8) == 0)
+	{
+	  if (strstr (line, " hg") != NULL)
+	    {
+	      result = true;
+	      break;
+	    }
+	  in_heap = false;
+	}
+    }
+  free (line);
+  xfclose (fp);
+  return result;
+}
+#endif
+
+static int
+do_test (void)
+{
+  allocate_and_check ();
+  xpthread_join (xpthread_create (NULL, thread_function, NULL));
+
+#if TEST_THP
+  if (!thp_enabled ())
+    FAIL_UNSUPPORTED ("transparent huge pages are not enabled");
+
+  /* Make sure the heap spans more than one huge page.  */
+  void *p[small_count];
+  for (int i = 0; i < small_count; ++i)
+    p[i] = xmalloc (small_size);
+  TEST_VERIFY (heap_has_hugepage_flag ());
+  for (int i = 0; i < small_count; ++i)
+    free (p[i]);
+#endif
+
+  return 0;
+}
+
+#include <support/test-driver.c>
@@ -0,0 +1,56 @@
+/* Test releasing the top of the heap with MADV_FREE (glibc.malloc.madv_free).
+   Copyright (C) 2018 Free Software Foundation, Inc.
+   This file is part of the GNU C Library.
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; if not, see
+   <http://www.gnu.org/licenses/>.  */
+
+/* The block below is allocated from the top of the main arena, and
+   only malloc_trim releases its pages.  */
+
+#include <malloc.h>
+#include <stdlib.h>
+#include <string.h>
+#include <support/check.h>
+#include <support/support.h>
+
+enum { block_size = 4 * 1024 * 1024 };
+
+static int
+do_test (void)
+{
+  TEST_COMPARE (mallopt (M_MMAP_THRESHOLD, 2 * block_size), 1);
+  TEST_COMPARE (mallopt (M_TRIM_THRESHOLD, 1 << 30), 1);
+
+  char *p = xmalloc (block_size);
+  memset (p, 1, block_size);
+  free (p);
+
+  /* The pages are released once, and not again while the top of the
+     heap is not used.  */
+  TEST_COMPARE (malloc_trim (0), 1);
+  TEST_COMPARE (malloc_trim (0), 0);
+
+  /* Allocating from the top of the heap uses the released pages, so
+     they are released again.  */
+  p = xmalloc (block_size);
+  memset (p, 2, block_size);
+  free (p);
+  TEST_COMPARE (malloc_trim (0), 1);
+  TEST_COMPARE (malloc_trim (0), 0);
+
+  return 0;
+}
+
+#include <support/test-driver.c>
@@ -0,0 +1,144 @@
+/* Test the cache of unmapped chunks (glibc.malloc.mmap_cache_max).
+   Copyright (C) 2018 Free Software Foundation, Inc.
+   This file is part of the GNU C Library.
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; if not, see
+   <http://www.gnu.org/licenses/>.  */
+
+/* The test runs with a cache of 64 MiB and glibc.malloc.stats, which
+   counts the chunks reused from the cache.  */
+
+#include <array_length.h>
+#include <malloc.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <support/check.h>
+#include <support/support.h>
+#include <support/xthread.h>
+
+enum
+  {
+    cache_size = 64 * 1024 * 1024,
+    large_size = 15 * 1024 * 1024,
+    large_count = 5,
+    thread_count = 4,
+    thread_iterations = 500,
+  };
+
+/* Return the number of mmapped chunks reused from the cache.  */
+static size_t
+cache_hits (void)
+{
+  static struct malloc_size_class_stats classes[256];
+  size_t nclasses = array_length (classes);
+  size_t narenas = 0;
+  TEST_COMPARE (malloc_get_stats (0, classes, &nclasses, NULL, &narenas), 0);
+  TEST_VERIFY_EXIT (nclasses <= array_length (classes));
+  size_t sum = 0;
+  for (size_t i = 0; i < nclasses; ++i)
+    {
+      TEST_VERIFY (classes[i].mmap_cache_hits <= classes[i].mmaps);
+      sum += classes[i].mmap_cache_hits;
+    }
+  return sum;
+}
+
+static void
+check_zero (const unsigned char *p, size_t size)
+{
+  for (size_t i = 0; i < size; ++i)
+    if (p[i] != 0)
+      FAIL_EXIT1 ("byte %zu of cleared block is %d", i, p[i]);
+}
+
+static void *
+thread_function (void *closure)
+{
+  unsigned int seed = (unsigned long int) closure;
+  for (size_t i = 0; i < thread_iterations; ++i)
+    {
+      size_t size = 256 * 1024 + rand_r (&seed) % (4 * 1024 * 1024);
+      unsigned char fill = seed;
+      unsigned char *p = xmalloc (size);
+      memset (p, fill, size);
+      if (p[0] != fill || p[size / 2] != fill || p[size - 1] != fill)
+	FAIL_EXIT1 ("block of %zu bytes was overwritten", size);
+      free (p);
+    }
+  return NULL;
+}
+
+static int
+do_test (void)
+{
+  /* A freed chunk is reused by the next request of the same size.  */
+  size_t hits = cache_hits ();
+  for (int i = 0; i < 10; ++i)
+    {
+      void *p = xmalloc (large_size);
+      memset (p, 0xa5, large_size);
+      free (p);
+    }
+  TEST_COMPARE (cache_hits () - hits, 9);
+
+  /* calloc clears reused chunks.  */
+  hits = cache_hits ();
+  unsigned char *p = xcalloc (1, large_size);
+  TEST_COMPARE (cache_hits () - hits, 1);
+  check_zero (p, large_size);
+  free (p);
+
+  /* A smaller request can use a larger chunk.  */
+  hits = cache_hits ();
+  p = xmalloc (large_size - large_size / 16);
+  TEST_COMPARE (cache_hits () - hits, 1);
+  free (p);
+
+  /* malloc_trim empties the cache.  */
+  p = xmalloc (large_size);
+  free (p);
+  TEST_COMPARE (malloc_trim (0), 1);
+  hits = cache_hits ();
+  p = xmalloc (large_size);
+  TEST_COMPARE (cache_hits (), hits);
+  free (p);
+  malloc_trim (0);
+
+  /* The cache does not grow beyond its limit.  */
+  void *blocks[large_count];
+  for (size_t i = 0; i < large_count; ++i)
+    blocks[i] = xmalloc (large_size);
+  for (size_t i = 0; i < large_count; ++i)
+    free (blocks[i]);
+  hits = cache_hits ();
+  for (size_t i = 0; i < large_count; ++i)
+    blocks[i] = xmalloc (large_size);
+  TEST_COMPARE (cache_hits () - hits, cache_size / large_size);
+  for (size_t i = 0; i < large_count; ++i)
+    free (blocks[i]);
+
+  /* Concurrent use.  */
+  pthread_t threads[thread_count];
+  for (size_t i = 0; i < thread_count; ++i)
+    threads[i] = xpthread_create (NULL, thread_function,
+				  (void *) (uintptr_t) (i + 1));
+  for (size_t i = 0; i < thread_count; ++i)
+    xpthread_join (threads[i]);
+  TEST_VERIFY (cache_hits () > hits + thread_count);
+
+  return 0;
+}
+
+#include <support/test-driver.c>
@@ -0,0 +1,137 @@
+/* Test NUMA-aware arena placement (glibc.malloc.numa).
+   Copyright (C) 2018 Free Software Foundation, Inc.
+   This file is part of the GNU C Library.
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; if not, see
+   <http://www.gnu.org/licenses/>.  */
+
+/* Allocate memory on several threads and check in
+   /proc/self/numa_maps that it comes from heaps which the kernel has
+   been asked to place on a NUMA node, and that the blocks are usable
+   and distinct.  */
+
+#include <array_length.h>
+#include <errno.h>
+#include <malloc.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <support/check.h>
+#include <support/support.h>
+#include <support/xstdio.h>
+#include <support/xthread.h>
+#include <support/xunistd.h>
+
+enum
+  {
+    thread_count = 8,
+    block_count = 64,
+    /* Below the mmap threshold, so that the blocks come from a heap.  */
+    block_size = 4000,
+  };
+
+/* Return the memory policy of the mapping containing ADDR, as
+   reported in /proc/self/numa_maps.  The caller frees the result.  */
+static char *
+mapping_policy (uintptr_t addr)
+{
+  FILE *fp = xfopen ("/proc/self/numa_maps", "r");
+  char *line = NULL;
+  size_t len = 0;
+  uintptr_t best = 0;
+  char *policy = NULL;
+
+  /* Each line starts with the start address of a mapping, followed by
+     its policy.  The mappings are sorted by address.  */
+  while (getline (&line, &len, fp) > 0)
+    {
+      char *p;
+      uintptr_t start = strtoull (line, &p, 16);
+      if (p == line || *p != ' ')
+	continue;
+      if (start <= addr && start >= best)
+	{
+	  best = start;
+	  free (policy);
+	  policy = xstrndup (p + 1, strcspn (p + 1, " \n"));
+	}
+    }
+  free (line);
+  xfclose (fp);
+  TEST_VERIFY_EXIT (policy != NULL);
+  return policy;
+}
+
+static void *
+allocation_thread_function (void *closure)
+{
+  unsigned char *blocks[block_count];
+
+  for (size_t i = 0; i < array_length (blocks); ++i)
+    {
+      blocks[i] = xmalloc (block_size);
+      memset (blocks[i], i, block_size);
+    }
+
+  char *policy = mapping_policy ((uintptr_t) blocks[0]);
+  printf ("info: thread heap policy: %s\n", policy);
+  TEST_VERIFY (strncmp (policy, "prefer:", strlen ("prefer:")) == 0);
+  free (policy);
+
+  for (size_t i = 0; i < array_length (blocks); ++i)
+    {
+      for (size_t j = 0; j < block_size; ++j)
+	if (blocks[i][j] != (unsigned char) i)
+	  FAIL_EXIT1 ("block %zu corrupted at offset %zu", i, j);
+      free (blocks[i]);
+    }
+  return NULL;
+}
+
+static int
+do_test (void)
+{
+  if (access ("/proc/self/numa_maps", R_OK) != 0)
+    FAIL_UNSUPPORTED ("/proc/self/numa_maps not available");
+
+  /* Check that the memory policy can be set at all.  Container
+     sandboxes commonly reject mbind.  */
+  size_t pagesize = sysconf (_SC_PAGESIZE);
+  void *page = xmmap (NULL, pagesize, PROT_READ | PROT_WRITE,
+		      MAP_PRIVATE | MAP_ANONYMOUS, -1);
+  unsigned long int mask = 1;
+  if (syscall (SYS_mbind, page, pagesize, 1 /* MPOL_PREFERRED */,
+	       &mask, 8 * sizeof (mask) + 1, 0) != 0)
+    FAIL_UNSUPPORTED ("mbind: %m");
+  xmunmap (page, pagesize);
+
+  pthread_t threads[thread_count];
+  for (size_t i = 0; i < array_length (threads); ++i)
+    threads[i] = xpthread_create (NULL, allocation_thread_function, NULL);
+  for (size_t i = 0; i < array_length (threads); ++i)
+    xpthread_join (threads[i]);
+
+  /* Now that the process is no longer single-threaded, the main thread
+     is moved off the main arena as well.  */
+  allocation_thread_function (NULL);
+
+  malloc_trim (0);
+  return 0;
+}
+
+#include <support/test-driver.c>
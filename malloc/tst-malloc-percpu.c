@@ -0,0 +1,106 @@
+/* Test per-CPU arena selection (glibc.malloc.percpu).
+   Copyright (C) 2018 Free Software Foundation, Inc.
+   This file is part of the GNU C Library.
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; if not, see
+   <http://www.gnu.org/licenses/>.  */
+
+/* Start many more threads than there are CPUs, let each of them
+   allocate and free memory from a tight loop, and check that the
+   number of arenas is bounded by the number of CPUs instead of by the
+   number of threads.  */
+
+#include <array_length.h>
+#include <malloc.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/sysinfo.h>
+#include <support/check.h>
+#include <support/support.h>
+#include <support/xmemstream.h>
+#include <support/xthread.h>
+
+static pthread_barrier_t barrier;
+
+enum
+  {
+    thread_count = 64,
+    iterations = 1000,
+  };
+
+static void *
+allocation_thread_function (void *closure)
+{
+  void *blocks[16];
+
+  xpthread_barrier_wait (&barrier);
+  for (int i = 0; i < iterations; ++i)
+    {
+      for (size_t j = 0; j < array_length (blocks); ++j)
+	{
+	  blocks[j] = xmalloc (16 + 48 * j);
+	  memset (blocks[j], 0xa5, 16 + 48 * j);
+	}
+      for (size_t j = 0; j < array_length (blocks); ++j)
+	free (blocks[j]);
+    }
+  xpthread_barrier_wait (&barrier);
+
+  return NULL;
+}
+
+/* Count the number of arenas reported by malloc_info.  */
+static int
+count_arenas (void)
+{
+  struct xmemstream info;
+  xopen_memstream (&info);
+  TEST_VERIFY_EXIT (malloc_info (0, info.out) == 0);
+  xfclose_memstream (&info);
+
+  int count = 0;
+  for (const char *p = info.buffer; (p = strstr (p, "<heap nr=")) != NULL;
+       ++p)
+    ++count;
+  free (info.buffer);
+  return count;
+}
+
+static int
+do_test (void)
+{
+  xpthread_barrier_init (&barrier, NULL, thread_count + 1);
+
+  pthread_t threads[thread_count];
+  for (size_t i = 0; i < array_length (threads); ++i)
+    threads[i] = xpthread_create (NULL, allocation_thread_function, NULL);
+
+  xpthread_barrier_wait (&barrier);
+  xpthread_barrier_wait (&barrier);
+
+  /* The main arena, plus at most one arena per CPU.  */
+  int arenas = count_arenas ();
+  int cpus = get_nprocs ();
+  printf ("info: %d arenas for %d threads on %d CPUs\n",
+	  arenas, thread_count, cpus);
+  TEST_VERIFY (arenas <= cpus + 1);
+
+  for (size_t i = 0; i < array_length (threads); ++i)
+    xpthread_join (threads[i]);
+
+  return 0;
+}
+
+#include <support/test-driver.c>
@@ -0,0 +1,220 @@
+/* Test the sampling heap profiler (glibc.malloc.profile_interval).
+   Copyright (C) 2018 Free Software Foundation, Inc.
+   This file is part of the GNU C Library.
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; if not, see
+   <http://www.gnu.org/licenses/>.  */
+
+/* The test runs with a sampling interval of 4096 bytes and the
+   profile signal set to 12.  It allocates memory from several threads
+   through all allocation functions, and checks the counts in the
+   profiles written by malloc_profile and by the signal handler.  */
+
+#include <errno.h>
+#include <malloc.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <support/check.h>
+#include <support/support.h>
+#include <support/temp_file.h>
+#include <support/xsignal.h>
+#include <support/xstdio.h>
+#include <support/xthread.h>
+#include <support/xunistd.h>
+
+enum
+  {
+    interval = 4096,
+    profile_signal = 12,
+    thread_count = 4,
+    block_count = 2000,
+    block_size = 200,
+  };
+
+struct counts
+{
+  size_t live_count;
+  size_t live_bytes;
+  size_t alloc_count;
+  size_t alloc_bytes;
+};
+
+/* Parse the header of the profile in BUFFER.  */
+static struct counts
+parse_profile (const char *buffer)
+{
+  struct counts c;
+  unsigned long int rate;
+  char *p = (char *) buffer;
+
+  if (strncmp (p, "heap profile: ", strlen ("heap profile: ")) != 0)
+    FAIL_EXIT1 ("invalid profile header: %.40s", buffer);
+  p += strlen ("heap profile: ");
+  c.live_count = strtoul (p, &p, 10);
+  TEST_VERIFY_EXIT (*p++ == ':');
+  c.live_bytes = strtoul (p, &p, 10);
+  TEST_VERIFY_EXIT (strncmp (p, " [", 2) == 0);
+  c.alloc_count = strtoul (p + 2, &p, 10);
+  TEST_VERIFY_EXIT (*p++ == ':');
+  c.alloc_bytes = strtoul (p, &p, 10);
+  static const char version[] = "] @ heap_v2/";
+  TEST_VERIFY_EXIT (strncmp (p, version, strlen (version)) == 0);
+  rate = strtoul (p + strlen (version), &p, 10);
+  TEST_COMPARE (rate, interval);
+  TEST_VERIFY_EXIT (*p == '\n');
+
+  /* There is a stack for every sample.  */
+  if (c.alloc_count > 0)
+    TEST_VERIFY (strstr (p, "] @ 0x") != NULL);
+  TEST_VERIFY (strstr (p, "\nMAPPED_LIBRARIES:\n") != NULL);
+  return c;
+}
+
+/* The stream get_profile writes to, and its buffer.  get_profile
+   does not allocate memory, so that the live counts of two profiles
+   only differ by the blocks allocated and freed in between.  */
+static FILE *profile_fp;
+static char profile_fp_buffer[BUFSIZ];
+static char profile_buffer[256 * 1024];
+
+static struct counts
+get_profile (void)
+{
+  int fd = fileno (profile_fp);
+  xftruncate (fd, 0);
+  rewind (profile_fp);
+  TEST_COMPARE (malloc_profile (0, profile_fp), 0);
+  TEST_COMPARE (fflush (profile_fp), 0);
+  ssize_t n = pread (fd, profile_buffer, sizeof (profile_buffer) - 1, 0);
+  TEST_VERIFY_EXIT (n > 0 && n < sizeof (profile_buffer) - 1);
+  profile_buffer[n] = '\0';
+  struct counts c = parse_profile (profile_buffer);
+  printf ("info: live %zu/%zu, total %zu/%zu\n", c.live_count, c.live_bytes,
+	  c.alloc_count, c.alloc_bytes);
+  return c;
+}
+
+static void *blocks[thread_count][block_count];
+
+static void *
+allocation_thread_function (void *closure)
+{
+  void **b = closure;
+
+  for (size_t i = 0; i < block_count; ++i)
+    {
+      switch (i % 4)
+	{
+	case 0:
+	  b[i] = xmalloc (block_size);
+	  break;
+	case 1:
+	  b[i] = xcalloc (1, block_size);
+	  break;
+	case 2:
+	  b[i] = xrealloc (NULL, block_size);
+	  break;
+	case 3:
+	  b[i] = memalign (64, block_size);
+	  TEST_VERIFY_EXIT (b[i] != NULL);
+	  break;
+	}
+      memset (b[i], 0xa5, block_size);
+    }
+  return NULL;
+}
+
+static void *
+free_thread_function (void *closure)
+{
+  void **b = closure;
+
+  for (size_t i = 0; i < block_count; ++i)
+    free (b[i]);
+  return NULL;
+}
+
+static int
+do_test (void)
+{
+  TEST_COMPARE (malloc_profile (1, stdout), -1);
+  TEST_COMPARE (errno, EINVAL);
+
+  int fd = create_temp_file ("tst-malloc-profile-", NULL);
+  TEST_VERIFY_EXIT (fd >= 0);
+  profile_fp = fdopen (fd, "w");
+  TEST_VERIFY_EXIT (profile_fp != NULL);
+  TEST_COMPARE (setvbuf (profile_fp, profile_fp_buffer, _IOFBF,
+			 sizeof (profile_fp_buffer)), 0);
+
+  struct counts before = get_profile ();
+
+  pthread_t threads[thread_count];
+  for (size_t i = 0; i < thread_count; ++i)
+    threads[i] = xpthread_create (NULL, allocation_thread_function,
+				  blocks[i]);
+  for (size_t i = 0; i < thread_count; ++i)
+    xpthread_join (threads[i]);
+
+  /* 1.6 MB have been allocated, which gives about 400 samples.  */
+  struct counts during = get_profile ();
+  size_t samples = during.alloc_count - before.alloc_count;
+  TEST_VERIFY (samples > 200);
+  TEST_VERIFY (samples < 800);
+  /* A few samples may come from the creation of the threads, and have
+     been freed again.  */
+  TEST_VERIFY_EXIT (during.live_count >= before.live_count);
+  TEST_VERIFY (during.live_count - before.live_count + 4 >= samples);
+  TEST_VERIFY_EXIT (during.live_bytes >= before.live_bytes);
+  TEST_VERIFY (during.live_bytes - before.live_bytes
+	       >= (samples - 4) * block_size);
+
+  /* Free the blocks on other threads, and check that the samples are
+     removed from the live profile.  */
+  for (size_t i = 0; i < thread_count; ++i)
+    threads[i] = xpthread_create (NULL, free_thread_function,
+				  blocks[(i + 1) % thread_count]);
+  for (size_t i = 0; i < thread_count; ++i)
+    xpthread_join (threads[i]);
+
+  struct counts after = get_profile ();
+  TEST_VERIFY (after.alloc_count >= during.alloc_count);
+  TEST_VERIFY (after.live_count < before.live_count + samples / 4);
+
+  /* Write a profile on the signal.  */
+  char *dir = support_create_temp_directory ("tst-malloc-profile-");
+  TEST_VERIFY_EXIT (chdir (dir) == 0);
+  xraise (profile_signal);
+  char *name = xasprintf ("%s/malloc-profile.%d.0.heap",
+			  dir, (int) getpid ());
+  add_temp_file (name);
+  FILE *fp = xfopen (name, "r");
+  char *buffer = NULL;
+  size_t len = 0;
+  TEST_VERIFY_EXIT (getdelim (&buffer, &len, '\0', fp) > 0);
+  xfclose (fp);
+  struct counts c = parse_profile (buffer);
+  TEST_VERIFY (c.alloc_count >= after.alloc_count);
+  free (buffer);
+  free (name);
+  free (dir);
+  xfclose (profile_fp);
+
+  return 0;
+}
+
+#include <support/test-driver.c>
@@ -0,0 +1,153 @@
+/* Test queued cross-thread frees (glibc.malloc.remote_free).
+   Copyright (C) 2018 Free Software Foundation, Inc.
+   This file is part of the GNU C Library.
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; if not, see
+   <http://www.gnu.org/licenses/>.  */
+
+/* Allocate blocks on one thread and free them on another, so that
+   every free is queued on the producer's arena instead of taking its
+   lock.  Each block is filled with a pattern which is checked before
+   it is freed, and the memory footprint of the process is checked at
+   the end to make sure that the queued chunks are drained and reused
+   by later allocations.  Freeing a queued chunk again is detected.  */
+
+#include <array_length.h>
+#include <malloc.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <support/capture_subprocess.h>
+#include <support/check.h>
+#include <support/support.h>
+#include <support/xthread.h>
+
+enum
+  {
+    rounds = 200,
+    blocks_per_round = 256,
+  };
+
+/* These sizes are too large for the fastbins and the tcache, which
+   handle cross-thread frees without the arena lock already.  */
+static const size_t sizes[] = { 1100, 1500, 2000, 3000, 4000 };
+
+static void *blocks[blocks_per_round];
+static pthread_barrier_t barrier;
+
+static size_t
+block_size (size_t i)
+{
+  return sizes[i % array_length (sizes)];
+}
+
+static void *
+producer_thread (void *closure)
+{
+  for (unsigned int r = 0; r < rounds; ++r)
+    {
+      for (size_t i = 0; i < blocks_per_round; ++i)
+	{
+	  unsigned char *p = xmalloc (block_size (i));
+	  for (size_t j = 0; j < block_size (i); ++j)
+	    p[j] = r + i + j;
+	  blocks[i] = p;
+	}
+      xpthread_barrier_wait (&barrier);
+      /* The consumer frees the blocks.  */
+      xpthread_barrier_wait (&barrier);
+    }
+  return NULL;
+}
+
+static void *
+consumer_thread (void *closure)
+{
+  for (unsigned int r = 0; r < rounds; ++r)
+    {
+      xpthread_barrier_wait (&barrier);
+      for (size_t i = 0; i < blocks_per_round; ++i)
+	{
+	  const unsigned char *p = blocks[i];
+	  for (size_t j = 0; j < block_size (i); ++j)
+	    if (p[j] != (unsigned char) (r + i + j))
+	      FAIL_EXIT1 ("block %zu of round %u corrupted at offset %zu",
+			  i, r, j);
+	  free (blocks[i]);
+	}
+      xpthread_barrier_wait (&barrier);
+    }
+  return NULL;
+}
+
+static void *double_free_blocks[2];
+
+static void *
+double_free_thread (void *closure)
+{
+  double_free_blocks[0] = xmalloc (sizes[0]);
+  double_free_blocks[1] = xmalloc (sizes[0]);
+  xpthread_barrier_wait (&barrier);
+  /* Stay attached to the arena while the blocks are freed, so that
+     they are queued.  */
+  xpthread_barrier_wait (&barrier);
+  return NULL;
+}
+
+static void
+double_free (void *closure)
+{
+  xpthread_barrier_init (&barrier, NULL, 2);
+  pthread_t thr = xpthread_create (NULL, double_free_thread, NULL);
+  xpthread_barrier_wait (&barrier);
+  free (double_free_blocks[0]);
+  free (double_free_blocks[1]);
+  /* The first block is queued, but no longer at the head of the
+     list.  */
+  free (double_free_blocks[0]);
+  xpthread_barrier_wait (&barrier);
+  xpthread_join (thr);
+}
+
+static int
+do_test (void)
+{
+  xpthread_barrier_init (&barrier, NULL, 2);
+  pthread_t producer = xpthread_create (NULL, producer_thread, NULL);
+  pthread_t consumer = xpthread_create (NULL, consumer_thread, NULL);
+  xpthread_join (producer);
+  xpthread_join (consumer);
+  xpthread_barrier_destroy (&barrier);
+
+  /* Without reuse of the queued chunks, the producer would have
+     obtained more than 100 MiB from the system.  One round needs less
+     than 1 MiB.  */
+  struct mallinfo info = mallinfo ();
+  printf ("info: %d bytes obtained from the system\n", info.arena);
+  TEST_VERIFY (info.arena < 16 * 1024 * 1024);
+
+  struct support_capture_subprocess result
+    = support_capture_subprocess (double_free, NULL);
+  TEST_VERIFY (strstr (result.err.buffer,
+		       "double free or corruption (remote)") != NULL);
+  TEST_VERIFY (WIFSIGNALED (result.status));
+  if (WIFSIGNALED (result.status))
+    TEST_COMPARE (WTERMSIG (result.status), SIGABRT);
+  support_capture_subprocess_free (&result);
+
+  return 0;
+}
+
+#include <support/test-driver.c>
@@ -0,0 +1,147 @@
+/* Test batched tcache refill and flush (glibc.malloc.tcache_batch).
+   Copyright (C) 2018 Free Software Foundation, Inc.
+   This file is part of the GNU C Library.
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; if not, see
+   <http://www.gnu.org/licenses/>.  */
+
+/* Run a producer/consumer workload in which every block is allocated
+   on one thread and freed on another, so that the producer's tcache
+   bins keep running empty and the consumer's keep overflowing.  Each
+   block is filled with a pattern that identifies it, and the pattern
+   is checked before the block is freed, which catches chunks handed
+   out twice by a refill or returned to the arena while still
+   cached.  */
+
+#include <array_length.h>
+#include <malloc.h>
+#include <stdlib.h>
+#include <string.h>
+#include <support/check.h>
+#include <support/support.h>
+#include <support/xmemstream.h>
+#include <support/xthread.h>
+
+enum
+  {
+    rounds = 200,
+    blocks_per_round = 256,
+  };
+
+static const size_t sizes[] = { 24, 40, 100, 250, 500, 1000 };
+
+static void *blocks[blocks_per_round];
+static pthread_barrier_t barrier;
+
+static size_t
+block_size (size_t i)
+{
+  return sizes[i % array_length (sizes)];
+}
+
+static void
+fill_block (unsigned char *p, size_t size, unsigned int tag)
+{
+  for (size_t j = 0; j < size; ++j)
+    p[j] = (unsigned char) (tag + j);
+}
+
+static void
+check_block (const unsigned char *p, size_t size, unsigned int tag)
+{
+  for (size_t j = 0; j < size; ++j)
+    if (p[j] != (unsigned char) (tag + j))
+      FAIL_EXIT1 ("block %p (tag %u) corrupted at offset %zu", p, tag, j);
+}
+
+static void *
+producer_thread (void *closure)
+{
+  for (unsigned int r = 0; r < rounds; ++r)
+    {
+      for (size_t i = 0; i < blocks_per_round; ++i)
+	{
+	  blocks[i] = xmalloc (block_size (i));
+	  fill_block (blocks[i], block_size (i), r * blocks_per_round + i);
+	}
+      xpthread_barrier_wait (&barrier);
+      /* The consumer frees the blocks.  */
+      xpthread_barrier_wait (&barrier);
+    }
+  return NULL;
+}
+
+static void *
+consumer_thread (void *closure)
+{
+  for (unsigned int r = 0; r < rounds; ++r)
+    {
+      xpthread_barrier_wait (&barrier);
+      for (size_t i = 0; i < blocks_per_round; ++i)
+	{
+	  check_block (blocks[i], block_size (i), r * blocks_per_round + i);
+	  free (blocks[i]);
+	}
+      xpthread_barrier_wait (&barrier);
+    }
+  return NULL;
+}
+
+/* Allocate and free many blocks of the same size on a single thread,
+   so that refills carve several chunks from top at once and frees
+   flush full bins, and check that no chunk is handed out twice.  */
+static void *
+single_thread (void *closure)
+{
+  for (unsigned int r = 0; r < 10; ++r)
+    {
+      void *local[blocks_per_round];
+      for (size_t i = 0; i < array_length (local); ++i)
+	{
+	  local[i] = xmalloc (block_size (r));
+	  fill_block (local[i], block_size (r), i);
+	}
+      for (size_t i = 0; i < array_length (local); ++i)
+	check_block (local[i], block_size (r), i);
+      for (size_t i = 0; i < array_length (local); ++i)
+	free (local[i]);
+    }
+  return NULL;
+}
+
+static int
+do_test (void)
+{
+  xpthread_join (xpthread_create (NULL, single_thread, NULL));
+
+  xpthread_barrier_init (&barrier, NULL, 2);
+  pthread_t producer = xpthread_create (NULL, producer_thread, NULL);
+  pthread_t consumer = xpthread_create (NULL, consumer_thread, NULL);
+  xpthread_join (producer);
+  xpthread_join (consumer);
+  xpthread_barrier_destroy (&barrier);
+
+  /* Both threads have exited and released their caches.  Walking the
+     heap checks that the chunks ended up in a consistent state.  */
+  struct xmemstream info;
+  xopen_memstream (&info);
+  TEST_VERIFY (malloc_info (0, info.out) == 0);
+  xfclose_memstream (&info);
+  free (info.buffer);
+  malloc_trim (0);
+
+  return 0;
+}
+
+#include <support/test-driver.c>
@@ -0,0 +1,219 @@
+/* Test the allocation trace recorder (glibc.malloc.trace_file).
+   Copyright (C) 2018 Free Software Foundation, Inc.
+   This file is part of the GNU C Library.
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; if not, see
+   <http://www.gnu.org/licenses/>.  */
+
+/* The threads of the test perform a known sequence of calls.  Their
+   records are written to the trace file when they exit, so the test
+   reads the file after joining them.  Tracing starts with the first
+   call to malloc, which happens in the subprocess running do_test, so
+   the name of the trace file carries the process ID of the test.  */
+
+#include <fcntl.h>
+#include <malloc.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <malloc/malloc-trace.h>
+#include <support/check.h>
+#include <support/support.h>
+#include <support/xthread.h>
+#include <support/xunistd.h>
+
+enum
+  {
+    thread_count = 4,
+    /* Enough calls to fill the buffer of a thread several times.  */
+    repeat_count = 2000,
+  };
+
+struct thread_calls
+{
+  unsigned int index;
+  void *blocks[5];
+};
+
+/* The calls made by thread INDEX.  The sizes are distinct per
+   thread.  */
+static void *
+thread_function (void *closure)
+{
+  struct thread_calls *c = closure;
+  size_t base = c->index * 8;
+
+  /* Fill the buffer.  These calls are only counted.  */
+  for (int i = 0; i < repeat_count; ++i)
+    free (xmalloc (16));
+
+  c->blocks[0] = xmalloc (1000 + base);
+  c->blocks[1] = xcalloc (3, 100 + base);
+  c->blocks[2] = xrealloc (c->blocks[0], 5000 + base);
+  c->blocks[3] = memalign (64, 200 + base);
+  TEST_VERIFY_EXIT (c->blocks[3] != NULL);
+  c->blocks[4] = aligned_alloc (4096, 300 + base);
+  TEST_VERIFY_EXIT (c->blocks[4] != NULL);
+  free (c->blocks[1]);
+  free (c->blocks[2]);
+  free_sized (c->blocks[3], 200 + base);
+  free (NULL);
+  free (c->blocks[4]);
+  return NULL;
+}
+
+/* Return the name of the trace file of this process.  */
+static char *
+trace_file_name (void)
+{
+  const char *tunables = getenv ("GLIBC_TUNABLES");
+  TEST_VERIFY_EXIT (tunables != NULL);
+  const char *key = "glibc.malloc.trace_file=";
+  const char *p = strstr (tunables, key);
+  TEST_VERIFY_EXIT (p != NULL);
+  p += strlen (key);
+  return xasprintf ("%.*s.%d", (int) strcspn (p, ":"), p, (int) getpid ());
+}
+
+static void
+check_record (const struct malloc_trace_record *r, uint32_t op, void *ptr,
+	      uint64_t arg, uint64_t size)
+{
+  TEST_COMPARE (r->op, op);
+  TEST_VERIFY (r->ptr == (uintptr_t) ptr);
+  TEST_COMPARE (r->arg, arg);
+  TEST_COMPARE (r->size, size);
+}
+
+static int
+compare_seq (const void *l, const void *r)
+{
+  const struct malloc_trace_record *left = l;
+  const struct malloc_trace_record *right = r;
+  if (left->seq < right->seq)
+    return -1;
+  return left->seq > right->seq;
+}
+
+static int
+do_test (void)
+{
+  struct thread_calls calls[thread_count];
+  pthread_t threads[thread_count];
+  for (unsigned int i = 0; i < thread_count; ++i)
+    {
+      calls[i].index = i;
+      threads[i] = xpthread_create (NULL, thread_function, &calls[i]);
+    }
+  for (unsigned int i = 0; i < thread_count; ++i)
+    xpthread_join (threads[i]);
+
+  /* Read the trace.  */
+  char *name = trace_file_name ();
+  int fd = xopen (name, O_RDONLY, 0);
+  size_t size = 0, allocated = 1024 * 1024;
+  char *data = xmalloc (allocated);
+  while (true)
+    {
+      if (size == allocated)
+	{
+	  allocated *= 2;
+	  data = xrealloc (data, allocated);
+	}
+      ssize_t n = read (fd, data + size, allocated - size);
+      TEST_VERIFY_EXIT (n >= 0);
+      if (n == 0)
+	break;
+      size += n;
+    }
+  xclose (fd);
+  xunlink (name);
+  free (name);
+
+  struct malloc_trace_header header;
+  TEST_VERIFY_EXIT (size >= sizeof (header));
+  memcpy (&header, data, sizeof (header));
+  TEST_VERIFY (memcmp (header.magic, MALLOC_TRACE_MAGIC, 8) == 0);
+  TEST_COMPARE (header.version, MALLOC_TRACE_VERSION);
+  TEST_COMPARE (header.record_size, sizeof (struct malloc_trace_record));
+  size_t count = (size - sizeof (header)) / header.record_size;
+  TEST_COMPARE ((size - sizeof (header)) % header.record_size, 0);
+  struct malloc_trace_record *records
+    = xmalloc (count * sizeof (*records));
+  memcpy (records, data + sizeof (header), count * sizeof (*records));
+  free (data);
+
+  for (unsigned int i = 0; i < thread_count; ++i)
+    {
+      size_t base = i * 8;
+      struct thread_calls *c = &calls[i];
+
+      /* The call to realloc identifies the records of the thread.  */
+      uint32_t thread = 0;
+      for (size_t j = 0; j < count && thread == 0; ++j)
+	if (records[j].op == malloc_trace_realloc
+	    && records[j].arg == (uintptr_t) c->blocks[0]
+	    && records[j].size == 5000 + base)
+	  thread = records[j].thread;
+      TEST_VERIFY_EXIT (thread != 0);
+
+      /* Collect the records of the thread, which appear in order.  */
+      struct malloc_trace_record *own = xmalloc (count * sizeof (*own));
+      size_t nown = 0;
+      for (size_t j = 0; j < count; ++j)
+	if (records[j].thread == thread)
+	  {
+	    if (nown > 0)
+	      TEST_VERIFY (records[j].seq > own[nown - 1].seq);
+	    own[nown++] = records[j];
+	  }
+      TEST_COMPARE (nown, 2 * repeat_count + 9);
+      for (size_t j = 0; j < 2 * repeat_count; j += 2)
+	{
+	  check_record (&own[j], malloc_trace_malloc, (void *) own[j].ptr,
+			0, 16);
+	  check_record (&own[j + 1], malloc_trace_free, (void *) own[j].ptr,
+			0, 0);
+	}
+
+      struct malloc_trace_record *r = own + 2 * repeat_count;
+      check_record (&r[0], malloc_trace_malloc, c->blocks[0], 0,
+		    1000 + base);
+      check_record (&r[1], malloc_trace_calloc, c->blocks[1], 3,
+		    3 * (100 + base));
+      check_record (&r[2], malloc_trace_realloc, c->blocks[2],
+		    (uintptr_t) c->blocks[0], 5000 + base);
+      check_record (&r[3], malloc_trace_memalign, c->blocks[3], 64,
+		    200 + base);
+      check_record (&r[4], malloc_trace_memalign, c->blocks[4], 4096,
+		    300 + base);
+      check_record (&r[5], malloc_trace_free, c->blocks[1], 0, 0);
+      check_record (&r[6], malloc_trace_free, c->blocks[2], 0, 0);
+      check_record (&r[7], malloc_trace_free, c->blocks[3], 0, 0);
+      check_record (&r[8], malloc_trace_free, c->blocks[4], 0, 0);
+      free (own);
+    }
+
+  /* The sequence numbers are unique.  */
+  qsort (records, count, sizeof (*records), compare_seq);
+  for (size_t i = 1; i < count; ++i)
+    TEST_VERIFY (records[i - 1].seq < records[i].seq);
+
+  free (records);
+  return 0;
+}
+
+#include <support/test-driver.c>
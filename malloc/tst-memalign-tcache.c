@@ -0,0 +1,149 @@
+/* Test the tcache bins for cache line and page aligned allocations.
+   Copyright (C) 2018 Free Software Foundation, Inc.
+   This file is part of the GNU C Library.
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; if not, see
+   <http://www.gnu.org/licenses/>.  */
+
+#include <malloc.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <support/check.h>
+#include <support/support.h>
+#include <support/xthread.h>
+
+enum
+  {
+    thread_count = 4,
+    block_count = 7,
+  };
+
+static size_t pagesize;
+
+static void *
+xaligned_alloc (size_t alignment, size_t size)
+{
+  void *p = aligned_alloc (alignment, size);
+  if (p == NULL)
+    FAIL_EXIT1 ("aligned_alloc (%zu, %zu) failed", alignment, size);
+  if (((uintptr_t) p & (alignment - 1)) != 0)
+    FAIL_EXIT1 ("aligned_alloc (%zu, %zu) returned %p", alignment, size, p);
+  memset (p, 0xa5, size);
+  return p;
+}
+
+/* Check that freed blocks of SIZE bytes aligned to ALIGNMENT are
+   reused by the next requests for the same alignment and size.  */
+static void
+check_reuse (size_t alignment, size_t size)
+{
+  void *blocks[block_count];
+  for (size_t i = 0; i < block_count; ++i)
+    blocks[i] = xaligned_alloc (alignment, size);
+  for (size_t i = 0; i < block_count; ++i)
+    free (blocks[block_count - 1 - i]);
+  /* The tcache returns the blocks in reverse order of freeing.  */
+  for (size_t i = 0; i < block_count; ++i)
+    {
+      void *p = xaligned_alloc (alignment, size);
+      if (p != blocks[i])
+	{
+	  support_record_failure ();
+	  printf ("error: aligned_alloc (%zu, %zu) returned %p, expected %p\n",
+		  alignment, size, p, blocks[i]);
+	}
+    }
+  for (size_t i = 0; i < block_count; ++i)
+    free (blocks[i]);
+}
+
+static void *
+thread_function (void *closure)
+{
+  for (size_t size = 1; size <= 1024; size += 13)
+    check_reuse (64, size);
+  for (size_t size = 1; size <= 4 * pagesize; size += 509)
+    check_reuse (pagesize, size);
+  return NULL;
+}
+
+/* Free a page aligned block which is mmapped with free_aligned_sized.
+   It must not enter the aligned bins, which are flushed to the arena
+   when the thread exits.  */
+static void *
+mmapped_thread (void *closure)
+{
+  void *p = xaligned_alloc (pagesize, 2 * pagesize);
+  free_aligned_sized (p, pagesize, 2 * pagesize);
+  p = xaligned_alloc (pagesize, 2 * pagesize);
+  free (p);
+  return NULL;
+}
+
+static int
+do_test (void)
+{
+  pagesize = sysconf (_SC_PAGESIZE);
+
+  for (size_t size = 0; size <= 1024; ++size)
+    {
+      check_reuse (32, size);
+      check_reuse (64, size);
+    }
+  for (size_t size = 1; size <= 4 * pagesize; size += 127)
+    {
+      check_reuse (128, size);
+      check_reuse (pagesize, size);
+    }
+
+  /* Other allocation functions share the bins.  */
+  void *p = xaligned_alloc (64, 200);
+  free (p);
+  void *q;
+  TEST_COMPARE (posix_memalign (&q, 64, 200), 0);
+  TEST_VERIFY (q == p);
+  free_aligned_sized (q, 64, 200);
+  q = memalign (64, 200);
+  TEST_VERIFY (q == p);
+  free (q);
+  p = valloc (100);
+  TEST_VERIFY_EXIT (p != NULL);
+  free (p);
+  q = xaligned_alloc (pagesize, 100);
+  TEST_VERIFY (q == p);
+  free (q);
+
+  /* Requests which are too large for the bins.  */
+  p = xaligned_alloc (64, 1025);
+  free (p);
+  p = xaligned_alloc (pagesize, 4 * pagesize + 1);
+  free (p);
+  p = xaligned_alloc (2 * pagesize, 100);
+  free (p);
+
+  pthread_t threads[thread_count];
+  for (size_t i = 0; i < thread_count; ++i)
+    threads[i] = xpthread_create (NULL, thread_function, NULL);
+  for (size_t i = 0; i < thread_count; ++i)
+    xpthread_join (threads[i]);
+
+  TEST_COMPARE (mallopt (M_MMAP_THRESHOLD, pagesize), 1);
+  xpthread_join (xpthread_create (NULL, mmapped_thread, NULL));
+
+  return 0;
+}
+
+#include <support/test-driver.c>
@@ -33,6 +33,11 @@
 #include <kernel-features.h>
 #include <stack-aliasing.h>
 
+#if HAVE_TUNABLES
+# define TUNABLE_NAMESPACE pthread
+#endif
+#include <elf/dl-tunables.h>
+
 
 #ifndef NEED_SEPARATE_REGISTER_STACK
 
@@ -102,22 +107,51 @@
 
 /* Cache handling for not-yet free stacks.  */
 
-/* Maximum size in kB of cache.  */
+/* Maximum size in bytes of the cache, see the
+   glibc.pthread.stack_cache_size tunable.  */
 static size_t stack_cache_maxsize = 40 * 1024 * 1024; /* 40MiBi by default.  */
+/* Size of the stacks in all shards of the cache.  Updated atomically
+   because the shards are protected by different locks.  */
 static size_t stack_cache_actsize;
 
-/* Mutex protecting this variable.  */
+/* Number of bytes at the top of new stacks which are faulted in when
+   the stack is allocated, and whether new stacks use transparent huge
+   pages.  See the glibc.pthread.stack_prefault and
+   glibc.pthread.stack_hugetlb tunables.  */
+static size_t stack_prefault_size;
+static int32_t stack_hugetlb;
+
+/* Mutex protecting the lists of stacks in use.  When both are needed,
+   the lock of a cache shard is acquired first.  */
 static int stack_cache_lock = LLL_LOCK_INITIALIZER;
 
-/* List of queued stack frames.  */
-static LIST_HEAD (stack_cache);
+/* The cache of unused stacks is split into shards, so that threads
+   creating threads do not all contend for one lock.  A stack is
+   returned to the shard of the thread which created it (the
+   stack_cache_shard member of struct pthread), and a thread looks
+   for a stack in its own shard first.  */
+#define STACK_CACHE_SHARDS 8
+
+struct stack_cache_shard
+{
+  /* Protects the members below.  */
+  int lock;
+  /* List of queued stack frames.  */
+  list_t list;
+  /* See in_flight_stack.  */
+  uintptr_t in_flight;
+} __attribute__ ((aligned (64)));
+
+/* The lists are initialized in __nptl_stack_cache_init.  */
+static struct stack_cache_shard stack_cache[STACK_CACHE_SHARDS];
 
 /* List of the stacks in use.  */
 static LIST_HEAD (stack_used);
 
 /* We need to record what list operations we are going to do so that,
    in case of an asynchronous interruption due to a fork() call, we
-   can correct for the work.  */
+   can correct for the work.  This covers the lists of stacks in use;
+   each shard of the cache has its own record.  */
 static uintptr_t in_flight_stack;
 
 /* List of the threads with user provided stacks in use.  No need to
@@ -131,9 +165,9 @@ hidden_data_def (__stack_user)
 
 
 static void
-stack_list_del (list_t *elem)
+recorded_list_del (list_t *elem, uintptr_t *in_flight)
 {
-  in_flight_stack = (uintptr_t) elem;
+  *in_flight = (uintptr_t) elem;
 
   atomic_write_barrier ();
 
@@ -141,14 +175,14 @@ stack_list_del (list_t *elem)
 
   atomic_write_barrier ();
 
-  in_flight_stack = 0;
+  *in_flight = 0;
 }
 
 
 static void
-stack_list_add (list_t *elem, list_t *list)
+recorded_list_add (list_t *elem, list_t *list, uintptr_t *in_flight)
 {
-  in_flight_stack = (uintptr_t) elem | 1;
+  *in_flight = (uintptr_t) elem | 1;
 
   atomic_write_barrier ();
 
@@ -156,7 +190,30 @@ stack_list_add (list_t *elem, list_t *list)
 
   atomic_write_barrier ();
 
-  in_flight_stack = 0;
+  *in_flight = 0;
+}
+
+
+static void
+stack_list_del (list_t *elem)
+{
+  recorded_list_del (elem, &in_flight_stack);
+}
+
+
+static void
+stack_list_add (list_t *elem, list_t *list)
+{
+  recorded_list_add (elem, list, &in_flight_stack);
+}
+
+
+/* Return the shard of the cache used by the calling thread.  */
+static inline unsigned int
+stack_cache_shard_self (void)
+{
+  return ((unsigned int) THREAD_GETMEM (THREAD_SELF, tid)
+	  % STACK_CACHE_SHARDS);
 }
 
 
@@ -164,16 +221,15 @@ stack_list_add (list_t *elem, list_t *list)
    because this allows removing entries from the end.  */
 
 
-/* Get a stack frame from the cache.  We have to match by size since
-   some blocks might be too small or far too large.  */
+/* Look for a stack of at least SIZE bytes in SHARD.  If one is found,
+   move it to the list of stacks in use and return it.  */
 static struct pthread *
-get_cached_stack (size_t *sizep, void **memp)
+get_cached_stack_shard (struct stack_cache_shard *shard, size_t size)
 {
-  size_t size = *sizep;
   struct pthread *result = NULL;
   list_t *entry;
 
-  lll_lock (stack_cache_lock, LLL_PRIVATE);
+  lll_lock (shard->lock, LLL_PRIVATE);
 
   /* Search the cache for a matching entry.  We search for the
      smallest stack which has at least the required size.  Note that
@@ -181,7 +237,7 @@ get_cached_stack (size_t *sizep, void **memp)
      same.  As the very least there are only a few different sizes.
      Therefore this loop will exit early most of the time with an
      exact match.  */
-  list_for_each (entry, &stack_cache)
+  list_for_each (entry, &shard->list)
     {
       struct pthread *curr;
 
@@ -206,7 +262,7 @@ get_cached_stack (size_t *sizep, void **memp)
       || __builtin_expect (result->stackblock_size > 4 * size, 0))
     {
       /* Release the lock.  */
-      lll_unlock (stack_cache_lock, LLL_PRIVATE);
+      lll_unlock (shard->lock, LLL_PRIVATE);
 
       return NULL;
     }
@@ -215,16 +271,47 @@ get_cached_stack (size_t *sizep, void **memp)
   result->setxid_futex = -1;
 
   /* Dequeue the entry.  */
-  stack_list_del (&result->list);
+  recorded_list_del (&result->list, &shard->in_flight);
 
-  /* And add to the list of stacks in use.  */
+  /* And add to the list of stacks in use.  We still hold the lock of
+     the shard, so that __make_stacks_executable sees the stack on one
+     of the lists.  */
+  lll_lock (stack_cache_lock, LLL_PRIVATE);
   stack_list_add (&result->list, &stack_used);
+  lll_unlock (stack_cache_lock, LLL_PRIVATE);
 
   /* And decrease the cache size.  */
-  stack_cache_actsize -= result->stackblock_size;
+  atomic_fetch_add_relaxed (&stack_cache_actsize, -result->stackblock_size);
 
   /* Release the lock early.  */
-  lll_unlock (stack_cache_lock, LLL_PRIVATE);
+  lll_unlock (shard->lock, LLL_PRIVATE);
+
+  return result;
+}
+
+
+/* Get a stack frame from the cache.  We have to match by size since
+   some blocks might be too small or far too large.  */
+static struct pthread *
+get_cached_stack (size_t *sizep, void **memp)
+{
+  size_t size = *sizep;
+  struct pthread *result = NULL;
+
+  /* Avoid locking all shards if the cache is empty.  */
+  if (atomic_load_relaxed (&stack_cache_actsize) == 0)
+    return NULL;
+
+  /* Try our own shard first, then take a stack from the others.  */
+  unsigned int home = stack_cache_shard_self ();
+  for (unsigned int i = 0; i < STACK_CACHE_SHARDS && result == NULL; ++i)
+    result = get_cached_stack_shard
+      (&stack_cache[(home + i) % STACK_CACHE_SHARDS], size);
+  if (result == NULL)
+    return NULL;
+
+  /* The stack goes back to our shard when it is freed.  */
+  result->stack_cache_shard = home;
 
   /* Report size and location of the stack to the caller.  */
   *sizep = result->stackblock_size;
@@ -250,9 +337,12 @@ get_cached_stack (size_t *sizep, void **memp)
 }
 
 
-/* Free stacks until cache size is lower than LIMIT.  */
+/* Remove stacks from SHARD until the size of the cache is lower than
+   LIMIT, and put them on the list FREED.  Must be called with the lock
+   of SHARD held.  The caller releases the stacks with release_stacks
+   after dropping the lock.  */
 static void
-free_stacks (size_t limit)
+free_stacks (struct stack_cache_shard *shard, size_t limit, list_t *freed)
 {
   /* We reduce the size of the cache.  Remove the last entries until
      the size is below the limit.  */
@@ -260,7 +350,7 @@ free_stacks (size_t limit)
   list_t *prev;
 
   /* Search from the end of the list.  */
-  list_for_each_prev_safe (entry, prev, &stack_cache)
+  list_for_each_prev_safe (entry, prev, &shard->list)
     {
       struct pthread *curr;
 
@@ -268,23 +358,60 @@ free_stacks (size_t limit)
       if (FREE_P (curr))
 	{
 	  /* Unlink the block.  */
-	  stack_list_del (entry);
+	  recorded_list_del (entry, &shard->in_flight);
+	  list_add (entry, freed);
+
+	  /* Account for the freed memory.  Maybe we have freed
+	     enough.  */
+	  if (atomic_fetch_add_relaxed (&stack_cache_actsize,
+					-curr->stackblock_size)
+	      - curr->stackblock_size <= limit)
+	    break;
+	}
+    }
+}
 
-	  /* Account for the freed memory.  */
-	  stack_cache_actsize -= curr->stackblock_size;
+/* Remove stacks from the shards other than SKIP until the size of the
+   cache is lower than its limit, and put them on the list FREED.  Used
+   when free_stacks could not free enough in shard SKIP, because its
+   stacks are still in use by the kernel or have been handed out to
+   other shards.  Must be called without a shard lock held.  */
+static void
+free_stacks_other (unsigned int skip, list_t *freed)
+{
+  for (unsigned int i = 1;
+       i < STACK_CACHE_SHARDS
+       && atomic_load_relaxed (&stack_cache_actsize) > stack_cache_maxsize;
+       ++i)
+    {
+      struct stack_cache_shard *shard
+	= &stack_cache[(skip + i) % STACK_CACHE_SHARDS];
 
-	  /* Free the memory associated with the ELF TLS.  */
-	  _dl_deallocate_tls (TLS_TPADJ (curr), false);
+      lll_lock (shard->lock, LLL_PRIVATE);
+      if (atomic_load_relaxed (&stack_cache_actsize) > stack_cache_maxsize)
+	free_stacks (shard, stack_cache_maxsize, freed);
+      lll_unlock (shard->lock, LLL_PRIVATE);
+    }
+}
 
-	  /* Remove this block.  This should never fail.  If it does
-	     something is really wrong.  */
-	  if (__munmap (curr->stackblock, curr->stackblock_size) != 0)
-	    abort ();
+/* Release the memory of the stacks on the list FREED.  */
+static void
+release_stacks (list_t *freed)
+{
+  list_t *entry;
+  list_t *prev;
 
-	  /* Maybe we have freed enough.  */
-	  if (stack_cache_actsize <= limit)
-	    break;
-	}
+  list_for_each_prev_safe (entry, prev, freed)
+    {
+      struct pthread *curr = list_entry (entry, struct pthread, list);
+
+      /* Free the memory associated with the ELF TLS.  */
+      _dl_deallocate_tls (TLS_TPADJ (curr), false);
+
+      /* Remove this block.  This should never fail.  If it does
+	 something is really wrong.  */
+      if (__munmap (curr->stackblock, curr->stackblock_size) != 0)
+	abort ();
     }
 }
 
@@ -292,23 +419,34 @@ free_stacks (size_t limit)
 void
 __nptl_stacks_freeres (void)
 {
-  free_stacks (0);
+  for (unsigned int i = 0; i < STACK_CACHE_SHARDS; ++i)
+    {
+      LIST_HEAD (freed);
+
+      lll_lock (stack_cache[i].lock, LLL_PRIVATE);
+      free_stacks (&stack_cache[i], 0, &freed);
+      lll_unlock (stack_cache[i].lock, LLL_PRIVATE);
+      release_stacks (&freed);
+    }
 }
 
 /* Add a stack frame which is not used anymore to the stack.  Must be
-   called with the cache lock held.  */
+   called with the lock of SHARD held.  Stacks which have to be freed
+   to keep the cache under its limit are put on the list FREED.  */
 static inline void
 __attribute ((always_inline))
-queue_stack (struct pthread *stack)
+queue_stack (struct stack_cache_shard *shard, struct pthread *stack,
+	     list_t *freed)
 {
   /* We unconditionally add the stack to the list.  The memory may
      still be in use but it will not be reused until the kernel marks
      the stack as not used anymore.  */
-  stack_list_add (&stack->list, &stack_cache);
+  recorded_list_add (&stack->list, &shard->list, &shard->in_flight);
 
-  stack_cache_actsize += stack->stackblock_size;
-  if (__glibc_unlikely (stack_cache_actsize > stack_cache_maxsize))
-    free_stacks (stack_cache_maxsize);
+  if (__glibc_unlikely (atomic_fetch_add_relaxed (&stack_cache_actsize,
+						  stack->stackblock_size)
+			+ stack->stackblock_size > stack_cache_maxsize))
+    free_stacks (shard, stack_cache_maxsize, freed);
 }
 
 
@@ -377,6 +515,28 @@ setup_stack_prot (char *mem, size_t size, char *guard, size_t guardsize,
   return 0;
 }
 
+/* Fault in the top pages of the new stack MEM of SIZE bytes, where the
+   thread starts running, so that it does not take page faults right
+   after it starts.  See the glibc.pthread.stack_prefault tunable.  */
+static inline void
+__always_inline
+prefault_stack (char *mem, size_t size, size_t guardsize, size_t pagesize_m1)
+{
+#if _STACK_GROWS_DOWN && !defined(NEED_SEPARATE_REGISTER_STACK)
+  if (stack_prefault_size == 0)
+    return;
+
+  char *start = mem + guardsize;
+  if (stack_prefault_size < size - guardsize)
+    start = (char *) ((uintptr_t) (mem + size - stack_prefault_size)
+		      & ~pagesize_m1);
+
+  /* The memory is still zero, so writing zero keeps it intact.  */
+  for (char *p = start; p < mem + size; p += pagesize_m1 + 1)
+    *(volatile char *) p = 0;
+#endif
+}
+
 /* Mark the memory of the stack as usable to the kernel.  It frees everything
    except for the space used for the TCB itself.  */
 static inline void
@@ -570,6 +730,13 @@ allocate_stack (const struct pthread_attr *attr, struct pthread **pdp,
 	     So we can never get a null pointer back from mmap.  */
 	  assert (mem != NULL);
 
+#ifdef MADV_HUGEPAGE
+	  /* Ask for transparent huge pages before the stack is touched.
+	     Failure is not a problem.  */
+	  if (stack_hugetlb != 0)
+	    __madvise (mem, size, MADV_HUGEPAGE);
+#endif
+
 	  /* Place the thread descriptor at the end of the stack.  */
 #if TLS_TCB_AT_TP
 	  pd = (struct pthread *) ((char *) mem + size) - 1;
@@ -592,12 +759,16 @@ allocate_stack (const struct pthread_attr *attr, struct pthread **pdp,
 		}
 	    }
 
+	  prefault_stack (mem, size, guardsize, pagesize_m1);
+
 	  /* Remember the stack-related values.  */
 	  pd->stackblock = mem;
 	  pd->stackblock_size = size;
 	  /* Update guardsize for newly allocated guardsize to avoid
 	     an mprotect in guard resize below.  */
 	  pd->guardsize = guardsize;
+	  /* The stack goes to our shard of the cache when it is freed.  */
+	  pd->stack_cache_shard = stack_cache_shard_self ();
 
 	  /* We allocated the first block thread-specific data array.
 	     This address will not change for the lifetime of this
@@ -786,23 +957,83 @@ allocate_stack (const struct pthread_attr *attr, struct pthread **pdp,
 void
 __deallocate_stack (struct pthread *pd)
 {
-  lll_lock (stack_cache_lock, LLL_PRIVATE);
+  if (__glibc_unlikely (pd->user_stack))
+    {
+      lll_lock (stack_cache_lock, LLL_PRIVATE);
 
-  /* Remove the thread from the list of threads with user defined
-     stacks.  */
-  stack_list_del (&pd->list);
+      /* Remove the thread from the list of threads with user defined
+	 stacks.  */
+      stack_list_del (&pd->list);
+
+      /* Free the memory associated with the ELF TLS.  */
+      _dl_deallocate_tls (TLS_TPADJ (pd), false);
+
+      lll_unlock (stack_cache_lock, LLL_PRIVATE);
+      return;
+    }
 
-  /* Not much to do.  Just free the mmap()ed memory.  Note that we do
-     not reset the 'used' flag in the 'tid' field.  This is done by
+  /* Not much to do.  Just put the stack into the cache.  Note that we
+     do not reset the 'used' flag in the 'tid' field.  This is done by
      the kernel.  If no thread has been created yet this field is
      still zero.  */
-  if (__glibc_likely (! pd->user_stack))
-    (void) queue_stack (pd);
-  else
-    /* Free the memory associated with the ELF TLS.  */
-    _dl_deallocate_tls (TLS_TPADJ (pd), false);
+  unsigned int home = pd->stack_cache_shard;
+  struct stack_cache_shard *shard = &stack_cache[home];
+  LIST_HEAD (freed);
+
+  lll_lock (shard->lock, LLL_PRIVATE);
 
+  /* Remove the thread from the list of stacks in use.  */
+  lll_lock (stack_cache_lock, LLL_PRIVATE);
+  stack_list_del (&pd->list);
   lll_unlock (stack_cache_lock, LLL_PRIVATE);
+
+  queue_stack (shard, pd, &freed);
+
+  lll_unlock (shard->lock, LLL_PRIVATE);
+
+  /* PD may be reused as soon as the lock is dropped, so HOME is used
+     instead of its stack_cache_shard member.  */
+  if (__glibc_unlikely (atomic_load_relaxed (&stack_cache_actsize)
+			> stack_cache_maxsize))
+    free_stacks_other (home, &freed);
+
+  /* Unmap the stacks which did not fit into the cache without holding
+     any lock.  */
+  release_stacks (&freed);
+}
+
+
+/* Initialize the stack cache.  Called once from
+   __pthread_initialize_minimal, after the default thread attributes
+   are set up.  */
+void
+__nptl_stack_cache_init (void)
+{
+  for (unsigned int i = 0; i < STACK_CACHE_SHARDS; ++i)
+    INIT_LIST_HEAD (&stack_cache[i].list);
+
+#if HAVE_TUNABLES
+  stack_cache_maxsize = TUNABLE_GET (stack_cache_size, size_t, NULL);
+  stack_prefault_size = TUNABLE_GET (stack_prefault, size_t, NULL);
+  stack_hugetlb = TUNABLE_GET (stack_hugetlb, int32_t, NULL);
+
+  /* Allocate stacks of the default size up front and put them into the
+     cache, spread over the shards.  They have not been used by a
+     thread, so they are free already.  */
+  size_t prefill = TUNABLE_GET (stack_cache_prefill, size_t, NULL);
+  for (size_t i = 0; i < prefill; ++i)
+    {
+      struct pthread *pd;
+      void *stackaddr;
+
+      if (atomic_load_relaxed (&stack_cache_actsize) >= stack_cache_maxsize
+	  || allocate_stack (&__default_pthread_attr, &pd, &stackaddr) != 0)
+	break;
+
+      pd->stack_cache_shard = i % STACK_CACHE_SHARDS;
+      __deallocate_stack (pd);
+    }
+#endif
 }
 
 
@@ -818,6 +1049,10 @@ __make_stacks_executable (void **stack_endp)
   const size_t pagemask = ~(__getpagesize () - 1);
 #endif
 
+  /* Stacks move between the cache and the list of stacks in use with
+     the lock of their shard held, so we see each stack once.  */
+  for (unsigned int i = 0; i < STACK_CACHE_SHARDS; ++i)
+    lll_lock (stack_cache[i].lock, LLL_PRIVATE);
   lll_lock (stack_cache_lock, LLL_PRIVATE);
 
   list_t *runp;
@@ -835,8 +1070,8 @@ __make_stacks_executable (void **stack_endp)
   /* Also change the permission for the currently unused stacks.  This
      might be wasted time but better spend it here than adding a check
      in the fast path.  */
-  if (err == 0)
-    list_for_each (runp, &stack_cache)
+  for (unsigned int i = 0; err == 0 && i < STACK_CACHE_SHARDS; ++i)
+    list_for_each (runp, &stack_cache[i].list)
       {
 	err = change_stack_perm (list_entry (runp, struct pthread, list)
 #ifdef NEED_SEPARATE_REGISTER_STACK
@@ -848,11 +1083,45 @@ __make_stacks_executable (void **stack_endp)
       }
 
   lll_unlock (stack_cache_lock, LLL_PRIVATE);
+  for (unsigned int i = 0; i < STACK_CACHE_SHARDS; ++i)
+    lll_unlock (stack_cache[i].lock, LLL_PRIVATE);
 
   return err;
 }
 
 
+/* Complete the list operation recorded in IN_FLIGHT, which was
+   interrupted by fork.  Additions are to the head of the list L.  */
+static void
+replay_in_flight (uintptr_t in_flight, list_t *l)
+{
+  if (in_flight == 0)
+    return;
+
+  bool add_p = in_flight & 1;
+  list_t *elem = (list_t *) (in_flight & ~(uintptr_t) 1);
+
+  if (add_p)
+    {
+      /* We always add at the beginning of the list.  So in this case we
+	 only need to check the beginning of the list to see if the
+	 pointers at the head of the list are inconsistent.  */
+      if (l->next->prev != l)
+	{
+	  assert (l->next->prev == elem);
+	  elem->next = l->next;
+	  elem->prev = l;
+	  l->next = elem;
+	}
+    }
+  else
+    {
+      /* We can simply always replay the delete operation.  */
+      elem->next->prev = elem->prev;
+      elem->prev->next = elem->next;
+    }
+}
+
 /* In case of a fork() call the memory allocation in the child will be
    the same but only one thread is running.  All stacks except that of
    the one running thread are not used anymore.  We have to recycle
@@ -865,39 +1134,9 @@ __reclaim_stacks (void)
   /* No locking necessary.  The caller is the only stack in use.  But
      we have to be aware that we might have interrupted a list
      operation.  */
-
-  if (in_flight_stack != 0)
-    {
-      bool add_p = in_flight_stack & 1;
-      list_t *elem = (list_t *) (in_flight_stack & ~(uintptr_t) 1);
-
-      if (add_p)
-	{
-	  /* We always add at the beginning of the list.  So in this case we
-	     only need to check the beginning of these lists to see if the
-	     pointers at the head of the list are inconsistent.  */
-	  list_t *l = NULL;
-
-	  if (stack_used.next->prev != &stack_used)
-	    l = &stack_used;
-	  else if (stack_cache.next->prev != &stack_cache)
-	    l = &stack_cache;
-
-	  if (l != NULL)
-	    {
-	      assert (l->next->prev == elem);
-	      elem->next = l->next;
-	      elem->prev = l;
-	      l->next = elem;
-	    }
-	}
-      else
-	{
-	  /* We can simply always replay the delete operation.  */
-	  elem->next->prev = elem->prev;
-	  elem->prev->next = elem->next;
-	}
-    }
+  replay_in_flight (in_flight_stack, &stack_used);
+  for (unsigned int i = 0; i < STACK_CACHE_SHARDS; ++i)
+    replay_in_flight (stack_cache[i].in_flight, &stack_cache[i].list);
 
   /* Mark all stacks except the still running one as free.  */
   list_t *runp;
@@ -911,6 +1150,7 @@ __reclaim_stacks (void)
 
 	  /* Account for the size of the stack.  */
 	  stack_cache_actsize += curp->stackblock_size;
+	  curp->stack_cache_shard = 0;
 
 	  if (curp->specific_used)
 	    {
@@ -935,7 +1175,7 @@ __reclaim_stacks (void)
     }
 
   /* Add the stack of all running threads to the cache.  */
-  list_splice (&stack_used, &stack_cache);
+  list_splice (&stack_used, &stack_cache[0].list);
 
   /* Remove the entry for the current thread to from the cache list
      and add it to the list of running threads.  Which of the two
@@ -958,6 +1198,11 @@ __reclaim_stacks (void)
 
   /* Initialize locks.  */
   stack_cache_lock = LLL_LOCK_INITIALIZER;
+  for (unsigned int i = 0; i < STACK_CACHE_SHARDS; ++i)
+    {
+      stack_cache[i].in_flight = 0;
+      stack_cache[i].lock = LLL_LOCK_INITIALIZER;
+    }
   __default_pthread_attr_lock = LLL_LOCK_INITIALIZER;
 }
 
@@ -385,6 +385,8 @@ struct pthread
   size_t guardsize;
   /* This is what the user specified and what we will report.  */
   size_t reported_guardsize;
+  /* Shard of the stack cache which the stack is returned to.  */
+  unsigned int stack_cache_shard;
 
   /* Thread Priority Protection data.  */
   struct priority_protection_data *tpp;
@@ -395,6 +397,13 @@ struct pthread
   /* Indicates whether is a C11 thread created by thrd_creat.  */
   bool c11;
 
+  /* True while the lock profiler records a lock operation of this
+     thread, so that the operations it performs itself are not
+     recorded.  */
+  bool lock_profile_busy;
+  /* Lock contention recorded for this thread, or NULL.  */
+  struct lock_profile_buffer *lock_profile;
+
   /* This member must be last.  */
   char end_padding[];
 
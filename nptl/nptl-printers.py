@@ -41,7 +41,8 @@ MUTEX_TYPES = {
     PTHREAD_MUTEX_NORMAL: ('Type', 'Normal'),
     PTHREAD_MUTEX_RECURSIVE: ('Type', 'Recursive'),
     PTHREAD_MUTEX_ERRORCHECK: ('Type', 'Error check'),
-    PTHREAD_MUTEX_ADAPTIVE_NP: ('Type', 'Adaptive')
+    PTHREAD_MUTEX_ADAPTIVE_NP: ('Type', 'Adaptive'),
+    PTHREAD_MUTEX_QUEUED_NP: ('Type', 'Queued')
 }
 
 class MutexPrinter(object):
@@ -93,7 +94,8 @@ class MutexPrinter(object):
     def read_type(self):
         """Read the mutex's type."""
 
-        mutex_type = self.kind & PTHREAD_MUTEX_KIND_MASK
+        mutex_type = self.kind & (PTHREAD_MUTEX_KIND_MASK
+                                  | PTHREAD_MUTEX_QUEUED_NP)
 
         # mutex_type must be casted to int because it's a gdb.Value
         self.values.append(MUTEX_TYPES[int(mutex_type)])
@@ -499,6 +501,8 @@ class RWLockPrinter(object):
             self.values.append(('Prefers', 'Readers'))
         elif self.flags == PTHREAD_RWLOCK_PREFER_WRITER_NP:
             self.values.append(('Prefers', 'Writers'))
+        elif self.flags == PTHREAD_RWLOCK_PREFER_READER_SCALABLE_NP:
+            self.values.append(('Prefers', 'Readers (scalable)'))
         else:
             self.values.append(('Prefers', 'Writers no recursive readers'))
 
@@ -565,6 +569,8 @@ class RWLockAttributesPrinter(object):
             self.values.append(('Prefers', 'Readers'))
         elif rwlock_type == PTHREAD_RWLOCK_PREFER_WRITER_NP:
             self.values.append(('Prefers', 'Writers'))
+        elif rwlock_type == PTHREAD_RWLOCK_PREFER_READER_SCALABLE_NP:
+            self.values.append(('Prefers', 'Readers (scalable)'))
         else:
             self.values.append(('Prefers', 'Writers no recursive readers'))
 
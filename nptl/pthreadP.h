@@ -161,6 +161,82 @@ enum
 					 << (sizeof (unsigned int) * 8 - 1))
 #define PTHREAD_RWLOCK_FUTEX_USED	2
 
+/* True if writers are preferred over readers by RWLOCK.  */
+#define PTHREAD_RWLOCK_PREFER_WRITER(rwlock) \
+  ((rwlock)->__data.__flags != PTHREAD_RWLOCK_PREFER_READER_NP		      \
+   && (rwlock)->__data.__flags != PTHREAD_RWLOCK_PREFER_READER_SCALABLE_NP)
+
+/* Reader bias of PTHREAD_RWLOCK_PREFER_READER_SCALABLE_NP rwlocks.  See
+   pthread_rwlock_common.c.  Readers which find the bias set publish
+   themselves in one slot of this table, selected by a hash of the rwlock
+   and the thread, instead of registering in __readers.  */
+#define PTHREAD_RWLOCK_VISIBLE_READERS_BITS	12
+#define PTHREAD_RWLOCK_VISIBLE_READERS \
+  (1 << PTHREAD_RWLOCK_VISIBLE_READERS_BITS)
+
+/* Set in the rwlock member of a slot by a writer which waits for the
+   reader to release the slot.  */
+#define PTHREAD_RWLOCK_VISIBLE_WAITING	((uintptr_t) 1)
+
+struct pthread_rwlock_visible_reader
+{
+  /* The address of the rwlock which is read-locked through this slot,
+     possibly with PTHREAD_RWLOCK_VISIBLE_WAITING, or 0.  */
+  uintptr_t rwlock;
+  /* The thread which owns the slot, or NULL.  Only modified by that
+     thread.  */
+  struct pthread *owner;
+  /* Number of recursive read locks the owner holds through the slot in
+     addition to the first one.  Only accessed by the owner.  */
+  unsigned int nesting;
+  /* Futex word of a writer waiting for the slot, incremented by the
+     reader releasing it.  */
+  unsigned int wake;
+};
+
+extern struct pthread_rwlock_visible_reader
+  __pthread_rwlock_visible_readers[PTHREAD_RWLOCK_VISIBLE_READERS]
+  attribute_hidden;
+
+/* Set the reader bias of RWLOCK, which the caller has read-locked, unless
+   a recent revocation inhibits it.  */
+extern void __pthread_rwlock_set_bias (pthread_rwlock_t *rwlock)
+  attribute_hidden;
+
+/* Clear the reader bias of RWLOCK, which the caller has write-locked, and
+   wait for the readers which acquired it through the bias.  Return
+   EBUSY if TRYLOCK and there are such readers, and ETIMEDOUT if ABSTIME
+   expired before they released it; the bias is set again in both cases.  */
+extern int __pthread_rwlock_revoke_bias (pthread_rwlock_t *rwlock,
+					 const struct timespec *abstime,
+					 bool trylock) attribute_hidden;
+
+/* Record that the waiters of the process-private condvar COND use MUTEX,
+   so that signalers can requeue them onto the mutex futex.  Return true
+   if they may do so.  */
+extern bool __condvar_set_mutex (pthread_cond_t *cond,
+				 pthread_mutex_t *mutex) attribute_hidden;
+
+/* Return the mutex onto which waiters of group slot G of COND can be
+   requeued and mark the group as requeued, or return NULL.  */
+extern pthread_mutex_t *__condvar_requeue_mutex (pthread_cond_t *cond,
+						 unsigned int g)
+  attribute_hidden;
+
+/* Wake up the waiters of the group slots in the bit mask GROUPS of COND
+   which may have been requeued onto the mutex futex.  */
+extern void __condvar_requeue_kick (pthread_cond_t *cond,
+				    unsigned int groups) attribute_hidden;
+
+/* Return true if waiters of group slot G of COND may have been requeued
+   onto the mutex futex.  */
+extern bool __condvar_requeued_p (pthread_cond_t *cond, unsigned int g)
+  attribute_hidden;
+
+/* Remove COND from the table, without waking up requeued waiters.  */
+extern void __condvar_requeue_forget (pthread_cond_t *cond)
+  attribute_hidden;
+
 
 /* Bits used in robust mutex implementation.  */
 #define FUTEX_WAITERS		0x80000000
@@ -357,6 +433,50 @@ extern void __deallocate_stack (struct pthread *pd) attribute_hidden;
    function also re-initializes the lock for the stack cache.  */
 extern void __reclaim_stacks (void) attribute_hidden;
 
+/* Initialize the stack cache from the tunables.  */
+extern void __nptl_stack_cache_init (void) attribute_hidden;
+
+/* Lock profiler.  If __nptl_lock_profile is nonzero, the blocking lock
+   functions first try to acquire the lock without blocking, and record
+   the time spent waiting for it if that fails.  */
+enum
+  {
+    LOCK_PROFILE_MUTEX,
+    LOCK_PROFILE_RDLOCK,
+    LOCK_PROFILE_WRLOCK,
+    LOCK_PROFILE_COND,
+  };
+
+extern int __nptl_lock_profile attribute_hidden;
+
+/* Return true if lock operations of the current thread are
+   recorded.  */
+static inline bool
+__lock_profile_active (void)
+{
+  return (__glibc_unlikely (__nptl_lock_profile != 0)
+	  && !THREAD_GETMEM (THREAD_SELF, lock_profile_busy));
+}
+
+/* Start recording a wait of the current thread, and return the
+   current time.  */
+extern uint64_t __lock_profile_begin (void) attribute_hidden;
+
+/* Record a wait for LOCK of kind TYPE which started at START, and
+   stop recording.  CALLER is the return address of the lock function,
+   and RESULT its return value.  Nothing is recorded if RESULT shows
+   that the function failed without waiting.  */
+extern void __lock_profile_end (const void *lock, int type, uint64_t start,
+				const void *caller, int result)
+     attribute_hidden;
+
+/* Release the buffer of the exiting thread PD, and reset its state.  */
+extern void __lock_profile_thread_exit (struct pthread *pd)
+     attribute_hidden;
+
+/* Set up the lock profiler from the tunables.  */
+extern void __lock_profile_init (void) attribute_hidden;
+
 /* Make all threads's stacks executable.  */
 extern int __make_stacks_executable (void **stack_endp) attribute_hidden;
 
@@ -433,6 +553,8 @@ extern int __pthread_mutex_cond_lock (pthread_mutex_t *__mutex)
      attribute_hidden;
 extern void __pthread_mutex_cond_lock_adjust (pthread_mutex_t *__mutex)
      attribute_hidden;
+extern void __pthread_mutex_queued_lock (pthread_mutex_t *__mutex)
+     attribute_hidden;
 extern int __pthread_mutex_unlock (pthread_mutex_t *__mutex);
 extern int __pthread_mutex_unlock_usercnt (pthread_mutex_t *__mutex,
 					   int __decr) attribute_hidden;
@@ -520,6 +642,8 @@ hidden_proto (__pthread_mutex_trylock)
 hidden_proto (__pthread_mutex_unlock)
 hidden_proto (__pthread_rwlock_rdlock)
 hidden_proto (__pthread_rwlock_wrlock)
+hidden_proto (__pthread_rwlock_tryrdlock)
+hidden_proto (__pthread_rwlock_trywrlock)
 hidden_proto (__pthread_rwlock_unlock)
 hidden_proto (__pthread_key_create)
 hidden_proto (__pthread_getspecific)
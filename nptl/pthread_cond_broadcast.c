@@ -76,8 +76,10 @@ __pthread_cond_broadcast (pthread_cond_t *cond)
       atomic_fetch_add_relaxed (cond->__data.__g_signals + g1,
 				cond->__data.__g_size[g1] << 1);
       cond->__data.__g_size[g1] = 0;
+      /* Requeue the waiters onto the mutex futex if we can, so that they
+	 do not all wake up just to block on the mutex.  */
       /* TODO Only set it if there are indeed futex waiters.  */
-      do_futex_wake = true;
+      do_futex_wake = !__condvar_requeue_waiters (cond, g1, false, private);
     }
 
   __condvar_release_lock (cond, private);
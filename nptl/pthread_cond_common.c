@@ -408,6 +408,17 @@ __condvar_quiesce_and_switch_g1 (pthread_cond_t *cond, uint64_t wseq,
 	     this futex word.  */
 	  r = atomic_fetch_or_relaxed (cond->__data.__g_refs + g1, 1);
 
+	  /* Waiters that we or a previous signaler requeued onto the mutex
+	     futex hold group references too, and our caller may have
+	     acquired the mutex.  Wake them up so that they remove their
+	     references and block on the mutex again.  No waiter can be
+	     requeued while we hold the condvar-internal lock.  */
+	  if ((r >> 1) > 0 && private == FUTEX_PRIVATE)
+	    {
+	      __condvar_requeue_kick (cond, 1 << g1);
+	      r = atomic_load_relaxed (cond->__data.__g_refs + g1);
+	    }
+
 	  if ((r >> 1) > 0)
 	    futex_wait_simple (cond->__data.__g_refs + g1, r, private);
 	  /* Reload here so we eventually see the most recent value even if we
@@ -444,6 +455,11 @@ __condvar_quiesce_and_switch_g1 (pthread_cond_t *cond, uint64_t wseq,
      Release MO so that this synchronizes with the acquire MO operation
      waiters use to obtain a position in the waiter sequence.  */
   wseq = __condvar_fetch_xor_wseq_release (cond, 1) >> 1;
+  /* Waiters record their mutex before they acquire a position in __wseq
+     and use a release fence for that (see __pthread_cond_wait_common).
+     The acquire fence makes sure that __condvar_requeue_waiters sees the
+     mutex of all waiters in the new G1.  */
+  atomic_thread_fence_acquire ();
   g1 ^= 1;
   *g1index ^= 1;
 
@@ -463,3 +479,46 @@ __condvar_quiesce_and_switch_g1 (pthread_cond_t *cond, uint64_t wseq,
 
   return true;
 }
+
+/* Requeue all waiters blocked on the futex of group slot G (which must
+   be G1 and have received signals for them) onto the futex of their
+   mutex, or only one if ONE is true.  Must be called with the
+   condvar-internal lock acquired, so that no signaler quiesces the group
+   before the requeue (see __condvar_quiesce_and_switch_g1).
+   If the caller has acquired the mutex, we make sure that its unlock
+   wakes up a waiter and requeue all waiters; otherwise, we wake up one
+   waiter and requeue the others, which then get woken one at a time by
+   the unlock of the previous one.  Signaling just one waiter is only
+   worth a requeue if the caller has acquired the mutex.
+   Return false if the caller has to wake up the waiters.  */
+static bool __attribute__ ((unused))
+__condvar_requeue_waiters (pthread_cond_t *cond, unsigned int g, bool one,
+    int private)
+{
+  /* The table is private to the process.  */
+  if (private != FUTEX_PRIVATE)
+    return false;
+
+  pthread_mutex_t *mutex = __condvar_requeue_mutex (cond, g);
+  if (mutex == NULL)
+    return false;
+
+  int nr_wake = 1;
+  if (atomic_load_relaxed (&mutex->__data.__owner)
+      == THREAD_GETMEM (THREAD_SELF, tid))
+    {
+      /* The lock word is 1 or 2 while we own the mutex, and 2 makes our
+	 unlock wake up a waiter.  */
+      atomic_exchange_relaxed (&mutex->__data.__lock, 2);
+      nr_wake = 0;
+    }
+  else if (one)
+    return false;
+
+  unsigned int signals = atomic_load_relaxed (cond->__data.__g_signals + g);
+  /* If waiters consumed a signal concurrently, the kernel returns
+     EAGAIN.  */
+  return lll_futex_requeue (cond->__data.__g_signals + g, nr_wake,
+			    one ? 1 : INT_MAX,
+			    &mutex->__data.__lock, signals, private) >= 0;
+}
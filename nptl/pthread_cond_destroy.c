@@ -49,6 +49,17 @@ __pthread_cond_destroy (pthread_cond_t *cond)
      that they finished.  */
   unsigned int wrefs = atomic_fetch_or_acquire (&cond->__data.__wrefs, 4);
   int private = __condvar_get_private (wrefs);
+  /* Waiters requeued onto the mutex futex have not confirmed their
+     wake-up yet, and the caller may have acquired the mutex.  The mutex
+     still exists while there are waiters, which acquire it before they
+     return.  Without waiters, it may have been destroyed already, so
+     we must not wake up its futex.  */
+  if (private == FUTEX_PRIVATE)
+    {
+      if (wrefs >> 3 != 0)
+	__condvar_requeue_kick (cond, 3);
+      __condvar_requeue_forget (cond);
+    }
   while (wrefs >> 3 != 0)
     {
       futex_wait_simple (&cond->__data.__wrefs, wrefs, private);
@@ -0,0 +1,184 @@
+/* Wait morphing for condition variables.
+   Copyright (C) 2018 Free Software Foundation, Inc.
+   This file is part of the GNU C Library.
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; if not, see
+   <http://www.gnu.org/licenses/>.  */
+
+#include <limits.h>
+#include <stdint.h>
+#include <atomic.h>
+#include <lowlevellock.h>
+#include "pthreadP.h"
+
+/* pthread_cond_broadcast, and pthread_cond_signal called by the owner of
+   the mutex, move the waiters they signal from the futex of the group to
+   the futex of the mutex with FUTEX_CMP_REQUEUE (see
+   __condvar_requeue_waiters).  They are then woken one at a time by
+   unlocks of the mutex instead of all at once, only to block on the
+   mutex again.
+
+   pthread_cond_t has no room for a pointer to the mutex, so waiters of
+   process-private condvars record it in this table before they register
+   in __wseq.  Each condvar uses the slot selected by a hash of its
+   address.  A free slot is taken by the first condvar which is waited
+   on, and released by pthread_cond_destroy.  If the slot is taken by
+   another condvar, or the mutex does not use the plain lock word
+   protocol, signalers do not requeue.  Waiters check this without the
+   slot lock, so that condvars which share a slot do not contend on it.
+
+   Requeued waiters still hold a reference to their group, and they have
+   not confirmed their wake-up in __wrefs.  Signalers which quiesce a
+   group, and pthread_cond_destroy, can be called with the mutex held, so
+   they first wake up all waiters blocked on the mutex futex for the
+   groups marked in the slot (__condvar_requeue_kick).  Those waiters
+   release their references, and block on the mutex again in
+   __pthread_mutex_cond_lock.
+
+   LOCK protects the slot.  COND, MUTEX and GROUPS are also read without
+   it, so they are accessed atomically.  */
+struct condvar_requeue
+{
+  int lock;
+  /* Bit G is set if waiters of group slot G may have been requeued.  */
+  unsigned int groups;
+  pthread_cond_t *cond;
+  /* The mutex of the waiters, or NULL if they must be woken up.  */
+  pthread_mutex_t *mutex;
+};
+
+#define CONDVAR_REQUEUE_SLOTS 64
+
+static struct condvar_requeue requeue_table[CONDVAR_REQUEUE_SLOTS];
+
+static struct condvar_requeue *
+requeue_slot (pthread_cond_t *cond)
+{
+  uintptr_t h = (uintptr_t) cond / sizeof (pthread_cond_t);
+  return &requeue_table[(h ^ (h >> 6)) % CONDVAR_REQUEUE_SLOTS];
+}
+
+/* Return true if the waiters of a condvar can be requeued onto MUTEX.
+   These kinds use a private lock word which is 2 if there may be
+   waiters, and unlock wakes one of them.  Elided unlocks do not wake up
+   anyone, and waiters of queued mutexes do not block on the lock word.  */
+static bool
+requeue_mutex_p (pthread_mutex_t *mutex)
+{
+  int kind = atomic_load_relaxed (&mutex->__data.__kind);
+  return ((kind & (127 | PTHREAD_MUTEX_PSHARED_BIT
+		   | PTHREAD_MUTEX_ELISION_NP))
+	  <= PTHREAD_MUTEX_ADAPTIVE_NP);
+}
+
+bool
+__condvar_set_mutex (pthread_cond_t *cond, pthread_mutex_t *mutex)
+{
+  struct condvar_requeue *slot = requeue_slot (cond);
+  if (!requeue_mutex_p (mutex))
+    mutex = NULL;
+
+  /* Concurrent waiters use the same mutex, so the slot is usually up to
+     date already.  */
+  pthread_cond_t *owner = atomic_load_relaxed (&slot->cond);
+  if (owner == cond && atomic_load_relaxed (&slot->mutex) == mutex)
+    return mutex != NULL;
+
+  /* The slot belongs to another condvar until that is destroyed.  */
+  if (owner != NULL && owner != cond)
+    return false;
+
+  lll_lock (slot->lock, LLL_PRIVATE);
+  if (slot->cond == cond)
+    {
+      /* The condvar is used with another mutex now, so there cannot be
+	 requeued waiters left.  */
+      if (slot->mutex != mutex)
+	{
+	  atomic_store_relaxed (&slot->mutex, mutex);
+	  atomic_store_relaxed (&slot->groups, 0);
+	}
+    }
+  else if (slot->cond == NULL)
+    {
+      atomic_store_relaxed (&slot->cond, cond);
+      atomic_store_relaxed (&slot->mutex, mutex);
+    }
+  else
+    mutex = NULL;
+  lll_unlock (slot->lock, LLL_PRIVATE);
+  return mutex != NULL;
+}
+
+pthread_mutex_t *
+__condvar_requeue_mutex (pthread_cond_t *cond, unsigned int g)
+{
+  struct condvar_requeue *slot = requeue_slot (cond);
+  pthread_mutex_t *mutex = NULL;
+
+  lll_lock (slot->lock, LLL_PRIVATE);
+  if (slot->cond == cond && slot->mutex != NULL)
+    {
+      mutex = slot->mutex;
+      atomic_store_relaxed (&slot->groups, slot->groups | 1 << g);
+    }
+  lll_unlock (slot->lock, LLL_PRIVATE);
+  return mutex;
+}
+
+void
+__condvar_requeue_kick (pthread_cond_t *cond, unsigned int groups)
+{
+  struct condvar_requeue *slot = requeue_slot (cond);
+  pthread_mutex_t *mutex = NULL;
+
+  lll_lock (slot->lock, LLL_PRIVATE);
+  if (slot->cond == cond && (slot->groups & groups) != 0)
+    {
+      mutex = slot->mutex;
+      atomic_store_relaxed (&slot->groups, slot->groups & ~groups);
+    }
+  lll_unlock (slot->lock, LLL_PRIVATE);
+
+  /* The waiters block again on the lock word in
+     __pthread_mutex_cond_lock, so we do not need to update it.  Other
+     threads blocked on the mutex just see a spurious wake-up.  If all
+     requeued waiters have returned already, the mutex may have been
+     destroyed, which is why we ignore errors.  */
+  if (mutex != NULL)
+    lll_futex_wake (&mutex->__data.__lock, INT_MAX, LLL_PRIVATE);
+}
+
+bool
+__condvar_requeued_p (pthread_cond_t *cond, unsigned int g)
+{
+  struct condvar_requeue *slot = requeue_slot (cond);
+  return (atomic_load_relaxed (&slot->cond) == cond
+	  && (atomic_load_relaxed (&slot->groups) & (1 << g)) != 0);
+}
+
+void
+__condvar_requeue_forget (pthread_cond_t *cond)
+{
+  struct condvar_requeue *slot = requeue_slot (cond);
+
+  lll_lock (slot->lock, LLL_PRIVATE);
+  if (slot->cond == cond)
+    {
+      atomic_store_relaxed (&slot->cond, NULL);
+      atomic_store_relaxed (&slot->mutex, NULL);
+      atomic_store_relaxed (&slot->groups, 0);
+    }
+  lll_unlock (slot->lock, LLL_PRIVATE);
+}
@@ -84,8 +84,10 @@ __pthread_cond_signal (pthread_cond_t *cond)
 	 read-modify-write and thus extend that store's release sequence.  */
       atomic_fetch_add_relaxed (cond->__data.__g_signals + g1, 2);
       cond->__data.__g_size[g1]--;
+      /* If we have acquired the mutex, the waiter would just block on it
+	 again, so requeue it onto the mutex futex if we can.  */
       /* TODO Only set it if there are indeed futex waiters.  */
-      do_futex_wake = true;
+      do_futex_wake = !__condvar_requeue_waiters (cond, g1, true, private);
     }
 
   __condvar_release_lock (cond, private);
@@ -386,6 +386,18 @@ __pthread_cond_wait_common (pthread_cond_t *cond, pthread_mutex_t *mutex,
 
   LIBC_PROBE (cond_wait, 2, cond, mutex);
 
+  /* Record our mutex so that signalers can requeue us onto its futex
+     instead of waking us up (see pthread_cond_requeue.c).  The release
+     fence makes this happen before we acquire a position in __wseq; it
+     pairs with the acquire fence in __condvar_quiesce_and_switch_g1.  */
+  bool requeue = false;
+  if (__condvar_get_private (atomic_load_relaxed (&cond->__data.__wrefs))
+      == FUTEX_PRIVATE)
+    {
+      requeue = __condvar_set_mutex (cond, mutex);
+      atomic_thread_fence_release ();
+    }
+
   /* Acquire a position (SEQ) in the waiter sequence (WSEQ).  We use an
      atomic operation because signals and broadcasts may update the group
      switch without acquiring the mutex.  We do not need release MO here
@@ -560,6 +572,15 @@ __pthread_cond_wait_common (pthread_cond_t *cond, pthread_mutex_t *mutex,
 
 	  /* Reload signals.  See above for MO.  */
 	  signals = atomic_load_acquire (cond->__data.__g_signals + g);
+
+	  /* If we were requeued onto the mutex futex and woken up by an
+	     unlock of the mutex, the other requeued waiters rely on us to
+	     acquire the mutex and wake up the next of them when we release
+	     it.  If we block again because another waiter has taken our
+	     signal, pass the wake-up on instead.  We cannot tell whether we
+	     were requeued ourselves, but our group must have been.  */
+	  if (requeue && signals == 0 && __condvar_requeued_p (cond, g))
+	    lll_futex_wake (&mutex->__data.__lock, 1, private);
 	}
 
     }
@@ -648,10 +669,25 @@ __pthread_cond_wait_common (pthread_cond_t *cond, pthread_mutex_t *mutex,
 }
 
 
+/* Record the time spent in a wait on COND, including reacquiring the
+   mutex.  If the thread is canceled, the wait is not recorded.  */
+static int __attribute_noinline__
+__pthread_cond_wait_profile (pthread_cond_t *cond, pthread_mutex_t *mutex,
+    const struct timespec *abstime, const void *caller)
+{
+  uint64_t start = __lock_profile_begin ();
+  int result = __pthread_cond_wait_common (cond, mutex, abstime);
+  __lock_profile_end (cond, LOCK_PROFILE_COND, start, caller, result);
+  return result;
+}
+
 /* See __pthread_cond_wait_common.  */
 int
 __pthread_cond_wait (pthread_cond_t *cond, pthread_mutex_t *mutex)
 {
+  if (__lock_profile_active ())
+    return __pthread_cond_wait_profile (cond, mutex, NULL,
+					RETURN_ADDRESS (0));
   return __pthread_cond_wait_common (cond, mutex, NULL);
 }
 
@@ -664,6 +700,9 @@ __pthread_cond_timedwait (pthread_cond_t *cond, pthread_mutex_t *mutex,
      it can assume that abstime is not NULL.  */
   if (abstime->tv_nsec < 0 || abstime->tv_nsec >= 1000000000)
     return EINVAL;
+  if (__lock_profile_active ())
+    return __pthread_cond_wait_profile (cond, mutex, abstime,
+					RETURN_ADDRESS (0));
   return __pthread_cond_wait_common (cond, mutex, abstime);
 }
 
@@ -503,6 +503,10 @@ START_THREAD_DEFN
   /* Clean up any state libc stored in thread-local variables.  */
   __libc_thread_freeres ();
 
+  /* Hand the lock profile of this thread to the next one.  */
+  if (__glibc_unlikely (__nptl_lock_profile != 0))
+    __lock_profile_thread_exit (pd);
+
   /* If this is the last thread we terminate the process now.  We
      do not notify the debugger, it might just irritate it if there
      is no thread left.  */
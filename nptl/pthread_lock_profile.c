@@ -0,0 +1,409 @@
+/* Lock contention profiler.
+   Copyright (C) 2018 Free Software Foundation, Inc.
+   This file is part of the GNU C Library.
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; if not, see
+   <http://www.gnu.org/licenses/>.  */
+
+/* If glibc.pthread.lock_profile is set, pthread_mutex_lock,
+   pthread_mutex_timedlock and the blocking rwlock functions first try
+   to acquire the lock without blocking.  Only if that fails, they take
+   the time before and after acquiring the lock, and the wait is
+   recorded unless the lock function fails without waiting.  pthread_cond_wait and pthread_cond_timedwait record every
+   wait.  Uncontended lock operations only pay for the failed check of
+   __lock_profile_active and the trylock.
+
+   Each thread records its waits in a buffer of its own, which is a hash
+   table keyed by the address and kind of the lock.  For each lock, it
+   counts the waits, their total and maximum duration, and the caller of
+   the lock function for the longest wait.  When the thread exits, its
+   buffer is kept with its counters and handed to the next thread which
+   needs one.  The buffers are only read to write the report, which
+   merges the counters of all buffers.  While threads are running, the
+   report may miss the waits they record at the same time.
+
+   The report is written to standard error when the process exits, and
+   to a file on the signal selected by glibc.pthread.lock_profile_signal.
+   Lock addresses can be reused after a lock is destroyed, in which
+   case the counters of both locks are combined.  */
+
+#include <errno.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <atomic.h>
+#include <fork.h>
+#include <not-cancel.h>
+#include <profile-writer.h>
+#include "pthreadP.h"
+
+#if HAVE_TUNABLES
+# define TUNABLE_NAMESPACE pthread
+#endif
+#include <elf/dl-tunables.h>
+
+/* Number of locks a thread buffer can record.  A power of two.  */
+#define LOCK_PROFILE_SLOTS 512
+
+struct lock_profile_entry
+{
+  /* The lock, or NULL if the slot is unused.  Set after TYPE.  */
+  const void *lock;
+  int type;
+  uint64_t waits;
+  uint64_t total_ns;
+  uint64_t max_ns;
+  /* Caller of the lock function for the longest wait.  */
+  const void *caller;
+};
+
+struct lock_profile_buffer
+{
+  struct lock_profile_buffer *next;
+  /* True while a thread records into the buffer.  */
+  bool in_use;
+  /* Number of waits not recorded because the buffer was full.  */
+  uint64_t dropped;
+  struct lock_profile_entry entries[LOCK_PROFILE_SLOTS];
+};
+
+int __nptl_lock_profile;
+
+/* Number of reports written to files.  */
+static unsigned int lock_profile_dumps;
+
+/* List of all buffers.  Buffers are never freed.  */
+static struct lock_profile_buffer *lock_profile_buffers;
+/* Protects lock_profile_buffers and the in_use flags.  */
+static int lock_profile_lock = LLL_LOCK_INITIALIZER;
+
+static uint64_t
+lock_profile_clock (void)
+{
+  struct timespec ts;
+  if (__clock_gettime (CLOCK_MONOTONIC, &ts) != 0)
+    return 0;
+  return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static size_t
+lock_profile_hash (const void *lock, int type)
+{
+  return (((uintptr_t) lock >> 3) ^ type) * (size_t) 0x9e3779b97f4a7c15ULL;
+}
+
+/* Return a free buffer for the current thread, or NULL if none can be
+   allocated.  */
+static struct lock_profile_buffer *
+lock_profile_buffer_get (void)
+{
+  struct lock_profile_buffer *buf;
+
+  lll_lock (lock_profile_lock, LLL_PRIVATE);
+  for (buf = lock_profile_buffers; buf != NULL; buf = buf->next)
+    if (!buf->in_use)
+      break;
+  if (buf == NULL)
+    {
+      buf = __mmap (NULL, sizeof (*buf), PROT_READ | PROT_WRITE,
+		    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+      if (buf == MAP_FAILED)
+	buf = NULL;
+      else
+	{
+	  buf->next = lock_profile_buffers;
+	  atomic_store_release (&lock_profile_buffers, buf);
+	}
+    }
+  if (buf != NULL)
+    buf->in_use = true;
+  lll_unlock (lock_profile_lock, LLL_PRIVATE);
+  return buf;
+}
+
+uint64_t
+__lock_profile_begin (void)
+{
+  THREAD_SETMEM (THREAD_SELF, lock_profile_busy, true);
+  return lock_profile_clock ();
+}
+
+void
+__lock_profile_end (const void *lock, int type, uint64_t start,
+		    const void *caller, int result)
+{
+  uint64_t wait = lock_profile_clock () - start;
+  struct pthread *self = THREAD_SELF;
+  struct lock_profile_buffer *buf = THREAD_GETMEM (self, lock_profile);
+
+  /* The lock was busy, but the caller already owns it (EDEADLK), the
+     timeout is invalid (EINVAL), or a counter would overflow (EAGAIN).
+     These are detected before the lock is waited for.  */
+  if (result == EDEADLK || result == EINVAL || result == EAGAIN)
+    goto out;
+
+  if (buf == NULL)
+    {
+      buf = lock_profile_buffer_get ();
+      if (buf == NULL)
+	goto out;
+      THREAD_SETMEM (self, lock_profile, buf);
+    }
+
+  size_t hash = lock_profile_hash (lock, type);
+  struct lock_profile_entry *e = NULL;
+  for (size_t i = 0; i < LOCK_PROFILE_SLOTS; ++i)
+    {
+      struct lock_profile_entry *slot
+	= &buf->entries[(hash + i) & (LOCK_PROFILE_SLOTS - 1)];
+      if (slot->lock == NULL)
+	{
+	  slot->type = type;
+	  atomic_store_release (&slot->lock, lock);
+	  e = slot;
+	  break;
+	}
+      if (slot->lock == lock && slot->type == type)
+	{
+	  e = slot;
+	  break;
+	}
+    }
+
+  if (e == NULL)
+    ++buf->dropped;
+  else
+    {
+      ++e->waits;
+      e->total_ns += wait;
+      if (wait >= e->max_ns)
+	{
+	  e->max_ns = wait;
+	  e->caller = caller;
+	}
+    }
+
+ out:
+  THREAD_SETMEM (self, lock_profile_busy, false);
+}
+
+void
+__lock_profile_thread_exit (struct pthread *pd)
+{
+  if (pd->lock_profile != NULL)
+    {
+      lll_lock (lock_profile_lock, LLL_PRIVATE);
+      pd->lock_profile->in_use = false;
+      lll_unlock (lock_profile_lock, LLL_PRIVATE);
+      pd->lock_profile = NULL;
+    }
+  /* The thread may have been canceled in pthread_cond_wait.  The
+     descriptor is reused for new threads.  */
+  pd->lock_profile_busy = false;
+}
+
+/* Only the forking thread exists in the new process.  */
+static void
+lock_profile_fork_child (void)
+{
+  lock_profile_lock = LLL_LOCK_INITIALIZER;
+  struct lock_profile_buffer *own = THREAD_GETMEM (THREAD_SELF,
+						   lock_profile);
+  for (struct lock_profile_buffer *buf = lock_profile_buffers; buf != NULL;
+       buf = buf->next)
+    buf->in_use = buf == own;
+}
+
+static const char *const lock_profile_types[] =
+  {
+    [LOCK_PROFILE_MUTEX] = "mutex",
+    [LOCK_PROFILE_RDLOCK] = "rwlock-rd",
+    [LOCK_PROFILE_WRLOCK] = "rwlock-wr",
+    [LOCK_PROFILE_COND] = "cond",
+  };
+
+/* Write the report to W.  If TRY is true, give up if lock_profile_lock
+   is not available immediately.  */
+static void
+lock_profile_dump (struct profile_writer *w, bool try)
+{
+  if (try)
+    {
+      if (lll_trylock (lock_profile_lock) != 0)
+	return;
+    }
+  else
+    lll_lock (lock_profile_lock, LLL_PRIVATE);
+
+  /* Merge the buffers into a hash table with room for all their
+     entries.  */
+  size_t nbuffers = 0;
+  for (struct lock_profile_buffer *buf = lock_profile_buffers; buf != NULL;
+       buf = buf->next)
+    ++nbuffers;
+  size_t nslots = LOCK_PROFILE_SLOTS;
+  while (nslots < nbuffers * LOCK_PROFILE_SLOTS)
+    nslots *= 2;
+  size_t size = ALIGN_UP (nslots * sizeof (struct lock_profile_entry),
+			  GLRO(dl_pagesize));
+  struct lock_profile_entry *table = __mmap (NULL, size,
+					     PROT_READ | PROT_WRITE,
+					     MAP_PRIVATE | MAP_ANONYMOUS,
+					     -1, 0);
+  if (table == MAP_FAILED)
+    {
+      lll_unlock (lock_profile_lock, LLL_PRIVATE);
+      return;
+    }
+
+  uint64_t dropped = 0;
+  for (struct lock_profile_buffer *buf = lock_profile_buffers; buf != NULL;
+       buf = buf->next)
+    {
+      dropped += buf->dropped;
+      for (size_t i = 0; i < LOCK_PROFILE_SLOTS; ++i)
+	{
+	  struct lock_profile_entry *e = &buf->entries[i];
+	  const void *lock = atomic_load_acquire (&e->lock);
+	  if (lock == NULL)
+	    continue;
+	  size_t hash = lock_profile_hash (lock, e->type);
+	  struct lock_profile_entry *t;
+	  for (size_t j = 0; ; ++j)
+	    {
+	      t = &table[(hash + j) & (nslots - 1)];
+	      if (t->lock == NULL)
+		{
+		  t->lock = lock;
+		  t->type = e->type;
+		  break;
+		}
+	      if (t->lock == lock && t->type == e->type)
+		break;
+	    }
+	  t->waits += e->waits;
+	  t->total_ns += e->total_ns;
+	  if (e->max_ns >= t->max_ns)
+	    {
+	      t->max_ns = e->max_ns;
+	      t->caller = e->caller;
+	    }
+	}
+    }
+  lll_unlock (lock_profile_lock, LLL_PRIVATE);
+
+  /* Sort the locks by the total wait time, longest first, with a Shell
+   sort.  qsort may call malloc.  */
+  size_t count = 0;
+  for (size_t i = 0; i < nslots; ++i)
+    if (table[i].lock != NULL)
+      table[count++] = table[i];
+  for (size_t gap = count / 2; gap > 0; gap /= 2)
+    for (size_t i = gap; i < count; ++i)
+      {
+	struct lock_profile_entry e = table[i];
+	size_t j = i;
+	for (; j >= gap && table[j - gap].total_ns < e.total_ns; j -= gap)
+	  table[j] = table[j - gap];
+	table[j] = e;
+      }
+
+  profile_writer_puts (w, "lock profile of process ");
+  profile_writer_putnum (w, __getpid (), 10, 0);
+  profile_writer_puts (w, ": ");
+  profile_writer_putnum (w, count, 10, 0);
+  profile_writer_puts (w, " locks waited for");
+  if (dropped != 0)
+    {
+      profile_writer_puts (w, ", ");
+      profile_writer_putnum (w, dropped, 10, 0);
+      profile_writer_puts (w, " waits not recorded");
+    }
+  profile_writer_puts (w, "\n\n              lock       type       waits"
+		     "    total us      max us  caller of max\n");
+  for (size_t i = 0; i < count; ++i)
+    {
+      profile_writer_putaddr (w, table[i].lock);
+      profile_writer_puts (w, " ");
+      const char *type = lock_profile_types[table[i].type];
+      for (int pad = 10 - strlen (type); pad > 0; --pad)
+	profile_writer_write (w, " ", 1);
+      profile_writer_puts (w, type);
+      profile_writer_putnum (w, table[i].waits, 10, 12);
+      profile_writer_putnum (w, table[i].total_ns / 1000, 10, 12);
+      profile_writer_putnum (w, table[i].max_ns / 1000, 10, 12);
+      profile_writer_puts (w, "  ");
+      profile_writer_putaddr (w, table[i].caller);
+      profile_writer_puts (w, "\n");
+    }
+
+  profile_writer_finish (w);
+
+  __munmap (table, size);
+}
+
+/* Write the report to standard error.  */
+static void
+lock_profile_exit (void *closure)
+{
+  struct profile_writer w = { .fp = NULL, .fd = STDERR_FILENO };
+  lock_profile_dump (&w, false);
+}
+
+/* Write the report to lock-profile.PID.N in the current directory,
+   where N counts the reports written so far.  */
+static void
+lock_profile_signal_handler (int sig)
+{
+  int saved_errno = errno;
+  int fd = profile_writer_open ("lock-profile", lock_profile_dumps++, "");
+  if (fd >= 0)
+    {
+      struct profile_writer w = { .fp = NULL, .fd = fd };
+      lock_profile_dump (&w, true);
+      __close_nocancel_nostatus (fd);
+    }
+  __set_errno (saved_errno);
+}
+
+void
+__lock_profile_init (void)
+{
+#if HAVE_TUNABLES
+  int32_t enable = TUNABLE_GET (lock_profile, int32_t, NULL);
+  int32_t sig = TUNABLE_GET (lock_profile_signal, int32_t, NULL);
+#else
+  int32_t enable = 0;
+  int32_t sig = 0;
+#endif
+  if (enable == 0)
+    return;
+
+  __register_atfork (NULL, NULL, lock_profile_fork_child, NULL);
+  __cxa_atexit (lock_profile_exit, NULL, NULL);
+
+  if (sig != 0)
+    {
+      struct sigaction sa;
+      memset (&sa, 0, sizeof (sa));
+      sa.sa_handler = lock_profile_signal_handler;
+      sa.sa_flags = SA_RESTART;
+      __sigaction (sig, &sa, NULL);
+    }
+
+  __nptl_lock_profile = 1;
+}
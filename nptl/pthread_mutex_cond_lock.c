@@ -17,5 +17,6 @@
 #define __pthread_mutex_lock  __pthread_mutex_cond_lock
 #define __pthread_mutex_lock_full __pthread_mutex_cond_lock_full
 #define NO_INCR
+#define LOCK_PROFILE 0
 
 #include <nptl/pthread_mutex_lock.c>
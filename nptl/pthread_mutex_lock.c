@@ -56,14 +56,31 @@
 #define FORCE_ELISION(m, s)
 #endif
 
+/* pthread_mutex_cond_lock.c defines this to 0, because waits in
+   pthread_cond_wait are recorded for the condvar.  */
+#ifndef LOCK_PROFILE
+# define LOCK_PROFILE 1
+#endif
+
 static int __pthread_mutex_lock_full (pthread_mutex_t *mutex)
      __attribute_noinline__;
 
+#if LOCK_PROFILE
+static int __pthread_mutex_lock_profile (pthread_mutex_t *mutex,
+					 const void *caller)
+     __attribute_noinline__;
+#endif
+
 int
 __pthread_mutex_lock (pthread_mutex_t *mutex)
 {
   unsigned int type = PTHREAD_MUTEX_TYPE_ELISION (mutex);
 
+#if LOCK_PROFILE
+  if (__lock_profile_active ())
+    return __pthread_mutex_lock_profile (mutex, RETURN_ADDRESS (0));
+#endif
+
   LIBC_PROBE (mutex_entry, 1, mutex);
 
   if (__builtin_expect (type & ~(PTHREAD_MUTEX_KIND_MASK_NP
@@ -164,6 +181,23 @@ __pthread_mutex_lock (pthread_mutex_t *mutex)
   return 0;
 }
 
+#if LOCK_PROFILE
+/* Acquire MUTEX, and record the wait if it is not available
+   immediately.  */
+static int
+__pthread_mutex_lock_profile (pthread_mutex_t *mutex, const void *caller)
+{
+  int result = __pthread_mutex_trylock (mutex);
+  if (result != EBUSY)
+    return result;
+
+  uint64_t start = __lock_profile_begin ();
+  result = __pthread_mutex_lock (mutex);
+  __lock_profile_end (mutex, LOCK_PROFILE_MUTEX, start, caller, result);
+  return result;
+}
+#endif
+
 static int
 __pthread_mutex_lock_full (pthread_mutex_t *mutex)
 {
@@ -582,6 +616,11 @@ __pthread_mutex_lock_full (pthread_mutex_t *mutex)
       }
       break;
 
+    case PTHREAD_MUTEX_QUEUED_NP:
+      __pthread_mutex_queued_lock (mutex);
+      assert (mutex->__data.__owner == 0);
+      break;
+
     default:
       /* Correct code cannot set any other type.  */
       return EINVAL;
@@ -0,0 +1,180 @@
+/* Blocking path of queued mutexes.
+   Copyright (C) 2018 Free Software Foundation, Inc.
+   This file is part of the GNU C Library.
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; if not, see
+   <http://www.gnu.org/licenses/>.  */
+
+#include <stdbool.h>
+#include <atomic.h>
+#include <futex-internal.h>
+#include <lowlevellock.h>
+#include "pthreadP.h"
+
+/* Queued mutexes (PTHREAD_MUTEX_QUEUED_NP) use the lock word like normal
+   mutexes, so unlock, trylock and timedlock are the same.  Threads which
+   block in pthread_mutex_lock do not all spin or wait on the lock word,
+   though.  Similar to an MCS lock, each of them appends a node on its
+   stack to a queue, and only the thread at the head of the queue
+   competes for the lock word.  The other threads spin on the state of
+   their own node, which is on a cache line of its own, and park on it
+   with a futex after a bounded number of spins.  When the head has
+   acquired the lock word, it removes its node from the queue and makes
+   the next waiter the new head, so waiters get the mutex in FIFO order
+   and the handoff only touches the cache line of the next waiter.
+
+   A node is only used while its thread is blocked, so the mutex owner
+   does not have one and the queue is empty if no thread is blocked.
+   Threads in trylock and timedlock, and threads which find the queue
+   empty, can acquire the lock word before the head of the queue.
+
+   The tail of the queue is stored in __list.__next, which is used only
+   by robust mutexes otherwise.  pthread_mutex_init does not allow queued
+   mutexes which are robust, process-shared or use a priority protocol.  */
+
+/* States of a queue node.  */
+enum
+{
+  /* The waiter spins on the node.  */
+  QUEUED_WAITING,
+  /* The waiter is blocked in futex_wait.  */
+  QUEUED_PARKED,
+  /* The predecessor of the waiter became the head of the queue and
+     woke the waiter up, so that it is ready when it becomes the head.  */
+  QUEUED_NEXT,
+  /* The waiter is the head of the queue.  */
+  QUEUED_HEAD
+};
+
+struct queue_node
+{
+  struct queue_node *next;
+  unsigned int state;
+} __attribute__ ((aligned (64)));
+
+/* Number of times a waiter checks the state of its node before it
+   parks.  Spinning only touches the waiter's own cache line, so this is
+   larger than MAX_ADAPTIVE_COUNT, which bounds the spinning of the head
+   of the queue on the lock word.  */
+#define QUEUED_SPIN_COUNT (10 * MAX_ADAPTIVE_COUNT)
+
+typedef __typeof (((pthread_mutex_t *) 0)->__data.__list.__next) queue_tail_t;
+
+/* Set the state of NODE to STATE and wake up its waiter if it is
+   parked.  */
+static void
+queue_wake (struct queue_node *node, unsigned int state)
+{
+  /* Release MO so that the waiter synchronizes with us.  */
+  if (atomic_exchange_release (&node->state, state) == QUEUED_PARKED)
+    futex_wake (&node->state, 1, FUTEX_PRIVATE);
+}
+
+/* Wait until NODE becomes the head of the queue.  */
+static void
+queue_wait (struct queue_node *node)
+{
+  int max_cnt = __is_smp ? QUEUED_SPIN_COUNT : 0;
+  int cnt = 0;
+  while (true)
+    {
+      /* Acquire MO so that we synchronize with the previous head.  */
+      unsigned int state = atomic_load_acquire (&node->state);
+      if (state == QUEUED_HEAD)
+	return;
+      if (cnt++ < max_cnt)
+	{
+	  atomic_spin_nop ();
+	  continue;
+	}
+      cnt = 0;
+      if (atomic_compare_exchange_weak_relaxed (&node->state, &state,
+						QUEUED_PARKED))
+	futex_wait_simple (&node->state, QUEUED_PARKED, FUTEX_PRIVATE);
+    }
+}
+
+/* Acquire the lock word of MUTEX.  The caller records the ownership.  */
+void
+__pthread_mutex_queued_lock (pthread_mutex_t *mutex)
+{
+  queue_tail_t *tail = &mutex->__data.__list.__next;
+
+  if (atomic_load_relaxed (tail) == NULL
+      && lll_trylock (mutex->__data.__lock) == 0)
+    return;
+
+  struct queue_node node;
+  node.next = NULL;
+  node.state = QUEUED_WAITING;
+
+  /* The fence makes the initialization of NODE visible to the thread
+     which appends its node after ours.  Acquire MO so that our store to
+     the next field of the predecessor happens after its initialization
+     of that field.  */
+  atomic_thread_fence_release ();
+  struct queue_node *prev
+    = (struct queue_node *) atomic_exchange_acquire (tail,
+						     (queue_tail_t) &node);
+  if (prev != NULL)
+    {
+      /* Release MO because the predecessor accesses NODE through the
+	 pointer.  */
+      atomic_store_release (&prev->next, &node);
+      queue_wait (&node);
+    }
+
+  /* If our successor has parked already, wake it up now, so that the
+     handoff to it does not need a system call while the mutex is
+     locked.  */
+  struct queue_node *next = atomic_load_acquire (&node.next);
+  if (next != NULL && atomic_load_relaxed (&next->state) == QUEUED_PARKED)
+    queue_wake (next, QUEUED_NEXT);
+
+  if (! __is_smp)
+    lll_lock (mutex->__data.__lock, PTHREAD_MUTEX_PSHARED (mutex));
+  else
+    {
+      int cnt = 0;
+      while (atomic_load_relaxed (&mutex->__data.__lock) != 0
+	     || lll_trylock (mutex->__data.__lock) != 0)
+	{
+	  if (cnt++ >= MAX_ADAPTIVE_COUNT)
+	    {
+	      lll_lock (mutex->__data.__lock, PTHREAD_MUTEX_PSHARED (mutex));
+	      break;
+	    }
+	  atomic_spin_nop ();
+	}
+    }
+
+  /* Remove NODE from the queue.  If it is the last node, reset the
+     tail.  Otherwise, or if another thread is appending a node, make the
+     next waiter the head.  */
+  next = atomic_load_acquire (&node.next);
+  if (next == NULL)
+    {
+      queue_tail_t expected = (queue_tail_t) &node;
+      while (!atomic_compare_exchange_weak_relaxed (tail, &expected, NULL))
+	{
+	  if (expected != (queue_tail_t) &node)
+	    break;
+	}
+      if (expected == (queue_tail_t) &node)
+	return;
+      while ((next = atomic_load_acquire (&node.next)) == NULL)
+	atomic_spin_nop ();
+    }
+  queue_wake (next, QUEUED_HEAD);
+}
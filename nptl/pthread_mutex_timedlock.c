@@ -40,6 +40,23 @@
 #define FORCE_ELISION(m, s)
 #endif
 
+/* Acquire MUTEX, and record the wait if it is not available
+   immediately.  */
+static int __attribute_noinline__
+__pthread_mutex_timedlock_profile (pthread_mutex_t *mutex,
+				   const struct timespec *abstime,
+				   const void *caller)
+{
+  int result = __pthread_mutex_trylock (mutex);
+  if (result != EBUSY)
+    return result;
+
+  uint64_t start = __lock_profile_begin ();
+  result = __pthread_mutex_timedlock (mutex, abstime);
+  __lock_profile_end (mutex, LOCK_PROFILE_MUTEX, start, caller, result);
+  return result;
+}
+
 int
 __pthread_mutex_timedlock (pthread_mutex_t *mutex,
 			   const struct timespec *abstime)
@@ -48,6 +65,10 @@ __pthread_mutex_timedlock (pthread_mutex_t *mutex,
   pid_t id = THREAD_GETMEM (THREAD_SELF, tid);
   int result = 0;
 
+  if (__lock_profile_active ())
+    return __pthread_mutex_timedlock_profile (mutex, abstime,
+					      RETURN_ADDRESS (0));
+
   LIBC_PROBE (mutex_timedlock_entry, 2, mutex, abstime);
 
   /* We must not check ABSTIME here.  If the thread does not block
@@ -92,6 +113,11 @@ __pthread_mutex_timedlock (pthread_mutex_t *mutex,
       /* Don't do lock elision on an error checking mutex.  */
       goto simple;
 
+    case PTHREAD_MUTEX_QUEUED_NP:
+      /* Waiters with a timeout do not join the queue, because they
+	 could not leave it before they get the mutex.  */
+      goto simple;
+
     case PTHREAD_MUTEX_TIMED_NP:
       FORCE_ELISION (mutex, goto elision);
     simple:
@@ -329,6 +329,18 @@ __pthread_mutex_unlock_full (pthread_mutex_t *mutex, int decr)
 
       return __pthread_tpp_change_priority (oldprio, -1);
 
+    case PTHREAD_MUTEX_QUEUED_NP:
+      /* Always reset the owner field.  */
+      mutex->__data.__owner = 0;
+      if (decr)
+	/* One less user.  */
+	--mutex->__data.__nusers;
+
+      /* Unlock.  The next waiter is already spinning on the lock word
+	 or blocked on it, see pthread_mutex_queued.c.  */
+      lll_unlock (mutex->__data.__lock, PTHREAD_MUTEX_PSHARED (mutex));
+      break;
+
     default:
       /* Correct code cannot set any other type.  */
       return EINVAL;
@@ -0,0 +1,155 @@
+/* POSIX reader--writer lock: reader bias of the scalable kind.
+   Copyright (C) 2018 Free Software Foundation, Inc.
+   This file is part of the GNU C Library.
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; if not, see
+   <http://www.gnu.org/licenses/>.  */
+
+#include <errno.h>
+#include <time.h>
+#include <atomic.h>
+#include <futex-internal.h>
+#include "pthreadP.h"
+
+/* See pthread_rwlock_common.c for how the table is used.  */
+struct pthread_rwlock_visible_reader
+  __pthread_rwlock_visible_readers[PTHREAD_RWLOCK_VISIBLE_READERS];
+
+/* After a revocation which took T microseconds, the bias is not set
+   again for PTHREAD_RWLOCK_BIAS_INHIBIT * T microseconds, which bounds
+   the share of time writers spend on revocations.  */
+#define PTHREAD_RWLOCK_BIAS_INHIBIT 9
+
+/* Number of checks of a slot before a revoking writer blocks.  */
+#define PTHREAD_RWLOCK_BIAS_SPINS 100
+
+/* Return the monotonic time in microseconds, truncated to 32 bits.  The
+   value 0 of __rbias_until means that the bias is not inhibited.  */
+static uint32_t
+bias_clock (void)
+{
+  struct timespec ts;
+  if (__clock_gettime (CLOCK_MONOTONIC, &ts) != 0)
+    return 0;
+  return (uint32_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+void
+__pthread_rwlock_set_bias (pthread_rwlock_t *rwlock)
+{
+  /* Process-shared rwlocks cannot use the table, which is private to
+     the process.  */
+  if (rwlock->__data.__shared != 0)
+    return;
+  uint32_t until = atomic_load_relaxed (&rwlock->__data.__rbias_until);
+  if (until != 0)
+    {
+      if ((int32_t) (bias_clock () - until) < 0)
+	return;
+      atomic_store_relaxed (&rwlock->__data.__rbias_until, 0);
+    }
+  /* Release MO so that readers which acquire the lock through the bias
+     synchronize with us and thus with the writers before us.  */
+  atomic_store_release (&rwlock->__data.__rbias, 1);
+}
+
+/* Wait until SLOT does not refer to RWLOCK anymore.  Return 0 on
+   success, EBUSY if TRYLOCK and it does, and ETIMEDOUT if ABSTIME
+   expires first.  */
+static int
+wait_for_slot (struct pthread_rwlock_visible_reader *slot,
+	       pthread_rwlock_t *rwlock, const struct timespec *abstime,
+	       bool trylock)
+{
+  uintptr_t lock = (uintptr_t) rwlock;
+  unsigned int spins = 0;
+
+  for (;;)
+    {
+      /* Acquire MO so that we synchronize with the release of the read
+	 lock.  */
+      uintptr_t v = atomic_load_acquire (&slot->rwlock);
+      if ((v & ~PTHREAD_RWLOCK_VISIBLE_WAITING) != lock)
+	return 0;
+      if (trylock)
+	return EBUSY;
+      if (spins < PTHREAD_RWLOCK_BIAS_SPINS)
+	{
+	  ++spins;
+	  atomic_spin_nop ();
+	  continue;
+	}
+
+      /* Read the futex word before marking the slot.  The reader
+	 increments it only after it has seen the mark, so it cannot
+	 release the slot unnoticed.  Release MO on the CAS orders the
+	 load before it, and pairs with the acquire fence of the
+	 reader.  */
+      unsigned int wake = atomic_load_relaxed (&slot->wake);
+      if (v == lock
+	  && !atomic_compare_exchange_weak_release
+	       (&slot->rwlock, &v, lock | PTHREAD_RWLOCK_VISIBLE_WAITING))
+	continue;
+      int err = futex_abstimed_wait (&slot->wake, wake, abstime,
+				     FUTEX_PRIVATE);
+      if (err == ETIMEDOUT)
+	{
+	  /* Remove the mark unless the reader is gone already.  */
+	  v = lock | PTHREAD_RWLOCK_VISIBLE_WAITING;
+	  while (!atomic_compare_exchange_weak_relaxed (&slot->rwlock, &v,
+							lock)
+		 && v == (lock | PTHREAD_RWLOCK_VISIBLE_WAITING))
+	    continue;
+	  return ETIMEDOUT;
+	}
+    }
+}
+
+int
+__pthread_rwlock_revoke_bias (pthread_rwlock_t *rwlock,
+			      const struct timespec *abstime, bool trylock)
+{
+  uint32_t start = bias_clock ();
+  int ret = 0;
+
+  /* The fence orders the store before the loads from the table.  It
+     pairs with the fence in __pthread_rwlock_rdlock_biased, so that
+     either the reader observes the cleared bias, or we observe the
+     reader in its slot.  */
+  atomic_store_relaxed (&rwlock->__data.__rbias, 0);
+  atomic_thread_fence_seq_cst ();
+
+  for (unsigned int i = 0; i < PTHREAD_RWLOCK_VISIBLE_READERS; ++i)
+    {
+      ret = wait_for_slot (&__pthread_rwlock_visible_readers[i], rwlock,
+			   abstime, trylock);
+      if (ret != 0)
+	goto fail;
+    }
+
+  /* Only writers modify __rbias_until, and readers read it while they
+     hold a read lock, so relaxed MO is sufficient.  */
+  uint32_t now = bias_clock ();
+  uint32_t until = now + PTHREAD_RWLOCK_BIAS_INHIBIT * (now - start);
+  atomic_store_relaxed (&rwlock->__data.__rbias_until, until ?: 1);
+  return 0;
+
+ fail:
+  /* The readers we waited for still hold the lock through the bias, so
+     it has to stay set for the writers after us.  The caller releases
+     the write lock without having modified the protected data, so new
+     readers may use the bias again right away.  */
+  atomic_store_release (&rwlock->__data.__rbias, 1);
+  return ret;
+}
@@ -204,6 +204,29 @@
    waiting thread because the waiting thread came first.
 
 
+   Rwlocks of kind PTHREAD_RWLOCK_PREFER_READER_SCALABLE_NP additionally
+   have a reader bias (__rbias), which lets readers avoid the atomic
+   read-modify-write on __readers, whose cache line would otherwise bounce
+   between all CPUs running readers.  While the bias is set, a reader
+   acquires the lock by installing the rwlock in a slot of the global table
+   __pthread_rwlock_visible_readers, selected by a hash of the rwlock and
+   the thread, and checking that the bias is still set; the reader releases
+   the lock by clearing the slot.  If the slot is taken, or the bias is
+   not set, the reader falls back to __readers.  Recursive read locks of
+   a thread which holds the lock through its slot are counted in the
+   slot, whether or not the bias is still set: a writer may already be
+   waiting for that thread, which must not wait for the writer in turn.
+   The bias is set by readers that acquired the lock through __readers,
+   and cleared by writers once they have acquired the lock as described
+   above, which blocks further readers on __readers.  The writer then waits
+   until no slot of the table refers to the rwlock anymore (revocation).
+   It blocks on the wake futex of a slot after marking the slot with
+   PTHREAD_RWLOCK_VISIBLE_WAITING, and the reader releasing a marked slot
+   wakes it.
+   Revocation scans the whole table, so to bound its cost, the bias is not
+   set again for a multiple of the time the last revocation took.
+   The bias is never set on process-shared rwlocks.
+
    POSIX allows but does not require rwlock acquisitions to be a cancellation
    point.  We do not support cancellation.
 
@@ -220,9 +243,106 @@ __pthread_rwlock_get_private (pthread_rwlock_t *rwlock)
   return rwlock->__data.__shared != 0 ? FUTEX_SHARED : FUTEX_PRIVATE;
 }
 
+/* Return the slot of the table of visible readers for RWLOCK and the
+   current thread.  */
+static __always_inline struct pthread_rwlock_visible_reader *
+__pthread_rwlock_visible_reader (pthread_rwlock_t *rwlock)
+{
+  uint32_t h = (((uintptr_t) rwlock >> 4) ^ ((uintptr_t) THREAD_SELF >> 12))
+	       * 2654435761U;
+  return &__pthread_rwlock_visible_readers
+    [h >> (32 - PTHREAD_RWLOCK_VISIBLE_READERS_BITS)];
+}
+
+/* Return true if the current thread holds RWLOCK through SLOT.  Only we
+   store our thread in the owner field, and we clear it before releasing
+   the slot, so if it is set, we own the slot.  */
+static __always_inline bool
+__pthread_rwlock_visible_owned (struct pthread_rwlock_visible_reader *slot,
+				pthread_rwlock_t *rwlock)
+{
+  return (atomic_load_relaxed (&slot->owner) == THREAD_SELF
+	  && ((atomic_load_relaxed (&slot->rwlock)
+	       & ~PTHREAD_RWLOCK_VISIBLE_WAITING) == (uintptr_t) rwlock));
+}
+
+/* Release SLOT, and wake the writer waiting for it, if any.  */
+static __always_inline void
+__pthread_rwlock_visible_release (struct pthread_rwlock_visible_reader *slot)
+{
+  /* Release MO so that a revoking writer synchronizes with us.  The
+     exchange tells us whether the writer is blocked.  */
+  uintptr_t old = atomic_exchange_release (&slot->rwlock, 0);
+  if (__glibc_unlikely ((old & PTHREAD_RWLOCK_VISIBLE_WAITING) != 0))
+    {
+      /* Synchronize with the writer marking the slot, so that it has
+	 read the futex word before we modify it.  */
+      atomic_thread_fence_acquire ();
+      atomic_fetch_add_relaxed (&slot->wake, 1);
+      futex_wake (&slot->wake, 1, FUTEX_PRIVATE);
+    }
+}
+
+/* Try to acquire a read lock through the reader bias.  */
+static __always_inline bool
+__pthread_rwlock_rdlock_biased (pthread_rwlock_t *rwlock)
+{
+  struct pthread_rwlock_visible_reader *slot
+    = __pthread_rwlock_visible_reader (rwlock);
+  if (__glibc_unlikely (__pthread_rwlock_visible_owned (slot, rwlock)))
+    {
+      ++slot->nesting;
+      return true;
+    }
+  if (atomic_load_relaxed (&rwlock->__data.__rbias) == 0)
+    return false;
+  uintptr_t expected = 0;
+  if (!atomic_compare_exchange_weak_relaxed (&slot->rwlock, &expected,
+					     (uintptr_t) rwlock))
+    return false;
+  /* Make our slot visible to writers before checking the bias again.  See
+     __pthread_rwlock_revoke_bias.  Acquire MO on the load so that we
+     synchronize with the reader that set the bias, and thus with the
+     previous writers.  */
+  atomic_thread_fence_seq_cst ();
+  if (__glibc_likely (atomic_load_acquire (&rwlock->__data.__rbias) != 0))
+    {
+      atomic_store_relaxed (&slot->owner, THREAD_SELF);
+      return true;
+    }
+  /* A writer is revoking the bias.  */
+  __pthread_rwlock_visible_release (slot);
+  return false;
+}
+
+/* Release a read lock acquired through the reader bias.  Return false if
+   the current thread did not acquire RWLOCK this way.  */
+static __always_inline bool
+__pthread_rwlock_rdunlock_biased (pthread_rwlock_t *rwlock)
+{
+  struct pthread_rwlock_visible_reader *slot
+    = __pthread_rwlock_visible_reader (rwlock);
+  /* A recursive read lock may have been acquired through __readers, but
+     read locks are interchangeable.  */
+  if (!__pthread_rwlock_visible_owned (slot, rwlock))
+    return false;
+  if (slot->nesting > 0)
+    {
+      --slot->nesting;
+      return true;
+    }
+  atomic_store_relaxed (&slot->owner, NULL);
+  __pthread_rwlock_visible_release (slot);
+  return true;
+}
+
 static __always_inline void
 __pthread_rwlock_rdunlock (pthread_rwlock_t *rwlock)
 {
+  if (rwlock->__data.__flags == PTHREAD_RWLOCK_PREFER_READER_SCALABLE_NP
+      && __pthread_rwlock_rdunlock_biased (rwlock))
+    return;
+
   int private = __pthread_rwlock_get_private (rwlock);
   /* We decrease the number of readers, and if we are the last reader and
      there is a primary writer, we start a write phase.  We use a CAS to
@@ -277,7 +397,7 @@ __pthread_rwlock_rdunlock (pthread_rwlock_t *rwlock)
 
 
 static __always_inline int
-__pthread_rwlock_rdlock_full (pthread_rwlock_t *rwlock,
+__pthread_rwlock_rdlock_slow (pthread_rwlock_t *rwlock,
     const struct timespec *abstime)
 {
   unsigned int r;
@@ -508,6 +628,25 @@ __pthread_rwlock_rdlock_full (pthread_rwlock_t *rwlock,
 }
 
 
+static __always_inline int
+__pthread_rwlock_rdlock_full (pthread_rwlock_t *rwlock,
+    const struct timespec *abstime)
+{
+  if (rwlock->__data.__flags == PTHREAD_RWLOCK_PREFER_READER_SCALABLE_NP)
+    {
+      if (__pthread_rwlock_rdlock_biased (rwlock))
+	return 0;
+      int err = __pthread_rwlock_rdlock_slow (rwlock, abstime);
+      /* We hold a read lock, so no writer can revoke the bias
+	 concurrently.  */
+      if (err == 0 && atomic_load_relaxed (&rwlock->__data.__rbias) == 0)
+	__pthread_rwlock_set_bias (rwlock);
+      return err;
+    }
+  return __pthread_rwlock_rdlock_slow (rwlock, abstime);
+}
+
+
 static __always_inline void
 __pthread_rwlock_wrunlock (pthread_rwlock_t *rwlock)
 {
@@ -519,7 +658,7 @@ __pthread_rwlock_wrunlock (pthread_rwlock_t *rwlock)
   bool wake_writers = ((atomic_exchange_relaxed
       (&rwlock->__data.__writers_futex, 0) & PTHREAD_RWLOCK_FUTEX_USED) != 0);
 
-  if (rwlock->__data.__flags != PTHREAD_RWLOCK_PREFER_READER_NP)
+  if (PTHREAD_RWLOCK_PREFER_WRITER (rwlock))
     {
       /* First, try to hand over to another writer.  */
       unsigned int w = atomic_load_relaxed (&rwlock->__data.__writers);
@@ -597,8 +736,7 @@ __pthread_rwlock_wrlock_full (pthread_rwlock_t *rwlock,
   if (__glibc_unlikely ((r & PTHREAD_RWLOCK_WRLOCKED) != 0))
     {
       /* There is another primary writer.  */
-      bool prefer_writer =
-	  (rwlock->__data.__flags != PTHREAD_RWLOCK_PREFER_READER_NP);
+      bool prefer_writer = PTHREAD_RWLOCK_PREFER_WRITER (rwlock);
       if (prefer_writer)
 	{
 	  /* We register as a waiting writer, so that we can make use of
@@ -804,8 +942,7 @@ __pthread_rwlock_wrlock_full (pthread_rwlock_t *rwlock,
 	      PTHREAD_RWLOCK_FUTEX_USED, abstime, private);
 	  if (err == ETIMEDOUT)
 	    {
-	      if (rwlock->__data.__flags
-		  != PTHREAD_RWLOCK_PREFER_READER_NP)
+	      if (PTHREAD_RWLOCK_PREFER_WRITER (rwlock))
 		{
 		  /* We try writer--writer hand-over.  */
 		  unsigned int w = atomic_load_relaxed
@@ -920,6 +1057,17 @@ __pthread_rwlock_wrlock_full (pthread_rwlock_t *rwlock,
     }
 
  done:
+  /* If readers may have acquired the lock through the reader bias, wait
+     for them.  If we time out, we give up the lock again.  */
+  if (__glibc_unlikely (atomic_load_relaxed (&rwlock->__data.__rbias) != 0))
+    {
+      int err = __pthread_rwlock_revoke_bias (rwlock, abstime, false);
+      if (err != 0)
+	{
+	  __pthread_rwlock_wrunlock (rwlock);
+	  return err;
+	}
+    }
   atomic_store_relaxed (&rwlock->__data.__cur_writer,
       THREAD_GETMEM (THREAD_SELF, tid));
   return 0;
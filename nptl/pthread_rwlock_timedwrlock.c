@@ -33,5 +33,19 @@ pthread_rwlock_timedwrlock (pthread_rwlock_t *rwlock,
       || abstime->tv_nsec < 0))
     return EINVAL;
 
-  return __pthread_rwlock_wrlock_full (rwlock, abstime);
+  bool profile = __lock_profile_active ();
+  uint64_t start = 0;
+  if (profile)
+    {
+      int result = __pthread_rwlock_trywrlock (rwlock);
+      if (result != EBUSY)
+	return result;
+      start = __lock_profile_begin ();
+    }
+
+  int result = __pthread_rwlock_wrlock_full (rwlock, abstime);
+  if (profile)
+    __lock_profile_end (rwlock, LOCK_PROFILE_WRLOCK, start,
+			RETURN_ADDRESS (0), result);
+  return result;
 }
@@ -27,6 +27,10 @@
 int
 __pthread_rwlock_tryrdlock (pthread_rwlock_t *rwlock)
 {
+  if (rwlock->__data.__flags == PTHREAD_RWLOCK_PREFER_READER_SCALABLE_NP
+      && __pthread_rwlock_rdlock_biased (rwlock))
+    return 0;
+
   /* For tryrdlock, we could speculate that we will succeed and go ahead and
      register as a reader.  However, if we misspeculate, we have to do the
      same steps as a timed-out rdlock, which will increase contention.
@@ -110,3 +114,4 @@ __pthread_rwlock_tryrdlock (pthread_rwlock_t *rwlock)
 
 }
 strong_alias (__pthread_rwlock_tryrdlock, pthread_rwlock_tryrdlock)
+hidden_def (__pthread_rwlock_tryrdlock)
@@ -19,6 +19,7 @@
 #include <errno.h>
 #include "pthreadP.h"
 #include <atomic.h>
+#include "pthread_rwlock_common.c"
 
 /* See pthread_rwlock_common.c for an overview.  */
 int
@@ -35,8 +36,7 @@ __pthread_rwlock_trywrlock (pthread_rwlock_t *rwlock)
      further comments) -- and thus must loop until we get a definitive
      observation or state change.  */
   unsigned int r = atomic_load_relaxed (&rwlock->__data.__readers);
-  bool prefer_writer =
-      (rwlock->__data.__flags != PTHREAD_RWLOCK_PREFER_READER_NP);
+  bool prefer_writer = PTHREAD_RWLOCK_PREFER_WRITER (rwlock);
   while (((r & PTHREAD_RWLOCK_WRLOCKED) == 0)
       && (((r >> PTHREAD_RWLOCK_READER_SHIFT) == 0)
 	  || (prefer_writer && ((r & PTHREAD_RWLOCK_WRPHASE) != 0))))
@@ -48,6 +48,14 @@ __pthread_rwlock_trywrlock (pthread_rwlock_t *rwlock)
 	{
 	  atomic_store_relaxed (&rwlock->__data.__writers_futex, 1);
 	  atomic_store_relaxed (&rwlock->__data.__wrphase_futex, 1);
+	  /* Fail if readers acquired the lock through the reader bias.  */
+	  if (__glibc_unlikely (atomic_load_relaxed (&rwlock->__data.__rbias)
+				!= 0)
+	      && __pthread_rwlock_revoke_bias (rwlock, NULL, true) != 0)
+	    {
+	      __pthread_rwlock_wrunlock (rwlock);
+	      return EBUSY;
+	    }
 	  atomic_store_relaxed (&rwlock->__data.__cur_writer,
 	      THREAD_GETMEM (THREAD_SELF, tid));
 	  return 0;
@@ -59,3 +67,4 @@ __pthread_rwlock_trywrlock (pthread_rwlock_t *rwlock)
 }
 
 strong_alias (__pthread_rwlock_trywrlock, pthread_rwlock_trywrlock)
+hidden_def (__pthread_rwlock_trywrlock)
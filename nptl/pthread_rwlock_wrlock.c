@@ -24,7 +24,20 @@ __pthread_rwlock_wrlock (pthread_rwlock_t *rwlock)
 {
   LIBC_PROBE (wrlock_entry, 1, rwlock);
 
+  bool profile = __lock_profile_active ();
+  uint64_t start = 0;
+  if (profile)
+    {
+      int result = __pthread_rwlock_trywrlock (rwlock);
+      if (result != EBUSY)
+	return result;
+      start = __lock_profile_begin ();
+    }
+
   int result = __pthread_rwlock_wrlock_full (rwlock, NULL);
+  if (profile)
+    __lock_profile_end (rwlock, LOCK_PROFILE_WRLOCK, start,
+			RETURN_ADDRESS (0), result);
   LIBC_PROBE (wrlock_acquire_write, 1, rwlock);
   return result;
 }
@@ -0,0 +1,230 @@
+/* Test requeueing of condvar waiters onto the mutex futex.
+   Copyright (C) 2018 Free Software Foundation, Inc.
+   This file is part of the GNU C Library.
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; if not, see
+   <http://www.gnu.org/licenses/>.  */
+
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdbool.h>
+#include <time.h>
+#include <support/check.h>
+#include <support/xthread.h>
+
+enum
+  {
+    thread_count = 8,
+    iterations = 20000,
+  };
+
+static pthread_mutex_t lock;
+static pthread_cond_t cond = PTHREAD_COND_INITIALIZER;
+
+/* Protected by LOCK.  */
+static bool done;
+static unsigned int waiting;
+
+static void *
+worker_thread (void *closure)
+{
+  bool timed = closure != NULL;
+  xpthread_mutex_lock (&lock);
+  while (!done)
+    {
+      if (timed)
+	{
+	  struct timespec abstime;
+	  TEST_COMPARE (clock_gettime (CLOCK_REALTIME, &abstime), 0);
+	  abstime.tv_nsec += 1000 * 1000;
+	  if (abstime.tv_nsec >= 1000 * 1000 * 1000)
+	    {
+	      abstime.tv_nsec -= 1000 * 1000 * 1000;
+	      ++abstime.tv_sec;
+	    }
+	  int ret = pthread_cond_timedwait (&cond, &lock, &abstime);
+	  if (ret != 0)
+	    TEST_COMPARE (ret, ETIMEDOUT);
+	}
+      else
+	xpthread_cond_wait (&cond, &lock);
+    }
+  xpthread_mutex_unlock (&lock);
+  return NULL;
+}
+
+/* Mixes broadcasts and signals with and without the mutex held.  A
+   signal which switches groups has to quiesce the group of waiters which
+   a previous broadcast requeued onto the mutex.  */
+static void
+test_worker_pool (void)
+{
+  pthread_t threads[thread_count];
+  for (int i = 0; i < thread_count; ++i)
+    threads[i] = xpthread_create (NULL, worker_thread,
+				  i % 4 == 3 ? &threads[i] : NULL);
+
+  for (int i = 0; i < iterations; ++i)
+    {
+      xpthread_mutex_lock (&lock);
+      if (i % 3 == 0)
+	TEST_COMPARE (pthread_cond_broadcast (&cond), 0);
+      else
+	TEST_COMPARE (pthread_cond_signal (&cond), 0);
+      xpthread_mutex_unlock (&lock);
+      if (i % 5 == 0)
+	TEST_COMPARE (pthread_cond_broadcast (&cond), 0);
+      if (i % 7 == 0)
+	sched_yield ();
+    }
+
+  xpthread_mutex_lock (&lock);
+  done = true;
+  TEST_COMPARE (pthread_cond_broadcast (&cond), 0);
+  xpthread_mutex_unlock (&lock);
+  for (int i = 0; i < thread_count; ++i)
+    xpthread_join (threads[i]);
+}
+
+static pthread_cond_t local_cond;
+
+static void *
+destroy_thread (void *closure)
+{
+  xpthread_mutex_lock (&lock);
+  ++waiting;
+  while (!done)
+    xpthread_cond_wait (&local_cond, &lock);
+  xpthread_mutex_unlock (&lock);
+  return NULL;
+}
+
+/* The waiters requeued by a broadcast have not returned from
+   pthread_cond_wait yet when the condvar is destroyed with the mutex
+   held.  */
+static void
+test_destroy (void)
+{
+  for (int round = 0; round < 100; ++round)
+    {
+      TEST_COMPARE (pthread_cond_init (&local_cond, NULL), 0);
+      done = false;
+      waiting = 0;
+      pthread_t threads[thread_count];
+      for (int i = 0; i < thread_count; ++i)
+	threads[i] = xpthread_create (NULL, destroy_thread, NULL);
+
+      xpthread_mutex_lock (&lock);
+      while (waiting < thread_count)
+	{
+	  xpthread_mutex_unlock (&lock);
+	  sched_yield ();
+	  xpthread_mutex_lock (&lock);
+	}
+      done = true;
+      TEST_COMPARE (pthread_cond_broadcast (&local_cond), 0);
+      TEST_COMPARE (pthread_cond_destroy (&local_cond), 0);
+      xpthread_mutex_unlock (&lock);
+
+      for (int i = 0; i < thread_count; ++i)
+	xpthread_join (threads[i]);
+    }
+}
+
+/* More condvars than slots in the requeue table, so that some of them
+   share a slot.  Only one condvar of a slot has its waiters requeued;
+   the waiters of the others are woken up.  */
+enum { shared_count = 65 };
+static pthread_cond_t shared_conds[shared_count];
+
+static void *
+shared_thread (void *closure)
+{
+  pthread_cond_t *cond = closure;
+  xpthread_mutex_lock (&lock);
+  ++waiting;
+  while (!done)
+    xpthread_cond_wait (cond, &lock);
+  xpthread_mutex_unlock (&lock);
+  return NULL;
+}
+
+static void
+test_shared_slots (void)
+{
+  for (int i = 0; i < shared_count; ++i)
+    TEST_COMPARE (pthread_cond_init (&shared_conds[i], NULL), 0);
+
+  for (int round = 0; round < 10; ++round)
+    {
+      done = false;
+      waiting = 0;
+      pthread_t threads[shared_count];
+      for (int i = 0; i < shared_count; ++i)
+	threads[i] = xpthread_create (NULL, shared_thread, &shared_conds[i]);
+
+      xpthread_mutex_lock (&lock);
+      while (waiting < shared_count)
+	{
+	  xpthread_mutex_unlock (&lock);
+	  sched_yield ();
+	  xpthread_mutex_lock (&lock);
+	}
+      done = true;
+      for (int i = 0; i < shared_count; ++i)
+	TEST_COMPARE (pthread_cond_broadcast (&shared_conds[i]), 0);
+      xpthread_mutex_unlock (&lock);
+
+      for (int i = 0; i < shared_count; ++i)
+	xpthread_join (threads[i]);
+    }
+
+  for (int i = 0; i < shared_count; ++i)
+    TEST_COMPARE (pthread_cond_destroy (&shared_conds[i]), 0);
+}
+
+static int
+do_test (void)
+{
+  static const int types[] =
+    {
+      PTHREAD_MUTEX_NORMAL,
+      PTHREAD_MUTEX_RECURSIVE,
+      PTHREAD_MUTEX_ERRORCHECK,
+      PTHREAD_MUTEX_ADAPTIVE_NP,
+      /* Waiters are not requeued onto these.  */
+      PTHREAD_MUTEX_QUEUED_NP,
+    };
+
+  for (int i = 0; i < sizeof (types) / sizeof (types[0]); ++i)
+    {
+      pthread_mutexattr_t attr;
+      TEST_COMPARE (pthread_mutexattr_init (&attr), 0);
+      TEST_COMPARE (pthread_mutexattr_settype (&attr, types[i]), 0);
+      TEST_COMPARE (pthread_mutex_init (&lock, &attr), 0);
+      TEST_COMPARE (pthread_mutexattr_destroy (&attr), 0);
+
+      done = false;
+      test_worker_pool ();
+      test_destroy ();
+      test_shared_slots ();
+
+      TEST_COMPARE (pthread_mutex_destroy (&lock), 0);
+    }
+
+  return 0;
+}
+
+#include <support/test-driver.c>
@@ -0,0 +1,276 @@
+/* Test the lock profiler (glibc.pthread.lock_profile).
+   Copyright (C) 2018 Free Software Foundation, Inc.
+   This file is part of the GNU C Library.
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; if not, see
+   <http://www.gnu.org/licenses/>.  */
+
+#include <errno.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <support/capture_subprocess.h>
+#include <support/check.h>
+#include <support/support.h>
+#include <support/temp_file.h>
+#include <support/test-driver.h>
+#include <support/xstdio.h>
+#include <support/xthread.h>
+#include <support/xunistd.h>
+
+static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t uncontended = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t errorcheck = PTHREAD_ERRORCHECK_MUTEX_INITIALIZER_NP;
+static pthread_rwlock_t rwlock = PTHREAD_RWLOCK_INITIALIZER;
+static pthread_cond_t cond = PTHREAD_COND_INITIALIZER;
+static pthread_barrier_t barrier;
+
+/* Protected by MUTEX.  */
+static bool signaled;
+
+static void
+sleep_ms (int ms)
+{
+  struct timespec ts = { 0, ms * 1000 * 1000 };
+  while (nanosleep (&ts, &ts) != 0)
+    ;
+}
+
+static void *
+mutex_thread (void *closure)
+{
+  xpthread_barrier_wait (&barrier);
+  xpthread_mutex_lock (&mutex);
+  xpthread_mutex_unlock (&mutex);
+  return NULL;
+}
+
+static void *
+rdlock_thread (void *closure)
+{
+  xpthread_barrier_wait (&barrier);
+  TEST_COMPARE (pthread_rwlock_rdlock (&rwlock), 0);
+  TEST_COMPARE (pthread_rwlock_unlock (&rwlock), 0);
+  return NULL;
+}
+
+static void *
+wrlock_thread (void *closure)
+{
+  xpthread_barrier_wait (&barrier);
+  TEST_COMPARE (pthread_rwlock_wrlock (&rwlock), 0);
+  TEST_COMPARE (pthread_rwlock_unlock (&rwlock), 0);
+  return NULL;
+}
+
+static void *
+cond_thread (void *closure)
+{
+  xpthread_mutex_lock (&mutex);
+  xpthread_barrier_wait (&barrier);
+  while (!signaled)
+    xpthread_cond_wait (&cond, &mutex);
+  xpthread_mutex_unlock (&mutex);
+  return NULL;
+}
+
+/* Make another thread wait for each kind of lock.  The other thread
+   blocks while the main thread holds the lock for a while.  */
+static void
+contend (void)
+{
+  xpthread_mutex_lock (&uncontended);
+  xpthread_mutex_unlock (&uncontended);
+
+  /* Relocking an error-checking mutex fails without waiting.  */
+  xpthread_mutex_lock (&errorcheck);
+  TEST_COMPARE (pthread_mutex_lock (&errorcheck), EDEADLK);
+  xpthread_mutex_unlock (&errorcheck);
+
+  xpthread_barrier_init (&barrier, NULL, 2);
+
+  xpthread_mutex_lock (&mutex);
+  pthread_t thr = xpthread_create (NULL, mutex_thread, NULL);
+  xpthread_barrier_wait (&barrier);
+  sleep_ms (20);
+  xpthread_mutex_unlock (&mutex);
+  xpthread_join (thr);
+
+  TEST_COMPARE (pthread_rwlock_wrlock (&rwlock), 0);
+  thr = xpthread_create (NULL, rdlock_thread, NULL);
+  xpthread_barrier_wait (&barrier);
+  sleep_ms (20);
+  TEST_COMPARE (pthread_rwlock_unlock (&rwlock), 0);
+  xpthread_join (thr);
+
+  TEST_COMPARE (pthread_rwlock_rdlock (&rwlock), 0);
+  thr = xpthread_create (NULL, wrlock_thread, NULL);
+  xpthread_barrier_wait (&barrier);
+  sleep_ms (20);
+  TEST_COMPARE (pthread_rwlock_unlock (&rwlock), 0);
+  xpthread_join (thr);
+
+  thr = xpthread_create (NULL, cond_thread, NULL);
+  xpthread_barrier_wait (&barrier);
+  xpthread_mutex_lock (&mutex);
+  signaled = true;
+  TEST_COMPARE (pthread_cond_signal (&cond), 0);
+  xpthread_mutex_unlock (&mutex);
+  xpthread_join (thr);
+
+  xpthread_barrier_destroy (&barrier);
+}
+
+/* Return the report line for LOCK of TYPE in REPORT, or NULL.  */
+static char *
+find_lock (const char *report, const void *lock, const char *type)
+{
+  char *prefix = xasprintf ("0x%0*lx %*s ", (int) (2 * sizeof (void *)),
+			    (unsigned long int) lock, 10, type);
+  char *result = NULL;
+  for (const char *line = report; line != NULL && *line != '\0'; )
+    {
+      const char *end = strchrnul (line, '\n');
+      if (strncmp (line, prefix, strlen (prefix)) == 0)
+	{
+	  result = xasprintf ("%.*s", (int) (end - line), line);
+	  break;
+	}
+      line = *end == '\0' ? NULL : end + 1;
+    }
+  free (prefix);
+  return result;
+}
+
+/* Check that REPORT records the waits made by contend.  */
+static void
+check_report (const char *report)
+{
+  if (test_verbose > 0)
+    printf ("info: report:\n%s", report);
+
+  char *expected = xasprintf ("lock profile of process %d: ", (int) getpid ());
+  TEST_VERIFY (strncmp (report, expected, strlen (expected)) == 0);
+  free (expected);
+  TEST_VERIFY (strstr (report, "\nMAPPED_LIBRARIES:\n") != NULL);
+
+  char *line = find_lock (report, &uncontended, "mutex");
+  TEST_VERIFY (line == NULL);
+  free (line);
+  line = find_lock (report, &errorcheck, "mutex");
+  TEST_VERIFY (line == NULL);
+  free (line);
+
+  static const struct
+  {
+    const void *lock;
+    const char *type;
+    /* Whether the wait was long enough to be included in the counters.  */
+    bool slow;
+  } locks[] =
+    {
+      { &mutex, "mutex", true },
+      { &rwlock, "rwlock-rd", true },
+      { &rwlock, "rwlock-wr", true },
+      { &cond, "cond", false },
+    };
+  for (int i = 0; i < sizeof (locks) / sizeof (locks[0]); ++i)
+    {
+      char *line = find_lock (report, locks[i].lock, locks[i].type);
+      if (line == NULL)
+	{
+	  support_record_failure ();
+	  printf ("error: no %s line for %p\n", locks[i].type, locks[i].lock);
+	  continue;
+	}
+      unsigned long int waits, total, max;
+      int caller = 0;
+      TEST_COMPARE (sscanf (line + 2 + 2 * sizeof (void *) + 11,
+			    "%lu %lu %lu  0x%n", &waits, &total, &max, &caller),
+		    3);
+      TEST_VERIFY (waits >= 1);
+      TEST_VERIFY (max <= total);
+      if (locks[i].slow)
+	TEST_VERIFY (max >= 10 * 1000);
+      /* The caller is printed with all its digits.  */
+      TEST_VERIFY (caller > 0);
+      TEST_COMPARE (strlen (line + 2 + 2 * sizeof (void *) + 11 + caller),
+		    2 * sizeof (void *));
+      free (line);
+    }
+}
+
+/* Run in a subprocess, which writes its report to standard error when
+   it exits.  */
+static void
+report_at_exit (void *closure)
+{
+  contend ();
+  exit (0);
+}
+
+static int
+do_test (void)
+{
+  contend ();
+
+  /* Ask for a report in a temporary directory.  */
+  char *dir = support_create_temp_directory ("tst-lock-profile-");
+  TEST_COMPARE (chdir (dir), 0);
+  free (dir);
+  TEST_COMPARE (raise (12), 0);
+  char *name = xasprintf ("lock-profile.%d.0", (int) getpid ());
+  FILE *fp = xfopen (name, "r");
+  char *report = NULL;
+  size_t report_size = 0;
+  {
+    char buf[4096];
+    size_t n;
+    while ((n = fread (buf, 1, sizeof (buf), fp)) > 0)
+      {
+	report = xrealloc (report, report_size + n + 1);
+	memcpy (report + report_size, buf, n);
+	report_size += n;
+	report[report_size] = '\0';
+      }
+  }
+  xfclose (fp);
+  TEST_VERIFY_EXIT (report != NULL);
+  check_report (report);
+  free (report);
+  xunlink (name);
+  free (name);
+
+  struct support_capture_subprocess result
+    = support_capture_subprocess (report_at_exit, NULL);
+  support_capture_subprocess_check (&result, "report_at_exit", 0,
+				    sc_allow_stderr);
+  /* The report names the process which wrote it.  */
+  TEST_VERIFY (strncmp (result.err.buffer, "lock profile of process ",
+			strlen ("lock profile of process ")) == 0);
+  TEST_VERIFY (strstr (result.err.buffer, " mutex ") != NULL);
+  TEST_VERIFY (strstr (result.err.buffer, " rwlock-rd ") != NULL);
+  TEST_VERIFY (strstr (result.err.buffer, " rwlock-wr ") != NULL);
+  TEST_VERIFY (strstr (result.err.buffer, " cond ") != NULL);
+  support_capture_subprocess_free (&result);
+
+  return 0;
+}
+
+#include <support/test-driver.c>
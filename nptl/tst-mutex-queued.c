@@ -0,0 +1,147 @@
+/* Test PTHREAD_MUTEX_QUEUED_NP mutexes.
+   Copyright (C) 2018 Free Software Foundation, Inc.
+   This file is part of the GNU C Library.
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; if not, see
+   <http://www.gnu.org/licenses/>.  */
+
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+#include <support/check.h>
+#include <support/xthread.h>
+
+enum
+  {
+    thread_count = 16,
+    iterations = 20000,
+  };
+
+static pthread_mutex_t lock = PTHREAD_QUEUED_MUTEX_INITIALIZER_NP;
+static pthread_cond_t cond = PTHREAD_COND_INITIALIZER;
+
+/* Protected by LOCK.  */
+static unsigned long int counter;
+static unsigned int signals;
+
+static void *
+thread_function (void *closure)
+{
+  for (int i = 0; i < iterations; ++i)
+    {
+      if (i % 32 == 1)
+	{
+	  int ret = pthread_mutex_trylock (&lock);
+	  if (ret != 0)
+	    {
+	      TEST_COMPARE (ret, EBUSY);
+	      xpthread_mutex_lock (&lock);
+	    }
+	}
+      else if (i % 32 == 2)
+	{
+	  struct timespec abstime;
+	  TEST_COMPARE (clock_gettime (CLOCK_REALTIME, &abstime), 0);
+	  abstime.tv_sec += 60;
+	  TEST_COMPARE (pthread_mutex_timedlock (&lock, &abstime), 0);
+	}
+      else
+	xpthread_mutex_lock (&lock);
+
+      /* Not atomic, so that lost updates show up in the total.  */
+      unsigned long int c = counter;
+      if (i % 256 == 0)
+	sched_yield ();
+      counter = c + 1;
+
+      /* Exercise reacquiring the mutex in pthread_cond_wait.  */
+      if (i % 1024 == 3)
+	{
+	  ++signals;
+	  TEST_COMPARE (pthread_cond_signal (&cond), 0);
+	}
+      xpthread_mutex_unlock (&lock);
+    }
+  return NULL;
+}
+
+static void *
+cond_thread (void *closure)
+{
+  xpthread_mutex_lock (&lock);
+  while (signals < thread_count)
+    xpthread_cond_wait (&cond, &lock);
+  xpthread_mutex_unlock (&lock);
+  return NULL;
+}
+
+static int
+do_test (void)
+{
+  pthread_mutexattr_t attr;
+  int kind;
+  TEST_COMPARE (pthread_mutexattr_init (&attr), 0);
+  TEST_COMPARE (pthread_mutexattr_settype (&attr, PTHREAD_MUTEX_QUEUED_NP), 0);
+  TEST_COMPARE (pthread_mutexattr_gettype (&attr, &kind), 0);
+  TEST_COMPARE (kind, PTHREAD_MUTEX_QUEUED_NP);
+  TEST_COMPARE (pthread_mutexattr_settype (&attr,
+					   PTHREAD_MUTEX_QUEUED_NP + 1),
+		EINVAL);
+
+  /* The waiter queue is private to the process, and the waiters do not
+     support robustness or priority protocols.  */
+  pthread_mutex_t m;
+  TEST_COMPARE (pthread_mutexattr_setpshared (&attr, PTHREAD_PROCESS_SHARED),
+		0);
+  TEST_COMPARE (pthread_mutex_init (&m, &attr), ENOTSUP);
+  TEST_COMPARE (pthread_mutexattr_setpshared (&attr, PTHREAD_PROCESS_PRIVATE),
+		0);
+  TEST_COMPARE (pthread_mutexattr_setrobust (&attr, PTHREAD_MUTEX_ROBUST), 0);
+  TEST_COMPARE (pthread_mutex_init (&m, &attr), ENOTSUP);
+  TEST_COMPARE (pthread_mutexattr_setrobust (&attr, PTHREAD_MUTEX_STALLED),
+		0);
+  TEST_COMPARE (pthread_mutexattr_setprotocol (&attr, PTHREAD_PRIO_INHERIT),
+		0);
+  TEST_COMPARE (pthread_mutex_init (&m, &attr), ENOTSUP);
+  TEST_COMPARE (pthread_mutexattr_setprotocol (&attr, PTHREAD_PRIO_NONE), 0);
+
+  TEST_COMPARE (pthread_mutex_init (&m, &attr), 0);
+  TEST_COMPARE (m.__data.__kind, lock.__data.__kind);
+  xpthread_mutex_lock (&m);
+  TEST_COMPARE (pthread_mutex_trylock (&m), EBUSY);
+  xpthread_mutex_unlock (&m);
+  TEST_COMPARE (pthread_mutex_trylock (&m), 0);
+  xpthread_mutex_unlock (&m);
+  TEST_COMPARE (pthread_mutex_destroy (&m), 0);
+  TEST_COMPARE (pthread_mutexattr_destroy (&attr), 0);
+
+  pthread_t waiter = xpthread_create (NULL, cond_thread, NULL);
+  pthread_t threads[thread_count];
+  for (int i = 0; i < thread_count; ++i)
+    threads[i] = xpthread_create (NULL, thread_function, NULL);
+  for (int i = 0; i < thread_count; ++i)
+    xpthread_join (threads[i]);
+  xpthread_join (waiter);
+
+  TEST_COMPARE (counter, thread_count * iterations);
+  /* No waiter is left in the queue.  */
+  TEST_VERIFY (lock.__data.__list.__next == NULL);
+  TEST_COMPARE (lock.__data.__lock, 0);
+  TEST_COMPARE (pthread_mutex_destroy (&lock), 0);
+
+  return 0;
+}
+
+#include <support/test-driver.c>
@@ -0,0 +1,222 @@
+/* Test the reader bias of PTHREAD_RWLOCK_PREFER_READER_SCALABLE_NP.
+   Copyright (C) 2018 Free Software Foundation, Inc.
+   This file is part of the GNU C Library.
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; if not, see
+   <http://www.gnu.org/licenses/>.  */
+
+#include <errno.h>
+#include <pthread.h>
+#include <time.h>
+#include <support/check.h>
+#include <support/xthread.h>
+
+enum
+  {
+    reader_count = 6,
+    writer_count = 2,
+    read_iterations = 200000,
+    write_iterations = 2000,
+  };
+
+static pthread_rwlock_t lock;
+
+/* Both counters are incremented by writers.  Readers check that they
+   never observe different values.  */
+static volatile unsigned int counter1;
+static volatile unsigned int counter2;
+
+static void
+init_lock (pthread_rwlock_t *rwlock, int pshared)
+{
+  pthread_rwlockattr_t attr;
+  xpthread_rwlockattr_init (&attr);
+  xpthread_rwlockattr_setkind_np (&attr,
+				  PTHREAD_RWLOCK_PREFER_READER_SCALABLE_NP);
+  TEST_COMPARE (pthread_rwlockattr_setpshared (&attr, pshared), 0);
+  xpthread_rwlock_init (rwlock, &attr);
+  TEST_COMPARE (pthread_rwlockattr_destroy (&attr), 0);
+}
+
+static void
+check_counters (void)
+{
+  unsigned int c1 = counter1;
+  for (volatile int i = 0; i < 10; ++i)
+    ;
+  TEST_COMPARE (c1, counter2);
+}
+
+static void *
+reader_thread (void *closure)
+{
+  for (int i = 0; i < read_iterations; ++i)
+    {
+      if (i % 16 == 0)
+	{
+	  /* Recursive read locks.  */
+	  xpthread_rwlock_rdlock (&lock);
+	  xpthread_rwlock_rdlock (&lock);
+	  check_counters ();
+	  xpthread_rwlock_unlock (&lock);
+	  check_counters ();
+	  xpthread_rwlock_unlock (&lock);
+	}
+      else if (i % 16 == 1)
+	{
+	  int ret = pthread_rwlock_tryrdlock (&lock);
+	  if (ret == 0)
+	    {
+	      check_counters ();
+	      xpthread_rwlock_unlock (&lock);
+	    }
+	  else
+	    TEST_COMPARE (ret, EBUSY);
+	}
+      else
+	{
+	  xpthread_rwlock_rdlock (&lock);
+	  check_counters ();
+	  xpthread_rwlock_unlock (&lock);
+	}
+    }
+  return NULL;
+}
+
+static void *
+writer_thread (void *closure)
+{
+  for (int i = 0; i < write_iterations; ++i)
+    {
+      if (i % 4 == 0)
+	{
+	  int ret = pthread_rwlock_trywrlock (&lock);
+	  if (ret != 0)
+	    {
+	      TEST_COMPARE (ret, EBUSY);
+	      continue;
+	    }
+	}
+      else
+	xpthread_rwlock_wrlock (&lock);
+      ++counter1;
+      ++counter2;
+      xpthread_rwlock_unlock (&lock);
+      /* Let the readers set the bias again.  */
+      if (i % 64 == 0)
+	{
+	  struct timespec delay = { 0, 1000 * 1000 };
+	  nanosleep (&delay, NULL);
+	}
+    }
+  return NULL;
+}
+
+/* Called with LOCK read-locked by the main thread, through the bias if
+   it is set.  */
+static void *
+blocked_writer_thread (void *closure)
+{
+  TEST_COMPARE (pthread_rwlock_trywrlock (&lock), EBUSY);
+
+  struct timespec abstime;
+  TEST_COMPARE (clock_gettime (CLOCK_REALTIME, &abstime), 0);
+  abstime.tv_nsec += 100 * 1000 * 1000;
+  if (abstime.tv_nsec >= 1000 * 1000 * 1000)
+    {
+      abstime.tv_nsec -= 1000 * 1000 * 1000;
+      ++abstime.tv_sec;
+    }
+  TEST_COMPARE (pthread_rwlock_timedwrlock (&lock, &abstime), ETIMEDOUT);
+
+  /* Other readers can still acquire the lock.  */
+  xpthread_rwlock_rdlock (&lock);
+  xpthread_rwlock_unlock (&lock);
+  return NULL;
+}
+
+static void *
+writer_once_thread (void *closure)
+{
+  xpthread_rwlock_wrlock (&lock);
+  ++counter1;
+  ++counter2;
+  xpthread_rwlock_unlock (&lock);
+  return NULL;
+}
+
+static int
+do_test (void)
+{
+  init_lock (&lock, PTHREAD_PROCESS_PRIVATE);
+
+  /* The first read lock sets the bias, so the second one is acquired
+     through it.  Writers must still be excluded.  */
+  for (int i = 0; i < 2; ++i)
+    {
+      xpthread_rwlock_rdlock (&lock);
+      if (i == 0)
+	xpthread_rwlock_unlock (&lock);
+    }
+  xpthread_join (xpthread_create (NULL, blocked_writer_thread, NULL));
+  pthread_t writer = xpthread_create (NULL, writer_once_thread, NULL);
+  struct timespec delay = { 0, 50 * 1000 * 1000 };
+  nanosleep (&delay, NULL);
+  TEST_COMPARE (counter1, 0);
+  /* The writer has cleared the bias and waits for us, so recursive read
+     locks must not wait for the writer.  */
+  xpthread_rwlock_rdlock (&lock);
+  TEST_COMPARE (pthread_rwlock_tryrdlock (&lock), 0);
+  check_counters ();
+  xpthread_rwlock_unlock (&lock);
+  xpthread_rwlock_unlock (&lock);
+  TEST_COMPARE (counter1, 0);
+  /* The writer is blocked and woken up when the slot is released.  */
+  xpthread_rwlock_unlock (&lock);
+  xpthread_join (writer);
+  TEST_COMPARE (counter1, 1);
+
+  /* A writer holding the lock is detected after the bias was used.  */
+  xpthread_rwlock_wrlock (&lock);
+  TEST_COMPARE (pthread_rwlock_rdlock (&lock), EDEADLK);
+  TEST_COMPARE (pthread_rwlock_tryrdlock (&lock), EBUSY);
+  xpthread_rwlock_unlock (&lock);
+
+  /* Concurrent readers and writers.  */
+  pthread_t threads[reader_count + writer_count];
+  for (int i = 0; i < reader_count; ++i)
+    threads[i] = xpthread_create (NULL, reader_thread, NULL);
+  for (int i = 0; i < writer_count; ++i)
+    threads[reader_count + i] = xpthread_create (NULL, writer_thread, NULL);
+  for (int i = 0; i < reader_count + writer_count; ++i)
+    xpthread_join (threads[i]);
+  TEST_COMPARE (counter1, counter2);
+  TEST_COMPARE (pthread_rwlock_destroy (&lock), 0);
+
+  /* Process-shared rwlocks of this kind behave like
+     PTHREAD_RWLOCK_PREFER_READER_NP.  */
+  init_lock (&lock, PTHREAD_PROCESS_SHARED);
+  xpthread_rwlock_rdlock (&lock);
+  xpthread_rwlock_rdlock (&lock);
+  TEST_COMPARE (pthread_rwlock_trywrlock (&lock), EBUSY);
+  xpthread_rwlock_unlock (&lock);
+  xpthread_rwlock_unlock (&lock);
+  xpthread_rwlock_wrlock (&lock);
+  xpthread_rwlock_unlock (&lock);
+  TEST_COMPARE (pthread_rwlock_destroy (&lock), 0);
+
+  return 0;
+}
+
+#include <support/test-driver.c>
@@ -0,0 +1,103 @@
+/* Test the sharded cache of thread stacks.
+   Copyright (C) 2018 Free Software Foundation, Inc.
+   This file is part of the GNU C Library.
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; if not, see
+   <http://www.gnu.org/licenses/>.  */
+
+#include <pthread.h>
+#include <stdint.h>
+#include <string.h>
+#include <support/check.h>
+#include <support/xthread.h>
+
+enum
+  {
+    creator_count = 8,
+    iterations = 2000,
+    /* Stacks which may be in the cache when the test starts.  The test
+       runs with glibc.pthread.stack_cache_prefill=4.  */
+    prefilled = 4,
+  };
+
+static void *
+stack_thread (void *closure)
+{
+  /* Touch the stack, so that reused stacks are checked to be
+     usable.  */
+  volatile char buf[4096];
+  memset ((char *) buf, 0xa5, sizeof (buf));
+
+  pthread_attr_t attr;
+  void *stackaddr;
+  size_t stacksize;
+  TEST_COMPARE (pthread_getattr_np (pthread_self (), &attr), 0);
+  TEST_COMPARE (pthread_attr_getstack (&attr, &stackaddr, &stacksize), 0);
+  TEST_COMPARE (pthread_attr_destroy (&attr), 0);
+  return stackaddr;
+}
+
+/* Create and join threads one at a time, with the default stack size
+   and with a smaller one.  */
+static void *
+creator_thread (void *closure)
+{
+  pthread_attr_t attr;
+  xpthread_attr_init (&attr);
+  xpthread_attr_setstacksize (&attr, 256 * 1024);
+
+  for (int i = 0; i < iterations; ++i)
+    xpthread_join (xpthread_create (i % 2 == 0 ? NULL : &attr,
+				    stack_thread, NULL));
+
+  xpthread_attr_destroy (&attr);
+  return NULL;
+}
+
+static int
+do_test (void)
+{
+  /* Threads created one at a time reuse the stacks of the threads
+     before them.  */
+  void *stacks[prefilled + 1];
+  int distinct = 0;
+  for (int i = 0; i < 100; ++i)
+    {
+      void *stackaddr = xpthread_join (xpthread_create (NULL, stack_thread,
+							NULL));
+      int j;
+      for (j = 0; j < distinct; ++j)
+	if (stacks[j] == stackaddr)
+	  break;
+      if (j == distinct)
+	{
+	  if (distinct == prefilled + 1)
+	    FAIL_EXIT1 ("stack %p of thread %d not reused from the cache",
+			stackaddr, i);
+	  stacks[distinct++] = stackaddr;
+	}
+    }
+
+  /* Concurrent creators use different shards of the cache, and take
+     stacks from each other's shards.  */
+  pthread_t creators[creator_count];
+  for (int i = 0; i < creator_count; ++i)
+    creators[i] = xpthread_create (NULL, creator_thread, NULL);
+  for (int i = 0; i < creator_count; ++i)
+    xpthread_join (creators[i]);
+
+  return 0;
+}
+
+#include <support/test-driver.c>
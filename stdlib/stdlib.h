@@ -562,6 +562,17 @@ extern void *reallocarray (void *__ptr, size_t __nmemb, size_t __size)
 /* Free a block allocated by `malloc', `realloc' or `calloc'.  */
 extern void free (void *__ptr) __THROW;
 
+#ifdef __USE_GNU
+/* Free a block of SIZE bytes allocated by `malloc', `realloc' or
+   `calloc'.  SIZE must be the size that was requested.  */
+extern void free_sized (void *__ptr, size_t __size) __THROW;
+
+/* Free a block of SIZE bytes allocated by `aligned_alloc' with an
+   alignment of ALIGNMENT bytes.  */
+extern void free_aligned_sized (void *__ptr, size_t __alignment,
+				size_t __size) __THROW;
+#endif
+
 #ifdef __USE_MISC
 # include <alloca.h>
 #endif /* Use misc.  */
@@ -57,8 +57,8 @@ struct __pthread_rwlock_arch_t
   unsigned int __writers;
   unsigned int __wrphase_futex;
   unsigned int __writers_futex;
-  unsigned int __pad3;
-  unsigned int __pad4;
+  unsigned int __rbias;
+  unsigned int __rbias_until;
   int __cur_writer;
   int __shared;
   unsigned long int __pad1;
@@ -56,6 +56,7 @@
 	string 1
 	string 2
 	...
+	hash table (optional, aligned)
 */
 struct file_entry
 {
@@ -89,12 +90,57 @@ struct cache_file_new
   char version[sizeof CACHE_VERSION - 1];
   uint32_t nlibs;		/* Number of entries.  */
   uint32_t len_strings;		/* Size of string table. */
-  uint32_t unused[5];		/* Leave space for future extensions
+  uint32_t unused[4];		/* Leave space for future extensions
 				   and align to 8 byte boundary.  */
+  uint32_t hash_offset;		/* Offset of struct cache_hash_table
+				   from the start of this structure,
+				   or 0 if there is none.  */
   struct file_entry_new libs[0]; /* Entries describing libraries.  */
   /* After this the string table of size len_strings is found.	*/
 };
 
+/* The hash table maps each library name to the range of entries for
+   it in libs, which ldconfig keeps sorted by name and, for each name,
+   by preference.  Readers which do not know about the table ignore
+   it, since it is placed after the string table.  */
+
+#define CACHE_HASH_MAGIC 0x6c646863	/* "chdl" in little endian.  */
+
+struct cache_hash_slot
+{
+  uint32_t hash;		/* Hash of the name, see _dl_cache_hash.  */
+  uint32_t first;		/* Index of the first entry for the name.  */
+  uint32_t count;		/* Number of entries, 0 for a free slot.  */
+};
+
+struct cache_hash_table
+{
+  uint32_t magic;		/* CACHE_HASH_MAGIC.  */
+  uint32_t nslots;		/* Number of slots, a power of two.  */
+  struct cache_hash_slot slots[0]; /* Open addressing, linear probing.  */
+};
+
+/* Compute the hash of the library name NAME.  Names which compare
+   equal under _dl_cache_libcmp must hash equally, so runs of digits
+   are hashed without their leading zeros.  */
+static inline uint32_t
+_dl_cache_hash (const char *name)
+{
+  uint32_t hash = 5381;
+  while (*name != '\0')
+    if (*name >= '0' && *name <= '9')
+      {
+	while (*name == '0')
+	  ++name;
+	hash = hash * 33 + '0';
+	while (*name >= '0' && *name <= '9')
+	  hash = hash * 33 + *name++;
+      }
+    else
+      hash = hash * 33 + (unsigned char) *name++;
+  return hash;
+}
+
 /* Used to align cache_file_new.  */
 #define ALIGN_CACHE(addr)				\
 (((addr) + __alignof__ (struct cache_file_new) -1)	\
@@ -222,6 +222,15 @@ enum allowmask
   };
 
 
+/* Algorithms for sorting objects by dependencies in _dl_sort_maps,
+   selected with the glibc.rtld.dynamic_sort tunable.  */
+enum dso_sort_algorithm
+  {
+    dso_sort_algorithm_original,
+    dso_sort_algorithm_dfs
+  };
+
+
 struct audit_ifaces
 {
   void (*activity) (uintptr_t *, unsigned int);
@@ -363,6 +372,7 @@ struct rtld_global
   /* Counters for the number of relocations performed.  */
   EXTERN unsigned long int _dl_num_relocations;
   EXTERN unsigned long int _dl_num_cache_relocations;
+  EXTERN unsigned long int _dl_num_symcache_relocations;
 
   /* List of search directories.  */
   EXTERN struct r_search_path_elem *_dl_all_dirs;
@@ -418,6 +428,12 @@ struct rtld_global
   EXTERN size_t _dl_tls_static_used;
   /* Alignment requirement of the static TLS block.  */
   EXTERN size_t _dl_tls_static_align;
+  /* Size of the surplus in the static TLS block for modules loaded
+     by dlopen.  */
+  EXTERN size_t _dl_tls_static_surplus;
+  /* Remaining amount of the surplus which modules with dynamic TLS may
+     use (see _dl_try_allocate_static_tls).  */
+  EXTERN size_t _dl_tls_static_optional;
 
 /* Number of additional entries in the slotinfo array of each slotinfo
    list element.  A large number makes it almost certain take we never
@@ -532,6 +548,9 @@ struct rtld_global_ro
   /* Expected cache ID.  */
   EXTERN int _dl_correct_cache_id;
 
+  /* Algorithm used by _dl_sort_maps.  */
+  EXTERN enum dso_sort_algorithm _dl_dso_sort_algo;
+
   /* Mask for hardware capabilities that are available.  */
   EXTERN uint64_t _dl_hwcap;
 
@@ -974,7 +993,11 @@ extern void _dl_fini (void) attribute_hidden;
 
 /* Sort array MAPS according to dependencies of the contained objects.  */
 extern void _dl_sort_maps (struct link_map **maps, unsigned int nmaps,
-			   char *used, bool for_fini) attribute_hidden;
+			   bool for_fini) attribute_hidden;
+
+/* Select the algorithm used by _dl_sort_maps from the
+   glibc.rtld.dynamic_sort tunable.  */
+extern void _dl_sort_maps_init (void) attribute_hidden;
 
 /* The dynamic linker calls this function before and having changing
    any shared object mappings.  The `r_state' member of `struct r_debug'
@@ -992,10 +1015,77 @@ extern struct r_debug *_dl_debug_initialize (ElfW(Addr) ldbase, Lmid_t ns)
 /* Initialize the basic data structure for the search paths.  */
 extern void _dl_init_paths (const char *library_path) attribute_hidden;
 
+/* Directory of the search path in the path cache (see dl-pathcache.c).  */
+struct dl_path_cache_dir;
+
+/* Nonzero if the contents of search path directories are cached.  */
+extern int _dl_path_cache_active attribute_hidden;
+
+/* Statistics: the number of probes answered from the path cache, the
+   number of times a directory was checked for changes, and the number
+   of times this found the cached contents to be out of date.  */
+extern unsigned long int _dl_path_cache_hits attribute_hidden;
+extern unsigned long int _dl_path_cache_checks attribute_hidden;
+extern unsigned long int _dl_path_cache_invalidations attribute_hidden;
+
+/* Enable the path cache unless glibc.rtld.path_cache is 0.  */
+extern void _dl_path_cache_init (void) attribute_hidden;
+
+/* Check the directories in the path cache for changes again before they
+   are used next.  Called for each dlopen.  */
+extern void _dl_path_cache_revalidate (void) attribute_hidden;
+
+/* Return the path cache entry for the directory NAME, which is
+   NAMELEN bytes long and null-terminated, or NULL if its contents
+   cannot be cached.  */
+extern struct dl_path_cache_dir *_dl_path_cache_find_dir (const char *name,
+							  size_t namelen)
+     attribute_hidden;
+
+/* Return false if the directory DIR does not exist.  */
+extern bool _dl_path_cache_dir_exists (struct dl_path_cache_dir *dir)
+     attribute_hidden;
+
+/* Return true if DIR has no entry NAME (NAMELEN bytes, including the
+   null terminator), so that opening it would fail with ENOENT.  */
+extern bool _dl_path_cache_lookup (struct dl_path_cache_dir *dir,
+				   const char *name, size_t namelen)
+     attribute_hidden;
+
 /* Gather the information needed to install the profiling tables and start
    the timers.  */
 extern void _dl_start_profile (void) attribute_hidden;
 
+#ifdef SHARED
+/* Nonzero while the objects loaded at startup are relocated with the
+   persistent symbol cache (see dl-symcache.c).  */
+extern int _dl_symcache_active attribute_hidden;
+
+/* Map the symbol cache for the objects loaded at startup, or prepare to
+   record it, if glibc.rtld.symbol_cache is set.  */
+extern void _dl_symcache_setup (void) attribute_hidden;
+
+/* If the symbol cache has the definition the reference REF to
+   UNDEF_NAME in UNDEF_MAP binds to for TYPE_CLASS, store it in *MAPP
+   and *SYMP and return true.  */
+extern bool _dl_symcache_lookup (const char *undef_name,
+				 struct link_map *undef_map,
+				 const ElfW(Sym) *ref, int type_class,
+				 struct link_map **mapp,
+				 const ElfW(Sym) **symp) attribute_hidden;
+
+/* Record that the reference REF to UNDEF_NAME in UNDEF_MAP binds to SYM
+   in MAP for TYPE_CLASS.  */
+extern void _dl_symcache_record (const char *undef_name,
+				 struct link_map *undef_map,
+				 const ElfW(Sym) *ref, int type_class,
+				 struct link_map *map, const ElfW(Sym) *sym)
+     attribute_hidden;
+
+/* Write the recorded symbol cache if needed, and stop using it.  */
+extern void _dl_symcache_finish (void) attribute_hidden;
+#endif
+
 /* The actual functions used to keep book on the calls.  */
 extern void _dl_mcount (ElfW(Addr) frompc, ElfW(Addr) selfpc);
 rtld_hidden_proto (_dl_mcount)
@@ -1058,6 +1148,9 @@ extern size_t _dl_count_modids (void) attribute_hidden;
 /* Calculate offset of the TLS blocks in the static TLS block.  */
 extern void _dl_determine_tlsoffset (void) attribute_hidden;
 
+/* Compute the size of the static TLS surplus from the tunables.  */
+extern void _dl_tls_static_surplus_init (void) attribute_hidden;
+
 #ifndef SHARED
 /* Set up the TCB for statically linked applications.  This is called
    early during startup because we always use TLS (for errno and the
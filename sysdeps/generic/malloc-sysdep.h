@@ -26,3 +26,58 @@ check_may_shrink_heap (void)
 {
   return __libc_enable_secure;
 }
+
+/* Return the number of the CPU the calling thread is running on, or -1
+   if that cannot be determined cheaply.  */
+static inline int
+malloc_getcpu (void)
+{
+  return -1;
+}
+
+/* Return the NUMA node the calling thread is running on, or -1 if that
+   cannot be determined.  */
+static inline int
+malloc_getnode (void)
+{
+  return -1;
+}
+
+/* Return the number of NUMA nodes the system may have online.  */
+static inline size_t
+malloc_numa_nodes (void)
+{
+  return 1;
+}
+
+/* Prefer NUMA node NODE for the pages of [P, P + SIZE).  */
+static inline void
+malloc_bind_node (void *p, size_t size, int node)
+{
+}
+
+/* Allocate the pages of [P, P + SIZE) for writing.  Return false if
+   they cannot be allocated, or this is not supported.  */
+static inline bool
+malloc_populate (void *p, size_t size)
+{
+  return false;
+}
+
+/* Return the size of the transparent huge pages the system may use to
+   back anonymous memory, or 0 if they are not available.  */
+static inline size_t
+malloc_thp_pagesize (void)
+{
+  return 0;
+}
+
+/* Store the size of the default explicit huge page and the mmap flags
+   needed to allocate memory backed by it in *PAGESIZE and *FLAGS, or
+   set *PAGESIZE to 0 if explicit huge pages are not supported.  */
+static inline void
+malloc_hugepage_config (size_t *pagesize, int *flags)
+{
+  *pagesize = 0;
+  *flags = 0;
+}
@@ -130,6 +130,9 @@ __libc_fork (void)
 	  _IO_list_resetlock ();
 	}
 
+      /* Stop recording allocations for the parent.  */
+      call_function_static_weak (__malloc_fork_child);
+
       /* Reset the lock the dynamic loader uses to protect its data.  */
       __rtld_lock_initialize (GL(dl_load_lock));
 
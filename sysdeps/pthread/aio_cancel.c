@@ -64,6 +64,10 @@ aio_cancel (int fildes, struct aiocb *aiocbp)
 	  __set_errno (EINVAL);
 	  return -1;
 	}
+      else if (aiocbp->__error_code == EINPROGRESS
+	       && __aio_find_submitted (fildes, (aiocb_union *) aiocbp) != NULL)
+	/* The kernel is working on the request.  */
+	result = AIO_NOTCANCELED;
       else if (aiocbp->__error_code == EINPROGRESS)
 	{
 	  struct requestlist *last = NULL;
@@ -132,6 +136,10 @@ aio_cancel (int fildes, struct aiocb *aiocbp)
 	      __aio_remove_request (NULL, req, 1);
 	    }
 	}
+
+      /* Requests submitted to the kernel are not canceled.  */
+      if (__aio_find_submitted (fildes, NULL) != NULL)
+	result = AIO_NOTCANCELED;
     }
 
   /* Mark requests as canceled and send signal.  */
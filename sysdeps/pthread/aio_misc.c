@@ -22,6 +22,7 @@
 #include <errno.h>
 #include <limits.h>
 #include <pthread.h>
+#include <stdbool.h>
 #include <stdlib.h>
 #include <unistd.h>
 #include <sys/param.h>
@@ -48,6 +49,14 @@ __aio_create_helper_thread (pthread_t *threadp, void *(*tf) (void *), void *arg)
 }
 #endif
 
+/* A backend can submit requests to the kernel instead of having a
+   thread process them.  AIO_SUBMIT_REQUEST returns true if it took the
+   request.  The backend owns the next_prio field of the requests it
+   took.  */
+#ifndef aio_submit_request
+# define aio_submit_request(req) false
+#endif
+
 static void add_request_to_runlist (struct requestlist *newrequest);
 
 /* Pool of request list entries.  */
@@ -74,6 +83,11 @@ static struct requestlist *runlist;
 /* Structure list of all currently processed requests.  */
 static struct requestlist *requests;
 
+/* List of the requests submitted to the kernel, linked through the
+   next_fd and last_fd fields.  Unlike the requests above, there can be
+   several for one descriptor.  */
+static struct requestlist *submitted;
+
 /* Number of threads currently running.  */
 static int nthreads;
 
@@ -185,6 +199,9 @@ __aio_find_req (aiocb_union *elem)
 	  runp = runp->next_prio;
     }
 
+  if (runp == NULL)
+    runp = __aio_find_submitted (fildes, elem);
+
   return runp;
 }
 
@@ -202,6 +219,41 @@ __aio_find_req_fd (int fildes)
 }
 
 
+struct requestlist *
+__aio_find_submitted (int fildes, aiocb_union *elem)
+{
+  struct requestlist *runp = submitted;
+
+  while (runp != NULL
+	 && (runp->aiocbp->aiocb.aio_fildes != fildes
+	     || (elem != NULL && runp->aiocbp != elem)))
+    runp = runp->next_fd;
+
+  return runp;
+}
+
+
+void
+__aio_finish_submitted (struct requestlist *req)
+{
+  /* Send the signal to notify about finished processing of the
+     request.  */
+  __aio_notify (req);
+
+  assert (req->running == allocated);
+  req->running = done;
+
+  if (req->last_fd != NULL)
+    req->last_fd->next_fd = req->next_fd;
+  else
+    submitted = req->next_fd;
+  if (req->next_fd != NULL)
+    req->next_fd->last_fd = req->last_fd;
+
+  __aio_free_request (req);
+}
+
+
 void
 __aio_remove_request (struct requestlist *last, struct requestlist *req,
 		      int all)
@@ -379,6 +431,19 @@ __aio_enqueue_request (aiocb_union *aiocbp, int operation)
 
       running = queued;
     }
+  else if (aio_submit_request (newp))
+    {
+      /* The kernel works on the request now.  Requests for a
+	 descriptor which threads are working on are not submitted, so
+	 that they are not reordered.  */
+      newp->last_fd = NULL;
+      newp->next_fd = submitted;
+      if (submitted != NULL)
+	submitted->last_fd = newp;
+      submitted = newp;
+
+      running = allocated;
+    }
   else
     {
       running = yes;
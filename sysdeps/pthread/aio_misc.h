@@ -101,6 +101,17 @@ extern struct requestlist *__aio_find_req (aiocb_union *elem) attribute_hidden;
 /* Find request entry for given file descriptor.  */
 extern struct requestlist *__aio_find_req_fd (int fildes) attribute_hidden;
 
+/* Find the entry of a request submitted to the kernel for the given file
+   descriptor and, if ELEM is not NULL, AIO control block.  */
+extern struct requestlist *__aio_find_submitted (int fildes,
+						 aiocb_union *elem)
+     attribute_hidden;
+
+/* Finish a request submitted to the kernel after its result has been
+   stored.  */
+extern void __aio_finish_submitted (struct requestlist *req)
+     attribute_hidden;
+
 /* Remove request from the list.  */
 extern void __aio_remove_request (struct requestlist *last,
 				  struct requestlist *req, int all)
@@ -31,6 +31,14 @@
 
 #include <shlib-compat.h>
 
+/* A backend which submits requests to the kernel can collect the
+   requests of one call and submit them at once.  The batch has to end
+   before the requests can complete.  */
+#ifndef aio_submit_batch_begin
+# define aio_submit_batch_begin() do { } while (0)
+# define aio_submit_batch_end() do { } while (0)
+#endif
+
 
 /* We need this special structure to handle asynchronous I/O.  */
 struct async_waitlist
@@ -75,6 +83,7 @@ lio_listio_internal (int mode, struct aiocb *const list[], int nent,
 
   /* Now we can enqueue all requests.  Since we already acquired the
      mutex the enqueue function need not do this.  */
+  aio_submit_batch_begin ();
   for (cnt = 0; cnt < nent; ++cnt)
     if (list[cnt] != NULL && list[cnt]->aio_lio_opcode != LIO_NOP)
       {
@@ -100,6 +109,7 @@ lio_listio_internal (int mode, struct aiocb *const list[], int nent,
     {
       /* We don't have anything to do except signalling if we work
 	 asynchronously.  */
+      aio_submit_batch_end ();
 
       /* Release the mutex.  We do this before raising a signal since the
 	 signal handler might do a `siglongjmp' and then the mutex is
@@ -138,6 +148,8 @@ lio_listio_internal (int mode, struct aiocb *const list[], int nent,
 	    }
 	}
 
+      aio_submit_batch_end ();
+
 #ifdef DONT_NEED_AIO_MISC_COND
       AIO_MISC_WAIT (result, total, NULL, 0);
 #else
@@ -204,6 +216,8 @@ lio_listio_internal (int mode, struct aiocb *const list[], int nent,
 	  waitlist->counter = total;
 	  waitlist->sigev = *sig;
 	}
+
+      aio_submit_batch_end ();
     }
 
   /* Release the mutex.  */
@@ -21,6 +21,7 @@
 # include <limits.h>
 # include <pthread.h>
 # include <signal.h>
+# include <stdbool.h>
 # include <sysdep.h>
 
 # define aio_start_notify_thread __aio_start_notify_thread
@@ -65,4 +66,15 @@ __aio_create_helper_thread (pthread_t *threadp, void *(*tf) (void *),
   (void) pthread_attr_destroy (&attr);
   return ret;
 }
+
+# ifdef __NR_io_uring_setup
+/* Submit requests to the kernel with io_uring, see aio_uring.c.  */
+#  define aio_submit_request __aio_uring_submit
+#  define aio_submit_batch_begin __aio_uring_batch_begin
+#  define aio_submit_batch_end __aio_uring_batch_end
+
+extern bool __aio_uring_submit (struct requestlist *req) attribute_hidden;
+extern void __aio_uring_batch_begin (void) attribute_hidden;
+extern void __aio_uring_batch_end (void) attribute_hidden;
+# endif
 #endif
@@ -0,0 +1,753 @@
+/* Submit asynchronous I/O requests with io_uring.  Linux version.
+   Copyright (C) 2018 Free Software Foundation, Inc.
+   This file is part of the GNU C Library.
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; if not, see
+   <http://www.gnu.org/licenses/>.  */
+
+#include <aio_misc.h>
+
+#ifdef __NR_io_uring_setup
+# include <errno.h>
+# include <stdint.h>
+# include <string.h>
+# include <unistd.h>
+# include <sys/mman.h>
+# include <sys/param.h>
+# include <atomic.h>
+
+# if HAVE_TUNABLES
+#  define TUNABLE_NAMESPACE rt
+# endif
+# include <elf/dl-tunables.h>
+
+/* Requests for which the kernel supports io_uring operations are
+   written to the submission queue of a ring shared with the kernel and
+   submitted with io_uring_enter.  A helper thread waits for their
+   completions and finishes them like the threads which process the
+   other requests.  So there is no context switch per request, and the
+   requests for one descriptor do not wait for each other.  lio_listio
+   submits all its requests with one system call.
+
+   All members of RING, and the submission queue, are protected by
+   __aio_requests_mutex.  If io_uring is not available, the requests
+   are processed by threads.  So are requests which do not fit into the
+   ring, unless requests for the same descriptor are in flight: a
+   thread could finish them before the kernel finishes the others, and
+   for example sync a file before it is written.  These requests wait
+   in order until entries of the ring become free.  */
+
+/* The io_uring interface of the kernel, see <linux/io_uring.h>.  */
+struct kernel_io_sqring_offsets
+{
+  uint32_t head;
+  uint32_t tail;
+  uint32_t ring_mask;
+  uint32_t ring_entries;
+  uint32_t flags;
+  uint32_t dropped;
+  uint32_t array;
+  uint32_t resv1;
+  uint64_t resv2;
+};
+
+struct kernel_io_cqring_offsets
+{
+  uint32_t head;
+  uint32_t tail;
+  uint32_t ring_mask;
+  uint32_t ring_entries;
+  uint32_t overflow;
+  uint32_t cqes;
+  uint32_t flags;
+  uint32_t resv1;
+  uint64_t resv2;
+};
+
+struct kernel_io_uring_params
+{
+  uint32_t sq_entries;
+  uint32_t cq_entries;
+  uint32_t flags;
+  uint32_t sq_thread_cpu;
+  uint32_t sq_thread_idle;
+  uint32_t features;
+  uint32_t wq_fd;
+  uint32_t resv[3];
+  struct kernel_io_sqring_offsets sq_off;
+  struct kernel_io_cqring_offsets cq_off;
+};
+
+struct kernel_io_uring_sqe
+{
+  uint8_t opcode;
+  uint8_t flags;
+  uint16_t ioprio;
+  int32_t fd;
+  uint64_t off;
+  uint64_t addr;
+  uint32_t len;
+  uint32_t op_flags;
+  uint64_t user_data;
+  uint64_t pad[3];
+};
+
+struct kernel_io_uring_cqe
+{
+  uint64_t user_data;
+  int32_t res;
+  uint32_t flags;
+};
+
+struct kernel_io_uring_probe_op
+{
+  uint8_t op;
+  uint8_t resv;
+  uint16_t flags;
+  uint32_t resv2;
+};
+
+struct kernel_io_uring_probe
+{
+  uint8_t last_op;
+  uint8_t ops_len;
+  uint16_t resv;
+  uint32_t resv2[3];
+  struct kernel_io_uring_probe_op ops[];
+};
+
+# define IORING_OFF_SQ_RING	0ULL
+# define IORING_OFF_CQ_RING	0x8000000ULL
+# define IORING_OFF_SQES	0x10000000ULL
+# define IORING_FEAT_SINGLE_MMAP (1U << 0)
+# define IORING_ENTER_GETEVENTS	(1U << 0)
+# define IORING_REGISTER_PROBE	8
+# define IO_URING_OP_SUPPORTED	(1U << 0)
+# define IOSQE_IO_DRAIN		(1U << 1)
+# define IORING_FSYNC_DATASYNC	(1U << 0)
+# define IORING_OP_FSYNC	3
+# define IORING_OP_READ		22
+# define IORING_OP_WRITE	23
+
+/* Number of entries of the submission queue.  This is also the
+   maximum number of requests in flight, so that the completion queue,
+   which has twice as many entries, cannot overflow.  */
+# define URING_ENTRIES		1024
+
+/* Set in the user data of a request which is submitted again without
+   an offset, see uring_reap.  Request entries are aligned.  */
+# define URING_NO_OFFSET	1
+
+static struct
+{
+  /* Zero if the ring has not been set up, one if it is in use, and -1
+     if requests are not submitted with io_uring.  */
+  int state;
+  int fd;
+  /* Nonzero while lio_listio enqueues its requests.  */
+  bool batch;
+  /* Number of requests in the submission queue which have not been
+     submitted yet, and number of submitted requests which have not been
+     finished.  */
+  unsigned int pending;
+  unsigned int inflight;
+  /* Requests waiting for entries of the ring, linked through the
+     next_prio field.  */
+  struct requestlist *waiting;
+  struct requestlist *waiting_last;
+
+  unsigned int *sq_tail;
+  unsigned int sq_mask;
+  unsigned int *sq_array;
+  struct kernel_io_uring_sqe *sqes;
+  unsigned int *cq_head;
+  unsigned int *cq_tail;
+  unsigned int cq_mask;
+  struct kernel_io_uring_cqe *cqes;
+
+  void *sq_ring;
+  size_t sq_ring_size;
+  void *cq_ring;
+  size_t cq_ring_size;
+  size_t sqes_size;
+} ring;
+
+
+static void
+uring_unmap (void)
+{
+  if (ring.sqes != NULL)
+    munmap (ring.sqes, ring.sqes_size);
+  if (ring.cq_ring != NULL && ring.cq_ring != ring.sq_ring)
+    munmap (ring.cq_ring, ring.cq_ring_size);
+  if (ring.sq_ring != NULL)
+    munmap (ring.sq_ring, ring.sq_ring_size);
+  __close (ring.fd);
+
+  ring.sqes = NULL;
+  ring.cq_ring = NULL;
+  ring.sq_ring = NULL;
+  ring.pending = 0;
+  ring.inflight = 0;
+}
+
+
+/* The helper thread does not exist in the child of fork.  Requests
+   which were in flight stay in progress, as with threads.  */
+static void
+uring_fork_child (void)
+{
+  if (ring.state > 0)
+    {
+      uring_unmap ();
+      ring.state = 0;
+    }
+  ring.batch = false;
+  ring.waiting = NULL;
+}
+
+
+static struct requestlist *uring_reap (void);
+static void uring_fallback (struct requestlist *req);
+
+static void *
+uring_helper_thread (void *arg)
+{
+  int fd = ring.fd;
+
+  while (1)
+    {
+      INTERNAL_SYSCALL_DECL (err);
+      int res = INTERNAL_SYSCALL (io_uring_enter, err, 6, fd, 0, 1,
+				  IORING_ENTER_GETEVENTS, NULL, 0);
+      if (INTERNAL_SYSCALL_ERROR_P (res, err)
+	  && INTERNAL_SYSCALL_ERRNO (res, err) != EINTR)
+	{
+	  /* The descriptor of the ring has been closed behind our back.
+	     Stop submitting requests.  */
+	  pthread_mutex_lock (&__aio_requests_mutex);
+	  ring.state = -1;
+	  pthread_mutex_unlock (&__aio_requests_mutex);
+	  return NULL;
+	}
+
+      pthread_mutex_lock (&__aio_requests_mutex);
+      struct requestlist *fallback = uring_reap ();
+      pthread_mutex_unlock (&__aio_requests_mutex);
+
+      while (fallback != NULL)
+	{
+	  struct requestlist *next = fallback->next_prio;
+	  uring_fallback (fallback);
+	  fallback = next;
+	}
+    }
+}
+
+
+/* Set up the ring and start the helper thread.  Return false if
+   io_uring cannot be used.  */
+static bool
+uring_setup (void)
+{
+# if HAVE_TUNABLES
+  if (TUNABLE_GET (aio_uring, int32_t, NULL) == 0)
+    return false;
+# endif
+
+  struct kernel_io_uring_params params;
+  memset (&params, 0, sizeof (params));
+
+  INTERNAL_SYSCALL_DECL (err);
+  int fd = INTERNAL_SYSCALL (io_uring_setup, err, 2, URING_ENTRIES, &params);
+  if (INTERNAL_SYSCALL_ERROR_P (fd, err))
+    return false;
+  ring.fd = fd;
+
+  /* We need the operations without iovec arrays.  */
+  union
+  {
+    struct kernel_io_uring_probe probe;
+    char buf[sizeof (struct kernel_io_uring_probe)
+	     + (IORING_OP_WRITE + 1) * sizeof (struct kernel_io_uring_probe_op)];
+  } probe;
+  memset (&probe, 0, sizeof (probe));
+  int res = INTERNAL_SYSCALL (io_uring_register, err, 4, fd,
+			      IORING_REGISTER_PROBE, &probe.probe,
+			      IORING_OP_WRITE + 1);
+  if (INTERNAL_SYSCALL_ERROR_P (res, err)
+      || probe.probe.last_op < IORING_OP_WRITE
+      || !(probe.probe.ops[IORING_OP_FSYNC].flags & IO_URING_OP_SUPPORTED)
+      || !(probe.probe.ops[IORING_OP_READ].flags & IO_URING_OP_SUPPORTED)
+      || !(probe.probe.ops[IORING_OP_WRITE].flags & IO_URING_OP_SUPPORTED))
+    goto fail;
+
+  ring.sq_ring_size = (params.sq_off.array
+		       + params.sq_entries * sizeof (unsigned int));
+  ring.cq_ring_size = (params.cq_off.cqes
+		       + params.cq_entries * sizeof (struct kernel_io_uring_cqe));
+  if (params.features & IORING_FEAT_SINGLE_MMAP)
+    ring.sq_ring_size = ring.cq_ring_size = MAX (ring.sq_ring_size,
+						 ring.cq_ring_size);
+  ring.sqes_size = params.sq_entries * sizeof (struct kernel_io_uring_sqe);
+
+  void *p = mmap (NULL, ring.sq_ring_size, PROT_READ | PROT_WRITE,
+		  MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+  if (p == MAP_FAILED)
+    goto fail;
+  ring.sq_ring = p;
+
+  if (params.features & IORING_FEAT_SINGLE_MMAP)
+    ring.cq_ring = ring.sq_ring;
+  else
+    {
+      p = mmap (NULL, ring.cq_ring_size, PROT_READ | PROT_WRITE,
+		MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+      if (p == MAP_FAILED)
+	goto fail;
+      ring.cq_ring = p;
+    }
+
+  p = mmap (NULL, ring.sqes_size, PROT_READ | PROT_WRITE,
+	    MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+  if (p == MAP_FAILED)
+    goto fail;
+  ring.sqes = p;
+
+  char *sq = ring.sq_ring;
+  char *cq = ring.cq_ring;
+  ring.sq_tail = (unsigned int *) (sq + params.sq_off.tail);
+  ring.sq_mask = *(unsigned int *) (sq + params.sq_off.ring_mask);
+  ring.sq_array = (unsigned int *) (sq + params.sq_off.array);
+  ring.cq_head = (unsigned int *) (cq + params.cq_off.head);
+  ring.cq_tail = (unsigned int *) (cq + params.cq_off.tail);
+  ring.cq_mask = *(unsigned int *) (cq + params.cq_off.ring_mask);
+  ring.cqes = (struct kernel_io_uring_cqe *) (cq + params.cq_off.cqes);
+
+  pthread_t th;
+  if (aio_create_helper_thread (&th, uring_helper_thread, NULL) != 0)
+    goto fail;
+
+  static bool atfork_registered;
+  if (!atfork_registered)
+    {
+      pthread_atfork (NULL, NULL, uring_fork_child);
+      atfork_registered = true;
+    }
+
+  return true;
+
+ fail:
+  uring_unmap ();
+  return false;
+}
+
+
+/* Return true if the request REQ can be submitted with io_uring.  */
+static bool
+uring_supported (struct requestlist *req)
+{
+  aiocb_union *aiocbp = req->aiocbp;
+  int opcode = aiocbp->aiocb.aio_lio_opcode;
+
+  switch (opcode & 127)
+    {
+    case LIO_READ:
+    case LIO_WRITE:
+      /* The kernel interprets an offset of -1 as the current position,
+	 so leave the error for negative offsets to pread and pwrite.  */
+      if (sizeof (off_t) != sizeof (off64_t) && (opcode & 128))
+	return aiocbp->aiocb64.aio_offset >= 0;
+      return aiocbp->aiocb.aio_offset >= 0;
+
+    case LIO_DSYNC:
+    case LIO_SYNC:
+      return true;
+
+    default:
+      return false;
+    }
+}
+
+
+/* Write the supported request REQ to the submission queue, which must
+   have room for it.  If NO_OFFSET, it reads or writes at the current
+   position of the file.  */
+static void
+uring_queue (struct requestlist *req, bool no_offset)
+{
+  aiocb_union *aiocbp = req->aiocbp;
+  unsigned int tail = *ring.sq_tail;
+  unsigned int idx = tail & ring.sq_mask;
+  struct kernel_io_uring_sqe *sqe = &ring.sqes[idx];
+  int opcode = aiocbp->aiocb.aio_lio_opcode;
+  uint64_t off;
+  size_t nbytes;
+  volatile void *buf;
+
+  if (sizeof (off_t) != sizeof (off64_t) && (opcode & 128))
+    {
+      off = aiocbp->aiocb64.aio_offset;
+      nbytes = aiocbp->aiocb64.aio_nbytes;
+      buf = aiocbp->aiocb64.aio_buf;
+    }
+  else
+    {
+      off = aiocbp->aiocb.aio_offset;
+      nbytes = aiocbp->aiocb.aio_nbytes;
+      buf = aiocbp->aiocb.aio_buf;
+    }
+
+  memset (sqe, 0, sizeof (*sqe));
+  sqe->fd = aiocbp->aiocb.aio_fildes;
+  sqe->user_data = (uintptr_t) req | (no_offset ? URING_NO_OFFSET : 0);
+
+  switch (opcode & 127)
+    {
+    case LIO_READ:
+    case LIO_WRITE:
+      sqe->opcode = (opcode & 127) == LIO_READ ? IORING_OP_READ
+						: IORING_OP_WRITE;
+      sqe->off = no_offset ? (uint64_t) -1 : off;
+      sqe->addr = (uintptr_t) buf;
+      /* Like read and write, the kernel transfers less than 2 GiB at
+	 once anyway.  */
+      sqe->len = MIN (nbytes, UINT32_MAX);
+      break;
+
+    case LIO_DSYNC:
+      sqe->op_flags = IORING_FSYNC_DATASYNC;
+      /* Fall through.  */
+    case LIO_SYNC:
+      /* Wait for the requests submitted before.  */
+      sqe->opcode = IORING_OP_FSYNC;
+      sqe->flags = IOSQE_IO_DRAIN;
+      break;
+    }
+
+  ring.sq_array[idx] = idx;
+  /* Release MO so that the kernel sees the entry.  */
+  atomic_store_release (ring.sq_tail, tail + 1);
+  ++ring.pending;
+}
+
+
+/* Submit the pending entries of the submission queue.  Entries which
+   the kernel did not take are removed from the queue again.  Return
+   the number of these entries; the first of them is at index
+   *SQ_TAIL.  */
+static unsigned int
+uring_submit_pending (void)
+{
+  while (ring.pending > 0)
+    {
+      INTERNAL_SYSCALL_DECL (err);
+      int res = INTERNAL_SYSCALL (io_uring_enter, err, 6, ring.fd,
+				  ring.pending, 0, 0, NULL, 0);
+      if (INTERNAL_SYSCALL_ERROR_P (res, err))
+	{
+	  if (INTERNAL_SYSCALL_ERRNO (res, err) == EINTR)
+	    continue;
+	  break;
+	}
+      if (res == 0)
+	break;
+      ring.pending -= res;
+      ring.inflight += res;
+    }
+
+  /* Only io_uring_enter, which we call with the lock held, consumes
+     entries, so the kernel does not look at the ones left.  */
+  unsigned int left = ring.pending;
+  if (left > 0)
+    {
+      atomic_store_relaxed (ring.sq_tail, *ring.sq_tail - left);
+      ring.pending = 0;
+    }
+  return left;
+}
+
+
+/* Return the request of entry I of the submission queue.  */
+static struct requestlist *
+uring_sqe_request (unsigned int i)
+{
+  struct kernel_io_uring_sqe *sqe = &ring.sqes[i & ring.sq_mask];
+  return (struct requestlist *) (uintptr_t) (sqe->user_data
+					     & ~(uint64_t) URING_NO_OFFSET);
+}
+
+
+/* Finish the request REQ, which could not be submitted.  */
+static void
+uring_fail (struct requestlist *req)
+{
+  req->aiocbp->aiocb.__error_code = EAGAIN;
+  req->aiocbp->aiocb.__return_value = -1;
+  __aio_finish_submitted (req);
+}
+
+
+/* Finish requests which could not be submitted.  */
+static void
+uring_fail_pending (unsigned int left)
+{
+  unsigned int tail = *ring.sq_tail;
+
+  for (unsigned int i = 0; i < left; ++i)
+    uring_fail (uring_sqe_request (tail + i));
+}
+
+
+/* Add the request REQ to the end of the waiting requests.  */
+static void
+uring_wait (struct requestlist *req)
+{
+  req->next_prio = NULL;
+  if (ring.waiting == NULL)
+    ring.waiting = req;
+  else
+    ring.waiting_last->next_prio = req;
+  ring.waiting_last = req;
+}
+
+
+/* Put requests which could not be submitted back in front of the
+   waiting requests.  They were taken from there, or are newer than all
+   of them.  */
+static void
+uring_requeue_pending (unsigned int left)
+{
+  unsigned int tail = *ring.sq_tail;
+  struct requestlist *rest = ring.waiting;
+  struct requestlist *rest_last = ring.waiting_last;
+
+  ring.waiting = NULL;
+  for (unsigned int i = 0; i < left; ++i)
+    uring_wait (uring_sqe_request (tail + i));
+  if (rest != NULL)
+    {
+      ring.waiting_last->next_prio = rest;
+      ring.waiting_last = rest_last;
+    }
+}
+
+
+/* Submit waiting requests as far as the ring has room for them.  If
+   they cannot be submitted, try again when requests in flight are
+   finished.  If no request is in flight, fail them.  */
+static void
+uring_submit_waiting (void)
+{
+  while (ring.waiting != NULL
+	 && ring.pending + ring.inflight < URING_ENTRIES)
+    {
+      struct requestlist *req = ring.waiting;
+      ring.waiting = req->next_prio;
+      uring_queue (req, false);
+    }
+
+  unsigned int left = uring_submit_pending ();
+  if (left > 0)
+    {
+      if (ring.inflight > 0)
+	uring_requeue_pending (left);
+      else
+	{
+	  uring_fail_pending (left);
+	  while (ring.waiting != NULL)
+	    {
+	      struct requestlist *req = ring.waiting;
+	      ring.waiting = req->next_prio;
+	      uring_fail (req);
+	    }
+	}
+    }
+}
+
+
+/* Read or write at the current position of the file for the request
+   REQ with a system call, like the threads do, if the kernel rejected
+   the offset and the request could not be submitted again.  REQ stays
+   in flight until then.  Called without __aio_requests_mutex.  */
+static void
+uring_fallback (struct requestlist *req)
+{
+  aiocb_union *aiocbp = req->aiocbp;
+  int fildes = aiocbp->aiocb.aio_fildes;
+  int opcode = aiocbp->aiocb.aio_lio_opcode;
+  size_t nbytes;
+  volatile void *buf;
+  ssize_t res;
+
+  if (sizeof (off_t) != sizeof (off64_t) && (opcode & 128))
+    {
+      nbytes = aiocbp->aiocb64.aio_nbytes;
+      buf = aiocbp->aiocb64.aio_buf;
+    }
+  else
+    {
+      nbytes = aiocbp->aiocb.aio_nbytes;
+      buf = aiocbp->aiocb.aio_buf;
+    }
+
+  if ((opcode & 127) == LIO_READ)
+    res = TEMP_FAILURE_RETRY (read (fildes, (void *) buf, nbytes));
+  else
+    res = TEMP_FAILURE_RETRY (write (fildes, (const void *) buf, nbytes));
+  int error = res < 0 ? errno : 0;
+
+  pthread_mutex_lock (&__aio_requests_mutex);
+  aiocbp->aiocb.__error_code = error;
+  aiocbp->aiocb.__return_value = res;
+  --ring.inflight;
+  __aio_finish_submitted (req);
+  if (ring.waiting != NULL)
+    uring_submit_waiting ();
+  pthread_mutex_unlock (&__aio_requests_mutex);
+}
+
+
+/* Finish the requests in the completion queue, and submit waiting
+   requests.  Return the requests which uring_fallback has to process,
+   linked through the next_prio field.  */
+static struct requestlist *
+uring_reap (void)
+{
+  struct requestlist *fallback = NULL;
+  struct requestlist **fallback_tail = &fallback;
+  unsigned int head = *ring.cq_head;
+  /* Acquire MO so that we see the entries the kernel wrote.  */
+  unsigned int tail = atomic_load_acquire (ring.cq_tail);
+
+  for (; head != tail; ++head)
+    {
+      struct kernel_io_uring_cqe *cqe = &ring.cqes[head & ring.cq_mask];
+      uint64_t data = cqe->user_data;
+      int res = cqe->res;
+      struct requestlist *req
+	= (struct requestlist *) (uintptr_t) (data
+					      & ~(uint64_t) URING_NO_OFFSET);
+      aiocb_union *aiocbp = req->aiocbp;
+
+      --ring.inflight;
+
+      /* Like pread and pwrite, the kernel may not accept an offset for
+	 sockets and pipes.  Other platforms simply ignore the offset
+	 for them, so try again at the current position.  */
+      if (res == -ESPIPE && !(data & URING_NO_OFFSET)
+	  && ((aiocbp->aiocb.aio_lio_opcode & 127) == LIO_READ
+	      || (aiocbp->aiocb.aio_lio_opcode & 127) == LIO_WRITE))
+	{
+	  uring_queue (req, true);
+	  if (uring_submit_pending () > 0)
+	    {
+	      /* Read or write without the ring, after the lock is
+		 released.  */
+	      ++ring.inflight;
+	      req->next_prio = NULL;
+	      *fallback_tail = req;
+	      fallback_tail = &req->next_prio;
+	    }
+	  continue;
+	}
+
+      if (res < 0)
+	{
+	  aiocbp->aiocb.__error_code = -res;
+	  aiocbp->aiocb.__return_value = -1;
+	}
+      else
+	{
+	  aiocbp->aiocb.__error_code = 0;
+	  aiocbp->aiocb.__return_value = res;
+	}
+
+      __aio_finish_submitted (req);
+    }
+
+  /* Release MO so that the kernel does not overwrite the entries before
+     we read them.  */
+  atomic_store_release (ring.cq_head, head);
+
+  if (ring.waiting != NULL)
+    uring_submit_waiting ();
+
+  return fallback;
+}
+
+
+bool
+__aio_uring_submit (struct requestlist *req)
+{
+  if (ring.state == 0)
+    ring.state = uring_setup () ? 1 : -1;
+  if (ring.state < 0 || !uring_supported (req))
+    return false;
+
+  /* If requests for the descriptor are in flight, or waiting, the
+     request waits behind them when it cannot be submitted.  Outside of
+     a batch, requests are only waiting while others are in flight, so
+     that their completion submits them.  Otherwise a thread processes
+     the request.  */
+  bool ordered = __aio_find_submitted (req->aiocbp->aiocb.aio_fildes,
+				       NULL) != NULL;
+
+  if (ring.waiting != NULL || ring.pending + ring.inflight >= URING_ENTRIES)
+    {
+      if (!ordered)
+	return false;
+      uring_wait (req);
+      return true;
+    }
+
+  uring_queue (req, false);
+
+  /* lio_listio submits its requests at the end of the batch.  */
+  if (ring.batch)
+    return true;
+
+  unsigned int left = uring_submit_pending ();
+  if (left == 0)
+    return true;
+  if (!ordered)
+    return false;
+  uring_requeue_pending (left);
+  return true;
+}
+
+
+void
+__aio_uring_batch_begin (void)
+{
+  ring.batch = true;
+}
+
+
+void
+__aio_uring_batch_end (void)
+{
+  ring.batch = false;
+
+  if (ring.pending > 0)
+    {
+      unsigned int left = uring_submit_pending ();
+      if (left > 0)
+	uring_fail_pending (left);
+    }
+
+  if (ring.waiting != NULL)
+    uring_submit_waiting ();
+}
+#endif
@@ -61,6 +61,9 @@ struct timer
   void (*thrfunc) (sigval_t);
   sigval_t sival;
   pthread_attr_t attr;
+  /* Nonzero if the notifications are run by the worker pool, because
+     the timer uses the default thread attributes.  */
+  int pool;
 
   /* Next element in list of active SIGEV_THREAD timers.  */
   struct timer *next;
@@ -17,7 +17,11 @@
    <http://www.gnu.org/licenses/>.  */
 
 #include <fcntl.h>
+#include <sched.h>
+#include <string.h>
+#include <sys/mman.h>
 #include <not-cancel.h>
+#include <sysdep.h>
 
 /* The Linux kernel overcommits address space by default and if there is not
    enough memory available, it uses various parameters to decide the process to
@@ -56,4 +60,153 @@ check_may_shrink_heap (void)
   return may_shrink_heap;
 }
 
+/* Return the number of the CPU the calling thread is running on, or -1
+   if that cannot be determined.  If the thread has registered rseq this
+   is a plain TLS load.  */
+static inline int
+malloc_getcpu (void)
+{
+  return __sched_getcpu ();
+}
+
+/* Return the NUMA node the calling thread is running on, or -1 if that
+   cannot be determined.  */
+static inline int
+malloc_getnode (void)
+{
+  return __sched_getnode ();
+}
+
+/* Ask the kernel to place the pages of [P, P + SIZE) on NUMA node NODE
+   when they are first touched.  The policy is only a preference, so
+   allocations still succeed once the node runs out of memory.  Failure
+   to set the policy is ignored.  */
+static inline void
+malloc_bind_node (void *p, size_t size, int node)
+{
+#ifdef __NR_mbind
+  /* MPOL_PREFERRED from <linux/mempolicy.h>.  */
+  enum { mpol_preferred = 1 };
+  unsigned long int mask;
+
+  if (node < 0 || node >= 8 * sizeof (mask))
+    return;
+  mask = 1UL << node;
+  /* The kernel ignores the last bit of the mask, hence the + 1.  */
+  INTERNAL_SYSCALL_DECL (err);
+  INTERNAL_SYSCALL_CALL (mbind, err, p, size, mpol_preferred, &mask,
+			 8 * sizeof (mask) + 1, 0);
+#endif
+}
+
+/* Allocate the pages of [P, P + SIZE) for writing.  Return false if
+   they cannot be allocated, for example because the huge page pool is
+   exhausted, or the kernel is older than 5.14.  */
+static inline bool
+malloc_populate (void *p, size_t size)
+{
+  /* MADV_POPULATE_WRITE from <linux/mman.h>.  */
+  enum { madv_populate_write = 23 };
+
+  return __madvise (p, size, madv_populate_write) == 0;
+}
+
+/* Read up to LEN - 1 bytes from the start of the file at PATH into BUF
+   and terminate them with a null byte.  Return the number of bytes
+   read, or -1 on failure.  */
+static inline ssize_t
+malloc_read_file (const char *path, char *buf, size_t len)
+{
+  int fd = __open_nocancel (path, O_RDONLY | O_CLOEXEC);
+  if (fd < 0)
+    return -1;
+
+  size_t total = 0;
+  while (total < len - 1)
+    {
+      ssize_t n = __read_nocancel (fd, buf + total, len - 1 - total);
+      if (n <= 0)
+	break;
+      total += n;
+    }
+  __close_nocancel_nostatus (fd);
+  buf[total] = '\0';
+  return total;
+}
+
+/* Parse the decimal number at the start of S, skipping leading
+   blanks.  */
+static inline size_t
+malloc_parse_size (const char *s)
+{
+  size_t value = 0;
+
+  while (*s == ' ')
+    ++s;
+  while (*s >= '0' && *s <= '9')
+    value = value * 10 + (*s++ - '0');
+  return value;
+}
+
+/* Return the size of the transparent huge pages the kernel may use to
+   back anonymous memory, or 0 if THP support is missing or has been
+   disabled with "never".  */
+static inline size_t
+malloc_thp_pagesize (void)
+{
+  char buf[64];
+
+  if (malloc_read_file ("/sys/kernel/mm/transparent_hugepage/enabled",
+			buf, sizeof (buf)) <= 0
+      || strstr (buf, "[never]") != NULL)
+    return 0;
+
+  if (malloc_read_file ("/sys/kernel/mm/transparent_hugepage/hpage_pmd_size",
+			buf, sizeof (buf)) <= 0)
+    return 0;
+  return malloc_parse_size (buf);
+}
+
+/* Return the number of NUMA nodes the system may have online.  */
+static inline size_t
+malloc_numa_nodes (void)
+{
+  char buf[256];
+  const char *last = buf;
+
+  if (malloc_read_file ("/sys/devices/system/node/online",
+			buf, sizeof (buf)) <= 0)
+    return 1;
+
+  /* The file holds a sorted list of node ranges such as "0-3" or
+     "0,2", so the last number is the highest node.  */
+  for (const char *p = buf; *p != '\0'; ++p)
+    if (*p == '-' || *p == ',')
+      last = p + 1;
+  return malloc_parse_size (last) + 1;
+}
+
+/* Store the size of the default huge page in *PAGESIZE and the mmap
+   flags to allocate memory backed by it in *FLAGS.  *PAGESIZE is set to
+   0 if the kernel does not report a huge page size.  */
+static inline void
+malloc_hugepage_config (size_t *pagesize, int *flags)
+{
+  *pagesize = 0;
+  *flags = 0;
+#ifdef MAP_HUGETLB
+  char buf[4096];
+  const char *p;
+
+  if (malloc_read_file ("/proc/meminfo", buf, sizeof (buf)) <= 0
+      || (p = strstr (buf, "Hugepagesize:")) == NULL)
+    return;
+
+  /* The size is reported in kB.  */
+  *pagesize = malloc_parse_size (p + strlen ("Hugepagesize:")) * 1024;
+  if (*pagesize != 0)
+    *flags = MAP_HUGETLB;
+#endif
+}
+
 #define HAVE_MREMAP 1
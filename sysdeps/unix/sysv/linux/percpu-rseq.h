@@ -0,0 +1,31 @@
+/* Restartable sequences for the per-CPU operations.  Generic version.
+   Copyright (C) 2018 Free Software Foundation, Inc.
+   This file is part of the GNU C Library.
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; if not, see
+   <http://www.gnu.org/licenses/>.  */
+
+#ifndef _PERCPU_RSEQ_H
+#define _PERCPU_RSEQ_H
+
+/* An architecture which provides the critical sections of the per-CPU
+   operations defines PERCPU_HAVE_RSEQ to 1 and the functions
+   percpu_rseq_add, percpu_rseq_cmpstore, percpu_rseq_list_pop and
+   percpu_rseq_memcpy_commit, which have the interface of the public
+   functions without the rseq_ prefix, except that they are only called
+   if the current thread is registered with the kernel.  Without them,
+   the per-CPU operations use atomic instructions.  */
+#define PERCPU_HAVE_RSEQ 0
+
+#endif /* percpu-rseq.h */
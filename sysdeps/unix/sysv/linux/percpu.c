@@ -0,0 +1,171 @@
+/* Per-CPU data operations based on restartable sequences.
+   Copyright (C) 2018 Free Software Foundation, Inc.
+   This file is part of the GNU C Library.
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; if not, see
+   <http://www.gnu.org/licenses/>.  */
+
+#include <atomic.h>
+#include <sched.h>
+#include <stdbool.h>
+#include <string.h>
+#include <sys/percpu.h>
+#include <lowlevellock.h>
+#include <percpu-rseq.h>
+
+/* If the current thread is registered with the kernel for restartable
+   sequences (which libpthread does for all threads when the kernel
+   supports them), the operations run as critical sections which are
+   aborted if the thread leaves its CPU, so they need neither atomic
+   instructions nor locks.  Otherwise they fall back to atomic
+   instructions, and the CPU argument only selects the data.
+
+   The kernel supports restartable sequences either for all threads of
+   a process or for none, so the two implementations are never used
+   concurrently on the same data.  */
+
+_Static_assert (offsetof (struct percpu_list_node, next) == 0,
+		"next pointer at offset 0 of struct percpu_list_node");
+
+/* Return true if the per-CPU operations of the current thread can use
+   restartable sequences.  */
+static inline bool
+percpu_use_rseq (void)
+{
+#if PERCPU_HAVE_RSEQ
+  return (int32_t) __rseq_abi.cpu_id >= 0;
+#else
+  return false;
+#endif
+}
+
+/* Pops in the fallback implementation are serialized by one of these
+   locks, selected by the address of the list, so that a node cannot be
+   popped and pushed again while another thread is popping it (the ABA
+   problem).  Pushes use a plain compare-and-exchange.  */
+#define PERCPU_LOCKS 64
+static int percpu_locks[PERCPU_LOCKS];
+
+static inline int *
+percpu_lock (const void *p)
+{
+  uintptr_t h = (uintptr_t) p;
+  return &percpu_locks[(h ^ (h >> 12)) / sizeof (void *) % PERCPU_LOCKS];
+}
+
+int
+percpu_current_cpu (void)
+{
+  int cpu;
+#if PERCPU_HAVE_RSEQ
+  cpu = (int32_t) __rseq_abi.cpu_id;
+  if (cpu >= 0)
+    return cpu;
+#endif
+  cpu = __sched_getcpu ();
+  return cpu >= 0 ? cpu : 0;
+}
+
+int
+percpu_add (intptr_t *v, intptr_t count, int cpu)
+{
+#if PERCPU_HAVE_RSEQ
+  if (percpu_use_rseq ())
+    return percpu_rseq_add (v, count, cpu);
+#endif
+  atomic_fetch_add_relaxed (v, count);
+  return 0;
+}
+
+int
+percpu_cmpstore (intptr_t *v, intptr_t expect, intptr_t newv, int cpu)
+{
+#if PERCPU_HAVE_RSEQ
+  if (percpu_use_rseq ())
+    return percpu_rseq_cmpstore (v, expect, newv, cpu);
+#endif
+  intptr_t old = expect;
+  if (atomic_compare_exchange_weak_release (v, &expect, newv))
+    return 0;
+  /* A spurious failure is reported like an abort.  */
+  return expect != old ? 1 : -1;
+}
+
+int
+percpu_list_push (struct percpu_list_head *head,
+		  struct percpu_list_node *node, int cpu)
+{
+#if PERCPU_HAVE_RSEQ
+  if (percpu_use_rseq ())
+    {
+      /* Only the store to the head has to happen on CPU, so a push
+	 is a compare-and-store of the head.  */
+      while (true)
+	{
+	  struct percpu_list_node *expect = head->head;
+	  node->next = expect;
+	  int ret = percpu_rseq_cmpstore ((intptr_t *) &head->head,
+					  (intptr_t) expect,
+					  (intptr_t) node, cpu);
+	  if (ret <= 0)
+	    return ret;
+	}
+    }
+#endif
+  struct percpu_list_node *expect = atomic_load_relaxed (&head->head);
+  do
+    node->next = expect;
+  while (!atomic_compare_exchange_weak_release (&head->head, &expect, node));
+  return 0;
+}
+
+int
+percpu_list_pop (struct percpu_list_head *head,
+		 struct percpu_list_node **node, int cpu)
+{
+#if PERCPU_HAVE_RSEQ
+  if (percpu_use_rseq ())
+    return percpu_rseq_list_pop (head, node, cpu);
+#endif
+  int *lock = percpu_lock (head);
+  lll_lock (*lock, LLL_PRIVATE);
+  struct percpu_list_node *first = atomic_load_acquire (&head->head);
+  while (first != NULL
+	 && !atomic_compare_exchange_weak_acquire (&head->head, &first,
+						   first->next))
+    ;
+  lll_unlock (*lock, LLL_PRIVATE);
+  if (first == NULL)
+    return 1;
+  *node = first;
+  return 0;
+}
+
+int
+percpu_memcpy_commit (intptr_t *v, intptr_t expect, void *dst,
+		      const void *src, size_t len, intptr_t newv, int cpu)
+{
+#if PERCPU_HAVE_RSEQ
+  if (percpu_use_rseq ())
+    return percpu_rseq_memcpy_commit (v, expect, dst, src, len, newv, cpu);
+#endif
+  if (atomic_load_acquire (v) != expect)
+    return 1;
+  memcpy (dst, src, len);
+  /* Another thread may have changed *V during the copy, in which case
+     the copy has to be redone, like after an abort.  */
+  if (!atomic_compare_exchange_weak_release (v, &expect, newv))
+    return -1;
+  return 0;
+}
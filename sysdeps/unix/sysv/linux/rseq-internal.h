@@ -19,6 +19,7 @@
 #ifndef RSEQ_INTERNAL_H
 #define RSEQ_INTERNAL_H
 
+#include <errno.h>
 #include <stdint.h>
 #include <atomic.h>
 #include <linux/rseq.h>
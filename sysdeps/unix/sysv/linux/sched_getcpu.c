@@ -45,7 +45,7 @@ extern __attribute__ ((tls_model ("initial-exec")))
 __thread volatile struct rseq __rseq_abi;
 
 int
-sched_getcpu (void)
+__sched_getcpu (void)
 {
 	int cpu_id = __rseq_abi.cpu_id;
 
@@ -53,8 +53,25 @@ sched_getcpu (void)
 }
 #else
 int
-sched_getcpu (void)
+__sched_getcpu (void)
 {
 	return vsyscall_sched_getcpu ();
 }
 #endif
+libc_hidden_def (__sched_getcpu)
+weak_alias (__sched_getcpu, sched_getcpu)
+
+/* Return the NUMA node the calling thread is running on, or -1.  */
+int
+__sched_getnode (void)
+{
+#ifdef __NR_getcpu
+  unsigned int node;
+  int r = INLINE_VSYSCALL (getcpu, 3, NULL, &node, NULL);
+
+  return r == -1 ? r : node;
+#else
+  __set_errno (ENOSYS);
+  return -1;
+#endif
+}
@@ -0,0 +1,90 @@
+/* Per-CPU data operations based on restartable sequences.
+   Copyright (C) 2018 Free Software Foundation, Inc.
+   This file is part of the GNU C Library.
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; if not, see
+   <http://www.gnu.org/licenses/>.  */
+
+#ifndef _SYS_PERCPU_H
+#define _SYS_PERCPU_H 1
+
+#include <features.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* The operations below update the data of one CPU, which the caller
+   selects by passing the number returned by percpu_current_cpu.  They
+   return 0 on success, a positive value if a comparison failed, and -1
+   if the calling thread was preempted, received a signal or migrated
+   to another CPU before the update was committed.  In the last case,
+   nothing has been stored (except possibly part of the data copied by
+   percpu_memcpy_commit), and the caller is expected to obtain the
+   current CPU again and retry.
+
+   Per-CPU data must only be modified through these functions.  */
+
+__BEGIN_DECLS
+
+/* A node of a per-CPU list.  Applications embed it in their own
+   objects.  */
+struct percpu_list_node
+{
+  struct percpu_list_node *next;
+};
+
+/* The head of a per-CPU list.  An empty list has a null head.  */
+struct percpu_list_head
+{
+  struct percpu_list_node *head;
+};
+
+/* Return the number of the CPU the calling thread is running on.  The
+   result can be out of date by the time it is used, which the
+   operations below detect.  */
+extern int percpu_current_cpu (void) __THROW;
+
+/* Add COUNT to *V, which belongs to CPU.  */
+extern int percpu_add (intptr_t *__v, intptr_t __count, int __cpu)
+     __THROW __nonnull ((1));
+
+/* Store NEWV to *V, which belongs to CPU, if *V is equal to EXPECT.
+   Return 1 if it is not.  */
+extern int percpu_cmpstore (intptr_t *__v, intptr_t __expect,
+			    intptr_t __newv, int __cpu)
+     __THROW __nonnull ((1));
+
+/* Push NODE on the list HEAD, which belongs to CPU.  */
+extern int percpu_list_push (struct percpu_list_head *__head,
+			     struct percpu_list_node *__node, int __cpu)
+     __THROW __nonnull ((1, 2));
+
+/* Pop the first node of the list HEAD, which belongs to CPU, and store
+   it in *NODE.  Return 1 if the list is empty.  */
+extern int percpu_list_pop (struct percpu_list_head *__head,
+			    struct percpu_list_node **__node, int __cpu)
+     __THROW __nonnull ((1, 2));
+
+/* If *V, which belongs to CPU, is equal to EXPECT, copy LEN bytes from
+   SRC to DST and store NEWV to *V.  Return 1 if *V is not equal to
+   EXPECT.  The copy is restarted from the beginning if the operation
+   is interrupted, so LEN should be small.  */
+extern int percpu_memcpy_commit (intptr_t *__v, intptr_t __expect,
+				 void *__restrict __dst,
+				 const void *__restrict __src, size_t __len,
+				 intptr_t __newv, int __cpu)
+     __THROW __nonnull ((1));
+
+__END_DECLS
+
+#endif /* sys/percpu.h */
@@ -120,6 +120,7 @@ timer_create (clockid_t clock_id, struct sigevent *evp, timer_t *timerid)
 	   implementation might keep internal information for
 	   each instance.  */
 	(void) pthread_attr_init (&newp->attr);
+	newp->pool = evp->sigev_notify_attributes == NULL;
 	if (evp->sigev_notify_attributes != NULL)
 	  {
 	    struct pthread_attr *nattr;
@@ -24,6 +24,11 @@
 #include <nptl/pthreadP.h>
 #include "kernel-posix-timers.h"
 
+#if HAVE_TUNABLES
+# define TUNABLE_NAMESPACE pthread
+#endif
+#include <elf/dl-tunables.h>
+
 
 /* List of active SIGEV_THREAD timers.  */
 struct timer *__active_timer_sigev_thread;
@@ -35,23 +40,24 @@ struct thread_start_data
 {
   void (*thrfunc) (sigval_t);
   sigval_t sival;
+  /* Next notification in the queue of the worker pool.  */
+  struct thread_start_data *next;
 };
 
 
-/* Helper thread to call the user-provided function.  */
-static void *
-timer_sigev_thread (void *arg)
+/* Call the user-provided function of the notification TD.  */
+static void
+timer_sigev_call (struct thread_start_data *td)
 {
   /* The parent thread has all signals blocked.  This is a bit
      surprising for user code, although valid.  We unblock all
-     signals.  */
+     signals.  Workers of the pool do this before each call, in case
+     the previous function changed the signal mask.  */
   sigset_t ss;
   sigemptyset (&ss);
   INTERNAL_SYSCALL_DECL (err);
   INTERNAL_SYSCALL (rt_sigprocmask, err, 4, SIG_SETMASK, &ss, NULL, _NSIG / 8);
 
-  struct thread_start_data *td = (struct thread_start_data *) arg;
-
   void (*thrfunc) (sigval_t) = td->thrfunc;
   sigval_t sival = td->sival;
 
@@ -60,11 +66,141 @@ timer_sigev_thread (void *arg)
 
   /* Call the user-provided function.  */
   thrfunc (sival);
+}
+
+
+/* Helper thread to call the user-provided function.  */
+static void *
+timer_sigev_thread (void *arg)
+{
+  timer_sigev_call ((struct thread_start_data *) arg);
+
+  return NULL;
+}
+
+
+/* Notifications of timers with the default thread attributes are run
+   by a pool of worker threads, so that a periodic timer does not create
+   a thread for each expiration.  Workers are started on demand, up to
+   the glibc.pthread.timer_pool_size tunable, and wait for the next
+   notification when the function returns.  If all workers are busy,
+   the notification gets a thread of its own as before, so a function
+   which blocks does not delay the notifications of other timers.  */
+static struct
+{
+  /* Protects the members below.  */
+  pthread_mutex_t lock;
+  /* Signaled when a notification is queued.  */
+  pthread_cond_t cond;
+  /* Queue of notifications which have not been picked up by a worker
+     yet.  There are never more than workers waiting for one.  */
+  struct thread_start_data *head;
+  struct thread_start_data **tail;
+  /* Number of workers, and number of workers waiting for a
+     notification which has not been queued yet.  */
+  size_t nworkers;
+  size_t idle;
+  /* Maximum number of workers.  Set by __start_helper_thread.  */
+  size_t maxworkers;
+} timer_pool =
+  {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .cond = PTHREAD_COND_INITIALIZER,
+    .tail = &timer_pool.head,
+  };
+
+
+/* Account for a worker which exits because the user-provided function
+   called pthread_exit or was canceled.  */
+static void
+timer_pool_worker_exit (void *arg)
+{
+  pthread_mutex_lock (&timer_pool.lock);
+  --timer_pool.nworkers;
+  pthread_mutex_unlock (&timer_pool.lock);
+}
+
+
+/* Worker of the pool.  ARG is the first notification to run.  */
+static void *
+timer_pool_worker (void *arg)
+{
+  struct thread_start_data *td = (struct thread_start_data *) arg;
+  sigset_t ss;
+  sigfillset (&ss);
+
+  pthread_cleanup_push (timer_pool_worker_exit, NULL);
+
+  while (1)
+    {
+      timer_sigev_call (td);
+
+      /* Do not let an idle worker take signals meant for the threads
+	 of the application, and do not let it be canceled while it
+	 waits.  */
+      INTERNAL_SYSCALL_DECL (err);
+      INTERNAL_SYSCALL (rt_sigprocmask, err, 4, SIG_SETMASK, &ss, NULL,
+			_NSIG / 8);
+      pthread_setcancelstate (PTHREAD_CANCEL_DISABLE, NULL);
+
+      pthread_mutex_lock (&timer_pool.lock);
+      ++timer_pool.idle;
+      while (timer_pool.head == NULL)
+	pthread_cond_wait (&timer_pool.cond, &timer_pool.lock);
+      td = timer_pool.head;
+      timer_pool.head = td->next;
+      if (timer_pool.head == NULL)
+	timer_pool.tail = &timer_pool.head;
+      pthread_mutex_unlock (&timer_pool.lock);
+
+      /* Run the next function in the state of a new thread.  */
+      pthread_setcanceltype (PTHREAD_CANCEL_DEFERRED, NULL);
+      pthread_setcancelstate (PTHREAD_CANCEL_ENABLE, NULL);
+    }
+
+  pthread_cleanup_pop (0);
 
   return NULL;
 }
 
 
+/* Run the notification TD of a timer with the default thread
+   attributes.  Returns false if there is no worker for it.  */
+static bool
+timer_pool_dispatch (struct thread_start_data *td)
+{
+  bool ret = true;
+
+  pthread_mutex_lock (&timer_pool.lock);
+  if (timer_pool.idle > 0)
+    {
+      --timer_pool.idle;
+      td->next = NULL;
+      *timer_pool.tail = td;
+      timer_pool.tail = &td->next;
+      pthread_cond_signal (&timer_pool.cond);
+    }
+  else if (timer_pool.nworkers < timer_pool.maxworkers)
+    {
+      pthread_attr_t attr;
+      pthread_t th;
+
+      (void) pthread_attr_init (&attr);
+      (void) pthread_attr_setdetachstate (&attr, PTHREAD_CREATE_DETACHED);
+      if (pthread_create (&th, &attr, timer_pool_worker, td) == 0)
+	++timer_pool.nworkers;
+      else
+	ret = false;
+      (void) pthread_attr_destroy (&attr);
+    }
+  else
+    ret = false;
+  pthread_mutex_unlock (&timer_pool.lock);
+
+  return ret;
+}
+
+
 /* Helper function to support starting threads for SIGEV_THREAD.  */
 static void *
 timer_helper_thread (void *arg)
@@ -116,9 +252,13 @@ timer_helper_thread (void *arg)
 		      td->thrfunc = tk->thrfunc;
 		      td->sival = tk->sival;
 
-		      pthread_t th;
-		      (void) pthread_create (&th, &tk->attr,
-					     timer_sigev_thread, td);
+		      if (!tk->pool || !timer_pool_dispatch (td))
+			{
+			  pthread_t th;
+			  if (pthread_create (&th, &tk->attr,
+					      timer_sigev_thread, td) != 0)
+			    free (td);
+			}
 		    }
 		}
 
@@ -146,6 +286,15 @@ reset_helper_control (void)
 {
   __helper_once = PTHREAD_ONCE_INIT;
   __helper_tid = 0;
+
+  /* The workers of the pool are gone as well.  Queued notifications
+     are lost, like the ones the helper thread had not handled yet.  */
+  (void) pthread_mutex_init (&timer_pool.lock, NULL);
+  (void) pthread_cond_init (&timer_pool.cond, NULL);
+  timer_pool.head = NULL;
+  timer_pool.tail = &timer_pool.head;
+  timer_pool.nworkers = 0;
+  timer_pool.idle = 0;
 }
 
 
@@ -153,6 +302,12 @@ void
 attribute_hidden
 __start_helper_thread (void)
 {
+#if HAVE_TUNABLES
+  timer_pool.maxworkers = TUNABLE_GET (timer_pool_size, size_t, NULL);
+#else
+  timer_pool.maxworkers = 4;
+#endif
+
   /* The helper thread needs only very little resources
      and should go away automatically when canceled.  */
   pthread_attr_t attr;
@@ -0,0 +1 @@
+#include "tst-aio-uring.c"
@@ -0,0 +1,250 @@
+/* Test asynchronous I/O requests submitted with io_uring.
+   Copyright (C) 2018 Free Software Foundation, Inc.
+   This file is part of the GNU C Library.
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; if not, see
+   <http://www.gnu.org/licenses/>.  */
+
+/* The requests are processed by threads instead if the kernel does not
+   support io_uring, and in tst-aio-uring-disabled.  */
+
+#include <aio.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <support/check.h>
+#include <support/temp_file.h>
+#include <support/xthread.h>
+#include <support/xunistd.h>
+
+enum
+  {
+    /* More than the requests io_uring has in flight.  */
+    request_count = 2000,
+    block_size = 512,
+    file_size = 256 * 1024,
+  };
+
+static int fd;
+static unsigned char contents[file_size];
+
+static struct aiocb cbs[request_count];
+static struct aiocb *list[request_count];
+static unsigned char buffers[request_count][block_size];
+
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t cond = PTHREAD_COND_INITIALIZER;
+
+/* Protected by LOCK.  */
+static unsigned int notified;
+static bool list_notified;
+
+static void
+request_notify (union sigval sv)
+{
+  xpthread_mutex_lock (&lock);
+  ++notified;
+  xpthread_mutex_unlock (&lock);
+}
+
+static void
+list_notify (union sigval sv)
+{
+  xpthread_mutex_lock (&lock);
+  list_notified = true;
+  TEST_COMPARE (pthread_cond_signal (&cond), 0);
+  xpthread_mutex_unlock (&lock);
+}
+
+/* Set up reads of different blocks of the file, all for FD.  */
+static void
+prepare_reads (bool notify)
+{
+  memset (buffers, 0, sizeof (buffers));
+  for (int i = 0; i < request_count; ++i)
+    {
+      memset (&cbs[i], 0, sizeof (cbs[i]));
+      cbs[i].aio_fildes = fd;
+      cbs[i].aio_lio_opcode = LIO_READ;
+      cbs[i].aio_buf = buffers[i];
+      cbs[i].aio_nbytes = block_size;
+      cbs[i].aio_offset = (i * 7 % (file_size / block_size)) * block_size;
+      if (notify)
+	{
+	  cbs[i].aio_sigevent.sigev_notify = SIGEV_THREAD;
+	  cbs[i].aio_sigevent.sigev_notify_function = request_notify;
+	}
+      else
+	cbs[i].aio_sigevent.sigev_notify = SIGEV_NONE;
+      list[i] = &cbs[i];
+    }
+}
+
+static void
+check_reads (void)
+{
+  for (int i = 0; i < request_count; ++i)
+    {
+      TEST_COMPARE (aio_error (&cbs[i]), 0);
+      TEST_COMPARE (aio_return (&cbs[i]), block_size);
+      TEST_VERIFY (memcmp (buffers[i], contents + cbs[i].aio_offset,
+			   block_size) == 0);
+    }
+}
+
+static int
+do_test (void)
+{
+  char *name;
+  fd = create_temp_file ("tst-aio-uring.", &name);
+  TEST_VERIFY_EXIT (fd >= 0);
+  for (int i = 0; i < file_size; ++i)
+    contents[i] = i * 13 + i / 256;
+  xwrite (fd, contents, file_size);
+
+  /* Synchronous lio_listio.  */
+  prepare_reads (false);
+  TEST_COMPARE (lio_listio (LIO_WAIT, list, request_count, NULL), 0);
+  check_reads ();
+
+  /* Asynchronous lio_listio with notifications for the requests and
+     the list.  */
+  prepare_reads (true);
+  struct sigevent sev =
+    {
+      .sigev_notify = SIGEV_THREAD,
+      .sigev_notify_function = list_notify,
+    };
+  TEST_COMPARE (lio_listio (LIO_NOWAIT, list, request_count, &sev), 0);
+  xpthread_mutex_lock (&lock);
+  while (!list_notified)
+    TEST_COMPARE (pthread_cond_wait (&cond, &lock), 0);
+  xpthread_mutex_unlock (&lock);
+  check_reads ();
+  /* The notifications of the requests are sent before the one of the
+     list, but run in threads of their own.  */
+  while (true)
+    {
+      xpthread_mutex_lock (&lock);
+      unsigned int n = notified;
+      xpthread_mutex_unlock (&lock);
+      if (n == request_count)
+	break;
+      TEST_VERIFY_EXIT (n < request_count);
+      usleep (1000);
+    }
+
+  /* aio_write, aio_fsync and aio_suspend.  */
+  static const char message[] = "written with aio_write";
+  struct aiocb wcb =
+    {
+      .aio_fildes = fd,
+      .aio_buf = (void *) message,
+      .aio_nbytes = sizeof (message),
+      .aio_offset = 4096,
+      .aio_sigevent.sigev_notify = SIGEV_NONE,
+    };
+  struct aiocb scb =
+    {
+      .aio_fildes = fd,
+      .aio_sigevent.sigev_notify = SIGEV_NONE,
+    };
+  TEST_COMPARE (aio_write (&wcb), 0);
+  TEST_COMPARE (aio_fsync (O_DSYNC, &scb), 0);
+  const struct aiocb *slist[] = { &scb };
+  while (aio_error (&scb) == EINPROGRESS)
+    TEST_COMPARE (aio_suspend (slist, 1, NULL), 0);
+  TEST_COMPARE (aio_return (&scb), 0);
+  /* The sync request waits for the write.  */
+  TEST_COMPARE (aio_error (&wcb), 0);
+  TEST_COMPARE (aio_return (&wcb), sizeof (message));
+  char buf[sizeof (message)];
+  TEST_COMPARE (pread (fd, buf, sizeof (buf), 4096), sizeof (buf));
+  TEST_VERIFY (memcmp (buf, message, sizeof (buf)) == 0);
+
+  /* More writes for one descriptor than fit into the ring.  The sync
+     request still waits for all of them.  */
+  for (int i = 0; i < request_count; ++i)
+    {
+      memset (&cbs[i], 0, sizeof (cbs[i]));
+      cbs[i].aio_fildes = fd;
+      cbs[i].aio_buf = buffers[i];
+      cbs[i].aio_nbytes = block_size;
+      cbs[i].aio_offset = (i % (file_size / block_size)) * block_size;
+      cbs[i].aio_sigevent.sigev_notify = SIGEV_NONE;
+      memcpy (buffers[i], contents + cbs[i].aio_offset, block_size);
+      TEST_COMPARE (aio_write (&cbs[i]), 0);
+    }
+  TEST_COMPARE (aio_fsync (O_SYNC, &scb), 0);
+  while (aio_error (&scb) == EINPROGRESS)
+    TEST_COMPARE (aio_suspend (slist, 1, NULL), 0);
+  TEST_COMPARE (aio_return (&scb), 0);
+  for (int i = 0; i < request_count; ++i)
+    {
+      TEST_COMPARE (aio_error (&cbs[i]), 0);
+      TEST_COMPARE (aio_return (&cbs[i]), block_size);
+    }
+
+  /* Finished requests cannot be canceled.  */
+  TEST_COMPARE (aio_cancel (fd, &wcb), AIO_ALLDONE);
+  TEST_COMPARE (aio_cancel (fd, NULL), AIO_ALLDONE);
+
+  /* The offset is ignored for pipes.  */
+  int fds[2];
+  xpipe (fds);
+  xwrite (fds[1], message, sizeof (message));
+  struct aiocb pcb =
+    {
+      .aio_fildes = fds[0],
+      .aio_buf = buf,
+      .aio_nbytes = sizeof (buf),
+      .aio_offset = 1234,
+      .aio_sigevent.sigev_notify = SIGEV_NONE,
+    };
+  memset (buf, 0, sizeof (buf));
+  TEST_COMPARE (aio_read (&pcb), 0);
+  const struct aiocb *plist[] = { &pcb };
+  while (aio_error (&pcb) == EINPROGRESS)
+    TEST_COMPARE (aio_suspend (plist, 1, NULL), 0);
+  TEST_COMPARE (aio_error (&pcb), 0);
+  TEST_COMPARE (aio_return (&pcb), sizeof (message));
+  TEST_VERIFY (memcmp (buf, message, sizeof (buf)) == 0);
+  xclose (fds[0]);
+  xclose (fds[1]);
+
+  /* Errors are reported by aio_error.  */
+  struct aiocb bcb =
+    {
+      .aio_fildes = fds[0],
+      .aio_buf = buf,
+      .aio_nbytes = sizeof (buf),
+      .aio_sigevent.sigev_notify = SIGEV_NONE,
+    };
+  TEST_COMPARE (aio_read (&bcb), 0);
+  const struct aiocb *blist[] = { &bcb };
+  while (aio_error (&bcb) == EINPROGRESS)
+    TEST_COMPARE (aio_suspend (blist, 1, NULL), 0);
+  TEST_COMPARE (aio_error (&bcb), EBADF);
+  TEST_COMPARE (aio_return (&bcb), -1);
+
+  xclose (fd);
+  free (name);
+  return 0;
+}
+
+#include <support/test-driver.c>
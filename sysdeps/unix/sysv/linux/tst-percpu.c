@@ -0,0 +1,288 @@
+/* Test the per-CPU operations of <sys/percpu.h>.
+   Copyright (C) 2018 Free Software Foundation, Inc.
+   This file is part of the GNU C Library.
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; if not, see
+   <http://www.gnu.org/licenses/>.  */
+
+#include <sched.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/percpu.h>
+#include <sys/syscall.h>
+#include <support/check.h>
+#include <support/support.h>
+#include <support/xthread.h>
+
+#ifdef __NR_rseq
+# include <linux/rseq.h>
+
+extern __thread volatile struct rseq __rseq_abi
+__attribute__ ((tls_model ("initial-exec")));
+
+static bool
+rseq_registered (void)
+{
+  return (int32_t) __rseq_abi.cpu_id >= 0;
+}
+#else
+static bool
+rseq_registered (void)
+{
+  return false;
+}
+#endif
+
+enum
+  {
+    max_cpus = 1024,
+    thread_count = 8,
+    iterations = 100000,
+    node_count = 64,
+  };
+
+/* Per-CPU data is kept on separate cache lines.  */
+struct slot
+{
+  intptr_t counter;
+  intptr_t version;
+  struct percpu_list_head list;
+  char data[32];
+} __attribute__ ((aligned (64)));
+
+static struct slot slots[max_cpus];
+
+static int
+current_cpu (void)
+{
+  int cpu = percpu_current_cpu ();
+  TEST_VERIFY_EXIT (cpu >= 0 && cpu < max_cpus);
+  return cpu;
+}
+
+struct list_node
+{
+  struct percpu_list_node node;
+  /* Number of times the node was popped.  Only modified by the thread
+     which popped it.  */
+  unsigned long int pops;
+  bool seen;
+};
+
+static struct list_node nodes[node_count];
+
+/* Counts of the successful operations of all threads.  */
+static unsigned long int total_pops;
+static unsigned long int total_commits;
+
+static void *
+thread_function (void *closure)
+{
+  unsigned long int pops = 0;
+  unsigned long int commits = 0;
+
+  for (int i = 0; i < iterations; ++i)
+    {
+      int cpu;
+
+      /* Counter.  */
+      do
+	cpu = current_cpu ();
+      while (percpu_add (&slots[cpu].counter, 1, cpu) != 0);
+
+      /* Compare-and-store, incrementing the same counter.  */
+      while (true)
+	{
+	  cpu = current_cpu ();
+	  intptr_t old = __atomic_load_n (&slots[cpu].counter, __ATOMIC_RELAXED);
+	  if (percpu_cmpstore (&slots[cpu].counter, old, old + 1, cpu) == 0)
+	    break;
+	}
+
+      /* Move a node from the list of the current CPU back to it.  */
+      struct percpu_list_node *node;
+      int ret;
+      do
+	{
+	  cpu = current_cpu ();
+	  ret = percpu_list_pop (&slots[cpu].list, &node, cpu);
+	}
+      while (ret < 0);
+      if (ret == 0)
+	{
+	  struct list_node *n = (struct list_node *) node;
+	  ++n->pops;
+	  ++pops;
+	  do
+	    cpu = current_cpu ();
+	  while (percpu_list_push (&slots[cpu].list, node, cpu) != 0);
+	}
+
+      /* Copy a buffer and bump the version.  */
+      char buffer[sizeof (slots[0].data)];
+      memset (buffer, i, sizeof (buffer));
+      while (true)
+	{
+	  cpu = current_cpu ();
+	  intptr_t old = __atomic_load_n (&slots[cpu].version, __ATOMIC_RELAXED);
+	  if (percpu_memcpy_commit (&slots[cpu].version, old,
+				    slots[cpu].data, buffer, sizeof (buffer),
+				    old + 1, cpu) == 0)
+	    break;
+	}
+      ++commits;
+    }
+
+  __atomic_fetch_add (&total_pops, pops, __ATOMIC_RELAXED);
+  __atomic_fetch_add (&total_commits, commits, __ATOMIC_RELAXED);
+  return NULL;
+}
+
+/* Check the operations on a single thread, including their failure
+   results.  */
+static void
+test_single_thread (void)
+{
+  intptr_t value = 5;
+  int cpu = current_cpu ();
+
+  /* Pin the thread, so that no operation is aborted because of a
+     migration.  Preemption or signals can still abort one, so retry on
+     -1.  */
+  cpu_set_t set;
+  CPU_ZERO (&set);
+  CPU_SET (cpu, &set);
+  bool pinned = sched_setaffinity (0, sizeof (set), &set) == 0;
+  if (pinned)
+    cpu = current_cpu ();
+
+  int ret;
+  while ((ret = percpu_cmpstore (&value, 4, 6, cpu)) < 0)
+    ;
+  TEST_COMPARE (ret, 1);
+  TEST_COMPARE (value, 5);
+  while ((ret = percpu_cmpstore (&value, 5, 6, cpu)) < 0)
+    ;
+  TEST_COMPARE (ret, 0);
+  TEST_COMPARE (value, 6);
+  while ((ret = percpu_add (&value, -10, cpu)) < 0)
+    ;
+  TEST_COMPARE (value, -4);
+
+  struct percpu_list_head head = { NULL };
+  struct percpu_list_node a, b, *node = NULL;
+  while ((ret = percpu_list_pop (&head, &node, cpu)) < 0)
+    ;
+  TEST_COMPARE (ret, 1);
+  TEST_VERIFY (node == NULL);
+  while (percpu_list_push (&head, &a, cpu) < 0)
+    ;
+  while (percpu_list_push (&head, &b, cpu) < 0)
+    ;
+  while ((ret = percpu_list_pop (&head, &node, cpu)) < 0)
+    ;
+  TEST_COMPARE (ret, 0);
+  TEST_VERIFY (node == &b);
+  while ((ret = percpu_list_pop (&head, &node, cpu)) < 0)
+    ;
+  TEST_COMPARE (ret, 0);
+  TEST_VERIFY (node == &a);
+  TEST_VERIFY (head.head == NULL);
+
+  char dst[16] = "";
+  while ((ret = percpu_memcpy_commit (&value, 0, dst, "abc", 4, 1, cpu)) < 0)
+    ;
+  TEST_COMPARE (ret, 1);
+  TEST_VERIFY (dst[0] == '\0');
+  while ((ret = percpu_memcpy_commit (&value, -4, dst, "abc", 4, 1,
+				      cpu)) < 0)
+    ;
+  TEST_COMPARE (ret, 0);
+  TEST_VERIFY (strcmp (dst, "abc") == 0);
+  TEST_COMPARE (value, 1);
+
+  /* With restartable sequences, an operation for another CPU is
+     never committed.  */
+  if (pinned && rseq_registered ())
+    {
+      int other = cpu + 1;
+      TEST_COMPARE (percpu_add (&value, 1, other), -1);
+      TEST_COMPARE (percpu_cmpstore (&value, 1, 2, other), -1);
+      TEST_COMPARE (percpu_list_push (&head, &a, other), -1);
+      TEST_VERIFY (head.head == NULL);
+      TEST_COMPARE (value, 1);
+    }
+}
+
+static void *
+single_thread_function (void *closure)
+{
+  test_single_thread ();
+  return NULL;
+}
+
+static int
+do_test (void)
+{
+  printf ("info: restartable sequences %s\n",
+	  rseq_registered () ? "registered" : "not registered");
+
+  /* Run the single-threaded checks on a separate thread because they
+     change the affinity mask.  */
+  xpthread_join (xpthread_create (NULL, single_thread_function, NULL));
+
+  /* Distribute the nodes over the lists of the CPUs.  */
+  for (int i = 0; i < node_count; ++i)
+    {
+      struct slot *s = &slots[i % 4];
+      nodes[i].node.next = s->list.head;
+      s->list.head = &nodes[i].node;
+    }
+
+  pthread_t threads[thread_count];
+  for (int i = 0; i < thread_count; ++i)
+    threads[i] = xpthread_create (NULL, thread_function, NULL);
+  for (int i = 0; i < thread_count; ++i)
+    xpthread_join (threads[i]);
+
+  intptr_t counter = 0;
+  intptr_t version = 0;
+  unsigned long int found = 0;
+  unsigned long int pops = 0;
+  for (int cpu = 0; cpu < max_cpus; ++cpu)
+    {
+      counter += slots[cpu].counter;
+      version += slots[cpu].version;
+      for (struct percpu_list_node *n = slots[cpu].list.head; n != NULL;
+	   n = n->next)
+	{
+	  struct list_node *ln = (struct list_node *) n;
+	  TEST_VERIFY_EXIT (!ln->seen);
+	  ln->seen = true;
+	  pops += ln->pops;
+	  ++found;
+	}
+    }
+  TEST_COMPARE (counter, 2 * thread_count * iterations);
+  TEST_COMPARE (version, thread_count * iterations);
+  TEST_COMPARE (total_commits, thread_count * iterations);
+  TEST_COMPARE (found, node_count);
+  TEST_COMPARE (pops, total_pops);
+
+  return 0;
+}
+
+#include <support/test-driver.c>
@@ -0,0 +1,152 @@
+/* Test the worker pool for SIGEV_THREAD timer notifications.
+   Copyright (C) 2018 Free Software Foundation, Inc.
+   This file is part of the GNU C Library.
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; if not, see
+   <http://www.gnu.org/licenses/>.  */
+
+#include <pthread.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+#include <support/check.h>
+#include <support/xthread.h>
+
+enum
+  {
+    timer_count = 16,
+    /* Notifications of each timer.  */
+    expirations = 50,
+    max_tids = 1024,
+  };
+
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t cond = PTHREAD_COND_INITIALIZER;
+
+/* Protected by LOCK.  */
+static unsigned int calls[timer_count + 1];
+static pid_t tids[max_tids];
+static unsigned int tid_count;
+static bool bad_stacksize;
+static bool blocked_signal;
+
+static size_t stacksize = 512 * 1024;
+
+static void
+notify (union sigval sv)
+{
+  int i = sv.sival_int;
+  pid_t tid = syscall (SYS_gettid);
+
+  /* The function runs with all signals unblocked, even in a worker
+     which ran a function that blocked them.  */
+  sigset_t ss;
+  TEST_COMPARE (pthread_sigmask (SIG_BLOCK, NULL, &ss), 0);
+  bool blocked = sigismember (&ss, SIGUSR1);
+  sigaddset (&ss, SIGUSR1);
+  TEST_COMPARE (pthread_sigmask (SIG_SETMASK, &ss, NULL), 0);
+
+  /* The timer with attributes gets a thread with these attributes.  */
+  bool wrong_stack = false;
+  if (i == timer_count)
+    {
+      pthread_attr_t attr;
+      size_t size;
+      TEST_COMPARE (pthread_getattr_np (pthread_self (), &attr), 0);
+      TEST_COMPARE (pthread_attr_getstacksize (&attr, &size), 0);
+      TEST_COMPARE (pthread_attr_destroy (&attr), 0);
+      wrong_stack = size != stacksize;
+    }
+
+  xpthread_mutex_lock (&lock);
+  ++calls[i];
+  blocked_signal |= blocked;
+  bad_stacksize |= wrong_stack;
+  unsigned int j;
+  for (j = 0; j < tid_count; ++j)
+    if (tids[j] == tid)
+      break;
+  if (j == tid_count && tid_count < max_tids)
+    tids[tid_count++] = tid;
+  TEST_COMPARE (pthread_cond_signal (&cond), 0);
+  xpthread_mutex_unlock (&lock);
+}
+
+static bool
+all_done (void)
+{
+  for (int i = 0; i <= timer_count; ++i)
+    if (calls[i] < expirations)
+      return false;
+  return true;
+}
+
+static int
+do_test (void)
+{
+  timer_t timers[timer_count + 1];
+  pthread_attr_t attr;
+  xpthread_attr_init (&attr);
+  xpthread_attr_setstacksize (&attr, stacksize);
+
+  for (int i = 0; i <= timer_count; ++i)
+    {
+      struct sigevent sev =
+	{
+	  .sigev_notify = SIGEV_THREAD,
+	  .sigev_notify_function = notify,
+	  .sigev_notify_attributes = i == timer_count ? &attr : NULL,
+	  .sigev_value.sival_int = i,
+	};
+      TEST_COMPARE (timer_create (CLOCK_MONOTONIC, &sev, &timers[i]), 0);
+    }
+  xpthread_attr_destroy (&attr);
+
+  struct itimerspec its =
+    {
+      .it_value = { 0, 1000 * 1000 },
+      .it_interval = { 0, 1000 * 1000 },
+    };
+  for (int i = 0; i <= timer_count; ++i)
+    TEST_COMPARE (timer_settime (timers[i], 0, &its, NULL), 0);
+
+  xpthread_mutex_lock (&lock);
+  while (!all_done ())
+    TEST_COMPARE (pthread_cond_wait (&cond, &lock), 0);
+  xpthread_mutex_unlock (&lock);
+
+  /* Notifications may still be running when the timers are
+     deleted.  */
+  for (int i = 0; i <= timer_count; ++i)
+    TEST_COMPARE (timer_delete (timers[i]), 0);
+
+  xpthread_mutex_lock (&lock);
+  TEST_VERIFY (!blocked_signal);
+  TEST_VERIFY (!bad_stacksize);
+  unsigned int total = 0;
+  for (int i = 0; i <= timer_count; ++i)
+    total += calls[i];
+  /* Without the pool, each notification would have a thread of its
+     own.  */
+  printf ("info: %u notifications ran on %u threads\n", total, tid_count);
+  TEST_VERIFY (tid_count < total / 2);
+  xpthread_mutex_unlock (&lock);
+
+  return 0;
+}
+
+#include <support/test-driver.c>
@@ -0,0 +1,164 @@
+/* Restartable sequences for the per-CPU operations.  x86-64 version.
+   Copyright (C) 2018 Free Software Foundation, Inc.
+   This file is part of the GNU C Library.
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; if not, see
+   <http://www.gnu.org/licenses/>.  */
+
+#ifndef _PERCPU_RSEQ_H
+#define _PERCPU_RSEQ_H
+
+#include <sysdep.h>
+
+#ifndef __NR_rseq
+# include <sysdeps/unix/sysv/linux/percpu-rseq.h>
+#else
+
+# include <linux/rseq.h>
+# include <sysdeps/unix/sysv/linux/rseq-internal.h>
+
+# define PERCPU_HAVE_RSEQ 1
+
+/* Each critical section consists of:
+
+   - a struct rseq_cs descriptor (label 3) in the __rseq_cs section,
+     giving the start of the section (label 1), the length up to the
+     end of the committing instruction (label 2), and the abort
+     handler (label 4);
+   - the store of the descriptor address to __rseq_abi.rseq_cs,
+     followed by the check that the thread still runs on the requested
+     CPU;
+   - the operation proper, ending with a single committing store;
+   - the abort handler, placed out of line in the __rseq_failure
+     section after the RSEQ_SIG signature the kernel checks before
+     jumping to it.
+
+   The kernel moves the thread to the abort handler if it is preempted,
+   migrated or interrupted by a signal between labels 1 and 2.  */
+
+# define PERCPU_RSEQ_STR_1(x) #x
+# define PERCPU_RSEQ_STR(x) PERCPU_RSEQ_STR_1 (x)
+
+# define PERCPU_RSEQ_START						\
+  ".pushsection __rseq_cs, \"aw\"\n\t"					\
+  ".balign 32\n"							\
+  "3:\n\t"								\
+  ".long 0, 0\n\t"							\
+  ".quad 1f, 2f - 1f, 4f\n\t"						\
+  ".popsection\n\t"							\
+  "leaq 3b(%%rip), %%rax\n\t"						\
+  "movq %%rax, 8(%[rseq_abi])\n"					\
+  "1:\n\t"								\
+  "cmpl %[cpu], 4(%[rseq_abi])\n\t"					\
+  "jnz 4f\n\t"
+
+# define PERCPU_RSEQ_END						\
+  "2:\n\t"								\
+  ".pushsection __rseq_failure, \"ax\"\n\t"				\
+  ".long " PERCPU_RSEQ_STR (RSEQ_SIG) "\n"				\
+  "4:\n\t"								\
+  "jmp %l[abort]\n\t"							\
+  ".popsection\n\t"
+
+static inline int
+percpu_rseq_add (intptr_t *v, intptr_t count, int cpu)
+{
+  asm goto (PERCPU_RSEQ_START
+	    "addq %[count], %[v]\n"
+	    PERCPU_RSEQ_END
+	    :
+	    : [rseq_abi] "r" (&__rseq_abi), [cpu] "r" (cpu),
+	      [v] "m" (*v), [count] "er" (count)
+	    : "memory", "cc", "rax"
+	    : abort);
+  return 0;
+ abort:
+  return -1;
+}
+
+static inline int
+percpu_rseq_cmpstore (intptr_t *v, intptr_t expect, intptr_t newv, int cpu)
+{
+  asm goto (PERCPU_RSEQ_START
+	    "cmpq %[v], %[expect]\n\t"
+	    "jnz %l[cmpfail]\n\t"
+	    "movq %[newv], %[v]\n"
+	    PERCPU_RSEQ_END
+	    :
+	    : [rseq_abi] "r" (&__rseq_abi), [cpu] "r" (cpu),
+	      [v] "m" (*v), [expect] "r" (expect), [newv] "r" (newv)
+	    : "memory", "cc", "rax"
+	    : abort, cmpfail);
+  return 0;
+ abort:
+  return -1;
+ cmpfail:
+  return 1;
+}
+
+/* The next pointer is at offset 0 of struct percpu_list_node.  */
+static inline int
+percpu_rseq_list_pop (struct percpu_list_head *head,
+		      struct percpu_list_node **node, int cpu)
+{
+  asm goto (PERCPU_RSEQ_START
+	    "movq %[head], %%rax\n\t"
+	    "testq %%rax, %%rax\n\t"
+	    "jz %l[empty]\n\t"
+	    "movq %%rax, %[node]\n\t"
+	    "movq (%%rax), %%rax\n\t"
+	    "movq %%rax, %[head]\n"
+	    PERCPU_RSEQ_END
+	    :
+	    : [rseq_abi] "r" (&__rseq_abi), [cpu] "r" (cpu),
+	      [head] "m" (head->head), [node] "m" (*node)
+	    : "memory", "cc", "rax"
+	    : abort, empty);
+  return 0;
+ abort:
+  return -1;
+ empty:
+  return 1;
+}
+
+static inline int
+percpu_rseq_memcpy_commit (intptr_t *v, intptr_t expect, void *dst,
+			   const void *src, size_t len, intptr_t newv,
+			   int cpu)
+{
+  asm goto (PERCPU_RSEQ_START
+	    "cmpq %[v], %[expect]\n\t"
+	    "jnz %l[cmpfail]\n\t"
+	    "movq %[dst], %%rdi\n\t"
+	    "movq %[src], %%rsi\n\t"
+	    "movq %[len], %%rcx\n\t"
+	    "rep movsb\n\t"
+	    "movq %[newv], %[v]\n"
+	    PERCPU_RSEQ_END
+	    :
+	    : [rseq_abi] "r" (&__rseq_abi), [cpu] "r" (cpu),
+	      [v] "m" (*v), [expect] "r" (expect), [newv] "r" (newv),
+	      [dst] "r" (dst), [src] "r" (src), [len] "r" (len)
+	    : "memory", "cc", "rax", "rcx", "rsi", "rdi"
+	    : abort, cmpfail);
+  return 0;
+ abort:
+  return -1;
+ cmpfail:
+  return 1;
+}
+
+#endif /* __NR_rseq */
+
+#endif /* percpu-rseq.h */